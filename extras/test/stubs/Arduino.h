@@ -0,0 +1,61 @@
+//
+// host stand-in for the parts of the Teensy core used by TeensyUserInterface, time is
+// simulated: tests set fakeMillis and fakeMicros rather than waiting
+//
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+extern unsigned long fakeMillis;
+extern unsigned long fakeMicros;
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void yield(void);
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#ifndef min
+#define min(a, b) ({ __typeof__(a) _a = (a); __typeof__(b) _b = (b); (_a < _b) ? _a : _b; })
+#define max(a, b) ({ __typeof__(a) _a = (a); __typeof__(b) _b = (b); (_a > _b) ? _a : _b; })
+#endif
+
+char *itoa(int value, char *s, int radix);
+char *dtostrf(double value, signed char width, unsigned char precision, char *s);
+
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define FALLING 2
+#define digitalPinToInterrupt(p) (p)
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void attachInterrupt(uint8_t irq, void (*function)(void), int mode);
+void detachInterrupt(uint8_t irq);
+
+//
+// interrupts can't happen on the host, the count of nested disables lets a test check
+// that a region was guarded
+//
+extern int stubInterruptsDisabled;
+#define __disable_irq() (stubInterruptsDisabled++)
+#define __enable_irq() (stubInterruptsDisabled--)
+#define noInterrupts() __disable_irq()
+#define interrupts() __enable_irq()
+
+class Print
+{
+  public:
+    virtual size_t write(uint8_t c) = 0;
+    size_t print(const char *s) { size_t n = 0; while (*s) n += write(*s++); return(n); }
+};
+
+#endif
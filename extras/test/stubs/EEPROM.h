@@ -0,0 +1,21 @@
+//
+// host stand-in for the EEPROM library, backed by the stubEEPROM array
+//
+
+#ifndef EEPROM_h
+#define EEPROM_h
+
+#include "Arduino.h"
+
+extern uint8_t stubEEPROM[4096];
+
+struct EEPROMClass
+{
+  uint8_t read(int address) { return(stubEEPROM[address]); }
+  void write(int address, uint8_t value) { stubEEPROM[address] = value; }
+  uint16_t length(void) { return(sizeof(stubEEPROM)); }
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
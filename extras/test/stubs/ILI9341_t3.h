@@ -0,0 +1,122 @@
+//
+// host stand-in for the ILI9341_t3 display driver, it keeps a copy of the panel's memory
+// and counts what would have been sent over SPI
+//
+// Drawing functions follow the real driver: each filled run costs an address window
+// (CASET + PASET) and a RAMWR command, and fillCircle(), fillRoundRect() and
+// fillTriangle() are built from vertical or horizontal lines the same way.  The panel is
+// kept in the coordinates of the current rotation.  The vertical scrolling registers
+// (VSCRDEF and VSCRSADD) are kept too, stubMemoryRowShown() applies them.
+//
+
+#ifndef ILI9341_t3_h
+#define ILI9341_t3_h
+
+#include "Arduino.h"
+
+typedef struct {
+  const unsigned char *index;
+  const unsigned char *unicode;
+  const unsigned char *data;
+  unsigned char version;
+  unsigned char reserved;
+  unsigned char index1_first;
+  unsigned char index1_last;
+  unsigned char index2_first;
+  unsigned char index2_last;
+  unsigned char bits_index;
+  unsigned char bits_width;
+  unsigned char bits_height;
+  unsigned char bits_xoffset;
+  unsigned char bits_yoffset;
+  unsigned char bits_delta;
+  unsigned char line_space;
+  unsigned char cap_height;
+} ILI9341_t3_font_t;
+
+#define ILI9341_TFTWIDTH  240
+#define ILI9341_TFTHEIGHT 320
+#define ILI9341_CASET     0x2A
+#define ILI9341_PASET     0x2B
+#define ILI9341_RAMWR     0x2C
+#define ILI9341_VSCRDEF   0x33
+#define ILI9341_VSCRSADD  0x37
+
+//
+// the panel's memory and the SPI traffic sent to it
+//
+extern uint16_t stubPanel[ILI9341_TFTWIDTH * ILI9341_TFTHEIGHT];
+extern long stubSpiCommands;                // command bytes: CASET, PASET, RAMWR...
+extern long stubSpiPixels;                  // 16 bit pixel words written to RAMWR
+extern long stubDriverCalls;                // calls to the driver's drawing functions
+extern unsigned long stubNanosecondsPerWord;  // simulated time for each 16 bit word sent
+void stubClearSpiCounts(void);
+
+//
+// the vertical scrolling registers, in the panel's own rows (rotation 0)
+//
+extern int stubScrollTopFixedRows;
+extern int stubScrollRows;
+extern int stubScrollBottomFixedRows;
+extern int stubScrollStartRow;
+int stubMemoryRowShown(int line);
+
+
+class ILI9341_t3 : public Print
+{
+  public:
+    ILI9341_t3(uint8_t cs, uint8_t dc, uint8_t rst = 255, uint8_t mosi = 11, uint8_t sclk = 13, uint8_t miso = 12);
+    void begin(void);
+    void setRotation(uint8_t r);
+    int16_t width(void) { return(_width); }
+    int16_t height(void) { return(_height); }
+    void fillScreen(uint16_t color);
+    void drawPixel(int16_t x, int16_t y, uint16_t color);
+    void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color);
+    void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color);
+    void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color);
+    void drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+    void drawRoundRect(int16_t x, int16_t y, int16_t w, int16_t h, int16_t r, uint16_t color);
+    void drawTriangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint16_t color);
+    void drawCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color);
+    void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+    void fillRoundRect(int16_t x, int16_t y, int16_t w, int16_t h, int16_t r, uint16_t color);
+    void fillTriangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint16_t color);
+    void fillCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color);
+    void writeRect(int16_t x, int16_t y, int16_t w, int16_t h, const uint16_t *pcolors);
+    void readRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t *pcolors);
+    void setFont(const ILI9341_t3_font_t &f) { font = &f; }
+    void setTextColor(uint16_t c) { textcolor = c; }
+    void setCursor(int16_t x, int16_t y) { cursor_x = x; cursor_y = y; }
+    void getCursor(int16_t *x, int16_t *y) { *x = cursor_x; *y = cursor_y; }
+    void drawFontChar(unsigned int c);
+    uint16_t strPixelLen(char *str);
+    void setScroll(uint16_t offset);
+    virtual size_t write(uint8_t c);
+
+  protected:
+    int16_t _width, _height;
+    int16_t cursor_x, cursor_y;
+    uint16_t textcolor;
+    const ILI9341_t3_font_t *font;
+    void beginSPITransaction(void) {}
+    void endSPITransaction(void) {}
+    void setAddr(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1);
+    void writecommand_cont(uint8_t c);
+    void writecommand_last(uint8_t c) { writecommand_cont(c); }
+    void writedata8_cont(uint8_t) {}
+    void writedata8_last(uint8_t) {}
+    void writedata16_cont(uint16_t d);
+    void writedata16_last(uint16_t d) { writedata16_cont(d); }
+
+  private:
+    int windowX1, windowY1, windowX2, windowY2;
+    int writeX, writeY;
+    bool ramWriteFlg;
+    void fillWindow(int x, int y, int w, int h, uint16_t color);
+    void fillCircleHelper(int16_t x0, int16_t y0, int16_t r, uint8_t corners, int16_t delta, uint16_t color);
+    void drawCircleHelper(int16_t x0, int16_t y0, int16_t r, uint8_t corners, uint16_t color);
+    int fontDelta(unsigned int c);
+};
+
+#endif
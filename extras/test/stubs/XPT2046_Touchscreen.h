@@ -0,0 +1,48 @@
+//
+// host stand-in for the XPT2046_Touchscreen driver
+//
+// The test sets what the panel is doing with stubTouched and stubRawX/Y/Z.  Reads are
+// throttled like the real driver: after a good read, touched() and getPoint() return the
+// same values for 3 ms without using SPI.  With an IRQ pin, no read is made after the
+// pen comes up until the pen-down interrupt fires again.  stubTouchScreenReads counts
+// the reads that would have used SPI.
+//
+
+#ifndef _XPT2046_Touchscreen_h_
+#define _XPT2046_Touchscreen_h_
+
+#include "Arduino.h"
+
+extern int stubTouched;
+extern int stubRawX, stubRawY, stubRawZ;
+extern long stubTouchScreenReads;
+extern void (*stubTouchHook)(void);
+
+class TS_Point
+{
+  public:
+    TS_Point(void) : x(0), y(0), z(0) {}
+    TS_Point(int16_t x, int16_t y, int16_t z) : x(x), y(y), z(z) {}
+    int16_t x, y, z;
+};
+
+
+class XPT2046_Touchscreen
+{
+  public:
+    XPT2046_Touchscreen(uint8_t cspin, uint8_t tirq = 255);
+    bool begin(void);
+    TS_Point getPoint(void);
+    bool tirqTouched(void);
+    bool touched(void);
+    void setRotation(uint8_t) {}
+
+  private:
+    void update(void);
+    uint8_t tirqPin;
+    bool isrWake;
+    int16_t xraw, yraw, zraw;
+    uint32_t msraw;
+};
+
+#endif
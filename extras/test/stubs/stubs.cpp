@@ -0,0 +1,506 @@
+//
+// host stand-ins for the Teensy core, ILI9341_t3, XPT2046_Touchscreen and EEPROM
+//
+
+#include "Arduino.h"
+#include "ILI9341_t3.h"
+#include "XPT2046_Touchscreen.h"
+#include "EEPROM.h"
+
+
+// ---------------------------------------------------------------------------------
+//                                  Teensy core
+// ---------------------------------------------------------------------------------
+
+unsigned long fakeMillis = 0;
+unsigned long fakeMicros = 0;
+int stubInterruptsDisabled = 0;
+
+unsigned long millis(void) { return(fakeMillis); }
+unsigned long micros(void) { return(fakeMicros); }
+void delay(unsigned long ms) { fakeMillis += ms; fakeMicros += ms * 1000; }
+void yield(void) {}
+
+char *itoa(int value, char *s, int) { sprintf(s, "%d", value); return(s); }
+char *dtostrf(double value, signed char width, unsigned char precision, char *s)
+  { sprintf(s, "%*.*f", width, precision, value); return(s); }
+
+void pinMode(uint8_t, uint8_t) {}
+int digitalRead(uint8_t) { return(1); }
+void attachInterrupt(uint8_t, void (*)(void), int) {}
+void detachInterrupt(uint8_t) {}
+
+
+// ---------------------------------------------------------------------------------
+//                                   ILI9341_t3
+// ---------------------------------------------------------------------------------
+
+uint16_t stubPanel[ILI9341_TFTWIDTH * ILI9341_TFTHEIGHT];
+long stubSpiCommands = 0;
+long stubSpiPixels = 0;
+long stubDriverCalls = 0;
+unsigned long stubNanosecondsPerWord = 0;
+static unsigned long stubNanosecondRemainder = 0;
+int stubScrollTopFixedRows = 0;
+int stubScrollRows = ILI9341_TFTHEIGHT;
+int stubScrollBottomFixedRows = 0;
+int stubScrollStartRow = 0;
+static uint8_t stubCommand = 0;
+static int stubDataWords = 0;
+
+
+void stubClearSpiCounts(void)
+{
+  stubSpiCommands = 0;
+  stubSpiPixels = 0;
+  stubDriverCalls = 0;
+}
+
+
+
+//
+// the row of the panel's memory shown on a line of the glass, both in the panel's own
+// rows (rotation 0), as the vertical scrolling registers set them
+//
+int stubMemoryRowShown(int line)
+{
+  if ((line < stubScrollTopFixedRows) || (line >= stubScrollTopFixedRows + stubScrollRows))
+    return(line);
+
+  int row = (line - stubScrollTopFixedRows) + (stubScrollStartRow - stubScrollTopFixedRows);
+  row %= stubScrollRows;
+  if (row < 0)
+    row += stubScrollRows;
+  return(stubScrollTopFixedRows + row);
+}
+
+
+
+//
+// advance simulated time for one 16 bit word sent over SPI
+//
+static void stubSendWord(void)
+{
+  stubNanosecondRemainder += stubNanosecondsPerWord;
+  while (stubNanosecondRemainder >= 1000)
+  {
+    stubNanosecondRemainder -= 1000;
+    fakeMicros++;
+    fakeMillis = fakeMicros / 1000;
+  }
+}
+
+
+
+ILI9341_t3::ILI9341_t3(uint8_t, uint8_t, uint8_t, uint8_t, uint8_t, uint8_t)
+{
+  _width = ILI9341_TFTWIDTH;
+  _height = ILI9341_TFTHEIGHT;
+  cursor_x = cursor_y = 0;
+  textcolor = 0xffff;
+  font = NULL;
+  ramWriteFlg = false;
+}
+
+void ILI9341_t3::begin(void) {}
+
+void ILI9341_t3::setRotation(uint8_t r)
+{
+  _width = (r & 1) ? ILI9341_TFTHEIGHT : ILI9341_TFTWIDTH;
+  _height = (r & 1) ? ILI9341_TFTWIDTH : ILI9341_TFTHEIGHT;
+}
+
+void ILI9341_t3::setScroll(uint16_t) {}
+
+
+
+void ILI9341_t3::setAddr(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1)
+{
+  stubSpiCommands += 2;
+  stubSendWord();
+  stubSendWord();
+  stubSendWord();
+  stubSendWord();
+  windowX1 = x0;
+  windowY1 = y0;
+  windowX2 = x1;
+  windowY2 = y1;
+}
+
+void ILI9341_t3::writecommand_cont(uint8_t c)
+{
+  stubSpiCommands++;
+  ramWriteFlg = (c == ILI9341_RAMWR);
+  stubCommand = c;
+  stubDataWords = 0;
+  writeX = windowX1;
+  writeY = windowY1;
+}
+
+void ILI9341_t3::writedata16_cont(uint16_t d)
+{
+  stubSendWord();
+  if (!ramWriteFlg)
+  {
+    //
+    // VSCRDEF is followed by the top fixed, scrolling and bottom fixed rows, VSCRSADD
+    // by the start row
+    //
+    if (stubCommand == ILI9341_VSCRDEF)
+    {
+      if (stubDataWords == 0)
+        stubScrollTopFixedRows = d;
+      else if (stubDataWords == 1)
+        stubScrollRows = d;
+      else if (stubDataWords == 2)
+        stubScrollBottomFixedRows = d;
+    }
+    else if ((stubCommand == ILI9341_VSCRSADD) && (stubDataWords == 0))
+      stubScrollStartRow = d;
+    stubDataWords++;
+    return;
+  }
+
+  stubSpiPixels++;
+  if ((writeX >= 0) && (writeX < _width) && (writeY >= 0) && (writeY < _height))
+    stubPanel[writeY * _width + writeX] = d;
+  if (++writeX > windowX2)
+  {
+    writeX = windowX1;
+    writeY++;
+  }
+}
+
+
+
+//
+// fill a clipped rectangle with one address window, as the driver's fillRect() does
+//
+void ILI9341_t3::fillWindow(int x, int y, int w, int h, uint16_t color)
+{
+  if (x < 0) { w += x; x = 0; }
+  if (y < 0) { h += y; y = 0; }
+  if (x + w > _width) w = _width - x;
+  if (y + h > _height) h = _height - y;
+  if ((w <= 0) || (h <= 0))
+    return;
+  setAddr(x, y, x + w - 1, y + h - 1);
+  writecommand_cont(ILI9341_RAMWR);
+  for (long count = (long)w * h; count > 0; count--)
+    writedata16_cont(color);
+}
+
+
+
+void ILI9341_t3::fillScreen(uint16_t color) { stubDriverCalls++; fillWindow(0, 0, _width, _height, color); }
+void ILI9341_t3::drawPixel(int16_t x, int16_t y, uint16_t color) { stubDriverCalls++; fillWindow(x, y, 1, 1, color); }
+void ILI9341_t3::drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) { stubDriverCalls++; fillWindow(x, y, w, 1, color); }
+void ILI9341_t3::drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) { stubDriverCalls++; fillWindow(x, y, 1, h, color); }
+void ILI9341_t3::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) { stubDriverCalls++; fillWindow(x, y, w, h, color); }
+
+void ILI9341_t3::drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+{
+  stubDriverCalls++;
+  fillWindow(x, y, w, 1, color);
+  fillWindow(x, y + h - 1, w, 1, color);
+  fillWindow(x, y, 1, h, color);
+  fillWindow(x + w - 1, y, 1, h, color);
+}
+
+void ILI9341_t3::drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color)
+{
+  stubDriverCalls++;
+  int dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+  int dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+  int err = dx + dy;
+  while (true)
+  {
+    fillWindow(x0, y0, 1, 1, color);
+    if ((x0 == x1) && (y0 == y1))
+      break;
+    int e2 = 2 * err;
+    if (e2 >= dy) { err += dy; x0 += sx; }
+    if (e2 <= dx) { err += dx; y0 += sy; }
+  }
+}
+
+void ILI9341_t3::drawCircleHelper(int16_t x0, int16_t y0, int16_t r, uint8_t corners, uint16_t color)
+{
+  int f = 1 - r, ddF_x = 1, ddF_y = -2 * r, x = 0, y = r;
+  while (x < y)
+  {
+    if (f >= 0) { y--; ddF_y += 2; f += ddF_y; }
+    x++; ddF_x += 2; f += ddF_x;
+    if (corners & 0x4) { fillWindow(x0 + x, y0 + y, 1, 1, color); fillWindow(x0 + y, y0 + x, 1, 1, color); }
+    if (corners & 0x2) { fillWindow(x0 + x, y0 - y, 1, 1, color); fillWindow(x0 + y, y0 - x, 1, 1, color); }
+    if (corners & 0x8) { fillWindow(x0 - y, y0 + x, 1, 1, color); fillWindow(x0 - x, y0 + y, 1, 1, color); }
+    if (corners & 0x1) { fillWindow(x0 - y, y0 - x, 1, 1, color); fillWindow(x0 - x, y0 - y, 1, 1, color); }
+  }
+}
+
+void ILI9341_t3::drawCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color)
+{
+  stubDriverCalls++;
+  fillWindow(x0, y0 + r, 1, 1, color);
+  fillWindow(x0, y0 - r, 1, 1, color);
+  fillWindow(x0 + r, y0, 1, 1, color);
+  fillWindow(x0 - r, y0, 1, 1, color);
+  drawCircleHelper(x0, y0, r, 0xf, color);
+}
+
+void ILI9341_t3::drawRoundRect(int16_t x, int16_t y, int16_t w, int16_t h, int16_t r, uint16_t color)
+{
+  stubDriverCalls++;
+  fillWindow(x + r, y, w - 2 * r, 1, color);
+  fillWindow(x + r, y + h - 1, w - 2 * r, 1, color);
+  fillWindow(x, y + r, 1, h - 2 * r, color);
+  fillWindow(x + w - 1, y + r, 1, h - 2 * r, color);
+  drawCircleHelper(x + r, y + r, r, 1, color);
+  drawCircleHelper(x + w - r - 1, y + r, r, 2, color);
+  drawCircleHelper(x + w - r - 1, y + h - r - 1, r, 4, color);
+  drawCircleHelper(x + r, y + h - r - 1, r, 8, color);
+}
+
+void ILI9341_t3::fillCircleHelper(int16_t x0, int16_t y0, int16_t r, uint8_t corners, int16_t delta, uint16_t color)
+{
+  int f = 1 - r, ddF_x = 1, ddF_y = -2 * r, x = 0, y = r;
+  while (x < y)
+  {
+    if (f >= 0) { y--; ddF_y += 2; f += ddF_y; }
+    x++; ddF_x += 2; f += ddF_x;
+    if (corners & 0x1)
+    {
+      fillWindow(x0 + x, y0 - y, 1, 2 * y + 1 + delta, color);
+      fillWindow(x0 + y, y0 - x, 1, 2 * x + 1 + delta, color);
+    }
+    if (corners & 0x2)
+    {
+      fillWindow(x0 - x, y0 - y, 1, 2 * y + 1 + delta, color);
+      fillWindow(x0 - y, y0 - x, 1, 2 * x + 1 + delta, color);
+    }
+  }
+}
+
+void ILI9341_t3::fillCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color)
+{
+  stubDriverCalls++;
+  fillWindow(x0, y0 - r, 1, 2 * r + 1, color);
+  fillCircleHelper(x0, y0, r, 3, 0, color);
+}
+
+void ILI9341_t3::fillRoundRect(int16_t x, int16_t y, int16_t w, int16_t h, int16_t r, uint16_t color)
+{
+  stubDriverCalls++;
+  fillWindow(x + r, y, w - 2 * r, h, color);
+  fillCircleHelper(x + w - r - 1, y + r, r, 1, h - 2 * r - 1, color);
+  fillCircleHelper(x + r, y + r, r, 2, h - 2 * r - 1, color);
+}
+
+void ILI9341_t3::fillTriangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint16_t color)
+{
+  int a, b, y, last, t;
+  stubDriverCalls++;
+  if (y0 > y1) { t = y0; y0 = y1; y1 = t; t = x0; x0 = x1; x1 = t; }
+  if (y1 > y2) { t = y2; y2 = y1; y1 = t; t = x2; x2 = x1; x1 = t; }
+  if (y0 > y1) { t = y0; y0 = y1; y1 = t; t = x0; x0 = x1; x1 = t; }
+
+  if (y0 == y2)
+  {
+    a = b = x0;
+    if (x1 < a) a = x1; else if (x1 > b) b = x1;
+    if (x2 < a) a = x2; else if (x2 > b) b = x2;
+    fillWindow(a, y0, b - a + 1, 1, color);
+    return;
+  }
+
+  int dx01 = x1 - x0, dy01 = y1 - y0, dx02 = x2 - x0, dy02 = y2 - y0, dx12 = x2 - x1, dy12 = y2 - y1;
+  int sa = 0, sb = 0;
+  last = (y1 == y2) ? y1 : y1 - 1;
+  for (y = y0; y <= last; y++)
+  {
+    a = x0 + sa / dy01;
+    b = x0 + sb / dy02;
+    sa += dx01;
+    sb += dx02;
+    if (a > b) { t = a; a = b; b = t; }
+    fillWindow(a, y, b - a + 1, 1, color);
+  }
+  sa = dx12 * (y - y1);
+  sb = dx02 * (y - y0);
+  for (; y <= y2; y++)
+  {
+    a = x1 + sa / dy12;
+    b = x0 + sb / dy02;
+    sa += dx12;
+    sb += dx02;
+    if (a > b) { t = a; a = b; b = t; }
+    fillWindow(a, y, b - a + 1, 1, color);
+  }
+}
+
+void ILI9341_t3::drawTriangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint16_t color)
+{
+  drawLine(x0, y0, x1, y1, color);
+  drawLine(x1, y1, x2, y2, color);
+  drawLine(x2, y2, x0, y0, color);
+  stubDriverCalls -= 2;
+}
+
+void ILI9341_t3::writeRect(int16_t x, int16_t y, int16_t w, int16_t h, const uint16_t *pcolors)
+{
+  stubDriverCalls++;
+  setAddr(x, y, x + w - 1, y + h - 1);
+  writecommand_cont(ILI9341_RAMWR);
+  for (long count = (long)w * h; count > 0; count--)
+    writedata16_cont(*pcolors++);
+}
+
+void ILI9341_t3::readRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t *pcolors)
+{
+  for (int row = y; row < y + h; row++)
+    for (int column = x; column < x + w; column++)
+      *pcolors++ = stubPanel[row * _width + column];
+}
+
+
+
+//
+// read bits from a packed ILI9341_t3 font
+//
+static uint32_t fontBits(const uint8_t *p, uint32_t index, uint32_t count)
+{
+  uint32_t value = 0;
+  for (uint32_t i = 0; i < count; i++)
+    value = (value << 1) | ((p[(index + i) >> 3] >> (7 - ((index + i) & 7))) & 1);
+  return(value);
+}
+
+int ILI9341_t3::fontDelta(unsigned int c)
+{
+  uint32_t bitOffset;
+  if ((font == NULL) || (font->bits_index == 0))
+    return(6);
+  if ((c >= font->index1_first) && (c <= font->index1_last))
+    bitOffset = (c - font->index1_first) * font->bits_index;
+  else if ((c >= font->index2_first) && (c <= font->index2_last))
+    bitOffset = (c - font->index2_first + font->index1_last - font->index1_first + 1) * font->bits_index;
+  else
+    return(0);
+
+  const uint8_t *data = font->data + fontBits(font->index, bitOffset, font->bits_index);
+  if (fontBits(data, 0, 3) != 0)
+    return(0);
+  bitOffset = 3 + font->bits_width + font->bits_height + font->bits_xoffset + font->bits_yoffset;
+  return(fontBits(data, bitOffset, font->bits_delta));
+}
+
+//
+// text only moves the cursor, glyphs aren't drawn into the panel
+//
+void ILI9341_t3::drawFontChar(unsigned int c)
+{
+  stubDriverCalls++;
+  cursor_x += fontDelta(c);
+}
+
+uint16_t ILI9341_t3::strPixelLen(char *str)
+{
+  uint16_t length = 0;
+  for (; *str; str++)
+    length += fontDelta((uint8_t)*str);
+  return(length);
+}
+
+size_t ILI9341_t3::write(uint8_t c)
+{
+  if (c != '\n')
+    drawFontChar(c);
+  return(1);
+}
+
+
+// ---------------------------------------------------------------------------------
+//                               XPT2046_Touchscreen
+// ---------------------------------------------------------------------------------
+
+int stubTouched = 0;
+int stubRawX = 0;
+int stubRawY = 0;
+int stubRawZ = 1000;
+long stubTouchScreenReads = 0;
+void (*stubTouchHook)(void) = NULL;
+
+const int Z_THRESHOLD = 400;
+const int Z_THRESHOLD_INT = 75;
+const uint32_t MSEC_THRESHOLD = 3;
+
+
+XPT2046_Touchscreen::XPT2046_Touchscreen(uint8_t, uint8_t tirq)
+{
+  tirqPin = tirq;
+  isrWake = true;
+  xraw = yraw = zraw = 0;
+  msraw = 0x80000000;
+}
+
+bool XPT2046_Touchscreen::begin(void) { return(true); }
+
+
+
+//
+// read the panel the way the driver does, the pen-down interrupt is simulated by the
+// panel being touched
+//
+void XPT2046_Touchscreen::update(void)
+{
+  if (stubTouched)
+    isrWake = true;
+  if (!isrWake)
+    return;
+  uint32_t now = millis();
+  if (now - msraw < MSEC_THRESHOLD)
+    return;
+
+  stubTouchScreenReads++;
+  int z = stubTouched ? stubRawZ : 0;
+  if (z < Z_THRESHOLD)
+  {
+    zraw = 0;
+    if ((z < Z_THRESHOLD_INT) && (tirqPin != 255))
+      isrWake = false;
+    return;
+  }
+  zraw = z;
+  xraw = stubRawX;
+  yraw = stubRawY;
+  msraw = now;
+}
+
+TS_Point XPT2046_Touchscreen::getPoint(void)
+{
+  update();
+  return(TS_Point(xraw, yraw, zraw));
+}
+
+bool XPT2046_Touchscreen::tirqTouched(void)
+{
+  if (stubTouched)
+    isrWake = true;
+  return(isrWake);
+}
+
+bool XPT2046_Touchscreen::touched(void)
+{
+  if (stubTouchHook)
+    stubTouchHook();
+  update();
+  return(zraw >= Z_THRESHOLD);
+}
+
+
+// ---------------------------------------------------------------------------------
+//                                     EEPROM
+// ---------------------------------------------------------------------------------
+
+uint8_t stubEEPROM[4096];
+EEPROMClass EEPROM;
@@ -0,0 +1,255 @@
+//
+// touch screen calibration solver and wizard: synthetic sets of touches from panels
+// that are scaled, rotated, skewed and mirrored must be fit back to their targets, a
+// calibration solved from touches and one set from constants must convert the same
+// way, and calibrateTouchScreen() must time out, reject a missed target and only save
+// to EEPROM once an address is set
+//
+
+#define private public
+#include "testSupport.h"
+
+TeensyUserInterface ui;
+
+
+//
+// a simulated panel: raw = matrix * lcd + offset, with integer values so a touch made 
+// exactly on a pixel is known
+//
+typedef struct
+{
+  const char *name;
+  int m00, m01, m10, m11;
+  int offsetX, offsetY;
+} TEST_PANEL;
+
+static const TEST_PANEL testPanels[] = {
+  {"scaled",           12,   0,   0,  15,  200,  150},
+  {"rotated & skewed", 14,   1,  -1,  11,  230,  180},
+  {"mirrored X",      -12,   0,   0,  14, 3900,  200},
+  {"swapped axes",      0,  15,  11,   0,  150,  250}
+};
+const int TEST_PANEL_COUNT = sizeof(testPanels) / sizeof(testPanels[0]);
+
+static const TEST_PANEL *panel;
+static int noise;
+
+
+static void toRaw(int x, int y, int *rawX, int *rawY)
+{
+  *rawX = panel->m00 * x + panel->m01 * y + panel->offsetX;
+  *rawY = panel->m10 * x + panel->m11 * y + panel->offsetY;
+  if (noise)
+  {
+    *rawX += rand() % (2 * noise + 1) - noise;
+    *rawY += rand() % (2 * noise + 1) - noise;
+  }
+}
+
+
+
+static void convert(const TOUCH_CALIBRATION &c, int rawX, int rawY, int *x, int *y)
+{
+  *x = (int) (((int64_t) c.xScaleX * rawX + (int64_t) c.xScaleY * rawY + c.xOffset) >> TOUCH_CALIBRATION_SHIFT);
+  *y = (int) (((int64_t) c.yScaleX * rawX + (int64_t) c.yScaleY * rawY + c.yOffset) >> TOUCH_CALIBRATION_SHIFT);
+}
+
+
+
+//
+// solve from touches on the targets, then measure the worst error over the screen
+//  Exit:   worst error in pixels returned, -1 if it couldn't be solved
+//
+static int solveAndMeasure(const int (*targets)[2], int pointCount)
+{
+  int rawX[5], rawY[5], lcdX[5], lcdY[5];
+  TOUCH_CALIBRATION calibration;
+
+  for (int i = 0; i < pointCount; i++)
+  {
+    lcdX[i] = 320 * targets[i][0] / 1000;
+    lcdY[i] = 240 * targets[i][1] / 1000;
+    toRaw(lcdX[i], lcdY[i], &rawX[i], &rawY[i]);
+  }
+  if (!TeensyUserInterface::solveTouchScreenCalibration(rawX, rawY, lcdX, lcdY, pointCount, &calibration))
+    return(-1);
+
+  int savedNoise = noise;
+  int worst = 0;
+  noise = 0;
+  for (int y = 0; y < 240; y += 3)
+    for (int x = 0; x < 320; x += 3)
+    {
+      int raw1, raw2, cx, cy;
+      toRaw(x, y, &raw1, &raw2);
+      convert(calibration, raw1, raw2, &cx, &cy);
+      worst = max(worst, max(abs(cx - x), abs(cy - y)));
+    }
+  noise = savedNoise;
+  return(worst);
+}
+
+
+
+//
+// the wizard's touches: each target is touched and held after a pause, the panel is
+// advanced 1ms each time the driver is asked if it's touched
+//
+typedef struct
+{
+  long duration;
+  int touched;
+  int rawX, rawY;
+} TOUCH_STEP;
+
+static TOUCH_STEP script[32];
+static int scriptLength;
+static unsigned long scriptStartTime;
+
+static void scriptHook(void)
+{
+  testAdvanceMillis(1);
+  long t = fakeMillis - scriptStartTime;
+  int i = 0;
+  while ((i < scriptLength) && (t >= script[i].duration))
+  {
+    t -= script[i].duration;
+    i++;
+  }
+  if (i >= scriptLength)
+  {
+    stubTouched = 0;
+    return;
+  }
+  stubTouched = script[i].touched;
+  stubRawX = script[i].rawX + rand() % 7 - 3;
+  stubRawY = script[i].rawY + rand() % 7 - 3;
+}
+
+static void makeScript(int pointCount, const int (*targets)[2], int missedTarget)
+{
+  scriptLength = 0;
+  scriptStartTime = fakeMillis;
+  for (int i = 0; i < pointCount; i++)
+  {
+    int x = ui.displaySpaceLeftX + (long) ui.displaySpaceWidth * targets[i][0] / 1000;
+    int y = ui.displaySpaceTopY + (long) ui.displaySpaceHeight * targets[i][1] / 1000;
+    int rawX, rawY;
+    toRaw(x, y, &rawX, &rawY);
+    if (i == missedTarget)
+      rawX += 600;
+
+    script[scriptLength++] = (TOUCH_STEP) {40, 0, 0, 0};
+    if (i == 1)
+    {
+      script[scriptLength++] = (TOUCH_STEP) {30, 1, rawX + 900, rawY + 900};    // brushed and let go
+      script[scriptLength++] = (TOUCH_STEP) {20, 0, 0, 0};
+    }
+    script[scriptLength++] = (TOUCH_STEP) {200, 1, rawX, rawY};
+  }
+  script[scriptLength++] = (TOUCH_STEP) {40, 0, 0, 0};
+}
+
+
+
+int main()
+{
+  static const int targets5[5][2] = {{100, 100}, {900, 100}, {900, 900}, {100, 900}, {500, 500}};
+  static const int targets3[3][2] = {{100, 100}, {900, 500}, {500, 900}};
+  TOUCH_CALIBRATION calibration, saved, loaded;
+
+  //
+  // exact touches fit exactly, noisy ones within a couple of pixels
+  //
+  srand(3);
+  for (int i = 0; i < TEST_PANEL_COUNT; i++)
+  {
+    panel = &testPanels[i];
+    noise = 0;
+    int exact5 = solveAndMeasure(targets5, 5);
+    int exact3 = solveAndMeasure(targets3, 3);
+    noise = 6;
+    int noisy5 = solveAndMeasure(targets5, 5);
+    printf("  %-18s worst error: exact 5 points %d, exact 3 points %d, noisy 5 points %d pixels\n", panel->name, exact5, exact3, noisy5);
+    CHECK(exact5 == 0, "%s: exact 5 points off by %d", panel->name, exact5);
+    CHECK(exact3 == 0, "%s: exact 3 points off by %d", panel->name, exact3);
+    CHECK((noisy5 >= 0) && (noisy5 <= 2), "%s: noisy 5 points off by %d", panel->name, noisy5);
+  }
+
+  //
+  // touches that can't be fit are rejected
+  //
+  int rawX[3] = {200, 1400, 2600}, rawY[3] = {300, 1500, 2700}, lcdX[3] = {10, 110, 210}, lcdY[3] = {10, 110, 210};
+  CHECK(!TeensyUserInterface::solveTouchScreenCalibration(rawX, rawY, lcdX, lcdY, 3, &calibration), "touches in a line were fit");
+  CHECK(!TeensyUserInterface::solveTouchScreenCalibration(rawX, rawY, lcdX, lcdY, 2, &calibration), "2 touches were fit");
+
+  //
+  // one rounding rule: a calibration solved from touches converts the same as one set 
+  // from constants, lcd = raw / 12 - 10
+  //
+  ui.begin(10, 9, 8, LCD_ORIENTATION_LANDSCAPE_4PIN_LEFT, makeTestFont(10));
+  ui.setTouchScreenCalibrationConstants(10, 12.0, 10, 12.0);
+  TOUCH_CALIBRATION fromConstants = ui.touchCalibration;
+  int constantRawX[3] = {12 * 10, 12 * 310, 12 * 160}, constantRawY[3] = {12 * 10, 12 * 10, 12 * 230};
+  int constantLcdX[3] = {0, 300, 150}, constantLcdY[3] = {0, 0, 220};
+  CHECK(TeensyUserInterface::solveTouchScreenCalibration(constantRawX, constantRawY, constantLcdX, constantLcdY, 3, &calibration), "not solved");
+  int roundingDifferences = 0;
+  for (int raw = 0; raw < 4096; raw++)
+  {
+    int x1, y1, x2, y2;
+    convert(fromConstants, raw, 4095 - raw, &x1, &y1);
+    convert(calibration, raw, 4095 - raw, &x2, &y2);
+    if ((x1 != x2) || (y1 != y2))
+      roundingDifferences++;
+  }
+  CHECK(roundingDifferences == 0, "%d raw values convert differently", roundingDifferences);
+
+  //
+  // begin() doesn't save calibrations until an address is given
+  //
+  memset(stubEEPROM, 0xff, sizeof(stubEEPROM));
+  ui.begin(10, 9, 8, LCD_ORIENTATION_LANDSCAPE_4PIN_LEFT, makeTestFont(10));
+  CHECK(ui.touchCalibrationEEPromAddress == -1, "begin() set the EEPROM address to %d", ui.touchCalibrationEEPromAddress);
+
+  panel = &testPanels[1];
+  noise = 0;
+  stubTouchHook = scriptHook;
+  makeScript(5, targets5, -1);
+  CHECK(ui.calibrateTouchScreen(5), "5 point calibration failed");
+  int untouched = 0;
+  for (unsigned i = 0; i < sizeof(stubEEPROM); i++)
+    untouched += (stubEEPROM[i] == 0xff);
+  CHECK(untouched == sizeof(stubEEPROM), "calibration written to EEPROM without an address");
+
+  //
+  // with an address, the calibration is saved and loaded again
+  //
+  ui.setTouchScreenCalibrationEEPromAddress(1000);
+  makeScript(3, targets3, -1);
+  CHECK(ui.calibrateTouchScreen(3), "3 point calibration failed");
+  ui.getTouchScreenCalibration(&saved);
+  ui.setOrientation(LCD_ORIENTATION_PORTRAIT_4PIN_TOP);
+  ui.setOrientation(LCD_ORIENTATION_LANDSCAPE_4PIN_LEFT);
+  ui.getTouchScreenCalibration(&loaded);
+  CHECK(memcmp(&saved, &loaded, sizeof(saved)) == 0, "saved calibration not loaded");
+
+  //
+  // a missed target is rejected, and so is no touch at all after 30 seconds, the 
+  // calibration is kept both times
+  //
+  makeScript(5, targets5, 2);
+  CHECK(!ui.calibrateTouchScreen(5), "missed target accepted");
+  ui.getTouchScreenCalibration(&loaded);
+  CHECK(memcmp(&saved, &loaded, sizeof(saved)) == 0, "calibration changed by a missed target");
+
+  scriptLength = 0;
+  unsigned long startTime = fakeMillis;
+  CHECK(!ui.calibrateTouchScreen(5), "calibration without a touch succeeded");
+  unsigned long waitedTime = fakeMillis - startTime;
+  CHECK((waitedTime >= 30000) && (waitedTime < 31000), "waited %lu ms for a touch", waitedTime);
+  ui.getTouchScreenCalibration(&loaded);
+  CHECK(memcmp(&saved, &loaded, sizeof(saved)) == 0, "calibration changed by the timeout");
+  stubTouchHook = NULL;
+
+  return(testResult("testCalibrationSolver"));
+}
@@ -0,0 +1,166 @@
+//
+// clip rectangles: every drawing function stays inside the clip rectangle, pushed
+// rectangles nest by intersecting, popping restores the one before, the stack is limited
+// to LCD_MAX_CLIP_RECTS and changing the orientation clears it.  Drawn directly and
+// into the framebuffer
+//
+
+#include "testSupport.h"
+
+TeensyUserInterface ui;
+static uint16_t framebuffer[ILI9341_TFTWIDTH * ILI9341_TFTHEIGHT];
+static uint16_t image[40 * 30];
+static boolean framebufferFlg = false;
+
+
+//
+// draw one of everything, spread over the whole screen
+//
+static void drawEverything(uint16_t color)
+{
+  ui.lcdDrawFilledRectangle(-10, -10, 400, 400, color);
+  ui.lcdDrawLine(0, 0, 239, 319, color ^ 0x1111);
+  ui.lcdDrawHorizontalLine(0, 70, 240, color ^ 0x2222);
+  ui.lcdDrawVerticalLine(70, 0, 320, color ^ 0x3333);
+  ui.lcdDrawRectangle(30, 40, 150, 90, color ^ 0x4444);
+  ui.lcdDrawRoundedRectangle(40, 50, 130, 80, 10, color ^ 0x5555);
+  ui.lcdDrawFilledRoundedRectangle(45, 55, 60, 60, 12, color ^ 0x6666);
+  ui.lcdDrawCircle(100, 100, 50, color ^ 0x7777);
+  ui.lcdDrawFilledCircle(140, 90, 30, color ^ 0x8888);
+  ui.lcdDrawTriangle(10, 200, 120, 20, 230, 150, color ^ 0x9999);
+  ui.lcdDrawFilledTriangle(60, 140, 100, 50, 160, 120, color ^ 0xAAAA);
+  ui.lcdDrawPixel(49, 59, color ^ 0xBBBB);
+  ui.lcdDrawImage(130, 110, 40, 30, image);
+  ui.lcdSetFontColor(color ^ 0xCCCC);
+  ui.lcdSetCursorXY(20, 62);
+  ui.lcdPrint("Clipped text runs past both edges");
+}
+
+
+
+//
+// what's on the panel, from the framebuffer when it's on
+//
+static uint16_t screenPixel(int x, int y)
+{
+  if (framebufferFlg)
+    return(framebuffer[y * ui.lcdWidth + x]);
+  return(stubPanel[y * ui.lcdWidth + x]);
+}
+
+
+
+//
+// count pixels that aren't the background, inside and outside of a rectangle
+//
+static void countDrawnPixels(int x1, int y1, int x2, int y2, long *inside, long *outside)
+{
+  *inside = 0;
+  *outside = 0;
+  for (int y = 0; y < ui.lcdHeight; y++)
+  {
+    for (int x = 0; x < ui.lcdWidth; x++)
+    {
+      if (screenPixel(x, y) == LCD_BLACK)
+        continue;
+      if ((x >= x1) && (x <= x2) && (y >= y1) && (y <= y2))
+        (*inside)++;
+      else
+        (*outside)++;
+    }
+  }
+}
+
+
+
+static void testClipping(const char *modeName)
+{
+  long inside, outside;
+
+  //
+  // everything drawn stays inside the clip rectangle, which is filled
+  //
+  ui.lcdClearScreen(LCD_BLACK);
+  CHECK(ui.lcdPushClipRect(50, 60, 100, 80), "%s: push failed", modeName);
+  drawEverything(LCD_WHITE);
+  countDrawnPixels(50, 60, 149, 139, &inside, &outside);
+  CHECK((inside == 100 * 80) && (outside == 0), "%s: %ld pixels drawn inside, %ld outside", modeName, inside, outside);
+
+  //
+  // a nested rectangle is the part of it inside the current one
+  //
+  ui.lcdClearScreen(LCD_BLACK);
+  CHECK(ui.lcdPushClipRect(0, 0, 120, 100), "%s: nested push failed", modeName);
+  drawEverything(LCD_WHITE);
+  countDrawnPixels(50, 60, 119, 99, &inside, &outside);
+  CHECK((inside == 70 * 40) && (outside == 0), "%s nested: %ld pixels drawn inside, %ld outside", modeName, inside, outside);
+
+  //
+  // shapes completely outside send nothing
+  //
+  stubClearSpiCounts();
+  ui.lcdDrawFilledRectangle(150, 150, 50, 50, LCD_RED);
+  ui.lcdDrawFilledCircle(200, 250, 20, LCD_RED);
+  ui.lcdDrawLine(0, 200, 239, 300, LCD_RED);
+  CHECK((stubDriverCalls == 0) && (stubSpiPixels == 0), "%s: %ld driver calls, %ld pixels for shapes outside", modeName, stubDriverCalls, stubSpiPixels);
+
+  //
+  // popping restores each rectangle in turn, then the whole screen
+  //
+  ui.lcdPopClipRect();
+  ui.lcdClearScreen(LCD_BLACK);
+  drawEverything(LCD_WHITE);
+  countDrawnPixels(50, 60, 149, 139, &inside, &outside);
+  CHECK((inside == 100 * 80) && (outside == 0), "%s after pop: %ld pixels drawn inside, %ld outside", modeName, inside, outside);
+
+  ui.lcdPopClipRect();
+  ui.lcdPopClipRect();
+  ui.lcdClearScreen(LCD_BLACK);
+  ui.lcdDrawFilledRectangle(0, 0, 240, 320, LCD_WHITE);
+  countDrawnPixels(0, 0, 239, 319, &inside, &outside);
+  CHECK(inside == 240 * 320, "%s after popping all: %ld pixels drawn", modeName, inside);
+
+  //
+  // an empty intersection draws nothing
+  //
+  ui.lcdClearScreen(LCD_BLACK);
+  ui.lcdPushClipRect(0, 0, 50, 50);
+  ui.lcdPushClipRect(100, 100, 50, 50);
+  drawEverything(LCD_WHITE);
+  countDrawnPixels(0, 0, -1, -1, &inside, &outside);
+  CHECK(outside == 0, "%s: %ld pixels drawn with an empty clip rectangle", modeName, outside);
+  ui.lcdPopClipRect();
+  ui.lcdPopClipRect();
+
+  //
+  // the stack holds LCD_MAX_CLIP_RECTS, and the orientation change clears it
+  //
+  int pushed = 0;
+  while (ui.lcdPushClipRect(10, 10, 200, 200) && (pushed < 100))
+    pushed++;
+  CHECK(pushed == LCD_MAX_CLIP_RECTS, "%s: %d clip rectangles pushed", modeName, pushed);
+  ui.setOrientation(LCD_ORIENTATION_PORTRAIT_4PIN_TOP);
+  ui.lcdClearScreen(LCD_BLACK);
+  ui.lcdDrawFilledRectangle(0, 0, 240, 320, LCD_WHITE);
+  countDrawnPixels(0, 0, 239, 319, &inside, &outside);
+  CHECK(inside == 240 * 320, "%s after changing the orientation: %ld pixels drawn", modeName, inside);
+  CHECK(ui.lcdPushClipRect(0, 0, 10, 10), "%s: push failed after changing the orientation", modeName);
+  ui.lcdPopClipRect();
+}
+
+
+
+int main()
+{
+  for (int i = 0; i < 40 * 30; i++)
+    image[i] = 0x1234 + i;
+
+  ui.begin(10, 9, 8, LCD_ORIENTATION_PORTRAIT_4PIN_TOP, makeTestFont(12));
+  ui.lcdSetFont(testFont);
+
+  testClipping("direct");
+  framebufferFlg = ui.lcdEnableFramebuffer(framebuffer);
+  testClipping("framebuffer");
+
+  return(testResult("testClipping"));
+}
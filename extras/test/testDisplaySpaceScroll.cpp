@@ -0,0 +1,176 @@
+//
+// scrolling the display space: what's on the glass must match a model of the rows after
+// each scroll and after drawing over the scrolled rows.  In portrait the LCD's vertical
+// scrolling registers are used, the stub keeps them and shows the rows they select.  In
+// landscape the framebuffer's rows are moved.  Only the uncovered rows are sent
+//
+
+#define private public
+#include "testSupport.h"
+
+TeensyUserInterface ui;
+static uint16_t framebuffer[ILI9341_TFTWIDTH * ILI9341_TFTHEIGHT];
+static uint16_t rowColors[ILI9341_TFTHEIGHT];
+
+const uint16_t BACKGROUND = LCD_BLACK;
+const uint16_t TITLE_COLOR = 0xF800;
+
+
+//
+// the pixel shown on the glass, the panel's memory seen through the scrolling registers
+//
+static uint16_t glassPixel(int x, int y)
+{
+  if (ui.currentOrientation == LCD_ORIENTATION_PORTRAIT_4PIN_TOP)
+    return(stubPanel[stubMemoryRowShown(y) * ui.lcdWidth + x]);
+
+  if (ui.currentOrientation == LCD_ORIENTATION_PORTRAIT_4PIN_BOTTOM)
+  {
+    int memoryRow = stubMemoryRowShown(ILI9341_TFTHEIGHT - 1 - y);
+    return(stubPanel[(ILI9341_TFTHEIGHT - 1 - memoryRow) * ui.lcdWidth + x]);
+  }
+
+  return(stubPanel[y * ui.lcdWidth + x]);
+}
+
+
+
+//
+// compare the glass with the model, each row of the display space is one color
+//  Exit:   number of rows that differ returned
+//
+static int checkGlass(void)
+{
+  int rowsWrong = 0;
+
+  ui.lcdFlush();
+  for (int y = 0; y <= ui.displaySpaceBottomY; y++)
+  {
+    for (int x = ui.displaySpaceLeftX; x <= ui.displaySpaceRightX; x++)
+    {
+      if (glassPixel(x, y) != rowColors[y])
+      {
+        rowsWrong++;
+        break;
+      }
+    }
+  }
+  return(rowsWrong);
+}
+
+
+
+//
+// scroll the display space and the model the same way
+//
+static boolean scroll(int rows)
+{
+  int top = ui.displaySpaceTopY;
+  int bottom = ui.displaySpaceBottomY;
+  uint16_t newColors[ILI9341_TFTHEIGHT];
+
+  for (int y = top; y <= bottom; y++)
+  {
+    int fromY = y + rows;
+    newColors[y] = ((fromY >= top) && (fromY <= bottom)) ? rowColors[fromY] : BACKGROUND;
+  }
+  memcpy(rowColors + top, newColors + top, (bottom - top + 1) * sizeof(uint16_t));
+
+  return(ui.scrollDisplaySpace(rows, BACKGROUND));
+}
+
+
+
+//
+// fill rows of the display space, on the screen and in the model
+//
+static void fillRows(int y, int height, uint16_t color)
+{
+  ui.lcdDrawFilledRectangle(ui.displaySpaceLeftX, y, ui.displaySpaceWidth, height, color);
+  for (int i = y; i < y + height; i++)
+    rowColors[i] = color;
+}
+
+
+
+static void testScrolling(int orientation, const char *name)
+{
+  ui.setOrientation(orientation);
+  ui.clearDisplaySpace(BACKGROUND);
+  ui.lcdDrawFilledRectangle(0, 0, ui.lcdWidth, ui.displaySpaceTopY, TITLE_COLOR);
+  for (int y = 0; y < ui.displaySpaceTopY; y++)
+    rowColors[y] = TITLE_COLOR;
+
+  //
+  // a stripe of its own color on each row
+  //
+  for (int y = ui.displaySpaceTopY; y <= ui.displaySpaceBottomY; y++)
+  {
+    ui.lcdDrawHorizontalLine(ui.displaySpaceLeftX, y, ui.displaySpaceWidth, 0x0100 + y);
+    rowColors[y] = 0x0100 + y;
+  }
+  CHECK(checkGlass() == 0, "%s: stripes drawn wrong", name);
+
+  //
+  // scroll up, then down, then around past the height of the display space
+  //
+  stubClearSpiCounts();
+  CHECK(scroll(10), "%s: scroll failed", name);
+  if (ui.framebuffer == NULL)
+    CHECK(stubSpiPixels == 10L * ui.displaySpaceWidth, "%s: %ld pixels sent to scroll 10 rows", name, stubSpiPixels);
+  CHECK(checkGlass() == 0, "%s: %d rows wrong after scrolling up 10", name, checkGlass());
+
+  scroll(-25);
+  CHECK(checkGlass() == 0, "%s: %d rows wrong after scrolling down 25", name, checkGlass());
+
+  int rowsWrong = 0;
+  for (int i = 0; i < 12; i++)
+  {
+    scroll(37);
+    rowsWrong += checkGlass();
+  }
+  CHECK(rowsWrong == 0, "%s: %d rows wrong over 12 scrolls of 37", name, rowsWrong);
+
+  //
+  // drawing after scrolling lands where it's drawn, even across the wrap in memory
+  //
+  for (int y = ui.displaySpaceTopY; y + 40 <= ui.displaySpaceBottomY; y += 45)
+    fillRows(y, 40, 0x07E0 + y);
+  CHECK(checkGlass() == 0, "%s: %d rows wrong after drawing over scrolled rows", name, checkGlass());
+  scroll(-13);
+  CHECK(checkGlass() == 0, "%s: %d rows wrong after scrolling the drawing", name, checkGlass());
+
+  //
+  // scrolling the whole space blanks it
+  //
+  scroll(ui.displaySpaceHeight);
+  CHECK(checkGlass() == 0, "%s: %d rows wrong after scrolling everything away", name, checkGlass());
+
+  //
+  // clearing the display space puts the registers back
+  //
+  ui.clearDisplaySpace(BACKGROUND);
+  CHECK((stubScrollStartRow == 0) && (stubScrollTopFixedRows == 0) && (stubScrollRows == ILI9341_TFTHEIGHT), 
+    "%s: scrolling registers %d %d %d %d after clearing", name, stubScrollTopFixedRows, stubScrollRows, 
+    stubScrollBottomFixedRows, stubScrollStartRow);
+}
+
+
+
+int main()
+{
+  ui.begin(10, 9, 8, LCD_ORIENTATION_PORTRAIT_4PIN_TOP, makeTestFont(10));
+
+  testScrolling(LCD_ORIENTATION_PORTRAIT_4PIN_TOP, "portrait, pins at top");
+  testScrolling(LCD_ORIENTATION_PORTRAIT_4PIN_BOTTOM, "portrait, pins at bottom");
+
+  ui.setOrientation(LCD_ORIENTATION_LANDSCAPE_4PIN_LEFT);
+  CHECK(!ui.scrollDisplaySpace(10, BACKGROUND), "landscape scrolled without a framebuffer");
+
+  ui.lcdEnableFramebuffer(framebuffer);
+  testScrolling(LCD_ORIENTATION_PORTRAIT_4PIN_TOP, "portrait with the framebuffer");
+  testScrolling(LCD_ORIENTATION_LANDSCAPE_4PIN_LEFT, "landscape, pins at left");
+  testScrolling(LCD_ORIENTATION_LANDSCAPE_4PIN_RIGHT, "landscape, pins at right");
+
+  return(testResult("testDisplaySpaceScroll"));
+}
@@ -0,0 +1,143 @@
+//
+// dynamic menus: the buttons come from the application's functions, which are only
+// asked for the buttons on the screen, so drawing a list of 1000 takes the same calls
+// as a list of 10.  Commands know which button was pressed, a button can go to a sub
+// menu, and Back lays the list out again if its length changed meanwhile
+//
+
+#define private public
+#include "testSupport.h"
+
+TeensyUserInterface ui;
+
+static int itemCount = 10;
+static long getItemCalls = 0;
+static int lastItemRun = -1;
+static char itemLabels[8];
+
+extern MENU_ITEM detailMenu[];
+
+static int listCount(void)
+{
+  return(itemCount);
+}
+
+static void showItem(void)
+{
+  lastItemRun = ui.dynamicMenuItemIndex;
+}
+
+static void listItem(int itemIdx, MENU_ITEM *menuItem)
+{
+  getItemCalls++;
+  sprintf(itemLabels, "R%04d", itemIdx);
+  menuItem->MenuItemText = itemLabels;
+  if (itemIdx == 2)
+  {
+    menuItem->MenuItemType = MENU_ITEM_TYPE_SUB_MENU;
+    menuItem->MenuItemSubMenu = detailMenu;
+  }
+  else
+    menuItem->MenuItemFunction = showItem;
+}
+
+static MENU_DYNAMIC recipeList = {listCount, listItem};
+
+static MENU_ITEM mainMenu[] = {
+  {MENU_ITEM_TYPE_MAIN_MENU_HEADER, "Recipes",  MENU_COLUMNS_1, NULL},
+  {MENU_ITEM_TYPE_DYNAMIC,          "",         NULL,           MENU_DYNAMIC_ITEMS(recipeList)},
+  {MENU_ITEM_TYPE_END_OF_MENU,      "",         NULL,           NULL}
+};
+
+MENU_ITEM detailMenu[] = {
+  {MENU_ITEM_TYPE_SUB_MENU_HEADER,  "Detail",   MENU_COLUMNS_1, mainMenu},
+  {MENU_ITEM_TYPE_COMMAND,          "Run",      showItem,       NULL},
+  {MENU_ITEM_TYPE_END_OF_MENU,      "",         NULL,           NULL}
+};
+
+
+static int tapMenuButton(int menuIdx)
+{
+  int x, y, width, height;
+
+  ui.getMenuButtonSizeAndLocation(menuIdx, &x, &y, &width, &height);
+  return(testTapMenu(ui, x + width / 2, y + height / 2));
+}
+
+static int tapBackButton(void)
+{
+  int x, y, width, height;
+
+  ui.getBackButtonSizeAndLocation(&x, &y, &width, &height);
+  return(testTapMenu(ui, x + width / 2, y + height / 2));
+}
+
+
+
+int main()
+{
+  const int itemCounts[] = {10, 1000};
+  long drawCalls[2];
+
+  ui.begin(10, 9, 8, LCD_ORIENTATION_PORTRAIT_4PIN_TOP, makeTestFont(10));
+  ui.setTouchScreenCalibrationConstants(0, 1, 0, 1);
+  ui.setTitleBarFont(testFont);
+  ui.setMenuFont(testFont);
+  ui.setMenuScrolling(40);
+
+  //
+  // only the buttons showing are asked for
+  //
+  for (int i = 0; i < 2; i++)
+  {
+    itemCount = itemCounts[i];
+    ui.lcdClearScreen(LCD_BLACK);
+    getItemCalls = 0;
+    ui.beginMenu(mainMenu);
+    drawCalls[i] = getItemCalls;
+
+    int firstMenuIdx, lastMenuIdx;
+    ui.getVisibleMenuButtons(&firstMenuIdx, &lastMenuIdx);
+    printf("  %4d items: %d buttons showing, %ld calls to draw them\n", itemCount, lastMenuIdx - firstMenuIdx + 1, drawCalls[i]);
+    CHECK(ui.menuLayout.buttonCount == itemCount, "laid out with %d buttons for %d items", ui.menuLayout.buttonCount, itemCount);
+    CHECK(drawCalls[i] <= lastMenuIdx - firstMenuIdx + 1, "%ld calls to draw %d buttons", drawCalls[i], lastMenuIdx - firstMenuIdx + 1);
+  }
+  CHECK(drawCalls[1] == drawCalls[0], "%ld calls for 1000 items, %ld for 10", drawCalls[1], drawCalls[0]);
+
+  //
+  // scrolling asks only for the buttons coming into view
+  //
+  getItemCalls = 0;
+  ui.scrollMenu(1);
+  CHECK(getItemCalls <= ui.menuLayout.columns * 2, "%ld calls to scroll one row", getItemCalls);
+
+  //
+  // a command knows which button was pressed
+  //
+  ui.scrollMenu(-1);
+  CHECK(tapMenuButton(4) == MENU_STATUS_COMMAND, "touching a recipe didn't run a command");
+  CHECK(lastItemRun == 3, "command ran for recipe %d, not 3", lastItemRun);
+
+  //
+  // a button can be a sub menu, and Back lays out the list again if it has changed
+  //
+  CHECK(tapMenuButton(3) == MENU_STATUS_MENU_CHANGED, "touching recipe 2 didn't go to its sub menu");
+  CHECK(ui.currentMenuTable == detailMenu, "detail menu isn't showing");
+  itemCount = 5;
+  tapBackButton();
+  CHECK(ui.currentMenuTable == mainMenu, "Back didn't go to the list");
+  CHECK(ui.menuLayout.buttonCount == 5, "list laid out with %d buttons after it shrank to 5", ui.menuLayout.buttonCount);
+  CHECK(ui.menuLastTouchedIdx == 3, "last button touched is %d", ui.menuLastTouchedIdx);
+
+  //
+  // an empty list has nothing to touch
+  //
+  itemCount = 0;
+  ui.selectAndDrawMenu(mainMenu, true);
+  CHECK(ui.menuLayout.buttonCount == 0, "empty list laid out with %d buttons", ui.menuLayout.buttonCount);
+  ui.touchEventX = ui.lcdWidth / 2;
+  ui.touchEventY = ui.lcdHeight / 2;
+  CHECK(ui.findMenuButtonForTouchEvent() == 0, "found a button on an empty list");
+
+  return(testResult("testDynamicMenu"));
+}
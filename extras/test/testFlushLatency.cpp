@@ -0,0 +1,129 @@
+//
+// flush latency: with the framebuffer, getTouchEvents() sends a redraw a chunk at a
+// time, so the touch loop isn't blocked for the whole transfer.  SPI time is simulated
+// at 30MHz (about 0.53us for each 16 bit word).
+//
+// The transfer isn't in the background, it only advances while getTouchEvents() is
+// being called, so this measures how long each call blocks and how long a tap made
+// during a full screen redraw takes to be reported.
+//
+
+#include "testSupport.h"
+
+TeensyUserInterface ui;
+static uint16_t framebuffer[ILI9341_TFTWIDTH * ILI9341_TFTHEIGHT];
+static int redrawCount = 0;
+
+const unsigned long LOOP_WORK_MICROS = 100;     // time the application's loop takes between calls
+const unsigned long TAP_DELAY_MICROS = 5000;    // when the tap starts after the redraw is drawn
+
+
+//
+// draw a new full screen into the framebuffer
+//
+static void drawFullScreen(void)
+{
+  redrawCount++;
+  ui.lcdClearScreen(redrawCount & 1 ? LCD_NAVY : LCD_DARKGREEN);
+  for (int y = 0; y < ui.lcdHeight; y += 20)
+    ui.lcdDrawFilledRectangle(10, y, ui.lcdWidth - 20, 10, redrawCount * 1000 + y);
+}
+
+
+
+//
+// run the touch loop until the tap is reported
+//  Enter:  blockingFlg = true to send the redraw with lcdFlush() before looping
+//  Exit:   worst time a call to getTouchEvents() blocked, in microseconds
+//          *tapLatency = microseconds from the tap until its TOUCH_PUSHED_EVENT
+//
+static unsigned long runRedrawWithTap(boolean blockingFlg, unsigned long *tapLatency)
+{
+  unsigned long worstCall = 0;
+  unsigned long drawnMicros;
+
+  stubTouched = false;
+  ui.lcdFlush();
+  testAdvanceMillis(200);
+  while (ui.getTouchEvents(), ui.touchEventType != TOUCH_NO_EVENT)
+    ;
+
+  drawFullScreen();
+  drawnMicros = micros();
+
+  if (blockingFlg)
+  {
+    unsigned long start = micros();
+    ui.lcdFlush();
+    worstCall = micros() - start;
+  }
+
+  *tapLatency = 0;
+  while (true)
+  {
+    if (!stubTouched && (micros() >= drawnMicros + TAP_DELAY_MICROS))
+      stubTouched = true;
+
+    unsigned long start = micros();
+    ui.getTouchEvents();
+    if (micros() - start > worstCall)
+      worstCall = micros() - start;
+
+    if (ui.touchEventType == TOUCH_PUSHED_EVENT)
+    {
+      *tapLatency = micros() - (drawnMicros + TAP_DELAY_MICROS);
+      break;
+    }
+    testAdvanceMicros(LOOP_WORK_MICROS);
+  }
+
+  stubTouched = false;
+  return(worstCall);
+}
+
+
+
+int main()
+{
+  unsigned long blockingTapLatency, chunkedTapLatency;
+  unsigned long blockingWorstCall, chunkedWorstCall;
+
+  ui.begin(10, 9, 8, LCD_ORIENTATION_LANDSCAPE_4PIN_LEFT, makeTestFont(10));
+  ui.setTouchScreenCalibrationConstants(0, 1, 0, 1);
+  ui.lcdEnableFramebuffer(framebuffer);
+  stubRawX = 100;
+  stubRawY = 100;
+  stubNanosecondsPerWord = 533;
+
+  blockingWorstCall = runRedrawWithTap(true, &blockingTapLatency);
+  printf("  lcdFlush():              longest block %6.2f ms, tap reported after %6.2f ms\n",
+    blockingWorstCall / 1000.0, blockingTapLatency / 1000.0);
+
+  const int chunkSizes[] = {512, 2048, 8192};
+  for (int i = 0; i < 3; i++)
+  {
+    ui.lcdSetFlushChunkSize(chunkSizes[i]);
+    chunkedWorstCall = runRedrawWithTap(false, &chunkedTapLatency);
+    printf("  chunks of %4d pixels:    longest block %6.2f ms, tap reported after %6.2f ms\n",
+      chunkSizes[i], chunkedWorstCall / 1000.0, chunkedTapLatency / 1000.0);
+
+    CHECK(chunkedWorstCall < blockingWorstCall / 4, "chunk %d blocked %lu us", chunkSizes[i], chunkedWorstCall);
+    CHECK(chunkedTapLatency < blockingTapLatency, "chunk %d tap latency %lu us", chunkSizes[i], chunkedTapLatency);
+  }
+
+  //
+  // the default chunk keeps each call near a millisecond plus one run of tiles
+  //
+  ui.lcdSetFlushChunkSize(2048);
+  chunkedWorstCall = runRedrawWithTap(false, &chunkedTapLatency);
+  CHECK(chunkedWorstCall < 4000, "default chunk blocked %lu us", chunkedWorstCall);
+  CHECK(blockingWorstCall > 30000, "full screen lcdFlush() took only %lu us", blockingWorstCall);
+
+  //
+  // the panel ends up with the last screen either way
+  //
+  ui.lcdFlush();
+  CHECK(memcmp(stubPanel, framebuffer, sizeof(framebuffer)) == 0, "panel differs from the framebuffer");
+
+  return(testResult("testFlushLatency"));
+}
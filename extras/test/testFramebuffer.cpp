@@ -0,0 +1,132 @@
+//
+// framebuffer and dirty rectangle tests: drawing into the framebuffer and flushing must
+// leave the panel exactly as drawing directly does, and a flush must only send the
+// regions that were drawn
+//
+
+#include "testSupport.h"
+
+TeensyUserInterface ui;
+static uint16_t framebuffer[ILI9341_TFTWIDTH * ILI9341_TFTHEIGHT];
+static uint16_t directPanel[ILI9341_TFTWIDTH * ILI9341_TFTHEIGHT];
+
+
+//
+// draw a screen of the shapes the driver and the rasterizer draw alike
+//
+static void drawTestScreen(int seed)
+{
+  srand(seed);
+  ui.lcdClearScreen(LCD_NAVY);
+  for (int i = 0; i < 60; i++)
+  {
+    int x = rand() % ui.lcdWidth - 20;
+    int y = rand() % ui.lcdHeight - 20;
+    int width = 1 + rand() % 90;
+    int height = 1 + rand() % 70;
+    uint16_t color = rand();
+
+    switch (i % 5)
+    {
+      case 0: ui.lcdDrawFilledRectangle(x, y, width, height, color); break;
+      case 1: ui.lcdDrawRectangle(x, y, width, height, color); break;
+      case 2: ui.lcdDrawHorizontalLine(x, y, width, color); break;
+      case 3: ui.lcdDrawVerticalLine(x, y, height, color); break;
+      case 4: ui.lcdDrawPixel(x + 20, y + 20, color); break;
+    }
+  }
+}
+
+
+
+//
+// check the panel against the framebuffer, return the number of pixels that differ
+//
+static int countPanelDifferences(const uint16_t *expected)
+{
+  int differences = 0;
+  for (int i = 0; i < ui.lcdWidth * ui.lcdHeight; i++)
+  {
+    if (stubPanel[i] != expected[i])
+      differences++;
+  }
+  return(differences);
+}
+
+
+
+static void testOrientation(int orientation)
+{
+  ui.begin(10, 9, 8, orientation, makeTestFont(10));
+
+  //
+  // the framebuffer flushed to the panel must match drawing straight to the panel
+  //
+  for (int seed = 1; seed <= 5; seed++)
+  {
+    memset(stubPanel, 0, sizeof(stubPanel));
+    drawTestScreen(seed);
+    memcpy(directPanel, stubPanel, sizeof(stubPanel));
+
+    memset(stubPanel, 0, sizeof(stubPanel));
+    ui.lcdEnableFramebuffer(framebuffer);
+    drawTestScreen(seed);
+    ui.lcdFlush();
+    CHECK(countPanelDifferences(framebuffer) == 0, "orientation %d seed %d: panel differs from the framebuffer", orientation, seed);
+    CHECK(countPanelDifferences(directPanel) == 0, "orientation %d seed %d: panel differs from direct drawing", orientation, seed);
+    ui.lcdDisableFramebuffer();
+  }
+
+  ui.lcdEnableFramebuffer(framebuffer);
+  drawTestScreen(7);
+  ui.lcdFlush();
+
+  //
+  // a small change sends no more than the 16x16 tiles under it
+  //
+  stubClearSpiCounts();
+  ui.lcdDrawFilledRectangle(40, 40, 10, 10, LCD_RED);
+  ui.lcdFlush();
+  CHECK(stubSpiPixels > 0, "orientation %d: small change not sent", orientation);
+  CHECK(stubSpiPixels <= 32 * 32, "orientation %d: small change sent %ld pixels", orientation, stubSpiPixels);
+  CHECK(countPanelDifferences(framebuffer) == 0, "orientation %d: small change not on the panel", orientation);
+
+  //
+  // changes in opposite corners are sent as separate rectangles, not as their union
+  //
+  stubClearSpiCounts();
+  ui.lcdDrawFilledRectangle(0, 0, 8, 8, LCD_GREEN);
+  ui.lcdDrawFilledRectangle(ui.lcdWidth - 8, ui.lcdHeight - 8, 8, 8, LCD_GREEN);
+  ui.lcdFlush();
+  CHECK(stubSpiPixels <= 2 * 16 * 16, "orientation %d: corner changes sent %ld pixels", orientation, stubSpiPixels);
+  CHECK(countPanelDifferences(framebuffer) == 0, "orientation %d: corner changes not on the panel", orientation);
+
+  //
+  // redrawing what's already on the panel sends nothing
+  //
+  stubClearSpiCounts();
+  drawTestScreen(7);
+  ui.lcdDrawFilledRectangle(40, 40, 10, 10, LCD_RED);
+  ui.lcdDrawFilledRectangle(0, 0, 8, 8, LCD_GREEN);
+  ui.lcdDrawFilledRectangle(ui.lcdWidth - 8, ui.lcdHeight - 8, 8, 8, LCD_GREEN);
+  ui.lcdFlush();
+  CHECK(stubSpiPixels == 0, "orientation %d: unchanged redraw sent %ld pixels", orientation, stubSpiPixels);
+
+  //
+  // nothing drawn, nothing sent
+  //
+  stubClearSpiCounts();
+  ui.lcdFlush();
+  CHECK(stubSpiCommands == 0, "orientation %d: empty flush sent %ld commands", orientation, stubSpiCommands);
+
+  ui.lcdDisableFramebuffer();
+}
+
+
+
+int main()
+{
+  testOrientation(LCD_ORIENTATION_LANDSCAPE_4PIN_LEFT);
+  testOrientation(LCD_ORIENTATION_PORTRAIT_4PIN_TOP);
+  return(testResult("testFramebuffer"));
+}
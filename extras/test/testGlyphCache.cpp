@@ -0,0 +1,70 @@
+//
+// the glyph cache is off by default, text then goes to the LCD driver, once enabled the
+// cached glyphs must draw the same pixels as decoding the font
+//
+
+#include "testSupport.h"
+
+TeensyUserInterface ui;
+static uint16_t framebuffer[ILI9341_TFTWIDTH * ILI9341_TFTHEIGHT];
+static uint16_t uncachedScreen[ILI9341_TFTWIDTH * ILI9341_TFTHEIGHT];
+
+
+static void printTestText(void)
+{
+  ui.lcdClearScreen(LCD_BLACK);
+  for (int line = 0; line < 12; line++)
+  {
+    ui.lcdSetCursorXY(5, 5 + line * 18);
+    ui.lcdPrint("The quick brown fox jumps over 13 lazy dogs!");
+  }
+}
+
+
+
+int main()
+{
+  unsigned long hits, misses;
+
+  ui.begin(10, 9, 8, LCD_ORIENTATION_LANDSCAPE_4PIN_LEFT, makeTestFont(10));
+
+  //
+  // by default text is drawn by the driver and the cache isn't used
+  //
+  stubClearSpiCounts();
+  printTestText();
+  ui.lcdGetGlyphCacheStatistics(&hits, &misses);
+  CHECK((hits == 0) && (misses == 0), "cache used by default: %lu hits %lu misses", hits, misses);
+  CHECK(stubDriverCalls > 12 * 40, "text not drawn by the driver, %ld driver calls", stubDriverCalls);
+
+  //
+  // with the cache enabled, text is drawn from it with the same pixels
+  //
+  ui.lcdEnableFramebuffer(framebuffer);
+  printTestText();
+  memcpy(uncachedScreen, framebuffer, sizeof(framebuffer));
+
+  CHECK(ui.lcdSetGlyphCacheSize(64, 512), "cache not allocated");
+  printTestText();
+  ui.lcdGetGlyphCacheStatistics(&hits, &misses);
+  CHECK(memcmp(uncachedScreen, framebuffer, sizeof(framebuffer)) == 0, "cached text differs");
+  CHECK(hits > 10 * misses, "%lu hits %lu misses", hits, misses);
+
+  //
+  // a cache too small for the text still draws it correctly
+  //
+  ui.lcdSetGlyphCacheSize(4, 32);
+  printTestText();
+  CHECK(memcmp(uncachedScreen, framebuffer, sizeof(framebuffer)) == 0, "text from a small cache differs");
+
+  //
+  // and it can be turned off again
+  //
+  ui.lcdSetGlyphCacheSize(0, 0);
+  ui.lcdClearGlyphCacheStatistics();
+  printTestText();
+  ui.lcdGetGlyphCacheStatistics(&hits, &misses);
+  CHECK((hits == 0) && (misses == 0), "cache used after disabling: %lu hits %lu misses", hits, misses);
+
+  return(testResult("testGlyphCache"));
+}
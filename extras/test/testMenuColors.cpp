@@ -0,0 +1,107 @@
+//
+// changing the palette, the menu colors or the fonts while a menu is on the screen: the
+// menu drawn next must look the same as one drawn on a blank screen, not keep the
+// buttons of the old colors that it would otherwise skip as unchanged
+//
+
+#define private public
+#include "testSupport.h"
+
+TeensyUserInterface ui;
+static uint16_t framebuffer[ILI9341_TFTWIDTH * ILI9341_TFTHEIGHT];
+static uint16_t expected[ILI9341_TFTWIDTH * ILI9341_TFTHEIGHT];
+static ILI9341_t3_font_t largeFont;
+
+static void command(void) {}
+
+extern MENU_ITEM settingsMenu[];
+
+static MENU_ITEM mainMenu[] = {
+  {MENU_ITEM_TYPE_MAIN_MENU_HEADER, "Main",     MENU_COLUMNS_2, NULL},
+  {MENU_ITEM_TYPE_COMMAND,          "Run",      command,        NULL},
+  {MENU_ITEM_TYPE_COMMAND,          "Stop",     command,        NULL},
+  {MENU_ITEM_TYPE_SUB_MENU,         "Settings", NULL,           settingsMenu},
+  {MENU_ITEM_TYPE_END_OF_MENU,      "",         NULL,           NULL}
+};
+
+MENU_ITEM settingsMenu[] = {
+  {MENU_ITEM_TYPE_SUB_MENU_HEADER,  "Settings", MENU_COLUMNS_2, mainMenu},
+  {MENU_ITEM_TYPE_COMMAND,          "Run",      command,        NULL},
+  {MENU_ITEM_TYPE_COMMAND,          "Speed",    command,        NULL},
+  {MENU_ITEM_TYPE_END_OF_MENU,      "",         NULL,           NULL}
+};
+
+
+//
+// draw a menu over what's on the screen, then on a blank screen, and compare them
+//  Exit:   number of pixels that differ returned
+//
+static long drawAndCompare(MENU_ITEM *menu)
+{
+  long differences = 0;
+
+  ui.selectAndDrawMenu(menu, true);
+  memcpy(expected, framebuffer, sizeof(expected));
+
+  ui.lcdClearScreen(LCD_BLACK);
+  ui.selectAndDrawMenu(menu, true);
+  for (int i = 0; i < ui.lcdWidth * ui.lcdHeight; i++)
+    differences += (expected[i] != framebuffer[i]);
+  return(differences);
+}
+
+
+
+int main()
+{
+  long differences;
+
+  ui.begin(10, 9, 8, LCD_ORIENTATION_LANDSCAPE_4PIN_LEFT, makeTestFont(14));
+  largeFont = testFont;
+  makeTestFont(10);
+  ui.setTitleBarFont(testFont);
+  ui.setMenuFont(testFont);
+  ui.lcdEnableFramebuffer(framebuffer);
+
+  //
+  // the same menu, and another menu, after the palette changes
+  //
+  ui.selectAndDrawMenu(mainMenu, true);
+  ui.setColorPaletteGray();
+  differences = drawAndCompare(mainMenu);
+  CHECK(differences == 0, "same menu after setColorPaletteGray(): %ld pixels differ", differences);
+
+  ui.setColorPaletteBlue();
+  differences = drawAndCompare(settingsMenu);
+  CHECK(differences == 0, "sub menu after setColorPaletteBlue(): %ld pixels differ", differences);
+
+  //
+  // the menu and title bar colors set on their own
+  //
+  ui.setMenuColors(LCD_BLACK, LCD_RED, LCD_YELLOW, LCD_WHITE, LCD_BLACK);
+  differences = drawAndCompare(settingsMenu);
+  CHECK(differences == 0, "after setMenuColors(): %ld pixels differ", differences);
+
+  ui.setTitleBarColors(LCD_RED, LCD_BLACK, LCD_DARKGREEN, LCD_GREEN);
+  differences = drawAndCompare(mainMenu);
+  CHECK(differences == 0, "after setTitleBarColors(): %ld pixels differ", differences);
+
+  //
+  // the fonts
+  //
+  ui.setMenuFont(largeFont);
+  differences = drawAndCompare(mainMenu);
+  CHECK(differences == 0, "after setMenuFont(): %ld pixels differ", differences);
+
+  ui.setTitleBarFont(largeFont);
+  differences = drawAndCompare(settingsMenu);
+  CHECK(differences == 0, "after setTitleBarFont(): %ld pixels differ", differences);
+
+  //
+  // with nothing changed, the next menu is still drawn incrementally
+  //
+  ui.selectAndDrawMenu(mainMenu, true);
+  CHECK(ui.menuOnScreenFlg, "the menu on the screen was forgotten without a change");
+
+  return(testResult("testMenuColors"));
+}
@@ -0,0 +1,136 @@
+//
+// menu descriptors: makeMenuDescriptor() works out a table's size when compiled, each
+// descriptor is checked against its table when given to beginMenu(), and the layout
+// uses the descriptor found from the table without searching it.  Descriptors that
+// don't match their tables, and tables without one, are searched for their ends
+//
+
+#define private public
+#include "testSupport.h"
+
+TeensyUserInterface ui;
+
+static void command(void) {}
+
+extern MENU_ITEM subMenus[40][6];
+
+static MENU_ITEM mainMenu[] = {
+  {MENU_ITEM_TYPE_MAIN_MENU_HEADER, "Main",     MENU_COLUMNS_2, NULL},
+  {MENU_ITEM_TYPE_COMMAND,          "Run",      command,        NULL},
+  {MENU_ITEM_TYPE_COMMAND,          "Stop",     command,        NULL},
+  {MENU_ITEM_TYPE_SUB_MENU,         "Settings", NULL,           subMenus[0]},
+  {MENU_ITEM_TYPE_END_OF_MENU,      "",         NULL,           NULL}
+};
+
+//
+// a table with room to spare, its end isn't its last entry
+//
+static MENU_ITEM paddedMenu[8] = {
+  {MENU_ITEM_TYPE_SUB_MENU_HEADER,  "Padded",   MENU_COLUMNS_1, mainMenu},
+  {MENU_ITEM_TYPE_COMMAND,          "A",        command,        NULL},
+  {MENU_ITEM_TYPE_COMMAND,          "B",        command,        NULL},
+  {MENU_ITEM_TYPE_END_OF_MENU,      "",         NULL,           NULL}
+};
+
+//
+// a table without its header
+//
+static MENU_ITEM headlessMenu[] = {
+  {MENU_ITEM_TYPE_COMMAND,          "A",        command,        NULL},
+  {MENU_ITEM_TYPE_COMMAND,          "B",        command,        NULL},
+  {MENU_ITEM_TYPE_END_OF_MENU,      "",         NULL,           NULL}
+};
+
+MENU_ITEM subMenus[40][6];
+
+constexpr MENU_DESCRIPTOR mainDescriptor = makeMenuDescriptor<2>(mainMenu);
+static_assert((mainDescriptor.buttonCount == 3) && (mainDescriptor.columns == 2) && (mainDescriptor.rows == 2), 
+  "makeMenuDescriptor() got the size of the main menu wrong");
+
+static MENU_DESCRIPTOR descriptors[41];
+
+
+//
+// the number of buttons the current menu is laid out with, laying it out again
+//
+static int layoutButtonCount(MENU_ITEM *menu)
+{
+  ui.currentMenuTable = menu;
+  ui.menuLayout.menu = NULL;
+  return(ui.getMenuLayout()->buttonCount);
+}
+
+
+
+int main()
+{
+  ui.begin(10, 9, 8, LCD_ORIENTATION_PORTRAIT_4PIN_TOP, makeTestFont(10));
+  ui.setTitleBarFont(testFont);
+  ui.setMenuFont(testFont);
+
+  //
+  // 40 sub menus of 4 buttons in 3 columns
+  //
+  descriptors[0] = mainDescriptor;
+  for (int i = 0; i < 40; i++)
+  {
+    subMenus[i][0] = {MENU_ITEM_TYPE_SUB_MENU_HEADER, "Sub", MENU_COLUMNS_3, mainMenu};
+    for (int j = 1; j <= 4; j++)
+      subMenus[i][j] = {MENU_ITEM_TYPE_COMMAND, "C", command, NULL};
+    subMenus[i][5] = {MENU_ITEM_TYPE_END_OF_MENU, "", NULL, NULL};
+    descriptors[i + 1] = makeMenuDescriptor<3>(subMenus[i]);
+  }
+  CHECK((descriptors[1].buttonCount == 4) && (descriptors[1].rows == 2), "sub menu descriptor has %d buttons, %d rows", 
+    descriptors[1].buttonCount, descriptors[1].rows);
+
+  //
+  // each descriptor that fits in the hash table is found from its table, the rest 
+  // aren't and their tables are searched
+  //
+  ui.beginMenu(descriptors);
+  int found = 0, wrong = 0;
+  for (int i = 0; i < 41; i++)
+  {
+    const MENU_DESCRIPTOR *descriptor = ui.findMenuDescriptor(descriptors[i].menu);
+    if (descriptor != NULL)
+      found++;
+    if ((descriptor != NULL) && (descriptor != &descriptors[i]))
+      wrong++;
+  }
+  CHECK((found == MENU_DESCRIPTOR_HASH_SIZE / 2) && (wrong == 0), "%d descriptors found, %d wrong", found, wrong);
+  CHECK(ui.findMenuDescriptor(paddedMenu) == NULL, "found a descriptor for a table without one");
+  CHECK(layoutButtonCount(subMenus[39]) == 4, "sub menu without a descriptor has %d buttons", ui.menuLayout.buttonCount);
+
+  //
+  // with a descriptor the table isn't searched: ending the main menu early doesn't 
+  // change its layout
+  //
+  mainMenu[2].MenuItemType = MENU_ITEM_TYPE_END_OF_MENU;
+  CHECK(layoutButtonCount(mainMenu) == 3, "main menu laid out with %d buttons, not from its descriptor", ui.menuLayout.buttonCount);
+  mainMenu[2].MenuItemType = MENU_ITEM_TYPE_COMMAND;
+
+  //
+  // descriptors that don't match their tables are ignored
+  //
+  MENU_DESCRIPTOR badDescriptors[] = {
+    makeMenuDescriptor<1>(paddedMenu),
+    makeMenuDescriptor<1>(headlessMenu),
+    makeMenuDescriptor<4>(mainMenu)
+  };
+  ui.beginMenu(badDescriptors);
+  CHECK(ui.findMenuDescriptor(paddedMenu) == NULL, "descriptor for a table whose end isn't its last entry was used");
+  CHECK(ui.findMenuDescriptor(headlessMenu) == NULL, "descriptor for a table without a header was used");
+  CHECK(ui.findMenuDescriptor(mainMenu) == NULL, "descriptor with the wrong columns was used");
+  CHECK(layoutButtonCount(paddedMenu) == 2, "padded menu laid out with %d buttons", ui.menuLayout.buttonCount);
+  CHECK((layoutButtonCount(mainMenu) == 3) && (ui.menuLayout.columns == 2), "main menu laid out with %d buttons in %d columns", 
+    ui.menuLayout.buttonCount, ui.menuLayout.columns);
+
+  //
+  // menus given as tables have no descriptors
+  //
+  ui.beginMenu(descriptors);
+  ui.beginMenu(mainMenu);
+  CHECK(ui.findMenuDescriptor(mainMenu) == NULL, "descriptors kept after beginMenu() with a table");
+
+  return(testResult("testMenuDescriptor"));
+}
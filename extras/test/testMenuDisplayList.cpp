@@ -0,0 +1,96 @@
+//
+// menus drawn directly (the default) and through a display list must look the same,
+// and nothing is recorded unless the display list is turned on
+//
+
+#include "testSupport.h"
+
+TeensyUserInterface ui;
+static uint16_t framebuffer[ILI9341_TFTWIDTH * ILI9341_TFTHEIGHT];
+static uint16_t directScreens[11][ILI9341_TFTWIDTH * ILI9341_TFTHEIGHT];
+
+static void command(void) {}
+
+extern MENU_ITEM settingsMenu[];
+extern MENU_ITEM moreMenu[];
+
+static MENU_ITEM mainMenu[] = {
+  {MENU_ITEM_TYPE_MAIN_MENU_HEADER, "Main",     MENU_COLUMNS_2, NULL},
+  {MENU_ITEM_TYPE_COMMAND,          "Run",      command,        NULL},
+  {MENU_ITEM_TYPE_COMMAND,          "Stop",     command,        NULL},
+  {MENU_ITEM_TYPE_SUB_MENU,         "Settings", NULL,           settingsMenu},
+  {MENU_ITEM_TYPE_SUB_MENU,         "More",     NULL,           moreMenu},
+  {MENU_ITEM_TYPE_COMMAND,          "Info",     command,        NULL},
+  {MENU_ITEM_TYPE_END_OF_MENU,      "",         NULL,           NULL}
+};
+
+MENU_ITEM settingsMenu[] = {
+  {MENU_ITEM_TYPE_SUB_MENU_HEADER,  "Settings", MENU_COLUMNS_2, mainMenu},
+  {MENU_ITEM_TYPE_COMMAND,          "Run",      command,        NULL},
+  {MENU_ITEM_TYPE_COMMAND,          "Speed",    command,        NULL},
+  {MENU_ITEM_TYPE_COMMAND,          "Settings", command,        NULL},
+  {MENU_ITEM_TYPE_END_OF_MENU,      "",         NULL,           NULL}
+};
+
+MENU_ITEM moreMenu[] = {
+  {MENU_ITEM_TYPE_SUB_MENU_HEADER,  "More",     MENU_COLUMNS_3, mainMenu},
+  {MENU_ITEM_TYPE_COMMAND,          "A",        command,        NULL},
+  {MENU_ITEM_TYPE_COMMAND,          "B",        command,        NULL},
+  {MENU_ITEM_TYPE_COMMAND,          "C",        command,        NULL},
+  {MENU_ITEM_TYPE_END_OF_MENU,      "",         NULL,           NULL}
+};
+
+static MENU_ITEM *menuSequence[11] = {mainMenu, settingsMenu, mainMenu, mainMenu, moreMenu,
+  mainMenu, settingsMenu, settingsMenu, moreMenu, settingsMenu, mainMenu};
+
+
+//
+// draw the sequence of menus, keeping or checking the framebuffer after each one
+//  Exit:   number of drawing commands recorded in display lists
+//
+static long drawMenuSequence(boolean displayListFlg)
+{
+  int commandsRecorded, commandsCulled, commandsMerged;
+  long pixelsSaved;
+  long totalRecorded = 0;
+
+  ui.setMenuDisplayList(displayListFlg);
+  ui.lcdClearScreen(LCD_BLACK);
+  ui.selectAndDrawMenu(mainMenu, true);
+  for (int i = 0; i < 11; i++)
+  {
+    ui.lcdGetDisplayListStatistics(&commandsRecorded, &commandsCulled, &commandsMerged, &pixelsSaved);
+    long recordedBefore = commandsRecorded;
+    ui.selectAndDrawMenu(menuSequence[i], true);
+    ui.lcdGetDisplayListStatistics(&commandsRecorded, &commandsCulled, &commandsMerged, &pixelsSaved);
+    if (commandsRecorded != recordedBefore)
+      totalRecorded += commandsRecorded;
+
+    if (!displayListFlg)
+      memcpy(directScreens[i], framebuffer, sizeof(framebuffer));
+    else
+      CHECK(memcmp(directScreens[i], framebuffer, sizeof(framebuffer)) == 0, "step %d: display list screen differs", i);
+  }
+  return(totalRecorded);
+}
+
+
+
+int main()
+{
+  const int orientations[] = {LCD_ORIENTATION_LANDSCAPE_4PIN_LEFT, LCD_ORIENTATION_PORTRAIT_4PIN_TOP};
+
+  for (int i = 0; i < 2; i++)
+  {
+    ui.begin(10, 9, 8, orientations[i], makeTestFont(10));
+    ui.setTitleBarFont(testFont);
+    ui.setMenuFont(testFont);
+    ui.lcdEnableFramebuffer(framebuffer);
+    long recordedDirect = drawMenuSequence(false);
+    long recordedList = drawMenuSequence(true);
+    CHECK(recordedDirect == 0, "orientation %d: %ld commands recorded with the display list off", orientations[i], recordedDirect);
+    CHECK(recordedList > 0, "orientation %d: nothing recorded with the display list on", orientations[i]);
+    ui.lcdDisableFramebuffer();
+  }
+  return(testResult("testMenuDisplayList"));
+}
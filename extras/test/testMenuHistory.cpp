@@ -0,0 +1,186 @@
+//
+// menu history: Back goes to the menu the user came from, even for a menu reachable
+// from several menus, with that menu's layout, scroll position and last button touched
+// restored rather than worked out again.  The history holds MENU_HISTORY_DEPTH levels,
+// past that Back follows the parent in the menu's header, and selecting a main menu
+// starts it over
+//
+
+#define private public
+#include "testSupport.h"
+
+TeensyUserInterface ui;
+
+static void command(void) {}
+
+extern MENU_ITEM bigMenu[];
+extern MENU_ITEM otherMenu[];
+extern MENU_ITEM sharedMenu[];
+extern MENU_ITEM chainMenus[12][4];
+
+static MENU_ITEM mainMenu[] = {
+  {MENU_ITEM_TYPE_MAIN_MENU_HEADER, "Main",     MENU_COLUMNS_1, NULL},
+  {MENU_ITEM_TYPE_SUB_MENU,         "Big",      NULL,           bigMenu},
+  {MENU_ITEM_TYPE_SUB_MENU,         "Other",    NULL,           otherMenu},
+  {MENU_ITEM_TYPE_SUB_MENU,         "Chain",    NULL,           chainMenus[0]},
+  {MENU_ITEM_TYPE_END_OF_MENU,      "",         NULL,           NULL}
+};
+
+MENU_ITEM otherMenu[] = {
+  {MENU_ITEM_TYPE_SUB_MENU_HEADER,  "Other",    MENU_COLUMNS_1, mainMenu},
+  {MENU_ITEM_TYPE_COMMAND,          "Run",      command,        NULL},
+  {MENU_ITEM_TYPE_SUB_MENU,         "Shared",   NULL,           sharedMenu},
+  {MENU_ITEM_TYPE_END_OF_MENU,      "",         NULL,           NULL}
+};
+
+//
+// reachable from Big and Other, its header names Main as its parent
+//
+MENU_ITEM sharedMenu[] = {
+  {MENU_ITEM_TYPE_SUB_MENU_HEADER,  "Shared",   MENU_COLUMNS_1, mainMenu},
+  {MENU_ITEM_TYPE_COMMAND,          "Run",      command,        NULL},
+  {MENU_ITEM_TYPE_SUB_MENU,         "Main",     NULL,           mainMenu},
+  {MENU_ITEM_TYPE_END_OF_MENU,      "",         NULL,           NULL}
+};
+
+MENU_ITEM bigMenu[42];
+static char bigLabels[40][8];
+MENU_ITEM chainMenus[12][4];
+
+
+static int tapMenuButton(int menuIdx)
+{
+  int x, y, width, height;
+
+  ui.getMenuButtonSizeAndLocation(menuIdx, &x, &y, &width, &height);
+  return(testTapMenu(ui, x + width / 2, y + height / 2));
+}
+
+static int tapBackButton(void)
+{
+  int x, y, width, height;
+
+  ui.getBackButtonSizeAndLocation(&x, &y, &width, &height);
+  return(testTapMenu(ui, x + width / 2, y + height / 2));
+}
+
+
+
+int main()
+{
+  //
+  // a menu of 40 buttons that scrolls, the 30th goes to the shared menu, and a chain 
+  // of sub menus deeper than the history
+  //
+  bigMenu[0] = {MENU_ITEM_TYPE_SUB_MENU_HEADER, "Big", MENU_COLUMNS_1, mainMenu};
+  for (int i = 1; i <= 40; i++)
+  {
+    sprintf(bigLabels[i - 1], "B%02d", i);
+    bigMenu[i] = {MENU_ITEM_TYPE_COMMAND, bigLabels[i - 1], command, NULL};
+  }
+  bigMenu[30] = {MENU_ITEM_TYPE_SUB_MENU, "Shared", NULL, sharedMenu};
+  bigMenu[41] = {MENU_ITEM_TYPE_END_OF_MENU, "", NULL, NULL};
+
+  for (int i = 0; i < 12; i++)
+  {
+    chainMenus[i][0] = {MENU_ITEM_TYPE_SUB_MENU_HEADER, "Chain", MENU_COLUMNS_1, (i == 0) ? mainMenu : chainMenus[i - 1]};
+    chainMenus[i][1] = {MENU_ITEM_TYPE_SUB_MENU, "Deeper", NULL, chainMenus[min(i + 1, 11)]};
+    chainMenus[i][2] = {MENU_ITEM_TYPE_COMMAND, "Run", command, NULL};
+    chainMenus[i][3] = {MENU_ITEM_TYPE_END_OF_MENU, "", NULL, NULL};
+  }
+
+  ui.begin(10, 9, 8, LCD_ORIENTATION_PORTRAIT_4PIN_TOP, makeTestFont(10));
+  ui.setTouchScreenCalibrationConstants(0, 1, 0, 1);
+  ui.setTitleBarFont(testFont);
+  ui.setMenuFont(testFont);
+  ui.setMenuScrolling(40);
+  ui.beginMenu(mainMenu);
+
+  //
+  // Back from the shared menu goes to the menu it was reached from
+  //
+  tapMenuButton(2);
+  CHECK(tapMenuButton(2) == MENU_STATUS_MENU_CHANGED, "touching Shared on Other didn't change the menu");
+  CHECK(ui.currentMenuTable == sharedMenu, "Shared isn't showing");
+  tapBackButton();
+  CHECK(ui.currentMenuTable == otherMenu, "Back from Shared reached from Other went to %s", ui.currentMenuTable[0].MenuItemText);
+  tapBackButton();
+  CHECK(ui.currentMenuTable == mainMenu, "Back from Other went to %s", ui.currentMenuTable[0].MenuItemText);
+  CHECK(ui.menuHistoryCount == 0, "%d levels left on the history at the main menu", ui.menuHistoryCount);
+
+  //
+  // scroll the big menu to its 30th button and go to the shared menu from there
+  //
+  tapMenuButton(1);
+  CHECK(ui.currentMenuTable == bigMenu, "Big isn't showing");
+  int x, y, width, height;
+  ui.getMenuButtonSizeAndLocation(30, &x, &y, &width, &height);
+  while (y + height - 1 > ui.displaySpaceBottomY)
+  {
+    ui.scrollMenu(1);
+    ui.getMenuButtonSizeAndLocation(30, &x, &y, &width, &height);
+  }
+  MENU_LAYOUT bigLayout = ui.menuLayout;
+  tapMenuButton(30);
+  CHECK(ui.currentMenuTable == sharedMenu, "touching the 30th button of Big didn't show Shared");
+
+  //
+  // Back restores its layout and scroll position without laying it out again: with 
+  // the table's end moved, the layout still has all 40 buttons
+  //
+  MENU_ITEM firstItem = bigMenu[1];
+  bigMenu[1].MenuItemType = MENU_ITEM_TYPE_END_OF_MENU;
+  tapBackButton();
+  bigMenu[1] = firstItem;
+  CHECK(ui.currentMenuTable == bigMenu, "Back from Shared reached from Big went to %s", ui.currentMenuTable[0].MenuItemText);
+  CHECK(memcmp(&ui.menuLayout, &bigLayout, sizeof(bigLayout)) == 0, "Big's layout wasn't restored, %d buttons scrolled to %d, was %d",
+    ui.menuLayout.buttonCount, ui.menuLayout.scrollY, bigLayout.scrollY);
+  CHECK(ui.menuLastTouchedIdx == 30, "last button touched is %d", ui.menuLastTouchedIdx);
+
+  //
+  // after the orientation changes the big menu is laid out again, scrolled so the 
+  // last button touched is showing
+  //
+  tapMenuButton(30);
+  ui.setOrientation(LCD_ORIENTATION_LANDSCAPE_4PIN_LEFT);
+  ui.setTouchScreenCalibrationConstants(0, 1, 0, 1);
+  ui.selectAndDrawMenu(sharedMenu, true);
+  tapBackButton();
+  ui.getMenuButtonSizeAndLocation(30, &x, &y, &width, &height);
+  CHECK(ui.currentMenuTable == bigMenu, "Back after the orientation changed went to %s", ui.currentMenuTable[0].MenuItemText);
+  CHECK(ui.menuLayout.displaySpaceWidth == ui.displaySpaceWidth, "Big wasn't laid out again for the new orientation");
+  CHECK((y >= ui.displaySpaceTopY) && (y + height - 1 <= ui.displaySpaceBottomY), "the 30th button is at %d, off the screen", y);
+  tapBackButton();
+  ui.setOrientation(LCD_ORIENTATION_PORTRAIT_4PIN_TOP);
+  ui.setTouchScreenCalibrationConstants(0, 1, 0, 1);
+  ui.selectAndDrawMenu(mainMenu, true);
+
+  //
+  // going deeper than the history, Back follows it, then the parents in the headers
+  //
+  tapMenuButton(3);
+  for (int i = 0; i < 11; i++)
+    tapMenuButton(1);
+  CHECK(ui.currentMenuTable == chainMenus[11], "not at the end of the chain");
+  CHECK(ui.menuHistoryCount == MENU_HISTORY_DEPTH, "%d levels on the history", ui.menuHistoryCount);
+  int wrongLevels = 0;
+  for (int i = 10; i >= 0; i--)
+  {
+    tapBackButton();
+    wrongLevels += (ui.currentMenuTable != chainMenus[i]);
+  }
+  tapBackButton();
+  CHECK(wrongLevels == 0, "Back went to the wrong menu %d times", wrongLevels);
+  CHECK(ui.currentMenuTable == mainMenu, "Back from the chain went to %s", ui.currentMenuTable[0].MenuItemText);
+
+  //
+  // selecting a main menu from a sub menu starts the history over
+  //
+  tapMenuButton(2);
+  tapMenuButton(2);
+  CHECK(ui.menuHistoryCount == 2, "%d levels on the history at Shared", ui.menuHistoryCount);
+  tapMenuButton(2);
+  CHECK((ui.currentMenuTable == mainMenu) && (ui.menuHistoryCount == 0), "%d levels on the history after going to Main", ui.menuHistoryCount);
+
+  return(testResult("testMenuHistory"));
+}
@@ -0,0 +1,227 @@
+//
+// menu layout and hit testing: every point of the screen must find the same button as
+// checking each button's rectangle, for menus of 1 to 4 columns with 3 to 400 items, laid
+// out to fit or scrolled, in each orientation.  The layout is built once per menu, then
+// finding the button touched doesn't read the menu table, so it takes the same time for
+// any number of items
+//
+
+#define private public
+#include "testSupport.h"
+
+TeensyUserInterface ui;
+
+const int MAX_ITEMS = 400;
+
+static MENU_ITEM menu[MAX_ITEMS + 2];
+static char labels[MAX_ITEMS][8];
+
+static void command(void) {}
+
+
+//
+// fill in a menu table with the given number of command buttons
+//
+static void buildMenu(int itemCount, int columns)
+{
+  menu[0].MenuItemType = MENU_ITEM_TYPE_MAIN_MENU_HEADER;
+  menu[0].MenuItemText = "Diagnostics";
+  menu[0].MenuItemFunction = (void (*)()) (intptr_t) columns;
+  menu[0].MenuItemSubMenu = NULL;
+  for (int i = 1; i <= itemCount; i++)
+  {
+    sprintf(labels[i - 1], "D%03d", i);
+    menu[i].MenuItemType = MENU_ITEM_TYPE_COMMAND;
+    menu[i].MenuItemText = labels[i - 1];
+    menu[i].MenuItemFunction = command;
+    menu[i].MenuItemSubMenu = NULL;
+  }
+  menu[itemCount + 1].MenuItemType = MENU_ITEM_TYPE_END_OF_MENU;
+  menu[itemCount + 1].MenuItemText = "";
+}
+
+
+
+//
+// find the button at a point by checking every button's rectangle
+//
+static int findButtonByRectangles(int x, int y)
+{
+  int buttonX, buttonY, buttonWidth, buttonHeight;
+
+  if (ui.menuLayout.scrollFlg && ((y < ui.displaySpaceTopY) || (y > ui.displaySpaceBottomY)))
+    return(0);
+
+  for (int menuIdx = 1; menuIdx <= ui.menuLayout.buttonCount; menuIdx++)
+  {
+    ui.getMenuButtonSizeAndLocation(menuIdx, &buttonX, &buttonY, &buttonWidth, &buttonHeight);
+    if ((x >= buttonX) && (x < buttonX + buttonWidth) && (y >= buttonY) && (y < buttonY + buttonHeight))
+      return(menuIdx);
+  }
+  return(0);
+}
+
+
+
+//
+// hit test the whole screen
+//  Exit:   number of points where the two ways disagree returned, *buttonsFound = 
+//            number of different buttons found
+//
+static long checkHitTesting(int *buttonsFound)
+{
+  static boolean foundFlg[MAX_ITEMS + 1];
+  long differences = 0;
+
+  memset(foundFlg, 0, sizeof(foundFlg));
+  *buttonsFound = 0;
+  for (int y = 0; y < ui.lcdHeight; y++)
+  {
+    for (int x = 0; x < ui.lcdWidth; x++)
+    {
+      ui.touchEventX = x;
+      ui.touchEventY = y;
+      int menuIdx = ui.findMenuButtonForTouchEvent();
+      if (menuIdx != findButtonByRectangles(x, y))
+        differences++;
+      if ((menuIdx > 0) && !foundFlg[menuIdx])
+      {
+        foundFlg[menuIdx] = true;
+        (*buttonsFound)++;
+      }
+    }
+  }
+  return(differences);
+}
+
+
+
+//
+// count the buttons that don't fit in the display space, or overlap the next button
+//
+static int checkButtonPlacement(void)
+{
+  int badButtons = 0;
+  int x, y, width, height, nextX, nextY, nextWidth, nextHeight;
+
+  for (int menuIdx = 1; menuIdx <= ui.menuLayout.buttonCount; menuIdx++)
+  {
+    ui.getMenuButtonSizeAndLocation(menuIdx, &x, &y, &width, &height);
+    if ((width <= 0) || (height <= 0) || (x < ui.displaySpaceLeftX) || (x + width - 1 > ui.displaySpaceRightX))
+      badButtons++;
+    else if (!ui.menuLayout.scrollFlg && ((y < ui.displaySpaceTopY) || (y + height - 1 > ui.displaySpaceBottomY)))
+      badButtons++;
+    else if (menuIdx < ui.menuLayout.buttonCount)
+    {
+      ui.getMenuButtonSizeAndLocation(menuIdx + 1, &nextX, &nextY, &nextWidth, &nextHeight);
+      if ((nextY == y) ? (nextX < x + width) : (nextY < y + height))
+        badButtons++;
+    }
+  }
+  return(badButtons);
+}
+
+
+
+//
+// time finding the button touched at points spread over the screen
+//  Exit:   nanoseconds for each lookup returned
+//
+static double timeHitTesting(void)
+{
+  const int LOOKUPS = 2000000;
+  volatile long total = 0;
+
+  double start = testSeconds();
+  for (int i = 0; i < LOOKUPS; i++)
+  {
+    ui.touchEventX = (i * 7) % ui.lcdWidth;
+    ui.touchEventY = (i * 13) % ui.lcdHeight;
+    total += ui.findMenuButtonForTouchEvent();
+  }
+  return((testSeconds() - start) * 1e9 / LOOKUPS);
+}
+
+
+
+int main()
+{
+  const int itemCounts[] = {3, 40, 400};
+  const int orientations[] = {LCD_ORIENTATION_PORTRAIT_4PIN_TOP, LCD_ORIENTATION_LANDSCAPE_4PIN_LEFT};
+  int buttonsFound;
+
+  ui.begin(10, 9, 8, LCD_ORIENTATION_PORTRAIT_4PIN_TOP, makeTestFont(10));
+  ui.setTitleBarFont(testFont);
+  ui.setMenuFont(testFont);
+
+  for (int scrollFlg = 0; scrollFlg <= 1; scrollFlg++)
+  {
+    ui.setMenuScrolling(scrollFlg ? 40 : 0);
+    for (int o = 0; o < 2; o++)
+    {
+      for (int i = 0; i < 3; i++)
+      {
+        for (int columns = 1; columns <= 4; columns++)
+        {
+          //
+          // the menu is laid out when it's selected, and again for a new orientation
+          //
+          buildMenu(itemCounts[i], columns);
+          ui.setOrientation(orientations[1 - o]);
+          ui.selectAndDrawMenu(menu, true);
+          ui.setOrientation(orientations[o]);
+
+          //
+          // scroll part way down, so the hit testing covers the scroll position
+          //
+          if (ui.getMenuLayout()->scrollFlg)
+            ui.menuLayout.scrollY = ui.menuLayout.maxScrollY / 2;
+
+          long differences = checkHitTesting(&buttonsFound);
+          int badButtons = checkButtonPlacement();
+          CHECK((ui.menuLayout.displaySpaceWidth == ui.displaySpaceWidth) && (ui.menuLayout.displaySpaceHeight == ui.displaySpaceHeight),
+            "%d items %d columns: not laid out again for the new orientation", itemCounts[i], columns);
+          CHECK(differences == 0, "%d items %d columns %s: %ld points hit a different button", 
+            itemCounts[i], columns, scrollFlg ? "scrolled" : "fitted", differences);
+
+          //
+          // without scrolling, large menus have no room for their buttons
+          //
+          if (ui.menuLayout.buttonHeight <= 0)
+            continue;
+          CHECK(badButtons == 0, "%d items %d columns %s: %d buttons misplaced", 
+            itemCounts[i], columns, scrollFlg ? "scrolled" : "fitted", badButtons);
+          CHECK(ui.menuLayout.scrollFlg || (buttonsFound == itemCounts[i]), "%d items %d columns: %d buttons can be touched", 
+            itemCounts[i], columns, buttonsFound);
+        }
+      }
+    }
+  }
+
+  //
+  // once laid out, finding the button touched doesn't read the table: with the end of 
+  // the menu moved, the same buttons are still found, and each lookup takes the same time
+  //
+  ui.setMenuScrolling(40);
+  ui.setOrientation(LCD_ORIENTATION_PORTRAIT_4PIN_TOP);
+  printf("  finding the button touched, scrolling menus of 4 columns:\n");
+  for (int i = 0; i < 3; i++)
+  {
+    int buttonsFoundChanged;
+    buildMenu(itemCounts[i], 4);
+    ui.selectAndDrawMenu(menu, true);
+    checkHitTesting(&buttonsFound);
+
+    MENU_ITEM firstItem = menu[1];
+    menu[1].MenuItemType = MENU_ITEM_TYPE_END_OF_MENU;
+    long differences = checkHitTesting(&buttonsFoundChanged);
+    double nanoseconds = timeHitTesting();
+    menu[1] = firstItem;
+
+    CHECK((differences == 0) && (buttonsFoundChanged == buttonsFound), "%d items: %d buttons found with the table changed, %d before", 
+      itemCounts[i], buttonsFoundChanged, buttonsFound);
+    printf("    %3d items: %2d buttons showing, %.1f ns each\n", itemCounts[i], buttonsFound, nanoseconds);
+  }
+
+  return(testResult("testMenuLayout"));
+}
@@ -0,0 +1,134 @@
+//
+// scrolling menu benchmark: one row scrolls of a 1 column menu with 10, 100 and 1000
+// items, the work for each scroll must not grow with the length of the menu, it can
+// differ some with the text on the buttons scrolled into view
+//
+// Portrait uses the LCD's hardware scrolling, so only the uncovered rows are sent.
+// Landscape moves the framebuffer's rows, then the flush sends the tiles whose pixels
+// changed.  The work is measured by the pixels flushed and by the characters drawn, counted by the
+// glyph cache.
+//
+
+#define private public
+#include "testSupport.h"
+
+TeensyUserInterface ui;
+static uint16_t framebuffer[ILI9341_TFTWIDTH * ILI9341_TFTHEIGHT];
+
+const int SCROLL_COUNT = 200;
+const int MAX_ITEMS = 1000;
+
+static MENU_ITEM menu[MAX_ITEMS + 2];
+static char labels[MAX_ITEMS][8];
+
+static void command(void) {}
+
+
+//
+// fill in a menu table with the given number of command buttons
+//
+static void buildMenu(int itemCount)
+{
+  menu[0].MenuItemType = MENU_ITEM_TYPE_MAIN_MENU_HEADER;
+  menu[0].MenuItemText = "Parameters";
+  menu[0].MenuItemFunction = MENU_COLUMNS_1;
+  menu[0].MenuItemSubMenu = NULL;
+  for (int i = 1; i <= itemCount; i++)
+  {
+    sprintf(labels[i - 1], "P%04d", i);
+    menu[i].MenuItemType = MENU_ITEM_TYPE_COMMAND;
+    menu[i].MenuItemText = labels[i - 1];
+    menu[i].MenuItemFunction = command;
+    menu[i].MenuItemSubMenu = NULL;
+  }
+  menu[itemCount + 1].MenuItemType = MENU_ITEM_TYPE_END_OF_MENU;
+  menu[itemCount + 1].MenuItemText = "";
+}
+
+
+
+//
+// scroll the menu one row at a time, down to the end and back up again
+//  Exit:   seconds taken, *pixelsSent and *charactersDrawn = per scroll averages
+//
+static double runScrolls(double *pixelsSent, double *charactersDrawn)
+{
+  int direction = 1;
+  long pixels = 0;
+  unsigned long hits, misses;
+  double seconds = 0;
+
+  ui.lcdClearGlyphCacheStatistics();
+
+  for (int i = 0; i < SCROLL_COUNT; i++)
+  {
+    if (ui.menuLayout.scrollY + ui.menuLayout.buttonHeight + ui.menuLayout.spacing > ui.menuLayout.maxScrollY)
+      direction = -1;
+    if (ui.menuLayout.scrollY == 0)
+      direction = 1;
+
+    stubClearSpiCounts();
+    double start = testSeconds();
+    ui.scrollMenu(direction);
+    ui.lcdFlush();
+    seconds += testSeconds() - start;
+    pixels += stubSpiPixels;
+  }
+
+  ui.lcdGetGlyphCacheStatistics(&hits, &misses);
+  *pixelsSent = (double) pixels / SCROLL_COUNT;
+  *charactersDrawn = (double) (hits + misses) / SCROLL_COUNT;
+  return(seconds);
+}
+
+
+
+static void testOrientation(int orientation, const char *orientationName)
+{
+  const int itemCounts[] = {10, 100, 1000};
+  double pixelsSent[3], charactersDrawn[3];
+
+  ui.begin(10, 9, 8, orientation, makeTestFont(10));
+  ui.setTitleBarFont(testFont);
+  ui.setMenuFont(testFont);
+  ui.lcdEnableFramebuffer(framebuffer);
+  ui.setMenuScrolling(40);
+  ui.lcdSetGlyphCacheSize(64, 512);
+
+  printf("  %s, %d one row scrolls:\n", orientationName, SCROLL_COUNT);
+  for (int i = 0; i < 3; i++)
+  {
+    buildMenu(itemCounts[i]);
+    ui.selectAndDrawMenu(menu, true);
+    ui.lcdFlush();
+    CHECK(ui.menuLayout.scrollFlg, "%d items: menu doesn't scroll", itemCounts[i]);
+
+    double seconds = runScrolls(&pixelsSent[i], &charactersDrawn[i]);
+
+    double start = testSeconds();
+    for (int j = 0; j < SCROLL_COUNT; j++)
+      ui.selectAndDrawMenu(menu, true);
+    double drawSeconds = testSeconds() - start;
+
+    printf("    %4d items: scrolling %.2f ms, %7.0f pixels and %4.1f characters per scroll, %d draws %.2f ms\n",
+      itemCounts[i], seconds * 1000, pixelsSent[i], charactersDrawn[i], SCROLL_COUNT, drawSeconds * 1000);
+  }
+
+  for (int i = 1; i < 3; i++)
+  {
+    CHECK(pixelsSent[i] <= pixelsSent[0] * 1.5, "%s %d items: %.0f pixels per scroll against %.0f for 10", orientationName, itemCounts[i], pixelsSent[i], pixelsSent[0]);
+    CHECK(charactersDrawn[i] <= charactersDrawn[0] * 1.5, "%s %d items: %.1f characters per scroll against %.1f for 10", orientationName, itemCounts[i], charactersDrawn[i], charactersDrawn[0]);
+  }
+
+  ui.lcdSetGlyphCacheSize(0, 0);
+  ui.lcdDisableFramebuffer();
+}
+
+
+
+int main()
+{
+  testOrientation(LCD_ORIENTATION_PORTRAIT_4PIN_TOP, "portrait");
+  testOrientation(LCD_ORIENTATION_LANDSCAPE_4PIN_LEFT, "landscape");
+  return(testResult("testMenuScrolling"));
+}
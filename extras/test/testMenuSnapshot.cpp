@@ -0,0 +1,143 @@
+//
+// menu snapshot cache: a command that draws its own screen gets the menu put back
+// from the copy, as long as nothing on the menu changed and nothing else was drawn
+// over it first.  The copy is only made from the framebuffer
+//
+
+#define private public
+#include "testSupport.h"
+
+TeensyUserInterface ui;
+static uint16_t framebuffer[ILI9341_TFTWIDTH * ILI9341_TFTHEIGHT];
+static uint16_t menuScreen[ILI9341_TFTWIDTH * ILI9341_TFTHEIGHT];
+
+static void drawOwnScreen(void)
+{
+  ui.lcdClearScreen(LCD_BLUE);
+  ui.lcdDrawFilledRectangle(20, 20, 100, 100, LCD_RED);
+}
+
+static void doNothing(void) {}
+static void renameRun(void);
+
+static MENU_ITEM mainMenu[] = {
+  {MENU_ITEM_TYPE_MAIN_MENU_HEADER, "Main",     MENU_COLUMNS_1, NULL},
+  {MENU_ITEM_TYPE_COMMAND,          "Draw",     drawOwnScreen,  NULL},
+  {MENU_ITEM_TYPE_COMMAND,          "Nothing",  doNothing,      NULL},
+  {MENU_ITEM_TYPE_COMMAND,          "Rename",   renameRun,      NULL},
+  {MENU_ITEM_TYPE_END_OF_MENU,      "",         NULL,           NULL}
+};
+
+static void renameRun(void)
+{
+  drawOwnScreen();
+  mainMenu[3].MenuItemText = "Renamed";
+}
+
+
+static int tapMenuButton(int menuIdx)
+{
+  int x, y, width, height;
+
+  ui.getMenuButtonSizeAndLocation(menuIdx, &x, &y, &width, &height);
+  return(testTapMenu(ui, x + width / 2, y + height / 2));
+}
+
+static void checkStatistics(unsigned long expectedHits, unsigned long expectedMisses, const char *when)
+{
+  unsigned long hits, misses;
+  long bytesUsed;
+
+  ui.getMenuSnapshotStatistics(&hits, &misses, &bytesUsed);
+  CHECK((hits == expectedHits) && (misses == expectedMisses), "%s: %lu hits, %lu misses, expected %lu and %lu", 
+    when, hits, misses, expectedHits, expectedMisses);
+}
+
+static void redrawMenu(void)
+{
+  ui.lcdClearScreen(LCD_BLACK);
+  ui.selectAndDrawMenu(mainMenu, true);
+  ui.lcdFlush();
+}
+
+
+
+int main()
+{
+  ui.begin(10, 9, 8, LCD_ORIENTATION_PORTRAIT_4PIN_TOP, makeTestFont(10));
+  ui.setTouchScreenCalibrationConstants(0, 1, 0, 1);
+  ui.setTitleBarFont(testFont);
+  ui.setMenuFont(testFont);
+  ui.lcdEnableFramebuffer(framebuffer);
+  CHECK(ui.setMenuSnapshotCache(16384), "couldn't allocate the snapshot cache");
+
+  //
+  // run length coding: the copy puts back exactly what was on the screen
+  //
+  ui.beginMenu(mainMenu);
+  ui.lcdFlush();
+  memcpy(menuScreen, framebuffer, sizeof(menuScreen));
+  ui.captureMenuSnapshot();
+  long bytesUsed;
+  unsigned long hits, misses;
+  ui.getMenuSnapshotStatistics(&hits, &misses, &bytesUsed);
+  printf("  menu copy is %ld bytes, the screen is %ld\n", bytesUsed, (long) sizeof(menuScreen));
+  CHECK(ui.menuSnapshotValidFlg, "menu wasn't copied");
+  CHECK((bytesUsed > 0) && (bytesUsed < 16384), "copy takes %ld bytes", bytesUsed);
+  memset(framebuffer, 0x55, sizeof(framebuffer));
+  CHECK(ui.restoreMenuSnapshot(), "copy wasn't put back");
+  ui.lcdFlush();
+  CHECK(memcmp(menuScreen, framebuffer, sizeof(menuScreen)) == 0, "copy put back differs from the menu");
+  ui.clearMenuSnapshotStatistics();
+
+  //
+  // hit: a command draws its own screen and the menu is put back as it was
+  //
+  redrawMenu();
+  memcpy(menuScreen, framebuffer, sizeof(menuScreen));
+  CHECK(tapMenuButton(1) == MENU_STATUS_COMMAND, "Draw didn't run");
+  checkStatistics(1, 0, "after Draw");
+  CHECK(memcmp(menuScreen, framebuffer, sizeof(menuScreen)) == 0, "menu put back after Draw differs from the menu drawn");
+
+  //
+  // a command that draws nothing leaves the menu alone, the copy isn't needed
+  //
+  CHECK(tapMenuButton(2) == MENU_STATUS_COMMAND, "Nothing didn't run");
+  checkStatistics(1, 0, "after Nothing");
+
+  //
+  // miss: something was drawn over the menu before the command, lcdDrawCount changed
+  //
+  ui.lcdDrawFilledRectangle(0, 300, 20, 20, LCD_GREEN);
+  CHECK(tapMenuButton(1) == MENU_STATUS_COMMAND, "Draw didn't run");
+  checkStatistics(1, 1, "after drawing over the menu");
+  CHECK(framebuffer[310 * ILI9341_TFTWIDTH + 10] != LCD_GREEN, "menu wasn't drawn again after drawing over it");
+
+  //
+  // miss: the command changes a button's label
+  //
+  CHECK(tapMenuButton(1) == MENU_STATUS_COMMAND, "Draw didn't run");
+  checkStatistics(2, 1, "after Draw");
+  CHECK(tapMenuButton(3) == MENU_STATUS_COMMAND, "Rename didn't run");
+  checkStatistics(2, 2, "after the label changed");
+
+  //
+  // miss: the copy doesn't fit its budget
+  //
+  CHECK(ui.setMenuSnapshotCache(64), "couldn't allocate the small snapshot cache");
+  ui.clearMenuSnapshotStatistics();
+  CHECK(tapMenuButton(1) == MENU_STATUS_COMMAND, "Draw didn't run");
+  checkStatistics(0, 1, "with a 64 byte budget");
+
+  //
+  // without the framebuffer no copy is made, the screen isn't read back
+  //
+  CHECK(ui.setMenuSnapshotCache(16384), "couldn't allocate the snapshot cache");
+  ui.lcdDisableFramebuffer();
+  ui.clearMenuSnapshotStatistics();
+  CHECK(tapMenuButton(1) == MENU_STATUS_COMMAND, "Draw didn't run");
+  CHECK(!ui.menuSnapshotValidFlg, "menu was copied without the framebuffer");
+  checkStatistics(0, 1, "without the framebuffer");
+
+  return(testResult("testMenuSnapshot"));
+}
@@ -0,0 +1,159 @@
+//
+// toggle state buttons: the label follows the MENU_TOGGLE's state, setToggleState()
+// redraws only that button and doesn't call the toggle's function, touching the button
+// steps to the next state and does call it
+//
+
+#define private public
+#include "testSupport.h"
+
+TeensyUserInterface ui;
+static uint16_t framebuffer[ILI9341_TFTWIDTH * ILI9341_TFTHEIGHT];
+static uint16_t panelBefore[ILI9341_TFTWIDTH * ILI9341_TFTHEIGHT];
+static int ledChangedCount = 0;
+
+static void command(void) {}
+static void ledChanged(void) { ledChangedCount++; }
+
+static const char *ledOptions[] = {"Off", "On", "Blink"};
+static MENU_TOGGLE ledToggle = {0, 3, ledOptions, false, false, 0, ""};
+static const char *fanOptions[] = {"Low", "High"};
+static MENU_TOGGLE fanToggle = {0, 2, fanOptions, false, false, 0, ""};
+
+extern MENU_ITEM fanMenu[];
+
+static MENU_ITEM mainMenu[] = {
+  {MENU_ITEM_TYPE_MAIN_MENU_HEADER, "Main",     MENU_COLUMNS_1, NULL},
+  {MENU_ITEM_TYPE_COMMAND,          "Run",      command,        NULL},
+  {MENU_ITEM_TYPE_TOGGLE_STATE,     "LED",      ledChanged,     MENU_TOGGLE_STATE(ledToggle)},
+  {MENU_ITEM_TYPE_SUB_MENU,         "Fan",      NULL,           fanMenu},
+  {MENU_ITEM_TYPE_END_OF_MENU,      "",         NULL,           NULL}
+};
+
+MENU_ITEM fanMenu[] = {
+  {MENU_ITEM_TYPE_SUB_MENU_HEADER,  "Fan",      MENU_COLUMNS_1, mainMenu},
+  {MENU_ITEM_TYPE_TOGGLE_STATE,     "Speed",    NULL,           MENU_TOGGLE_STATE(fanToggle)},
+  {MENU_ITEM_TYPE_END_OF_MENU,      "",         NULL,           NULL}
+};
+
+
+//
+// touch a menu button and let go, polling the menu all the while
+//
+static int tapMenuButton(int menuIdx)
+{
+  int x, y, width, height;
+
+  ui.getMenuButtonSizeAndLocation(menuIdx, &x, &y, &width, &height);
+  return(testTapMenu(ui, x + width / 2, y + height / 2));
+}
+
+
+
+//
+// count the pixels that changed on the panel, inside and outside of a menu button
+//
+static void countChangedPixels(int menuIdx, long *inside, long *outside)
+{
+  int x, y, width, height;
+
+  ui.getMenuButtonSizeAndLocation(menuIdx, &x, &y, &width, &height);
+  *inside = 0;
+  *outside = 0;
+  for (int py = 0; py < ui.lcdHeight; py++)
+  {
+    for (int px = 0; px < ui.lcdWidth; px++)
+    {
+      if (stubPanel[py * ui.lcdWidth + px] == panelBefore[py * ui.lcdWidth + px])
+        continue;
+      if ((px >= x) && (px < x + width) && (py >= y) && (py < y + height))
+        (*inside)++;
+      else
+        (*outside)++;
+    }
+  }
+}
+
+
+
+int main()
+{
+  long inside, outside;
+
+  ui.begin(10, 9, 8, LCD_ORIENTATION_PORTRAIT_4PIN_TOP, makeTestFont(10));
+  ui.setTouchScreenCalibrationConstants(0, 1, 0, 1);
+  ui.setTitleBarFont(testFont);
+  ui.setMenuFont(testFont);
+  ui.lcdEnableFramebuffer(framebuffer);
+
+  ui.beginMenu(mainMenu);
+  ui.lcdFlush();
+  CHECK(strcmp(ui.getToggleLabel(&mainMenu[2]), "LED:  Off") == 0, "label is \"%s\"", ui.getToggleLabel(&mainMenu[2]));
+
+  //
+  // setting the state from the application redraws just its button, on the next poll
+  //
+  memcpy(panelBefore, stubPanel, sizeof(panelBefore));
+  ui.setToggleState(ledToggle, 1);
+  CHECK(ledToggle.state == 1, "state is %d", ledToggle.state);
+  CHECK(ui.toggleDirtyFlg, "setting the state didn't mark the toggle to be drawn");
+  stubClearSpiCounts();
+  CHECK(ui.pollMenu() == MENU_STATUS_IDLE, "poll without a touch did something");
+  ui.lcdFlush();
+  countChangedPixels(2, &inside, &outside);
+  printf("  setToggleState: %ld pixels sent, %ld changed on the button, %ld elsewhere\n", stubSpiPixels, inside, outside);
+  CHECK((inside > 0) && (outside == 0), "%ld pixels changed on the button, %ld elsewhere", inside, outside);
+  CHECK(strcmp(ui.getToggleLabel(&mainMenu[2]), "LED:  On") == 0, "label is \"%s\"", ui.getToggleLabel(&mainMenu[2]));
+  CHECK(ledChangedCount == 0, "setToggleState() called the toggle's function");
+
+  //
+  // setting the same state again, or one out of range, draws nothing
+  //
+  ui.setToggleState(ledToggle, 1);
+  CHECK(!ui.toggleDirtyFlg, "setting the same state marked the toggle to be drawn");
+  ui.setToggleState(ledToggle, 3);
+  ui.setToggleState(ledToggle, -1);
+  CHECK(ledToggle.state == 1, "state out of range was taken, state is %d", ledToggle.state);
+  stubClearSpiCounts();
+  ui.pollMenu();
+  ui.lcdFlush();
+  CHECK(stubSpiPixels == 0, "%ld pixels sent with nothing changed", stubSpiPixels);
+
+  //
+  // touching the button steps through the states, wrapping around, and calls its function
+  //
+  CHECK(tapMenuButton(2) == MENU_STATUS_TOGGLED, "touching the toggle didn't report it");
+  CHECK(ledToggle.state == 2, "state is %d after a touch", ledToggle.state);
+  CHECK(tapMenuButton(2) == MENU_STATUS_TOGGLED, "touching the toggle didn't report it");
+  CHECK(ledToggle.state == 0, "state is %d after wrapping", ledToggle.state);
+  CHECK(ledChangedCount == 2, "the toggle's function was called %d times for 2 touches", ledChangedCount);
+  CHECK(strcmp(ui.getToggleLabel(&mainMenu[2]), "LED:  Off") == 0, "label is \"%s\"", ui.getToggleLabel(&mainMenu[2]));
+
+  //
+  // a toggle on a menu that isn't showing is drawn with its new state when its menu is
+  //
+  ui.setToggleState(fanToggle, 1);
+  stubClearSpiCounts();
+  ui.pollMenu();
+  ui.lcdFlush();
+  CHECK(stubSpiPixels == 0, "%ld pixels sent for a toggle that isn't showing", stubSpiPixels);
+  CHECK(tapMenuButton(3) == MENU_STATUS_MENU_CHANGED, "touching Fan didn't change the menu");
+  CHECK(ui.currentMenuTable == fanMenu, "Fan menu isn't showing");
+  CHECK(strcmp(ui.getToggleLabel(&fanMenu[1]), "Speed:  High") == 0, "label is \"%s\"", ui.getToggleLabel(&fanMenu[1]));
+
+  //
+  // a toggle without a function still steps
+  //
+  CHECK(tapMenuButton(1) == MENU_STATUS_TOGGLED, "touching the toggle didn't report it");
+  CHECK(fanToggle.state == 0, "state is %d after a touch", fanToggle.state);
+
+  //
+  // changing the orientation forgets the menu on the screen, so it's laid out and drawn again
+  //
+  ui.setOrientation(LCD_ORIENTATION_LANDSCAPE_4PIN_LEFT);
+  CHECK((ui.menuLayout.menu == NULL) && !ui.menuOnScreenFlg, "the menu on the screen survived a change in orientation");
+  ui.selectAndDrawMenu(fanMenu, true);
+  CHECK(ui.menuLayout.displaySpaceWidth == ui.displaySpaceWidth, "the menu wasn't laid out for the new orientation");
+
+  return(testResult("testMenuToggle"));
+}
@@ -0,0 +1,168 @@
+//
+// Number Box auto repeat: the default timing grows the step as before, a TOUCH_TIMING
+// speeds it up, and no timing or stepAmount can overflow the step or the value.  Holding
+// the Up button from 0 to 100000 is timed with each timing
+//
+
+#define private public
+#include <limits.h>
+#include "testSupport.h"
+
+TeensyUserInterface ui;
+
+static const TOUCH_TIMING fastTiming = {30, 500, 100, 10, 10, 0, 1000};
+
+
+static void getCoordinates(NUMBER_BOX &n, int *a, int *b, int *c, int *d, int *e, int *f, int *g)
+{
+  ui.getNumberBoxCoordinates(n, a, b, c, d, e, f, g);
+}
+
+static void getCoordinates(NUMBER_BOX_FLOAT &n, int *a, int *b, int *c, int *d, int *e, int *f, int *g)
+{
+  ui.getNumberBoxCoordinatesFloat(n, a, b, c, d, e, f, g);
+}
+
+
+
+//
+// hold a Number Box's button until the value stops changing
+//  Enter:  upFlg = true to hold Up, false for Down
+//  Exit:   seconds held returned, *wrongWayFlg set if the value ever went the wrong way
+//
+template<class NB> static double holdButton(NB &numberBox, boolean upFlg, const TOUCH_TIMING *timing, boolean *wrongWayFlg)
+{
+  int downButtonX, numberX, upButtonX, topY, buttonWidth, numberWidth, height;
+  getCoordinates(numberBox, &downButtonX, &numberX, &upButtonX, &topY, &buttonWidth, &numberWidth, &height);
+
+  stubRawX = (upFlg ? upButtonX : downButtonX) + buttonWidth / 2;
+  stubRawY = topY + height / 2;
+  stubTouched = 1;
+  *wrongWayFlg = false;
+
+  unsigned long startTime = fakeMillis;
+  unsigned long lastChangeTime = fakeMillis;
+  while (fakeMillis - lastChangeTime < 5000)
+  {
+    testAdvanceMillis(1);
+    ui.getTouchEvents();
+    double before = numberBox.value;
+    ui.checkForNumberBoxTouched(numberBox, timing);
+    if (numberBox.value != before)
+    {
+      lastChangeTime = fakeMillis;
+      if (upFlg ? (numberBox.value < before) : (numberBox.value > before))
+        *wrongWayFlg = true;
+    }
+  }
+
+  stubTouched = 0;
+  for (int i = 0; i < 100; i++)
+  {
+    testAdvanceMillis(1);
+    ui.getTouchEvents();
+    ui.checkForNumberBoxTouched(numberBox, timing);
+  }
+  return((lastChangeTime - startTime) / 1000.0);
+}
+
+
+
+//
+// run the step growth for a timing, checking it stays in range and never shrinks
+//  Exit:   the last step returned
+//
+static long checkStepGrowth(const char *name, const TOUCH_TIMING *timing, long repeats)
+{
+  long lastStep = 1;
+
+  ui.touchActiveTiming = timing;
+  ui.startNumberBoxRepeat(NULL);
+  for (long n = 1; n <= repeats; n++)
+  {
+    long step = ui.getNumberBoxRepeatStep();
+    long limit = (timing->maximumStep > 0) ? timing->maximumStep : 1000000;
+    if ((step < 1) || (step > limit) || ((timing->stepMultiplier >= 1) && (timing->stepIncrease >= 0) && (step < lastStep)))
+    {
+      CHECK(false, "%s: repeat %ld step %ld after %ld", name, n, step, lastStep);
+      break;
+    }
+    lastStep = step;
+  }
+  return(lastStep);
+}
+
+
+
+int main()
+{
+  boolean wrongWayFlg;
+
+  ui.begin(10, 9, 8, LCD_ORIENTATION_LANDSCAPE_4PIN_LEFT, makeTestFont(10));
+  ui.setTouchScreenCalibrationConstants(0, 1, 0, 1);
+  ui.setTitleBarFont(testFont);
+  ui.setMenuFont(testFont);
+  ui.drawTitleBar("Number Boxes");
+  ui.clearDisplaySpace();
+
+  //
+  // the default timing grows the step by one every 16 repeats, as it always did
+  //
+  int differences = 0;
+  ui.setTouchTiming(NULL);
+  const TOUCH_TIMING *defaultTiming = ui.touchTiming;
+  ui.startNumberBoxRepeat(NULL);
+  for (int n = 1; n <= 5000; n++)
+    differences += (ui.getNumberBoxRepeatStep() != (n / 16) + 1);
+  CHECK(differences == 0, "default step differs from repeats / 16 + 1 %d times", differences);
+
+  CHECK(checkStepGrowth("fast", &fastTiming, 100) == 1000, "fast timing doesn't reach its maximum step");
+
+  //
+  // timings that would overflow when multiplied or added stay within the limit
+  //
+  static const TOUCH_TIMING hugeMultiplier = {30, 500, 100, 1, INT_MAX, 0, 0};
+  static const TOUCH_TIMING hugeIncrease = {30, 500, 100, 1, 1, INT_MAX, 0};
+  static const TOUCH_TIMING hugeBoth = {30, 500, 100, 1, 1 << 30, INT_MAX, INT_MAX};
+  static const TOUCH_TIMING negativeMultiplier = {30, 500, 100, 1, INT_MIN, 5, 0};
+  CHECK(checkStepGrowth("huge multiplier", &hugeMultiplier, 1000) == 1000000, "huge multiplier doesn't stop at the limit");
+  CHECK(checkStepGrowth("huge increase", &hugeIncrease, 1000) == 1000000, "huge increase doesn't stop at the limit");
+  CHECK(checkStepGrowth("huge both", &hugeBoth, 1000) == 1000000, "huge multiplier and increase don't stop at the limit");
+  CHECK(checkStepGrowth("negative multiplier", &negativeMultiplier, 1000) == 5, "negative multiplier isn't taken as 0");
+  ui.setTouchTiming(NULL);
+
+  //
+  // a large stepAmount times a large step can't wrap the value around
+  //
+  NUMBER_BOX bigBox = {"Big", 0, INT_MIN + 1, INT_MAX - 1, 1000000000, 160, 60, 150, 32};
+  ui.drawNumberBox(bigBox);
+  holdButton(bigBox, true, &hugeMultiplier, &wrongWayFlg);
+  CHECK(!wrongWayFlg, "Up went down");
+  CHECK(bigBox.value == INT_MAX - 1, "Up stopped at %d", bigBox.value);
+  holdButton(bigBox, false, &hugeMultiplier, &wrongWayFlg);
+  CHECK(!wrongWayFlg, "Down went up");
+  CHECK(bigBox.value == INT_MIN + 1, "Down stopped at %d", bigBox.value);
+
+  //
+  // time holding Up from 0 to 100000
+  //
+  NUMBER_BOX box = {"N", 0, 0, 100000, 1, 100, 120, 150, 32};
+  NUMBER_BOX_FLOAT floatBox = {"F", 0, 0, 1000, 0.01, 2, 220, 120, 150, 32};
+  ui.drawNumberBox(box);
+  ui.drawNumberBox(floatBox);
+
+  double defaultSeconds = holdButton(box, true, NULL, &wrongWayFlg);
+  CHECK(box.value == 100000, "default timing stopped at %d", box.value);
+  box.value = 0;
+  double fastSeconds = holdButton(box, true, &fastTiming, &wrongWayFlg);
+  CHECK(box.value == 100000, "fast timing stopped at %d", box.value);
+  double floatSeconds = holdButton(floatBox, true, &fastTiming, &wrongWayFlg);
+  CHECK(fabs(floatBox.value - 1000) < 0.001, "float box stopped at %f", floatBox.value);
+  CHECK(ui.touchTiming == defaultTiming, "the widget's timing was kept for the screen");
+
+  printf("  holding Up from 0 to 100000: default timing %.1f s, fast timing %.1f s\n", defaultSeconds, fastSeconds);
+  printf("  holding Up from 0 to 1000 by 0.01 with the fast timing: %.1f s\n", floatSeconds);
+  CHECK(fastSeconds < defaultSeconds / 5, "fast timing isn't faster");
+
+  return(testResult("testNumberBoxRepeat"));
+}
@@ -0,0 +1,158 @@
+//
+// the menus run from the application's loop: pollMenu() returns right away, reads the
+// touch screen at most once and draws at most one menu, and commands, toggles, sub menus
+// and Back work as they do with displayAndExecuteMenu()
+//
+
+#define private public
+#include "testSupport.h"
+
+TeensyUserInterface ui;
+static uint16_t framebuffer[ILI9341_TFTWIDTH * ILI9341_TFTHEIGHT];
+
+static int runCount = 0;
+static int callbackCount = 0;
+static boolean lightOnFlg = false;
+
+static void run(void) { runCount++; }
+static void inMenuCallback(void) { callbackCount++; }
+
+static void light(void)
+{
+  if (ui.toggleSelectNextStateFlg)
+    lightOnFlg = !lightOnFlg;
+  ui.toggleText = lightOnFlg ? "Light:  On" : "Light:  Off";
+}
+
+extern MENU_ITEM settingsMenu[];
+
+static MENU_ITEM mainMenu[] = {
+  {MENU_ITEM_TYPE_MAIN_MENU_HEADER, "Main",     MENU_COLUMNS_1, NULL},
+  {MENU_ITEM_TYPE_COMMAND,          "Run",      run,            NULL},
+  {MENU_ITEM_TYPE_TOGGLE,           "Light",    light,          NULL},
+  {MENU_ITEM_TYPE_SUB_MENU,         "Settings", NULL,           settingsMenu},
+  {MENU_ITEM_TYPE_END_OF_MENU,      "",         NULL,           NULL}
+};
+
+MENU_ITEM settingsMenu[] = {
+  {MENU_ITEM_TYPE_SUB_MENU_HEADER,  "Settings", MENU_COLUMNS_2, mainMenu},
+  {MENU_ITEM_TYPE_COMMAND,          "A",        run,            NULL},
+  {MENU_ITEM_TYPE_COMMAND,          "B",        run,            NULL},
+  {MENU_ITEM_TYPE_END_OF_MENU,      "",         NULL,           NULL}
+};
+
+
+static int tapMenuButton(int menuIdx)
+{
+  int x, y, width, height;
+
+  ui.getMenuButtonSizeAndLocation(menuIdx, &x, &y, &width, &height);
+  return(testTapMenu(ui, x + width / 2, y + height / 2));
+}
+
+static int tapBackButton(void)
+{
+  int x, y, width, height;
+
+  ui.getBackButtonSizeAndLocation(&x, &y, &width, &height);
+  return(testTapMenu(ui, x + width / 2, y + height / 2));
+}
+
+
+
+int main()
+{
+  ui.begin(10, 9, 8, LCD_ORIENTATION_PORTRAIT_4PIN_TOP, makeTestFont(10));
+  ui.setTouchScreenCalibrationConstants(0, 1, 0, 1);
+  ui.setTitleBarFont(testFont);
+  ui.setMenuFont(testFont);
+  ui.setInMenuCallbackFunction(inMenuCallback);
+
+  CHECK(ui.pollMenu() == MENU_STATUS_NOT_RUNNING, "polled before beginMenu()");
+
+  ui.beginMenu(mainMenu);
+  CHECK(ui.currentMenuTable == mainMenu, "beginMenu() didn't show the main menu");
+
+  //
+  // with nothing touched each poll reads the touch screen at most once and draws nothing
+  //
+  long mostReads = 0;
+  long pixels = 0;
+  for (int i = 0; i < 1000; i++)
+  {
+    testAdvanceMicros(250);
+    stubTouchScreenReads = 0;
+    stubClearSpiCounts();
+    CHECK(ui.pollMenu() == MENU_STATUS_IDLE, "poll %d wasn't idle", i);
+    mostReads = max(mostReads, stubTouchScreenReads);
+    pixels += stubSpiPixels;
+  }
+  CHECK((mostReads <= 1) && (pixels == 0), "idle polls read the touch screen up to %ld times, sent %ld pixels", mostReads, pixels);
+
+  //
+  // a touch draws at most one menu in one poll
+  //
+  ui.lcdEnableFramebuffer(framebuffer);
+  ui.selectAndDrawMenu(mainMenu, true);
+  ui.lcdFlush();
+  int x, y, width, height;
+  ui.getMenuButtonSizeAndLocation(3, &x, &y, &width, &height);
+  stubRawX = x + width / 2;
+  stubRawY = y + height / 2;
+  long mostPixels = 0;
+  int menuChanges = 0;
+  for (int i = 0; i < 100; i++)
+  {
+    stubTouched = (i < 50);
+    testAdvanceMillis(1);
+    stubTouchScreenReads = 0;
+    stubClearSpiCounts();
+    menuChanges += (ui.pollMenu() == MENU_STATUS_MENU_CHANGED);
+    ui.lcdFlush();
+    mostReads = max(mostReads, stubTouchScreenReads);
+    mostPixels = max(mostPixels, stubSpiPixels);
+  }
+  printf("  most in one poll: %ld touch screen reads, %ld pixels sent\n", mostReads, mostPixels);
+  CHECK(menuChanges == 1, "the sub menu was selected %d times", menuChanges);
+  CHECK(mostReads <= 1, "a poll read the touch screen %ld times", mostReads);
+  CHECK(mostPixels <= (long) ui.lcdWidth * ui.lcdHeight, "a poll sent %ld pixels, more than one screen", mostPixels);
+
+  //
+  // Back from the sub menu goes back to the main menu
+  //
+  CHECK(ui.currentMenuTable == settingsMenu, "touching Settings didn't show it");
+  CHECK(tapBackButton() == MENU_STATUS_MENU_CHANGED, "Back on the sub menu didn't change the menu");
+  CHECK(ui.currentMenuTable == mainMenu, "Back on the sub menu didn't show the main menu");
+
+  //
+  // commands and toggles are run from pollMenu()
+  //
+  CHECK(tapMenuButton(1) == MENU_STATUS_COMMAND, "touching Run didn't report a command");
+  CHECK(runCount == 1, "Run's function called %d times", runCount);
+  CHECK(tapMenuButton(2) == MENU_STATUS_TOGGLED, "touching Light didn't report a toggle");
+  CHECK(lightOnFlg, "Light wasn't toggled");
+  CHECK(strcmp(ui.toggleText, "Light:  On") == 0, "toggle text is \"%s\"", ui.toggleText);
+
+  //
+  // touching between the buttons does nothing
+  //
+  ui.getMenuButtonSizeAndLocation(1, &x, &y, &width, &height);
+  CHECK(testTapMenu(ui, x + width / 2, y + height + ui.menuLayout.spacing / 2) == MENU_STATUS_IDLE, "touching between buttons did something");
+  CHECK(runCount == 1, "touching between buttons ran a command");
+
+  //
+  // Back on the main menu ends the menus, the application's loop takes the place 
+  // of the in menu callback
+  //
+  CHECK(tapBackButton() == MENU_STATUS_EXITED, "Back on the main menu didn't exit");
+  CHECK(ui.pollMenu() == MENU_STATUS_NOT_RUNNING, "still running after exiting");
+  CHECK(callbackCount == 0, "pollMenu() called the in menu callback %d times", callbackCount);
+
+  //
+  // it can be started again
+  //
+  ui.beginMenu(mainMenu);
+  CHECK(ui.pollMenu() == MENU_STATUS_IDLE, "not running after beginMenu() again");
+
+  return(testResult("testPollMenu"));
+}
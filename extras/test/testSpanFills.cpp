@@ -0,0 +1,99 @@
+//
+// SPI command counts for filled shapes drawn by the LCD driver (the default) and as
+// joined spans after lcdSetSpanFills(true), both must put the same pixels on the panel
+//
+
+#include "testSupport.h"
+
+TeensyUserInterface ui;
+static uint16_t driverPanel[ILI9341_TFTWIDTH * ILI9341_TFTHEIGHT];
+
+const int SHAPE_CIRCLE = 0;
+const int SHAPE_ROUNDED_RECTANGLE = 1;
+const int SHAPE_TRIANGLE = 2;
+
+typedef struct
+{
+  const char *name;
+  int shape;
+  int p0, p1, p2, p3, p4, p5;
+} TEST_SHAPE;
+
+static const TEST_SHAPE testShapes[] = {
+  {"circle r=10",                    SHAPE_CIRCLE,            100, 100,  10,   0,  0,   0},
+  {"circle r=30",                    SHAPE_CIRCLE,            100, 100,  30,   0,  0,   0},
+  {"circle r=60",                    SHAPE_CIRCLE,            160, 120,  60,   0,  0,   0},
+  {"rounded rect 100x40 r=8",        SHAPE_ROUNDED_RECTANGLE,  20,  20, 100,  40,  8,   0},
+  {"rounded rect 200x150 r=20",      SHAPE_ROUNDED_RECTANGLE,  40,  40, 200, 150, 20,   0},
+  {"triangle (arrow)",               SHAPE_TRIANGLE,          200,  10, 190,  25, 210, 25},
+  {"triangle 150x100",               SHAPE_TRIANGLE,           20, 200, 170, 200,  95, 100}
+};
+
+
+static void drawShape(const TEST_SHAPE &s, uint16_t color)
+{
+  switch (s.shape)
+  {
+    case SHAPE_CIRCLE: ui.lcdDrawFilledCircle(s.p0, s.p1, s.p2, color); break;
+    case SHAPE_ROUNDED_RECTANGLE: ui.lcdDrawFilledRoundedRectangle(s.p0, s.p1, s.p2, s.p3, s.p4, color); break;
+    case SHAPE_TRIANGLE: ui.lcdDrawFilledTriangle(s.p0, s.p1, s.p2, s.p3, s.p4, s.p5, color); break;
+  }
+}
+
+
+
+//
+// draw a shape on a cleared panel, returning the SPI commands it took
+//
+static long measureShape(const TEST_SHAPE &s, boolean spanFillsFlg)
+{
+  ui.lcdSetSpanFills(false);
+  ui.lcdClearScreen(LCD_BLACK);
+  ui.lcdSetSpanFills(spanFillsFlg);
+  stubClearSpiCounts();
+  drawShape(s, LCD_YELLOW);
+  return(stubSpiCommands);
+}
+
+
+
+int main()
+{
+  ui.begin(10, 9, 8, LCD_ORIENTATION_LANDSCAPE_4PIN_LEFT, makeTestFont(10));
+
+  printf("  %-28s %16s %16s\n", "", "driver commands", "span commands");
+  for (unsigned i = 0; i < sizeof(testShapes) / sizeof(testShapes[0]); i++)
+  {
+    const TEST_SHAPE &s = testShapes[i];
+
+    long driverCommands = measureShape(s, false);
+    long driverPixels = stubSpiPixels;
+    memcpy(driverPanel, stubPanel, sizeof(stubPanel));
+
+    long spanCommands = measureShape(s, true);
+    long spanPixels = stubSpiPixels;
+
+    printf("  %-28s %16ld %16ld\n", s.name, driverCommands, spanCommands);
+    CHECK(spanCommands < driverCommands, "%s: %ld span commands against %ld", s.name, spanCommands, driverCommands);
+    CHECK(memcmp(driverPanel, stubPanel, sizeof(stubPanel)) == 0, "%s: span pixels differ from the driver's", s.name);
+    CHECK(spanPixels <= driverPixels, "%s: %ld span pixels against %ld", s.name, spanPixels, driverPixels);
+  }
+
+  //
+  // a batch of shapes sends the same pixels
+  //
+  ui.lcdSetSpanFills(false);
+  ui.lcdClearScreen(LCD_BLACK);
+  for (unsigned i = 0; i < sizeof(testShapes) / sizeof(testShapes[0]); i++)
+    drawShape(testShapes[i], LCD_RED + i);
+  memcpy(driverPanel, stubPanel, sizeof(stubPanel));
+
+  ui.lcdClearScreen(LCD_BLACK);
+  ui.lcdBeginBatch();
+  for (unsigned i = 0; i < sizeof(testShapes) / sizeof(testShapes[0]); i++)
+    drawShape(testShapes[i], LCD_RED + i);
+  ui.lcdEndBatch();
+  CHECK(memcmp(driverPanel, stubPanel, sizeof(stubPanel)) == 0, "batched shapes differ from the driver's");
+
+  return(testResult("testSpanFills"));
+}
@@ -0,0 +1,63 @@
+//
+// string width benchmark: lcdStringWidthInPixels() sums character advances from a
+// table built when the font is selected, the driver's strPixelLen() decodes each
+// character's glyph header, both must give the same widths
+//
+
+#include "testSupport.h"
+
+TeensyUserInterface ui;
+
+const long BENCHMARK_CALLS = 200000;
+
+static const char *menuLabels[] = {"Main Menu", "Settings", "Run", "Stop", "Speed",
+  "Brightness", "Set the time", "About this device", "Back", "Calibrate touch screen"};
+const int MENU_LABEL_COUNT = sizeof(menuLabels) / sizeof(menuLabels[0]);
+
+
+int main()
+{
+  ILI9341_t3 driver(10, 9);
+  char s[2] = {0, 0};
+  char allCharacters[128];
+  long total = 0;
+
+  ui.begin(10, 9, 8, LCD_ORIENTATION_LANDSCAPE_4PIN_LEFT, makeTestFont(10));
+  driver.setFont(testFont);
+  ui.lcdSetFont(testFont);
+
+  //
+  // every character, and strings of them, measure the same as the driver
+  //
+  int length = 0;
+  for (int c = 1; c < 128; c++)
+  {
+    s[0] = c;
+    CHECK(ui.lcdStringWidthInPixels(s) == driver.strPixelLen(s), "character %d: %d against %d", c, ui.lcdStringWidthInPixels(s), driver.strPixelLen(s));
+    if (c != '\n')
+      allCharacters[length++] = c;
+  }
+  allCharacters[length] = 0;
+  CHECK(ui.lcdStringWidthInPixels(allCharacters) == driver.strPixelLen(allCharacters), "all characters");
+  for (int i = 0; i < MENU_LABEL_COUNT; i++)
+    CHECK(ui.lcdStringWidthInPixels(menuLabels[i]) == driver.strPixelLen((char *) menuLabels[i]), "label \"%s\"", menuLabels[i]);
+
+  //
+  // time measuring menu labels both ways
+  //
+  double start = testSeconds();
+  for (long i = 0; i < BENCHMARK_CALLS; i++)
+    total += driver.strPixelLen((char *) menuLabels[i % MENU_LABEL_COUNT]);
+  double driverSeconds = testSeconds() - start;
+
+  start = testSeconds();
+  for (long i = 0; i < BENCHMARK_CALLS; i++)
+    total -= ui.lcdStringWidthInPixels(menuLabels[i % MENU_LABEL_COUNT]);
+  double tableSeconds = testSeconds() - start;
+
+  printf("  %ld menu labels measured: driver %.3f s, advance table %.3f s\n", BENCHMARK_CALLS, driverSeconds, tableSeconds);
+  CHECK(total == 0, "widths differ by %ld in the benchmark", total);
+  CHECK(tableSeconds < driverSeconds, "the table wasn't faster");
+
+  return(testResult("testStringWidth"));
+}
@@ -0,0 +1,172 @@
+//
+// shared helpers for the host tests: a check macro, a generated font and the simulated
+// touch screen
+//
+
+#ifndef testSupport_h
+#define testSupport_h
+
+#include <stdio.h>
+#include <time.h>
+#include <EEPROM.h>
+#include <XPT2046_Touchscreen.h>
+#include "TeensyUserInterface.h"
+
+static int testFailures = 0;
+
+//
+// record a failed check without stopping the test
+//
+#define CHECK(condition, ...)                                         \
+  do {                                                                \
+    if (!(condition))                                                 \
+    {                                                                 \
+      testFailures++;                                                 \
+      printf("  FAILED %s:%d: %s: ", __FILE__, __LINE__, #condition); \
+      printf(__VA_ARGS__);                                            \
+      printf("\n");                                                   \
+    }                                                                 \
+  } while (0)
+
+
+//
+// report the result of the test, the return value is the program's exit status
+//
+static inline int testResult(const char *testName)
+{
+  if (testFailures == 0)
+    printf("PASS %s\n", testName);
+  else
+    printf("FAIL %s: %d checks failed\n", testName, testFailures);
+  return(testFailures == 0 ? 0 : 1);
+}
+
+
+//
+// seconds of host CPU time, for the benchmarks
+//
+static inline double testSeconds(void)
+{
+  return((double) clock() / CLOCKS_PER_SEC);
+}
+
+
+//
+// build a font in the ILI9341_t3 format with random glyphs of the given height, so that
+// text has widths and pixels without depending on the real font files
+//
+static unsigned char testFontIndex[1024];
+static unsigned char testFontData[65536];
+static ILI9341_t3_font_t testFont;
+
+static inline void testFontPutBits(unsigned char *buffer, int &bitPosition, unsigned value, int bitCount)
+{
+  for (int i = bitCount - 1; i >= 0; i--)
+  {
+    if ((value >> i) & 1)
+      buffer[bitPosition >> 3] |= 0x80 >> (bitPosition & 7);
+    bitPosition++;
+  }
+}
+
+static inline const ILI9341_t3_font_t &makeTestFont(int height)
+{
+  int indexBits = 0, dataBits = 0;
+
+  memset(testFontIndex, 0, sizeof(testFontIndex));
+  memset(testFontData, 0, sizeof(testFontData));
+  srand(height);
+  testFont.index = testFontIndex;
+  testFont.data = testFontData;
+  testFont.index1_first = 32;
+  testFont.index1_last = 126;
+  testFont.index2_first = 1;
+  testFont.index2_last = 0;
+  testFont.bits_index = 16;
+  testFont.bits_width = 6;
+  testFont.bits_height = 6;
+  testFont.bits_xoffset = 4;
+  testFont.bits_yoffset = 5;
+  testFont.bits_delta = 6;
+  testFont.line_space = height + 3;
+  testFont.cap_height = height;
+
+  for (int c = 32; c <= 126; c++)
+  {
+    while (dataBits & 7)
+      dataBits++;
+    testFontPutBits(testFontIndex, indexBits, dataBits / 8, 16);
+    int width = 3 + rand() % height;
+    int glyphHeight = 2 + rand() % height;
+    testFontPutBits(testFontData, dataBits, 0, 3);
+    testFontPutBits(testFontData, dataBits, width, 6);
+    testFontPutBits(testFontData, dataBits, glyphHeight, 6);
+    testFontPutBits(testFontData, dataBits, (rand() % 5) - 2, 4);
+    testFontPutBits(testFontData, dataBits, (rand() % 5) - 2, 5);
+    testFontPutBits(testFontData, dataBits, width + 1, 6);
+
+    for (int rows = glyphHeight; rows > 0; )
+    {
+      int repeat = 1;
+      if (rand() % 3 == 0)
+      {
+        repeat = 2 + rand() % 3;
+        if (repeat > rows)
+          repeat = rows;
+      }
+      if (repeat > 1)
+      {
+        testFontPutBits(testFontData, dataBits, 1, 1);
+        testFontPutBits(testFontData, dataBits, repeat - 2, 3);
+      }
+      else
+        testFontPutBits(testFontData, dataBits, 0, 1);
+      for (int x = 0; x < width; x++)
+        testFontPutBits(testFontData, dataBits, rand() % 2, 1);
+      rows -= repeat;
+    }
+  }
+  return(testFont);
+}
+
+
+//
+// advance simulated time
+//
+static inline void testAdvanceMicros(unsigned long us)
+{
+  fakeMicros += us;
+  fakeMillis = fakeMicros / 1000;
+}
+
+static inline void testAdvanceMillis(unsigned long ms)
+{
+  testAdvanceMicros(ms * 1000);
+}
+
+
+//
+// touch a point for 50 ms and let go, polling the menu each millisecond and flushing
+// the framebuffer if it's on, the calibration must map raw coords to LCD coords
+//  Exit:   the last status that wasn't MENU_STATUS_IDLE, MENU_STATUS_TOUCHED or 
+//            MENU_STATUS_NOT_RUNNING returned
+//
+static inline int testTapMenu(TeensyUserInterface &ui, int x, int y)
+{
+  int result = MENU_STATUS_IDLE;
+
+  stubRawX = x;
+  stubRawY = y;
+  for (int i = 0; i < 100; i++)
+  {
+    stubTouched = (i < 50);
+    testAdvanceMillis(1);
+    int status = ui.pollMenu();
+    ui.lcdFlush();
+    if ((status != MENU_STATUS_IDLE) && (status != MENU_STATUS_TOUCHED) && (status != MENU_STATUS_NOT_RUNNING))
+      result = status;
+  }
+  return(result);
+}
+
+#endif
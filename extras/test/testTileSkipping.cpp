@@ -0,0 +1,115 @@
+//
+// tile skipping: a flush checksums each 16x16 tile it covers and only sends the tiles
+// that changed since they were last sent, lcdGetTileStatistics() counts both
+//
+
+#include "testSupport.h"
+
+TeensyUserInterface ui;
+static uint16_t framebuffer[ILI9341_TFTWIDTH * ILI9341_TFTHEIGHT];
+
+static unsigned long tilesSent, tilesSkipped;
+
+
+//
+// flush, returning the tiles sent and skipped by it
+//
+static void flushAndCount(void)
+{
+  ui.lcdClearTileStatistics();
+  stubClearSpiCounts();
+  ui.lcdFlush();
+  ui.lcdGetTileStatistics(&tilesSent, &tilesSkipped);
+}
+
+
+
+static void drawTestScreen(void)
+{
+  srand(5);
+  ui.lcdClearScreen(LCD_NAVY);
+  for (int i = 0; i < 40; i++)
+    ui.lcdDrawFilledRectangle(rand() % 300, rand() % 220, 1 + rand() % 60, 1 + rand() % 40, rand());
+}
+
+
+
+int main()
+{
+  const int tilesAcross = ILI9341_TFTHEIGHT / LCD_TILE_SIZE;
+  const int tilesDown = ILI9341_TFTWIDTH / LCD_TILE_SIZE;
+
+  ui.begin(10, 9, 8, LCD_ORIENTATION_LANDSCAPE_4PIN_LEFT, makeTestFont(10));
+  ui.lcdEnableFramebuffer(framebuffer);
+
+  //
+  // the first flush sends every tile, redrawing the same screen sends none
+  //
+  drawTestScreen();
+  flushAndCount();
+  CHECK((tilesSent == (unsigned long) (tilesAcross * tilesDown)) && (tilesSkipped == 0), "first flush: %lu sent %lu skipped", tilesSent, tilesSkipped);
+
+  drawTestScreen();
+  flushAndCount();
+  CHECK((tilesSent == 0) && (tilesSkipped == (unsigned long) (tilesAcross * tilesDown)), "same screen: %lu sent %lu skipped", tilesSent, tilesSkipped);
+  CHECK(stubSpiPixels == 0, "same screen sent %ld pixels", stubSpiPixels);
+
+  //
+  // a change in one tile of the four drawn sends that tile alone
+  //
+  uint16_t color = framebuffer[40 * ILI9341_TFTHEIGHT + 40];
+  ui.lcdDrawFilledRectangle(32, 32, 32, 32, LCD_WHITE);
+  flushAndCount();
+  ui.lcdDrawFilledRectangle(32, 32, 32, 32, LCD_WHITE);
+  ui.lcdDrawPixel(40, 40, color);
+  flushAndCount();
+  CHECK((tilesSent == 1) && (tilesSkipped == 3), "one changed tile: %lu sent %lu skipped", tilesSent, tilesSkipped);
+  CHECK(stubSpiPixels == LCD_TILE_SIZE * LCD_TILE_SIZE, "one changed tile sent %ld pixels", stubSpiPixels);
+  CHECK(memcmp(stubPanel, framebuffer, sizeof(framebuffer)) == 0, "panel differs from the framebuffer");
+
+  //
+  // the counts add up over flushes until cleared
+  //
+  ui.lcdClearTileStatistics();
+  ui.lcdDrawPixel(200, 200, LCD_RED);
+  ui.lcdFlush();
+  ui.lcdDrawPixel(300, 10, LCD_RED);
+  ui.lcdFlush();
+  ui.lcdGetTileStatistics(&tilesSent, &tilesSkipped);
+  CHECK((tilesSent == 2) && (tilesSkipped == 0), "two flushes: %lu sent %lu skipped", tilesSent, tilesSkipped);
+  ui.lcdClearTileStatistics();
+  ui.lcdGetTileStatistics(&tilesSent, &tilesSkipped);
+  CHECK((tilesSent == 0) && (tilesSkipped == 0), "cleared: %lu sent %lu skipped", tilesSent, tilesSkipped);
+
+  //
+  // a menu redrawn after a command returns only sends what the command changed
+  //
+  static MENU_ITEM menu[] = {
+    {MENU_ITEM_TYPE_MAIN_MENU_HEADER, "Main",  MENU_COLUMNS_2, NULL},
+    {MENU_ITEM_TYPE_COMMAND,          "Run",   NULL,           NULL},
+    {MENU_ITEM_TYPE_COMMAND,          "Stop",  NULL,           NULL},
+    {MENU_ITEM_TYPE_COMMAND,          "Speed", NULL,           NULL},
+    {MENU_ITEM_TYPE_COMMAND,          "About", NULL,           NULL},
+    {MENU_ITEM_TYPE_END_OF_MENU,      "",      NULL,           NULL}
+  };
+  ui.setTitleBarFont(testFont);
+  ui.setMenuFont(testFont);
+  ui.selectAndDrawMenu(menu, true);
+  ui.lcdFlush();
+  ui.lcdClearScreen(LCD_BLACK);
+  ui.selectAndDrawMenu(menu, true);
+  flushAndCount();
+  CHECK((tilesSent == 0) && (tilesSkipped > 0), "menu redrawn the same: %lu sent %lu skipped", tilesSent, tilesSkipped);
+  printf("  menu repainted over a cleared screen: %lu tiles sent, %lu skipped\n", tilesSent, tilesSkipped);
+
+  //
+  // turning the framebuffer off and on again forgets what was sent
+  //
+  ui.lcdDisableFramebuffer();
+  ui.lcdEnableFramebuffer(framebuffer);
+  drawTestScreen();
+  flushAndCount();
+  CHECK(tilesSent == (unsigned long) (tilesAcross * tilesDown), "after enabling again: %lu sent", tilesSent);
+
+  return(testResult("testTileSkipping"));
+}
@@ -0,0 +1,220 @@
+//
+// fixed point touch calibration: the Q21 conversion must give the same LCD coordinates
+// as the float divide it replaced, for the default calibrations and for ones set with
+// setTouchScreenCalibrationConstants(), in every orientation.  The only differences
+// allowed are raw values that divide out to a whole number, which the float divide can
+// truncate to one less, each is printed with its quotients.  Also times both conversions,
+// each called out of line with the same arguments and results
+//
+
+#define private public
+#include <math.h>
+#include "testSupport.h"
+
+TeensyUserInterface ui;
+
+const int SAMPLE_COUNT = 20000;
+const int BENCHMARK_PASSES = 500;
+
+//
+// the calibration constants the library used before the fixed point conversion
+//
+typedef struct
+{
+  int offsetX;
+  float scalerX;
+  int offsetY;
+  float scalerY;
+} FLOAT_CALIBRATION;
+
+static const FLOAT_CALIBRATION floatCalibrations[] = {
+  {20 - 4, 14.90, 17, 11.07},       // LCD_ORIENTATION_PORTRAIT_4PIN_TOP
+  {17,     11.07, 20, 14.90},       // LCD_ORIENTATION_LANDSCAPE_4PIN_LEFT
+  {20,     14.90, 35, 11.07},       // LCD_ORIENTATION_PORTRAIT_4PIN_BOTTOM
+  {35,     11.06, 19, 14.84}        // LCD_ORIENTATION_LANDSCAPE_4PIN_RIGHT
+};
+
+static int rawX[SAMPLE_COUNT];
+static int rawY[SAMPLE_COUNT];
+
+
+//
+// the conversion as the library did it with floats
+//
+static inline int floatConvert(int raw, float scaler, int offset, int limit)
+{
+  int lcd = (int) ((float) raw / scaler) - offset;
+  return(constrain(lcd, 0, limit - 1));
+}
+
+
+
+//
+// the float conversion shaped like convertTouchScreenCoords(), kept out of line as the
+// library's is since it's in another file, so the two are timed the same way
+//
+static void __attribute__((noinline)) floatConvertTouchScreenCoords(const FLOAT_CALIBRATION &c, int xRaw, int yRaw, 
+  int *xLCD, int *yLCD)
+{
+  *xLCD = floatConvert(xRaw, c.scalerX, c.offsetX, ui.lcdWidth);
+  *yLCD = floatConvert(yRaw, c.scalerY, c.offsetY, ui.lcdHeight);
+}
+
+
+
+//
+// check if a raw value divides out to a whole number, where the float divide can come 
+// out just under it
+//
+static boolean dividesEvenly(int raw, float scaler)
+{
+  double quotient = (double) raw / (double) scaler;
+  return(fabs(quotient - floor(quotient + 0.5)) < 1e-4);
+}
+
+
+
+//
+// show why a raw value differs:  the scaler written in decimal divides it evenly, but
+// the float nearest the scaler is a little larger, so the float quotient is just under
+// the whole number and is truncated to one less
+//
+static void explainDifference(const char *axis, const int *samples, int raw, float scaler, const char *calibrationName)
+{
+  int sampleCount = 0;
+  for (int i = 0; i < SAMPLE_COUNT; i++)
+    if (samples[i] == raw)
+      sampleCount++;
+
+  double decimalScaler = floor(scaler * 100.0 + 0.5) / 100.0;
+  printf("    %s raw %s %d (%d samples): %d / %.2f = %.6f, float(%.2f) = %.9f, %d / float(%.2f) = %.6f truncates to %d\n", 
+    calibrationName, axis, raw, sampleCount, raw, decimalScaler, raw / decimalScaler, decimalScaler, (double) scaler, 
+    raw, decimalScaler, (double) ((float) raw / scaler), (int) ((float) raw / scaler));
+}
+
+
+
+//
+// a sweep of every raw value on each axis, then clusters of samples like taps
+//
+static void makeSamples(void)
+{
+  int n = 0;
+
+  for (int v = 0; v < 4096; v++)
+  {
+    rawX[n] = v;
+    rawY[n] = 4095 - v;
+    n++;
+  }
+
+  srand(7);
+  while (n < SAMPLE_COUNT)
+  {
+    int centerX = 300 + rand() % 3500;
+    int centerY = 300 + rand() % 3500;
+    for (int i = 0; (i < 20) && (n < SAMPLE_COUNT); i++)
+    {
+      rawX[n] = centerX + rand() % 41 - 20;
+      rawY[n] = centerY + rand() % 41 - 20;
+      n++;
+    }
+  }
+}
+
+
+
+//
+// compare the calibration in use against the float conversion
+//  Exit:   number of samples that differ returned
+//
+static int compareCalibration(int orientation, const char *calibrationName)
+{
+  const FLOAT_CALIBRATION &c = floatCalibrations[orientation];
+  int differences = 0;
+  int lastRawX = -1;
+  int lastRawY = -1;
+
+  for (int i = 0; i < SAMPLE_COUNT; i++)
+  {
+    int x, y;
+    ui.convertTouchScreenCoords(rawX[i], rawY[i], &x, &y);
+    int floatX = floatConvert(rawX[i], c.scalerX, c.offsetX, ui.lcdWidth);
+    int floatY = floatConvert(rawY[i], c.scalerY, c.offsetY, ui.lcdHeight);
+
+    if (x != floatX)
+    {
+      differences++;
+      CHECK((x == floatX + 1) && dividesEvenly(rawX[i], c.scalerX), "orientation %d %s: raw X %d gives %d, float %d", orientation, calibrationName, rawX[i], x, floatX);
+      if (rawX[i] != lastRawX)
+        explainDifference("X", rawX, rawX[i], c.scalerX, calibrationName);
+      lastRawX = rawX[i];
+    }
+    if (y != floatY)
+    {
+      differences++;
+      CHECK((y == floatY + 1) && dividesEvenly(rawY[i], c.scalerY), "orientation %d %s: raw Y %d gives %d, float %d", orientation, calibrationName, rawY[i], y, floatY);
+      if (rawY[i] != lastRawY)
+        explainDifference("Y", rawY, rawY[i], c.scalerY, calibrationName);
+      lastRawY = rawY[i];
+    }
+  }
+  return(differences);
+}
+
+
+
+int main()
+{
+  makeSamples();
+
+  //
+  // the fixed point calibrations agree with the float divides
+  //
+  for (int orientation = 0; orientation < 4; orientation++)
+  {
+    ui.begin(10, 9, 8, orientation, makeTestFont(10));
+    int defaultDifferences = compareCalibration(orientation, "default");
+
+    const FLOAT_CALIBRATION &c = floatCalibrations[orientation];
+    ui.setTouchScreenCalibrationConstants(c.offsetX, c.scalerX, c.offsetY, c.scalerY);
+    int constantsDifferences = compareCalibration(orientation, "set");
+
+    printf("  orientation %d: %d samples, %d differ with the default calibration, %d set from the constants\n", 
+      orientation, SAMPLE_COUNT, defaultDifferences, constantsDifferences);
+  }
+
+  //
+  // time both conversions, on the host this only shows the integer path isn't a cost.  
+  // On the Teensy 3.0 - 3.2 and LC there's no FPU, so each float divide is a library 
+  // call.  The Teensy 3.5, 3.6 and 4.x have an FPU, where a single precision divide 
+  // takes about 14 cycles and the fixed point multiplies take 1 each
+  //
+  const FLOAT_CALIBRATION &c = floatCalibrations[LCD_ORIENTATION_LANDSCAPE_4PIN_RIGHT];
+  volatile long sink = 0;
+  int x, y;
+
+  double start = testSeconds();
+  for (int pass = 0; pass < BENCHMARK_PASSES; pass++)
+    for (int i = 0; i < SAMPLE_COUNT; i++)
+    {
+      floatConvertTouchScreenCoords(c, rawX[i], rawY[i], &x, &y);
+      sink += x + y;
+    }
+  double floatSeconds = testSeconds() - start;
+
+  start = testSeconds();
+  for (int pass = 0; pass < BENCHMARK_PASSES; pass++)
+    for (int i = 0; i < SAMPLE_COUNT; i++)
+    {
+      ui.convertTouchScreenCoords(rawX[i], rawY[i], &x, &y);
+      sink += x + y;
+    }
+  double fixedSeconds = testSeconds() - start;
+
+  long conversions = (long) BENCHMARK_PASSES * SAMPLE_COUNT;
+  printf("  %ld conversions: float %.2f ns each, fixed point %.2f ns each\n", conversions, 
+    floatSeconds * 1e9 / conversions, fixedSeconds * 1e9 / conversions);
+
+  return(testResult("testTouchCalibration"));
+}
@@ -0,0 +1,275 @@
+//
+// touch filter replay: a synthetic trace of noisy taps, single sample spikes and
+// light grazes is played through sampleTouchScreen() every 1ms.  With the filter,
+// every tap must be reported once, near where it was made, and nothing else; light
+// samples under the pressure threshold must never make a touch.  With 3 samples
+// the touch must be reported within LATENCY_TARGET of first contact, on average and
+// for at least 95% of taps.  The unfiltered results are printed for comparison
+//
+
+#define private public
+#include "testSupport.h"
+
+TeensyUserInterface ui;
+
+const int TAP_PRESSURE_MIN = 650;           // pressure of a finger pressed firmly
+const int GRAZE_PRESSURE_MIN = 420;         // light contacts, above the driver's threshold of 400
+const int GRAZE_PRESSURE_MAX = 580;
+const int FILTER_PRESSURE = 600;            // the filter's pressure threshold, between the two
+const int POSITION_TOLERANCE = 3;           // pixels a filtered tap can be from where it was made
+const int LATENCY_TARGET = 10;              // ms from first contact to the push event
+
+typedef struct
+{
+  byte touched;
+  int16_t x, y, z;
+} TRACE_SAMPLE;
+
+typedef struct
+{
+  int startTime, endTime;
+  int x, y;
+} TRACE_TAP;
+
+static TRACE_SAMPLE trace[200000];
+static int traceLength;
+static TRACE_TAP taps[1000];
+static int tapCount;
+static int noiseBurstCount;
+
+typedef struct
+{
+  int tapsFound;
+  int tapsDoubled;
+  int falseTouches;
+  int worstPositionError;
+  int releasesWithoutTouch;
+  long longestLatency;
+  long totalLatency;
+  int slowTaps;
+} REPLAY_RESULT;
+
+
+static int randomBetween(int low, int high)
+{
+  return(low + rand() % (high - low + 1));
+}
+
+
+
+static void addIdle(int ms)
+{
+  for (int i = 0; i < ms; i++)
+    trace[traceLength++] = (TRACE_SAMPLE) {0, 0, 0, 0};
+}
+
+
+
+//
+// a tap: contact bounce with light, scattered samples while pressing and lifting, 
+// then a firm touch jittering by 2 pixels with an occasional outlier
+//
+static void addTap(int ms)
+{
+  int x = randomBetween(20, 300);
+  int y = randomBetween(20, 220);
+  taps[tapCount++] = (TRACE_TAP) {traceLength, traceLength + ms, x, y};
+
+  for (int i = 0; i < ms; i++)
+  {
+    TRACE_SAMPLE s = {1, (int16_t) (x + randomBetween(-2, 2)), (int16_t) (y + randomBetween(-2, 2)), (int16_t) randomBetween(TAP_PRESSURE_MIN, 1100)};
+    if ((i < 3) || (i >= ms - 3))
+    {
+      s.touched = (rand() % 3 != 0);
+      s.z = randomBetween(300, GRAZE_PRESSURE_MAX);
+      s.x = x + randomBetween(-40, 40);
+      s.y = y + randomBetween(-40, 40);
+    }
+    else if (rand() % 25 == 0)
+    {
+      s.x = x + randomBetween(-30, 30);
+      s.y = y + randomBetween(-30, 30);
+    }
+    trace[traceLength++] = s;
+  }
+}
+
+
+
+//
+// noise: a single firm sample from interference, or a light graze that the driver 
+// reports as touched
+//
+static void addSpike(void)
+{
+  trace[traceLength++] = (TRACE_SAMPLE) {1, (int16_t) randomBetween(0, 319), (int16_t) randomBetween(0, 239), (int16_t) randomBetween(TAP_PRESSURE_MIN, 1200)};
+  noiseBurstCount++;
+}
+
+static void addGraze(int ms)
+{
+  int x = randomBetween(20, 300);
+  int y = randomBetween(20, 220);
+  for (int i = 0; i < ms; i++)
+    trace[traceLength++] = (TRACE_SAMPLE) {1, (int16_t) (x + randomBetween(-1, 1)), (int16_t) (y + randomBetween(-1, 1)), (int16_t) randomBetween(GRAZE_PRESSURE_MIN, GRAZE_PRESSURE_MAX)};
+  noiseBurstCount++;
+}
+
+
+
+static void buildTrace(void)
+{
+  srand(11);
+  for (int i = 0; i < 400; i++)
+  {
+    addIdle(randomBetween(60, 400));
+    int r = rand() % 10;
+    if (r < 6)
+      addTap(randomBetween(25, 150));
+    else if (r < 8)
+      addSpike();
+    else
+      addGraze(randomBetween(20, 200));
+  }
+  addIdle(200);
+}
+
+
+
+//
+// play the trace through the touch screen, matching the events to the taps
+//
+static REPLAY_RESULT replay(int filterType, int sampleCount)
+{
+  REPLAY_RESULT result = {0, 0, 0, 0, 0, 0, 0, 0};
+  int lastTap = -1;
+  int touchedTap = -1;
+  boolean downFlg = false;
+
+  ui.setTouchFilter(filterType, sampleCount, FILTER_PRESSURE, 4);
+  testAdvanceMillis(1000);
+  unsigned long startTime = fakeMillis;
+
+  for (int t = 0; t < traceLength; t++)
+  {
+    fakeMillis = startTime + t;
+    fakeMicros = fakeMillis * 1000 + 17;
+    stubTouched = trace[t].touched;
+    stubRawX = trace[t].x;
+    stubRawY = trace[t].y;
+    stubRawZ = trace[t].z;
+    ui.sampleTouchScreen();
+
+    while (true)
+    {
+      ui.getTouchEvents();
+      if (ui.touchEventType == TOUCH_NO_EVENT)
+        break;
+
+      if (ui.touchEventType == TOUCH_PUSHED_EVENT)
+      {
+        downFlg = true;
+        touchedTap = -1;
+        for (int k = 0; k < tapCount; k++)
+        {
+          if ((t >= taps[k].startTime) && (t <= taps[k].endTime + 5))
+          {
+            touchedTap = k;
+            break;
+          }
+        }
+
+        if (touchedTap < 0)
+          result.falseTouches++;
+        else if (touchedTap == lastTap)
+          result.tapsDoubled++;
+        else
+        {
+          lastTap = touchedTap;
+          result.tapsFound++;
+          long latency = t - taps[touchedTap].startTime;
+          result.longestLatency = max(result.longestLatency, latency);
+          result.totalLatency += latency;
+          if (latency >= LATENCY_TARGET)
+            result.slowTaps++;
+          int error = max(abs(ui.touchEventX - taps[touchedTap].x), abs(ui.touchEventY - taps[touchedTap].y));
+          result.worstPositionError = max(result.worstPositionError, error);
+        }
+      }
+
+      if (ui.touchEventType == TOUCH_RELEASED_EVENT)
+      {
+        if (!downFlg)
+          result.releasesWithoutTouch++;
+        downFlg = false;
+      }
+    }
+  }
+  return(result);
+}
+
+
+
+static void printResult(const char *name, const REPLAY_RESULT &r)
+{
+  printf("  %-16s taps %d/%d, %d doubled, %d false touches from %d noise bursts, worst position %d px, latency %.1f ms average, %ld ms longest, %d taps %d ms or more\n", 
+    name, r.tapsFound, tapCount, r.tapsDoubled, r.falseTouches, noiseBurstCount, r.worstPositionError, 
+    (double) r.totalLatency / max(r.tapsFound, 1), r.longestLatency, r.slowTaps, LATENCY_TARGET);
+}
+
+
+
+int main()
+{
+  ui.begin(10, 9, 8, LCD_ORIENTATION_LANDSCAPE_4PIN_LEFT, makeTestFont(10));
+  ui.setTouchScreenCalibrationConstants(0, 1, 0, 1);
+  ui.setTouchSamplingFromInterrupt(true);
+  buildTrace();
+  printf("  trace of %d ms with %d taps\n", traceLength, tapCount);
+
+  REPLAY_RESULT off = replay(TOUCH_FILTER_OFF, 1);
+  printResult("off", off);
+
+  static const struct { const char *name; int type; int samples; } filters[] = {
+    {"median 3", TOUCH_FILTER_MEDIAN, 3},
+    {"median 5", TOUCH_FILTER_MEDIAN, 5},
+    {"trimmed mean 5", TOUCH_FILTER_TRIMMED_MEAN, 5}
+  };
+  for (unsigned i = 0; i < sizeof(filters) / sizeof(filters[0]); i++)
+  {
+    REPLAY_RESULT r = replay(filters[i].type, filters[i].samples);
+    printResult(filters[i].name, r);
+    CHECK(r.tapsFound == tapCount, "%s: %d of %d taps found", filters[i].name, r.tapsFound, tapCount);
+    CHECK(r.tapsDoubled == 0, "%s: %d taps reported twice", filters[i].name, r.tapsDoubled);
+    CHECK(r.falseTouches == 0, "%s: %d false touches", filters[i].name, r.falseTouches);
+    CHECK(r.worstPositionError <= POSITION_TOLERANCE, "%s: tap reported %d pixels away", filters[i].name, r.worstPositionError);
+    CHECK(r.releasesWithoutTouch == 0, "%s: %d releases without a touch", filters[i].name, r.releasesWithoutTouch);
+    CHECK(r.longestLatency < off.longestLatency, "%s: longest latency %ld ms, %ld ms without the filter", filters[i].name, r.longestLatency, off.longestLatency);
+  }
+
+  //
+  // with 3 samples a touch is reported under LATENCY_TARGET, on average and for all 
+  // but the taps with an outlier among their first samples
+  //
+  REPLAY_RESULT median3 = replay(TOUCH_FILTER_MEDIAN, 3);
+  CHECK(median3.totalLatency < (long) LATENCY_TARGET * median3.tapsFound, "median 3: average latency %.1f ms", 
+    (double) median3.totalLatency / median3.tapsFound);
+  CHECK(median3.slowTaps * 20 <= median3.tapsFound, "median 3: %d of %d taps took %d ms or more", 
+    median3.slowTaps, median3.tapsFound, LATENCY_TARGET);
+
+  //
+  // a long light press, above the driver's threshold but below the filter's, is 
+  // never a touch, while unfiltered it is
+  //
+  traceLength = 0;
+  tapCount = 0;
+  addIdle(100);
+  addGraze(500);
+  addIdle(100);
+  REPLAY_RESULT light = replay(TOUCH_FILTER_MEDIAN, 3);
+  CHECK(light.falseTouches == 0, "light press made %d touches with the filter", light.falseTouches);
+  light = replay(TOUCH_FILTER_OFF, 1);
+  CHECK(light.falseTouches == 1, "light press made %d touches without the filter", light.falseTouches);
+
+  return(testResult("testTouchFilter"));
+}
@@ -0,0 +1,69 @@
+//
+// touch screen IRQ pin: getTouchEvents() called at 1kHz for 10 seconds with two taps,
+// polled and with the IRQ pin.  Both must give the same events, with the IRQ pin the
+// driver isn't called while the screen waits for a touch.  Driver calls are what
+// getTouchScreenDriverCallCount() counts, reads are the driver's SPI reads
+//
+
+#include "testSupport.h"
+
+TeensyUserInterface ui;
+
+const int TEST_MILLISECONDS = 10000;
+
+
+//
+// run the simulated main loop, once a millisecond
+//  Enter:  irqPin = the touch screen's IRQ pin, or TOUCH_IRQ_PIN_NONE
+//          events -> storage for the events as a string of digits
+//          reads -> storage to return the SPI reads made by the driver
+//  Exit:   number of driver calls returned
+//
+static unsigned long runTouchLoop(int irqPin, char *events, long *reads)
+{
+  int eventCount = 0;
+
+  ui.begin(10, 9, 8, irqPin, LCD_ORIENTATION_LANDSCAPE_4PIN_LEFT, makeTestFont(10));
+  ui.setTouchScreenCalibrationConstants(0, 1, 0, 1);
+  stubRawX = 100;
+  stubRawY = 50;
+  stubTouched = 0;
+  testAdvanceMillis(1000);
+  ui.clearTouchScreenDriverCallCount();
+  stubTouchScreenReads = 0;
+
+  for (int ms = 0; ms < TEST_MILLISECONDS; ms++)
+  {
+    testAdvanceMillis(1);
+    stubTouched = ((ms >= 5000) && (ms < 5100)) || ((ms >= 7000) && (ms < 8200));
+    ui.getTouchEvents();
+    if ((ui.touchEventType != TOUCH_NO_EVENT) && (eventCount < 60))
+      events[eventCount++] = '0' + ui.touchEventType;
+  }
+  events[eventCount] = 0;
+  *reads = stubTouchScreenReads;
+  return(ui.getTouchScreenDriverCallCount());
+}
+
+
+
+int main()
+{
+  char polledEvents[64], irqEvents[64];
+  long polledReads, irqReads;
+
+  unsigned long polledCalls = runTouchLoop(TOUCH_IRQ_PIN_NONE, polledEvents, &polledReads);
+  unsigned long irqCalls = runTouchLoop(2, irqEvents, &irqReads);
+
+  printf("  %d ms at 1kHz, two taps:\n", TEST_MILLISECONDS);
+  printf("    polled:   events %s, %6lu driver calls, %5ld SPI reads\n", polledEvents, polledCalls, polledReads);
+  printf("    IRQ pin:  events %s, %6lu driver calls, %5ld SPI reads\n", irqEvents, irqCalls, irqReads);
+
+  CHECK(strcmp(polledEvents, irqEvents) == 0, "events differ: polled %s, IRQ %s", polledEvents, irqEvents);
+  CHECK(strncmp(polledEvents, "12", 2) == 0, "first tap gave %s", polledEvents);
+  CHECK(polledReads < (long) polledCalls, "the driver read the screen on every call");
+  CHECK(irqCalls * 4 < polledCalls, "IRQ pin: %lu driver calls against %lu polled", irqCalls, polledCalls);
+  CHECK(irqReads * 2 < polledReads, "IRQ pin: %ld SPI reads against %ld polled", irqReads, polledReads);
+
+  return(testResult("testTouchIRQ"));
+}
@@ -0,0 +1,120 @@
+//
+// touch event queue: with sampleTouchScreen() called from a timer interrupt, a tap made
+// while the application is busy is queued and returned once it calls getTouchEvents(),
+// a full queue keeps whole touches, and changing the orientation discards the waiting
+// events, leaving the interrupts enabled again
+//
+
+#define private public
+#include "testSupport.h"
+
+TeensyUserInterface ui;
+
+
+//
+// simulate the application drawing for 80ms while a timer interrupt samples the touch 
+// screen every 1ms, the screen is tapped from 5ms to 45ms
+//
+static void busyTap(boolean interruptFlg)
+{
+  stubRawX = 100;
+  stubRawY = 50;
+  for (int ms = 0; ms < 80; ms++)
+  {
+    testAdvanceMillis(1);
+    stubTouched = (ms >= 5) && (ms < 45);
+    if (interruptFlg)
+      ui.sampleTouchScreen();
+  }
+  stubTouched = 0;
+}
+
+
+
+//
+// take the events waiting in the queue
+//  Enter:  events -> storage for the event types as a string of digits
+//  Exit:   number of events returned
+//
+static int takeEvents(char *events, int maxEvents)
+{
+  int eventCount = 0;
+
+  for (int i = 0; i < 100; i++)
+  {
+    ui.getTouchEvents();
+    if (ui.touchEventType == TOUCH_NO_EVENT)
+      break;
+    if (eventCount < maxEvents)
+      events[eventCount] = '0' + ui.touchEventType;
+    eventCount++;
+  }
+  events[eventCount < maxEvents ? eventCount : maxEvents] = 0;
+  return(eventCount);
+}
+
+
+
+int main()
+{
+  char events[64];
+
+  ui.begin(10, 9, 8, LCD_ORIENTATION_LANDSCAPE_4PIN_LEFT, makeTestFont(10));
+  ui.setTouchScreenCalibrationConstants(0, 1, 0, 1);
+  testAdvanceMillis(1000);
+
+  //
+  // a tap while busy is missed when polled, and queued when sampled from an interrupt
+  //
+  busyTap(false);
+  takeEvents(events, 63);
+  CHECK(strcmp(events, "") == 0, "polled tap while busy gave %s", events);
+
+  ui.setTouchSamplingFromInterrupt(true);
+  unsigned long tapMicros = fakeMicros;
+  busyTap(true);
+  takeEvents(events, 63);
+  CHECK(strcmp(events, "12") == 0, "sampled tap while busy gave %s", events);
+
+  busyTap(true);
+  ui.getTouchEvents();
+  CHECK(ui.touchEventMicros > tapMicros + 80000, "event time %lu", ui.touchEventMicros);
+  CHECK((ui.touchEventX == 100) && (ui.touchEventY == 50), "event at %d, %d", ui.touchEventX, ui.touchEventY);
+  takeEvents(events, 63);
+
+  //
+  // a long hold with move events fills the queue, the touch still ends with its release
+  //
+  ui.setTouchMoveEvents(10);
+  for (int ms = 0; ms < 1000; ms++)
+  {
+    testAdvanceMillis(1);
+    stubTouched = ms < 900;
+    stubRawX = (ms * 7) % 300;
+    ui.sampleTouchScreen();
+  }
+  int eventCount = takeEvents(events, 63);
+  CHECK(eventCount < TOUCH_EVENT_QUEUE_SIZE, "%d events from a full queue", eventCount);
+  CHECK((events[0] == '1') && (events[eventCount - 1] == '2'), "full queue gave %s", events);
+  ui.setTouchMoveEvents(0);
+
+  //
+  // changing the orientation throws away the events waiting, they were in the old 
+  // orientation's coordinates
+  //
+  busyTap(true);
+  ui.setOrientation(LCD_ORIENTATION_PORTRAIT_4PIN_TOP);
+  CHECK(ui.touchEventQueueTail == ui.touchEventQueueHead, "events left in the queue");
+  CHECK(takeEvents(events, 63) == 0, "events after changing the orientation: %s", events);
+
+  //
+  // settings shared with sampleTouchScreen() are changed with interrupts off, then on again
+  //
+  static const TOUCH_TIMING slowTiming = {60, 800, 120, 16, 1, 1, 0};
+  ui.setTouchTiming(&slowTiming);
+  ui.setTouchFilter(TOUCH_FILTER_MEDIAN, 5, 500, 8);
+  ui.setOrientation(LCD_ORIENTATION_LANDSCAPE_4PIN_LEFT);
+  CHECK(stubInterruptsDisabled == 0, "interrupts left disabled (%d)", stubInterruptsDisabled);
+
+  return(testResult("testTouchQueue"));
+}
@@ -0,0 +1,134 @@
+//
+// touch regions: widgets add their areas when drawn and the check functions skip
+// widgets the touch isn't on, areas are removed when they're painted over, and a
+// widget that moved since it was drawn is still found by its own rectangle
+//
+
+#define private public
+#include "testSupport.h"
+
+TeensyUserInterface ui;
+
+static BUTTON okButton     = {"OK",     60,  100, 80, 40};
+static BUTTON cancelButton = {"Cancel", 180, 100, 80, 40};
+static NUMBER_BOX numberBox = {"", 5, 0, 10, 1, 120, 220, 160, 40};
+
+
+static void touchAt(int eventType, int x, int y)
+{
+  ui.touchEventType = eventType;
+  ui.touchEventX = x;
+  ui.touchEventY = y;
+  ui.touchEventHitMaskValidFlg = false;
+}
+
+static void drawScreen(void)
+{
+  ui.lcdClearScreen(LCD_BLACK);
+  ui.drawButton(okButton);
+  ui.drawButton(cancelButton);
+  ui.drawNumberBox(numberBox);
+}
+
+
+
+int main()
+{
+  ui.begin(10, 9, 8, LCD_ORIENTATION_PORTRAIT_4PIN_TOP, makeTestFont(10));
+  ui.setTouchScreenCalibrationConstants(0, 1, 0, 1);
+  ui.setMenuFont(testFont);
+
+  //
+  // each widget drawn has an area, and the touch is matched to one of them
+  //
+  drawScreen();
+  CHECK(ui.touchRegionCount == 3, "%d areas after drawing 3 widgets", ui.touchRegionCount);
+  touchAt(TOUCH_PUSHED_EVENT, 60, 100);
+  CHECK(ui.findTouchRegionForTouchEvent() == &okButton, "touch on OK found the wrong widget");
+  CHECK(!ui.checkForButtonFirstTouched(cancelButton), "touch on OK pressed Cancel");
+  CHECK(!ui.checkForNumberBoxTouched(numberBox), "touch on OK changed the Number Box");
+  CHECK(ui.checkForButtonFirstTouched(okButton), "touch on OK wasn't found");
+  CHECK(ui.touchRegionCount == 3, "%d areas after OK was redrawn pressed", ui.touchRegionCount);
+
+  //
+  // every button check goes through the grid, a touch between widgets finds none
+  //
+  touchAt(TOUCH_PUSHED_EVENT, 120, 100);
+  CHECK(ui.findTouchRegionForTouchEvent() == NULL, "touch between the buttons found a widget");
+  CHECK(!ui.touchEventMayHit(&okButton, 20, 80, 99, 119), "touch between the buttons may hit OK");
+  CHECK(!ui.checkForButtonFirstTouched(okButton), "touch between the buttons pressed OK");
+  touchAt(TOUCH_RELEASED_EVENT, 180, 100);
+  CHECK(ui.checkForButtonClicked(cancelButton), "release on Cancel didn't click it");
+  touchAt(TOUCH_REPEAT_EVENT, 180, 100);
+  CHECK(!ui.checkForButtonAutoRepeat(okButton), "repeat on Cancel repeated OK");
+  CHECK(ui.checkForButtonAutoRepeat(cancelButton), "repeat on Cancel wasn't found");
+
+  //
+  // the Number Box is still checked when it's touched
+  //
+  int downButtonX, numberX, upButtonX, topY, buttonWidth, numberWidth, height;
+  ui.getNumberBoxCoordinates(numberBox, &downButtonX, &numberX, &upButtonX, &topY, &buttonWidth, &numberWidth, &height);
+  touchAt(TOUCH_PUSHED_EVENT, downButtonX + buttonWidth / 2, topY + height / 2);
+  CHECK(ui.checkForNumberBoxTouched(numberBox), "touching the Number Box's down button did nothing");
+  CHECK(numberBox.value == 4, "Number Box value %d after stepping down from 5", numberBox.value);
+
+  //
+  // a widget that moved without being drawn again is checked by its own rectangle
+  //
+  okButton.centerY = 160;
+  touchAt(TOUCH_PUSHED_EVENT, 60, 160);
+  CHECK(ui.checkForButtonFirstTouched(okButton), "OK moved since it was drawn and the touch on it was missed");
+  okButton.centerY = 100;
+  drawScreen();
+
+  //
+  // an area is removed when all of it is painted over, not when part of it is
+  //
+  ui.lcdDrawFilledRectangle(20, 80, 40, 40, LCD_BLUE);
+  CHECK(ui.touchRegionCount == 3, "%d areas after painting over part of OK", ui.touchRegionCount);
+  ui.lcdDrawFilledRectangle(0, 60, 120, 80, LCD_BLUE);
+  CHECK(ui.touchRegionCount == 2, "%d areas after painting over OK", ui.touchRegionCount);
+  touchAt(TOUCH_PUSHED_EVENT, 60, 100);
+  CHECK(ui.findTouchRegionForTouchEvent() == NULL, "painted over OK is still found");
+  CHECK(!ui.checkForButtonFirstTouched(cancelButton), "touch on painted over OK pressed Cancel");
+
+  ui.lcdPushClipRect(0, 0, 160, 320);
+  ui.lcdDrawFilledRectangle(120, 60, 120, 80, LCD_BLUE);
+  ui.lcdPopClipRect();
+  CHECK(ui.touchRegionCount == 2, "Cancel was removed by a fill clipped to half of it");
+
+  uint16_t image[80 * 40] = {0};
+  ui.lcdDrawImage(140, 80, 80, 40, image);
+  CHECK(ui.touchRegionCount == 1, "%d areas after drawing an image over Cancel", ui.touchRegionCount);
+
+  ui.lcdClearScreen(LCD_BLACK);
+  CHECK(ui.touchRegionCount == 0, "%d areas after clearing the screen", ui.touchRegionCount);
+
+  //
+  // areas added by the application, the last added wins where they overlap
+  //
+  static int listRow[2];
+  ui.addTouchRegion(&listRow[0], 0, 40, 240, 40);
+  ui.addTouchRegion(&listRow[1], 100, 60, 40, 40);
+  touchAt(TOUCH_PUSHED_EVENT, 50, 50);
+  CHECK(ui.findTouchRegionForTouchEvent() == &listRow[0], "touch on row 0 not found");
+  touchAt(TOUCH_PUSHED_EVENT, 120, 70);
+  CHECK(ui.findTouchRegionForTouchEvent() == &listRow[1], "overlap didn't find the area added last");
+  ui.addTouchRegion(&listRow[1], 100, 200, 40, 40);
+  CHECK(ui.touchRegionCount == 2, "adding an area again made %d areas", ui.touchRegionCount);
+  CHECK(ui.findTouchRegionForTouchEvent() == &listRow[0], "moved area still found at its old place");
+
+  //
+  // past TOUCH_REGION_MAX areas, widgets are checked by their own rectangles
+  //
+  ui.clearTouchRegions();
+  static int filler[TOUCH_REGION_MAX];
+  for (int i = 0; i < TOUCH_REGION_MAX; i++)
+    ui.addTouchRegion(&filler[i], 0, 300, 10, 10);
+  ui.drawButton(okButton);
+  CHECK(ui.touchRegionCount == TOUCH_REGION_MAX, "%d areas kept", ui.touchRegionCount);
+  touchAt(TOUCH_PUSHED_EVENT, 60, 100);
+  CHECK(ui.checkForButtonFirstTouched(okButton), "button drawn with no room for its area wasn't found");
+
+  return(testResult("testTouchRegions"));
+}
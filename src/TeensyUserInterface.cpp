@@ -90,6 +90,13 @@
 // Red, Green and Blue).  The third field in this entry points to a callback 
 // function that alternates the value.
 //
+// Toggle State:  A MENU_ITEM_TYPE_TOGGLE_STATE works like a Toggle, but the toggle 
+// keeps its own state and the text for each state in a MENU_TOGGLE, given in the  
+// fourth field as MENU_TOGGLE_STATE(myToggle).  The button's text is only built when 
+// the state changes.  The optional function in the third field is called only after 
+// the user presses the button.  The application changes the state with 
+// setToggleState(), which redraws just that button.
+//
 // Sub Menu:  A MENU_ITEM_TYPE_SUB_MENU is used to select a different menu.  For 
 // example, a main menu might reference a "Settings" sub menu. The fourth field  
 // in this entry points to another menu table where the sub menu is defined.
@@ -164,12 +171,67 @@
 #include "TeensyUserInterface.h"
 
 
+//
+// the LCD driver, extended with a few functions that need access to the driver's
+// internals (used for sending the framebuffer to the display)
+//
+class TeensyUserInterfaceLCD : public ILI9341_t3
+{
+  public:
+    TeensyUserInterfaceLCD(uint8_t cs, uint8_t dc) : ILI9341_t3(cs, dc) {}
+    uint16_t getTextColor(void) { return(textcolor); }
+    void setCursorWithoutLimits(int16_t x, int16_t y) { cursor_x = x; cursor_y = y; }
+    void writeRectFromFramebuffer(int x, int y, int width, int height, const uint16_t *pixels, int pixelsPerRow);
+    void writeRectInTransaction(int x, int y, int width, int height, const uint16_t *pixels, int pixelsPerRow);
+    void fillRectInTransaction(int x, int y, int width, int height, uint16_t color);
+    void setVerticalScrollInTransaction(int topFixedRows, int scrollingRows, int bottomFixedRows, int startRow);
+    void beginTransaction(void) { beginSPITransaction(); }
+    void endTransaction(void) { endSPITransaction(); }
+};
+
+
 //
 // pointers to the LCD and Touch objects
 //
-ILI9341_t3 *lcd;
+TeensyUserInterfaceLCD *lcd;
 XPT2046_Touchscreen *ts;
 
+//
+// flags kept for each tile of the framebuffer
+//
+const byte TILE_FLAG_CHECKSUM_VALID = 0x01;
+const byte TILE_FLAG_COVERED        = 0x02;
+const byte TILE_FLAG_CHANGED        = 0x04;
+
+//
+// types of commands recorded in a display list
+//
+const byte DISPLAY_LIST_FILL_RECT           = 0;
+const byte DISPLAY_LIST_LINE                = 1;
+const byte DISPLAY_LIST_RECTANGLE           = 2;
+const byte DISPLAY_LIST_ROUNDED_RECTANGLE   = 3;
+const byte DISPLAY_LIST_TRIANGLE            = 4;
+const byte DISPLAY_LIST_CIRCLE              = 5;
+const byte DISPLAY_LIST_FILLED_ROUNDED_RECT = 6;
+const byte DISPLAY_LIST_FILLED_TRIANGLE     = 7;
+const byte DISPLAY_LIST_FILLED_CIRCLE       = 8;
+const byte DISPLAY_LIST_IMAGE               = 9;
+const byte DISPLAY_LIST_TEXT                = 10;
+const byte DISPLAY_LIST_CHARACTER           = 11;
+const byte DISPLAY_LIST_SET_CLIP            = 12;
+
+//
+// how a drawing function's bounds relate to the clip rectangle
+//
+const int CLIP_OUTSIDE = 0;
+const int CLIP_INSIDE  = 1;
+const int CLIP_PARTIAL = 2;
+
+//
+// functions for reading ILI9341_t3 fonts, found with the software rasterizer
+//
+static int fontGetCharacterAdvance(const ui_font *font, unsigned int c);
+
 //
 // the size of features for drawing the user interface
 //
@@ -186,6 +248,109 @@ const int arrowWidth = 8;
 //
 TeensyUserInterface::TeensyUserInterface(void)
 {
+  framebuffer = NULL;
+  framebufferAllocatedFlg = false;
+  dirtyRectCount = 0;
+  clearPendingDirtyRect();
+  flushQueueCount = 0;
+  flushChunkSize = 2048;
+  flushCompleteCallbackFunction = NULL;
+  tileChecksums = NULL;
+  tileFlags = NULL;
+  tileSentCount = 0;
+  tileSkippedCount = 0;
+  rasterMeasureOnlyFlg = false;
+  clipStackCount = 0;
+  spanPendingFlg = false;
+  spanTransactionFlg = false;
+  batchDepth = 0;
+  lcdSpanFillsFlg = false;
+  currentOrientation = LCD_ORIENTATION_LANDSCAPE_4PIN_LEFT;
+  scrollOffset = 0;
+  spanCount = 0;
+  addressWindowCount = 0;
+  displayList = NULL;
+  displayListText = NULL;
+  displayListMaxCommands = 128;
+  displayListMaxTextBytes = 1024;
+  displayListCount = 0;
+  displayListTextLength = 0;
+  displayListDepth = 0;
+  displayListRecordedCount = 0;
+  displayListCulledCount = 0;
+  displayListMergedCount = 0;
+  displayListPixelsSaved = 0;
+  menuLayout.menu = NULL;
+  menuLayout.dynamic = NULL;
+  dynamicMenuItemIndex = 0;
+  setMenuDescriptors(NULL, 0);
+  menuScrollButtonHeight = 0;
+  menuDisplayListFlg = false;
+  menuSlotCount = 0;
+  menuOnScreenFlg = false;
+  toggleDirtyFlg = false;
+  menuRunningFlg = false;
+  menuHistoryTop = 0;
+  menuHistoryCount = 0;
+  menuLastTouchedIdx = 0;
+  menuSnapshot = NULL;
+  menuSnapshotRow = NULL;
+  menuSnapshotBudget = 0;
+  menuSnapshotAllocatedFlg = false;
+  menuSnapshotValidFlg = false;
+  menuSnapshotLength = 0;
+  menuSnapshotSignature = 0;
+  menuSnapshotHits = 0;
+  menuSnapshotMisses = 0;
+  touchRegionCount = 0;
+  touchRegionSearchIdx = 0;
+  touchRegionGridValidFlg = false;
+  touchEventHitMaskValidFlg = false;
+  touchScreenIRQFlg = false;
+  touchScreenDriverCallCount = 0;
+
+  //
+  // touch screen calibrations aren't saved until the application says where in EEPROM, 
+  // see setTouchScreenCalibrationEEPromAddress()
+  //
+  touchCalibrationEEPromAddress = -1;
+
+  touchEventType = TOUCH_NO_EVENT;
+  touchEventMicros = 0;
+  touchMoveDistance = 0;
+  touchSamplingFromInterruptFlg = false;
+  setTouchTiming(NULL);
+  numberBoxRepeatCount = 0;
+  numberBoxStepFactor = 1;
+  touchFilterType = TOUCH_FILTER_OFF;
+  touchFilterSampleCount = 1;
+  touchFilterPressureThreshold = 0;
+  touchFilterJitterPixels = 0;
+  clearTouchFilter();
+  touchEventQueueHead = 0;
+  touchEventQueueTail = 0;
+  touchEventDroppedFlg = false;
+  menuTitleText = NULL;
+  menuTitleBackButtonFlg = false;
+  menuDrawingDepth = 0;
+  lcdDrawCount = 0;
+  menuScreenDrawCount = 0;
+  glyphCache = NULL;
+  glyphRunBlocks = NULL;
+  glyphCacheMaxGlyphs = 0;
+  glyphCacheMaxBlocks = 0;
+  glyphCacheFailedFlg = false;
+  glyphCacheClock = 0;
+  glyphCacheHits = 0;
+  glyphCacheMisses = 0;
+  for (int i = 0; i < LCD_MAX_FONT_ADVANCE_TABLES; i++)
+    fontAdvanceTables[i].font = NULL;
+  fontAdvanceTableNext = 0;
+  currentFontAdvances = NULL;
+  for (int i = 0; i < LCD_MAX_MEMOIZED_WIDTHS; i++)
+    memoizedWidths[i].s = NULL;
+  memoizedWidthNext = 0;
+  constantLabelText = NULL;
 }
 
 
@@ -200,13 +365,33 @@ TeensyUserInterface::TeensyUserInterface(void)
 //          font -> the font typeface to load, ei: Arial_10
 //
 void TeensyUserInterface::begin(int lcdCSPin, int LcdDCPin, int TouchScreenCSPin, int lcdOrientation, const ui_font &font)
+{
+  begin(lcdCSPin, LcdDCPin, TouchScreenCSPin, TOUCH_IRQ_PIN_NONE, lcdOrientation, font);
+}
+
+
+
+//
+// initialize the UI, display hardware and touchscreen hardware, using the touchscreen's 
+// IRQ pin so the touchscreen is only read after it signals that it's been touched
+//  Enter:  lcdCSPin = pin number for the LCD's CS pin
+//          LcdDCPin = pin number for the LCD's DC pin
+//          TouchScreenCSPin = pin number for the touchscreen's CS pin
+//          TouchScreenIRQPin = pin number for the touchscreen's IRQ pin (must support 
+//            interrupts), TOUCH_IRQ_PIN_NONE if not connected
+//          lcdOrientation = LCD_ORIENTATION_PORTRAIT_4PIN_TOP, LCD_ORIENTATION_LANDSCAPE_4PIN_LEFT
+//                           LCD_ORIENTATION_PORTRAIT_4PIN_BOTTOM, LCD_ORIENTATION_LANDSCAPE_4PIN_RIGHT
+//          font -> the font typeface to load, ei: Arial_10
+//
+void TeensyUserInterface::begin(int lcdCSPin, int LcdDCPin, int TouchScreenCSPin, int TouchScreenIRQPin, int lcdOrientation, const ui_font &font)
 {
   //
   // create the LCD and touchscreen objects
   //
-  lcd = new ILI9341_t3(lcdCSPin, LcdDCPin);
-  ts = new XPT2046_Touchscreen(TouchScreenCSPin);
-  
+  lcd = new TeensyUserInterfaceLCD(lcdCSPin, LcdDCPin);
+  ts = new XPT2046_Touchscreen(TouchScreenCSPin, TouchScreenIRQPin);
+  touchScreenIRQFlg = (TouchScreenIRQPin != TOUCH_IRQ_PIN_NONE);
+
   //
   // initialize the LCD and touch screen hardware
   //
@@ -258,6 +443,14 @@ void TeensyUserInterface::setOrientation(int lcdOrientation)
   displaySpaceBottomY = displaySpaceTopY + displaySpaceHeight - 1;
   displaySpaceCenterX = displaySpaceLeftX + displaySpaceWidth/2;
   displaySpaceCenterY = displaySpaceTopY + displaySpaceHeight/2;
+
+  //
+  // nothing of the menu survives the change, its buttons are laid out again for the 
+  // new display space and it's fully redrawn, not restored from the snapshot
+  //
+  menuLayout.menu = NULL;
+  menuOnScreenFlg = false;
+  menuSnapshotValidFlg = false;
 }
 
 
@@ -317,6 +510,11 @@ void TeensyUserInterface::setMenuColors(uint16_t _menuBackgroundColor, uint16_t
     menuButtonSelectedColor = _menuButtonSelectedColor;
     menuButtonFrameColor = _menuButtonFrameColor;
     menuButtonTextColor = _menuButtonTextColor;
+
+    //
+    // the menu on the screen is drawn in full next time, in the new colors
+    //
+    menuOnScreenFlg = false;
 }
 
 
@@ -330,6 +528,38 @@ void TeensyUserInterface::setMenuColors(uint16_t _menuBackgroundColor, uint16_t
 void TeensyUserInterface::setMenuFont(const ui_font &font)
 {
   menuButtonFont = &font;
+
+  //
+  // the menu on the screen is drawn in full next time, in the new font
+  //
+  menuOnScreenFlg = false;
+}
+
+
+
+//
+// set menus with too many buttons to fit on the screen to scroll, rather than 
+// shrinking their buttons, arrow buttons are added to the title bar for scrolling
+//  Enter:  buttonHeight = height of the buttons in menus that scroll, menus with 
+//            buttons shorter than this scroll, 0 to disable scrolling (default)
+//
+void TeensyUserInterface::setMenuScrolling(int buttonHeight)
+{
+  menuScrollButtonHeight = buttonHeight;
+  menuLayout.menu = NULL;
+}
+
+
+
+//
+// set menus to be drawn through a display list, so pixels painted over by the 
+// buttons aren't sent, the list's memory is allocated the first time a menu is drawn
+//  Enter:  enableFlg = true to draw menus through a display list, false to draw 
+//            them directly (default)
+//
+void TeensyUserInterface::setMenuDisplayList(boolean enableFlg)
+{
+  menuDisplayListFlg = enableFlg;
 }
 
 
@@ -339,86 +569,195 @@ void TeensyUserInterface::setMenuFont(const ui_font &font)
 //  Enter:  menu -> the menu to display
 //
 void TeensyUserInterface::displayAndExecuteMenu(MENU_ITEM *menu)
+{
+  beginMenu(menu);
+  runMenus();
+}
+
+
+
+//
+// display the top level menu, then execute the commands selected by the user, the 
+// size of each menu is given by its descriptor
+//  Enter:  menus -> the descriptors of the top level menu followed by all of its 
+//            sub menus, build them with makeMenuDescriptor<columns>(menuTable)
+//          menuCount = number of descriptors
+//
+void TeensyUserInterface::displayAndExecuteMenu(const MENU_DESCRIPTOR *menus, int menuCount)
+{
+  beginMenu(menus, menuCount);
+  runMenus();
+}
+
+
+
+//
+// execute the commands selected by the user until the menus are exited
+//
+void TeensyUserInterface::runMenus(void)
+{
+  while(true)
+  {
+    //
+    // check for screen touches and execute menu commands
+    //
+    if (pollMenu() == MENU_STATUS_EXITED)
+      return;
+    
+    //
+    // check if there is a callback function to execute while in a menu
+    //
+    if (inMenuCallbackFunction != NULL)
+    {
+      //
+      // there is a call back function, so execute it
+      //
+      (inMenuCallbackFunction)();
+    }
+  }
+}
+
+
+
+//
+// display the top level menu without waiting for the user, afterward call 
+// pollMenu() from the application's loop to execute the commands selected
+//  Enter:  menu -> the menu to display
+//
+void TeensyUserInterface::beginMenu(MENU_ITEM *menu)
+{
+  //
+  // menus given as tables are searched for their ends
+  //
+  setMenuDescriptors(NULL, 0);
+  menuHistoryCount = 0;
+  menuLastTouchedIdx = 0;
+  selectAndDrawMenu(menu, true);
+  menuRunningFlg = true;
+}
+
+
+
+//
+// display the top level menu without waiting for the user, the size of each menu 
+// is given by its descriptor, afterward call pollMenu() from the application's loop
+//  Enter:  menus -> the descriptors of the top level menu followed by all of its 
+//            sub menus, build them with makeMenuDescriptor<columns>(menuTable)
+//          menuCount = number of descriptors
+//
+void TeensyUserInterface::beginMenu(const MENU_DESCRIPTOR *menus, int menuCount)
+{
+  setMenuDescriptors(menus, menuCount);
+  menuHistoryCount = 0;
+  menuLastTouchedIdx = 0;
+  selectAndDrawMenu(menus[0].menu, true);
+  menuRunningFlg = true;
+}
+
+
+
+//
+// check the touch screen once and do what the menu asks, this never waits for the 
+// user and draws at most one menu, commands selected are executed from here
+//  Exit:   MENU_STATUS_xxx returned telling what was done, after MENU_STATUS_EXITED 
+//            the menus are done and MENU_STATUS_NOT_RUNNING is returned until 
+//            beginMenu() is called again
+//
+int TeensyUserInterface::pollMenu(void)
 {
   int menuIdx;
   MENU_ITEM *parentMenu;
-  
+
+  if (!menuRunningFlg)
+    return(MENU_STATUS_NOT_RUNNING);
+
   //
-  // display the top level menu
+  // redraw the toggle buttons whose state was set by the application
   //
-  selectAndDrawMenu(menu, true);
- 
+  if (toggleDirtyFlg)
+    drawDirtyToggles();
+
   //
-  // check for screen touches and execute menu commands
+  // check if there is a new Touch Event
   //
-  while(true)
+  getTouchEvents();
+  if (touchEventType == TOUCH_NO_EVENT)
+    return(MENU_STATUS_IDLE);
+
+  //
+  // check if user has pressed the menu's "Back" button on the title bar
+  //
+  menuDrawingDepth++;
+  boolean backButtonClickedFlg = checkForBackButtonClicked();
+  menuDrawingDepth--;
+  if (backButtonClickedFlg)
   {
     //
-    // check if there is a new Touch Event
+    // the menu's Back button pushed, get this menu's type
+    //
+    int menuItemType = currentMenuTable[0].MenuItemType;
+
+    //
+    // if this is a sub menu, go back to the menu it was selected from, or to its 
+    // parent menu when it wasn't selected from a menu
     //
-    getTouchEvents();
-    if (touchEventType != TOUCH_NO_EVENT)
+    if (menuItemType == MENU_ITEM_TYPE_SUB_MENU_HEADER)
     {
-      //
-      // check if user has pressed the menu's "Back" button on the title bar
-      //
-      if (checkForBackButtonClicked())
+      if (!popMenuHistory())
       {
-        //
-        // the menu's Back button pushed, get this menu's type
-        //
-        int menuItemType = currentMenuTable[0].MenuItemType;
-  
-        //
-        // if this is a sub menu, select this menu's parent menu
-        //
-        if (menuItemType == MENU_ITEM_TYPE_SUB_MENU_HEADER)
-        {
-          parentMenu = currentMenuTable[0].MenuItemSubMenu;
-          selectAndDrawMenu(parentMenu, true);
-          continue;
-        }
-  
-        //
-        // if this is the Main menu, exit the menus and return to the app
-        //
-        if (menuItemType == MENU_ITEM_TYPE_MAIN_MENU_HEADER)
-        {
-          parentMenu = currentMenuTable[0].MenuItemSubMenu;
-          if (parentMenu == NULL)
-            return;
-          continue;
-        }
-      }
-  
-      //
-      // check if user has pressed one of the menu's buttons
-      //
-      menuIdx = findMenuButtonForTouchEvent();
-      if (menuIdx > 0)
-      {
-        if (touchEventType == TOUCH_PUSHED_EVENT)
-          drawMenuItem(menuIdx, true);
-  
-        if (touchEventType == TOUCH_RELEASED_EVENT)
-        {
-          drawMenuItem(menuIdx, false);
-          executeMenuItem(menuIdx);
-        }
+        parentMenu = currentMenuTable[0].MenuItemSubMenu;
+        selectAndDrawMenu(parentMenu, true);
       }
+      return(MENU_STATUS_MENU_CHANGED);
     }
-    
+
     //
-    // check if there is a callback function to execute while in a menu
+    // if this is the Main menu, exit the menus and return to the app
     //
-    if (inMenuCallbackFunction != NULL)
+    if (menuItemType == MENU_ITEM_TYPE_MAIN_MENU_HEADER)
     {
-      //
-      // there is a call back function, so execute it
-      //
-      (inMenuCallbackFunction)();
+      parentMenu = currentMenuTable[0].MenuItemSubMenu;
+      if (parentMenu == NULL)
+      {
+        menuRunningFlg = false;
+        return(MENU_STATUS_EXITED);
+      }
     }
+    return(MENU_STATUS_TOUCHED);
   }
+
+  //
+  // check if user is pressing the arrows that scroll the menu
+  //
+  if (checkForMenuScrollButtons())
+    return(MENU_STATUS_TOUCHED);
+
+  //
+  // check if user has pressed one of the menu's buttons
+  //
+  menuIdx = findMenuButtonForTouchEvent();
+  if (menuIdx <= 0)
+    return(MENU_STATUS_TOUCHED);
+
+  if (touchEventType == TOUCH_PUSHED_EVENT)
+    drawMenuItem(menuIdx, true);
+
+  if (touchEventType != TOUCH_RELEASED_EVENT)
+    return(MENU_STATUS_TOUCHED);
+
+  //
+  // the button was released, execute it
+  //
+  menuLastTouchedIdx = menuIdx;
+  drawMenuItem(menuIdx, false);
+  int menuItemType = getMenuItem(menuIdx)->MenuItemType;
+  executeMenuItem(menuIdx);
+
+  if (menuItemType == MENU_ITEM_TYPE_SUB_MENU)
+    return(MENU_STATUS_MENU_CHANGED);
+  if (menuItemType == MENU_ITEM_TYPE_COMMAND)
+    return(MENU_STATUS_COMMAND);
+  return(MENU_STATUS_TOGGLED);
 }
 
 
@@ -442,19 +781,29 @@ void TeensyUserInterface::setInMenuCallbackFunction(void (*callbackFunction)())
 //
 void TeensyUserInterface::executeMenuItem(int menuIdx)
 {
+  MENU_ITEM *menuItem = getMenuItem(menuIdx);
   MENU_ITEM *subMenu;
 
   //
   // determine the type of menu entry, then execute it
   //
-  switch(currentMenuTable[menuIdx].MenuItemType)
+  switch(menuItem->MenuItemType)
   {    
     //
     // select a "Sub menu" from the current menu
     //
     case MENU_ITEM_TYPE_SUB_MENU:
     {
-      subMenu = currentMenuTable[menuIdx].MenuItemSubMenu;
+      //
+      // remember how the user got to the sub menu, a main menu starts over
+      //
+      subMenu = menuItem->MenuItemSubMenu;
+      if (subMenu[0].MenuItemType == MENU_ITEM_TYPE_MAIN_MENU_HEADER)
+        menuHistoryCount = 0;
+      else
+        pushMenuHistory();
+
+      menuLastTouchedIdx = 0;
       selectAndDrawMenu(subMenu, true);
       break;
     }
@@ -465,14 +814,24 @@ void TeensyUserInterface::executeMenuItem(int menuIdx)
     case MENU_ITEM_TYPE_COMMAND:
     {
       //
-      // execute the menu item's function
+      // keep a copy of the menu's screen, then execute the menu item's function
+      //
+      void (*menuItemFunction)() = menuItem->MenuItemFunction;
+      const TOUCH_TIMING *menuTouchTiming = touchTiming;
+      captureMenuSnapshot();
+      (menuItemFunction)();
+
+      //
+      // touch timing set by the function was for its screen only
       //
-      (currentMenuTable[menuIdx].MenuItemFunction)();
+      setTouchTiming(menuTouchTiming);
       
       //
-      // display the menu again
+      // display the menu again, if the function drew over it and nothing on the menu 
+      // has changed, the copy is put back instead
       //
-      selectAndDrawMenu(currentMenuTable, true);
+      if ((lcdDrawCount == menuScreenDrawCount) || !restoreMenuSnapshot())
+        selectAndDrawMenu(currentMenuTable, true);
       break;
     }
     
@@ -482,14 +841,151 @@ void TeensyUserInterface::executeMenuItem(int menuIdx)
     case MENU_ITEM_TYPE_TOGGLE:
     {
       toggleSelectNextStateFlg = true;
-      (currentMenuTable[menuIdx].MenuItemFunction)();
+      (menuItem->MenuItemFunction)();
+      drawMenuItem(menuIdx, false);
+      break;
+    }
+    
+    //
+    // select the toggle's next state, redisplay, then tell the application
+    //
+    case MENU_ITEM_TYPE_TOGGLE_STATE:
+    {
+      MENU_TOGGLE *toggle = (MENU_TOGGLE *) menuItem->MenuItemSubMenu;
+      toggle->state++;
+      if (toggle->state >= toggle->optionCount)
+        toggle->state = 0;
       drawMenuItem(menuIdx, false);
+
+      if (menuItem->MenuItemFunction != NULL)
+        (menuItem->MenuItemFunction)();
+      break;
     }
   }
 }
 
 
 
+//
+// set the state of a toggle, if the toggle is on the menu being shown, only its 
+// button is redrawn, the toggle's function is not called
+//  Enter:  toggle = the toggle to set
+//          state = index of the toggle's new option, 0 to optionCount - 1
+//
+void TeensyUserInterface::setToggleState(MENU_TOGGLE &toggle, int state)
+{
+  if ((state < 0) || (state >= toggle.optionCount))
+    return;
+
+  if ((state == toggle.state) && toggle.labelValidFlg && (toggle.labelState == state))
+    return;
+
+  toggle.state = state;
+  toggle.dirtyFlg = true;
+  toggleDirtyFlg = true;
+}
+
+
+
+//
+// redraw the toggles on the current menu whose state has been set since they were drawn
+//
+void TeensyUserInterface::drawDirtyToggles(void)
+{
+  int firstMenuIdx;
+  int lastMenuIdx;
+
+  toggleDirtyFlg = false;
+
+  getVisibleMenuButtons(&firstMenuIdx, &lastMenuIdx);
+  for (int menuIdx = firstMenuIdx; menuIdx <= lastMenuIdx; menuIdx++)
+  {
+    MENU_ITEM *menuItem = getMenuItem(menuIdx);
+    if (menuItem->MenuItemType != MENU_ITEM_TYPE_TOGGLE_STATE)
+      continue;
+
+    MENU_TOGGLE *toggle = (MENU_TOGGLE *) menuItem->MenuItemSubMenu;
+    if (toggle->dirtyFlg)
+      drawMenuItem(menuIdx, false);
+  }
+}
+
+
+
+//
+// get the range of the current menu's buttons that are showing, menus that scroll 
+// only show some of them
+//  Enter:  firstMenuIdx -> storage to return the number of the first button showing
+//          lastMenuIdx -> storage to return the number of the last button showing
+//
+void TeensyUserInterface::getVisibleMenuButtons(int *firstMenuIdx, int *lastMenuIdx)
+{
+  MENU_LAYOUT *layout = getMenuLayout();
+
+  *firstMenuIdx = 1;
+  *lastMenuIdx = layout->buttonCount;
+  if (!layout->scrollFlg)
+    return;
+
+  int rowPitch = layout->buttonHeight + layout->spacing;
+  int firstRow = max((displaySpaceTopY - layout->topY + layout->scrollY) / rowPitch, 0);
+  int lastRow = (displaySpaceBottomY - layout->topY + layout->scrollY) / rowPitch;
+  *firstMenuIdx = firstRow * layout->columns + 1;
+  *lastMenuIdx = min((lastRow + 1) * layout->columns, layout->buttonCount);
+}
+
+
+
+//
+// get the text shown on a toggle state button, the text is only built when the 
+// toggle's state has changed since it was last built
+//  Enter:  menuItem -> a MENU_ITEM_TYPE_TOGGLE_STATE entry
+//  Exit:   pointer to the text returned
+//
+const char *TeensyUserInterface::getToggleLabel(MENU_ITEM *menuItem)
+{
+  MENU_TOGGLE *toggle = (MENU_TOGGLE *) menuItem->MenuItemSubMenu;
+
+  if (!toggle->labelValidFlg || (toggle->labelState != toggle->state))
+  {
+    const char *optionText = "";
+    if ((toggle->state >= 0) && (toggle->state < toggle->optionCount))
+      optionText = toggle->optionLabels[toggle->state];
+
+    snprintf(toggle->label, sizeof(toggle->label), "%s:  %s", menuItem->MenuItemText, optionText);
+    toggle->labelState = toggle->state;
+    toggle->labelValidFlg = true;
+  }
+
+  return(toggle->label);
+}
+
+
+
+//
+// get the entry for one of the current menu's buttons, for dynamic menus the 
+// application is asked to fill it in
+//  Enter:  menuIdx = button number, 1 for the first button
+//  Exit:   pointer to the entry returned, for dynamic menus it's only good until 
+//            the next call
+//
+MENU_ITEM *TeensyUserInterface::getMenuItem(int menuIdx)
+{
+  MENU_DYNAMIC *dynamic = getMenuLayout()->dynamic;
+  if (dynamic == NULL)
+    return(&currentMenuTable[menuIdx]);
+
+  dynamicMenuItemIndex = menuIdx - 1;
+  dynamicMenuItem.MenuItemType = MENU_ITEM_TYPE_COMMAND;
+  dynamicMenuItem.MenuItemText = "";
+  dynamicMenuItem.MenuItemFunction = NULL;
+  dynamicMenuItem.MenuItemSubMenu = NULL;
+  (dynamic->getItem)(menuIdx - 1, &dynamicMenuItem);
+  return(&dynamicMenuItem);
+}
+
+
+
 //
 // select and display a menu or submenu, for most applications this function is not used
 //  Enter:  menu -> the menu to display
@@ -498,9 +994,10 @@ void TeensyUserInterface::executeMenuItem(int menuIdx)
 void TeensyUserInterface::selectAndDrawMenu(MENU_ITEM *menu, boolean drawMenuFlg)
 {   
   //
-  // remember the currently selected menu
+  // remember the currently selected menu, laying out its buttons once
   //
   currentMenuTable = menu;
+  buildMenuLayout();
 
   //
   // check if drawing the menu, if not return
@@ -508,48 +1005,444 @@ void TeensyUserInterface::selectAndDrawMenu(MENU_ITEM *menu, boolean drawMenuFlg
   if (!drawMenuFlg)
     return;
 
-  //
-  // draw the title bar, decide if should include the "Back" button (don't show the 
-  // Back button if this is the main menu and it links back to itself)
-  //
-  if ((currentMenuTable[0].MenuItemType == MENU_ITEM_TYPE_MAIN_MENU_HEADER) &&
-    (currentMenuTable[0].MenuItemSubMenu != NULL))
-    drawTitleBar(currentMenuTable[0].MenuItemText);
-  else
-    drawTitleBarWithBackButton(currentMenuTable[0].MenuItemText);
-   
-  //
-  // clear the display space
-  //
-  clearDisplaySpace();
-
-  //
-  // draw all buttons in the menu
-  //
-  drawMenu();
+  drawSelectedMenu();
 }
 
 
 
 //
-// display the currently selected menu
-//  Enter:  currentMenuTable -> the menu to display
+// save the current menu on the history, when full the oldest level is dropped
 //
-void TeensyUserInterface::drawMenu(void)
-{ 
-  int menuIdx = 1;
+void TeensyUserInterface::pushMenuHistory(void)
+{
+  MENU_HISTORY_ENTRY *entry = &menuHistory[menuHistoryTop];
+  entry->menu = currentMenuTable;
+  entry->layout = menuLayout;
+  entry->lastTouchedMenuIdx = menuLastTouchedIdx;
+
+  menuHistoryTop = (menuHistoryTop + 1) % MENU_HISTORY_DEPTH;
+  if (menuHistoryCount < MENU_HISTORY_DEPTH)
+    menuHistoryCount++;
+}
+
+
+
+//
+// go back to the last menu saved on the history, its layout and scroll position
+// are restored rather than worked out again
+//  Exit:   true returned if a menu was restored, false if the history is empty
+//
+boolean TeensyUserInterface::popMenuHistory(void)
+{
+  if (menuHistoryCount == 0)
+    return(false);
+
+  menuHistoryTop = (menuHistoryTop + MENU_HISTORY_DEPTH - 1) % MENU_HISTORY_DEPTH;
+  menuHistoryCount--;
+  MENU_HISTORY_ENTRY *entry = &menuHistory[menuHistoryTop];
+
+  currentMenuTable = entry->menu;
+  menuLayout = entry->layout;
+  menuLastTouchedIdx = entry->lastTouchedMenuIdx;
+
+  //
+  // if the display space changed since the menu was saved, its layout is built 
+  // again, scroll so the button last touched is showing
+  //
+  boolean staleFlg = (menuLayout.displaySpaceLeftX != displaySpaceLeftX) || 
+    (menuLayout.displaySpaceTopY != displaySpaceTopY) || 
+    (menuLayout.displaySpaceWidth != displaySpaceWidth) || 
+    (menuLayout.displaySpaceHeight != displaySpaceHeight);
+
+  //
+  // a dynamic menu is laid out again if its number of buttons changed
+  //
+  if (!staleFlg && (menuLayout.dynamic != NULL) && ((menuLayout.dynamic->itemCount)() != menuLayout.buttonCount))
+  {
+    staleFlg = true;
+    buildMenuLayout();
+  }
+
+  MENU_LAYOUT *layout = getMenuLayout();
+  if (staleFlg && layout->scrollFlg && (menuLastTouchedIdx > 0))
+  {
+    int rowY = (layout->topY - displaySpaceTopY) + ((menuLastTouchedIdx - 1) / layout->columns) * (layout->buttonHeight + layout->spacing);
+    if ((rowY < layout->scrollY) || (rowY + layout->buttonHeight > layout->scrollY + displaySpaceHeight))
+      layout->scrollY = constrain(rowY, 0, layout->maxScrollY);
+  }
+
+  drawSelectedMenu();
+  return(true);
+}
+
+
+
+//
+// draw the menu that's been selected
+//  Enter:  currentMenuTable -> the menu to draw, its layout already built
+//
+void TeensyUserInterface::drawSelectedMenu(void)
+{
+  //
+  // the menu's own drawing isn't counted as something else drawing over the menu, 
+  // when enabled, record the drawing so that pixels painted over by the buttons 
+  // aren't sent
+  //
+  menuDrawingDepth++;
+  if (menuDisplayListFlg)
+    lcdBeginDisplayList();
+
+  //
+  // when the last menu drawn is still on the screen untouched, only redraw what's 
+  // different in this one
+  //
+  boolean incrementalFlg = menuOnScreenFlg && (lcdDrawCount == menuScreenDrawCount) && 
+    (scrollOffset == 0) && !menuLayout.scrollFlg && (menuLayout.buttonCount <= MENU_MAX_SLOTS);
+
+  //
+  // draw the title bar, decide if should include the "Back" button (don't show the 
+  // Back button if this is the main menu and it links back to itself)
+  //
+  const char *titleText = currentMenuTable[0].MenuItemText;
+  boolean backButtonFlg = !((currentMenuTable[0].MenuItemType == MENU_ITEM_TYPE_MAIN_MENU_HEADER) &&
+    (currentMenuTable[0].MenuItemSubMenu != NULL));
+
+  if (!incrementalFlg || (backButtonFlg != menuTitleBackButtonFlg) || (strcmp(titleText, menuTitleText) != 0))
+  {
+    //
+    // menus that scroll have arrows on the right of the title bar, keep the title's 
+    // text from running under them
+    //
+    int scrollButtonX = lcdWidth;
+    int scrollButtonY;
+    int scrollButtonWidth;
+    int scrollButtonHeight;
+    if (menuLayout.scrollFlg)
+    {
+      getMenuScrollButtonSizeAndLocation(-1, &scrollButtonX, &scrollButtonY, &scrollButtonWidth, &scrollButtonHeight);
+      lcdPushClipRect(0, 0, scrollButtonX - 2, lcdHeight);
+    }
+
+    if (backButtonFlg)
+      drawTitleBarWithBackButton(titleText);
+    else
+      drawTitleBar(titleText);
+
+    if (menuLayout.scrollFlg)
+    {
+      lcdPopClipRect();
+      lcdDrawFilledRectangle(scrollButtonX - 2, 0, lcdWidth - scrollButtonX + 2, titleBarHeight, titleBarColor);
+      drawMenuScrollButton(-1, false);
+      drawMenuScrollButton(1, false);
+    }
+  }
+   
+  //
+  // clear the display space and draw all buttons in the menu, or just the buttons 
+  // that changed
+  //
+  if (incrementalFlg)
+    drawMenuChanges();
+  else
+  {
+    clearDisplaySpace();
+    drawMenu();
+  }
+  if (menuDisplayListFlg)
+    lcdEndDisplayList();
+
+  //
+  // remember what's on the screen for the next menu
+  //
+  menuTitleText = titleText;
+  menuTitleBackButtonFlg = backButtonFlg;
+  menuOnScreenFlg = !menuLayout.scrollFlg && (menuLayout.buttonCount <= MENU_MAX_SLOTS);
+  menuSlotCount = menuLayout.buttonCount;
+  menuDrawingDepth--;
+  menuScreenDrawCount = lcdDrawCount;
+}
+
+
+
+//
+// draw the current menu over the last one drawn, only redrawing the buttons that 
+// differ and clearing the areas of buttons that have gone
+//
+void TeensyUserInterface::drawMenuChanges(void)
+{
+  MENU_LAYOUT *layout = getMenuLayout();
+  int buttonX;
+  int buttonY;
+  int buttonWidth;
+  int buttonHeight;
+
+  //
+  // clear the old buttons that aren't in the same place in the new menu
+  //
+  for (int slotIdx = 0; slotIdx < menuSlotCount; slotIdx++)
+  {
+    MENU_SLOT *slot = &menuSlots[slotIdx];
+    if (slotIdx < layout->buttonCount)
+    {
+      getMenuButtonSizeAndLocation(slotIdx + 1, &buttonX, &buttonY, &buttonWidth, &buttonHeight);
+      if ((buttonX == slot->x) && (buttonY == slot->y) && (buttonWidth == slot->width) && (buttonHeight == slot->height))
+        continue;
+    }
+    lcdDrawFilledRectangle(slot->x, slot->y, slot->width, slot->height, menuBackgroundColor);
+  }
+
+  //
+  // draw the buttons whose place, type or label are different, toggles and dynamic 
+  // menus are always drawn since their text comes from a callback, toggle states 
+  // only when set
+  //
+  for (int menuIdx = 1; menuIdx <= layout->buttonCount; menuIdx++)
+  {
+    if (layout->dynamic != NULL)
+    {
+      drawMenuItem(menuIdx, false);
+      continue;
+    }
+
+    MENU_SLOT *slot = &menuSlots[menuIdx - 1];
+    MENU_ITEM *menuItem = &currentMenuTable[menuIdx];
+    getMenuButtonSizeAndLocation(menuIdx, &buttonX, &buttonY, &buttonWidth, &buttonHeight);
+
+    const char *labelText = menuItem->MenuItemText;
+    if (menuItem->MenuItemType == MENU_ITEM_TYPE_TOGGLE_STATE)
+    {
+      MENU_TOGGLE *toggle = (MENU_TOGGLE *) menuItem->MenuItemSubMenu;
+      if (toggle->dirtyFlg || !toggle->labelValidFlg || (toggle->labelState != toggle->state))
+        labelText = NULL;
+      else
+        labelText = toggle->label;
+    }
+
+    if ((menuIdx <= menuSlotCount) && (labelText != NULL) && 
+        (buttonX == slot->x) && (buttonY == slot->y) && (buttonWidth == slot->width) && (buttonHeight == slot->height) && 
+        (slot->menuItemType == menuItem->MenuItemType) && (menuItem->MenuItemType != MENU_ITEM_TYPE_TOGGLE) && 
+        !slot->selectedFlg && (strcmp(slot->labelText, labelText) == 0))
+    {
+      slot->labelText = labelText;
+      continue;
+    }
+
+    drawMenuItem(menuIdx, false);
+  }
+}
+
+
+
+//
+// display the currently selected menu
+//  Enter:  currentMenuTable -> the menu to display
+//
+void TeensyUserInterface::drawMenu(void)
+{ 
+  MENU_LAYOUT *layout = getMenuLayout();
+
+  //
+  // menus that scroll only draw the buttons that are showing
+  //
+  if (layout->scrollFlg)
+  {
+    drawMenuRows(displaySpaceTopY, displaySpaceBottomY);
+    return;
+  }
  
   //
   // loop through the menu, drawing each button
   //
-  while(true)
+  for (int menuIdx = 1; menuIdx <= layout->buttonCount; menuIdx++)
+    drawMenuItem(menuIdx, false);
+}
+
+
+
+//
+// draw the buttons of a scrolling menu that are in a band of the display space
+//  Enter:  y1, y2 = top and bottom of the band
+//
+void TeensyUserInterface::drawMenuRows(int y1, int y2)
+{
+  MENU_LAYOUT *layout = getMenuLayout();
+  int rowPitch = layout->buttonHeight + layout->spacing;
+
+  //
+  // find the rows of buttons in the band
+  //
+  int firstRow = (y1 - layout->topY + layout->scrollY) / rowPitch;
+  int lastRow = (y2 - layout->topY + layout->scrollY) / rowPitch;
+  if (firstRow < 0) firstRow = 0;
+  if (lastRow > layout->rows - 1) lastRow = layout->rows - 1;
+
+  //
+  // draw them, clipped to the band
+  //
+  lcdPushClipRect(displaySpaceLeftX, y1, displaySpaceWidth, y2 - y1 + 1);
+  for (int buttonRow = firstRow; buttonRow <= lastRow; buttonRow++)
   {
-    if(currentMenuTable[menuIdx].MenuItemType == MENU_ITEM_TYPE_END_OF_MENU)
-      break;
+    for (int buttonColumn = 0; buttonColumn < layout->columns; buttonColumn++)
+    {
+      int menuIdx = buttonRow * layout->columns + buttonColumn + 1;
+      if (menuIdx > layout->buttonCount)
+        break;
+      drawMenuItem(menuIdx, false);
+    }
+  }
+  lcdPopClipRect();
+}
 
-    drawMenuItem(menuIdx, false);
-    menuIdx++;
+
+
+//
+// scroll a menu that's too big for the screen, only the buttons scrolled into view
+// are drawn
+//  Enter:  buttonRows = number of rows of buttons to scroll, positive scrolls down 
+//            the menu
+//
+void TeensyUserInterface::scrollMenu(int buttonRows)
+{
+  MENU_LAYOUT *layout = getMenuLayout();
+  if (!layout->scrollFlg)
+    return;
+
+  int scrollY = layout->scrollY + buttonRows * (layout->buttonHeight + layout->spacing);
+  if (scrollY > layout->maxScrollY) scrollY = layout->maxScrollY;
+  if (scrollY < 0) scrollY = 0;
+  int distance = scrollY - layout->scrollY;
+  if (distance == 0)
+    return;
+  layout->scrollY = scrollY;
+
+  //
+  // move what's on the screen, then draw the rows uncovered, if the display space 
+  // can't be scrolled, draw the buttons that are showing
+  //
+  menuDrawingDepth++;
+  boolean scrolledFlg = scrollDisplaySpace(distance);
+
+  if (menuDisplayListFlg)
+    lcdBeginDisplayList();
+  if (!scrolledFlg)
+  {
+    lcdDrawFilledRectangle(displaySpaceLeftX, displaySpaceTopY, displaySpaceWidth, displaySpaceHeight, menuBackgroundColor);
+    drawMenuRows(displaySpaceTopY, displaySpaceBottomY);
+  }
+  else if (abs(distance) >= displaySpaceHeight)
+    drawMenuRows(displaySpaceTopY, displaySpaceBottomY);
+  else if (distance > 0)
+    drawMenuRows(displaySpaceBottomY - distance + 1, displaySpaceBottomY);
+  else
+    drawMenuRows(displaySpaceTopY, displaySpaceTopY - distance - 1);
+  if (menuDisplayListFlg)
+    lcdEndDisplayList();
+  menuDrawingDepth--;
+}
+
+
+
+//
+// check if the user is pressing the arrows that scroll the menu, holding an arrow 
+// keeps scrolling
+//  Exit:   true returned if the touch event was for one of the arrows
+//
+boolean TeensyUserInterface::checkForMenuScrollButtons(void)
+{
+  int X1;
+  int Y1;
+  int buttonWidth;
+  int buttonHeight;
+  boolean touchedFlg = false;
+
+  if (!getMenuLayout()->scrollFlg)
+    return(false);
+
+  menuDrawingDepth++;
+  for (int direction = -1; direction <= 1; direction += 2)
+  {
+    getMenuScrollButtonSizeAndLocation(direction, &X1, &Y1, &buttonWidth, &buttonHeight);
+    int X2 = X1 + buttonWidth - 1;
+    int Y2 = Y1 + buttonHeight - 1;
+
+    if (checkForTouchEventInRect(TOUCH_PUSHED_EVENT, X1, Y1, X2, Y2))
+    {
+      drawMenuScrollButton(direction, true);
+      scrollMenu(direction);
+      touchedFlg = true;
+    }
+
+    else if (checkForTouchEventInRect(TOUCH_REPEAT_EVENT, X1, Y1, X2, Y2))
+    {
+      scrollMenu(direction);
+      touchedFlg = true;
+    }
+
+    else if (checkForTouchEventInRect(TOUCH_RELEASED_EVENT, X1, Y1, X2, Y2))
+    {
+      drawMenuScrollButton(direction, false);
+      touchedFlg = true;
+    }
+
+    if (touchedFlg)
+      break;
   }
+
+  menuDrawingDepth--;
+  return(touchedFlg);
+}
+
+
+
+//
+// draw one of the arrows on the title bar for scrolling the menu
+//  Enter:  direction = -1 for the up arrow, 1 for the down arrow
+//          buttonSelectedFlg = true if should show the button selected
+//
+void TeensyUserInterface::drawMenuScrollButton(int direction, boolean buttonSelectedFlg)
+{
+  int buttonX;
+  int buttonY;
+  int buttonWidth;
+  int buttonHeight;
+  getMenuScrollButtonSizeAndLocation(direction, &buttonX, &buttonY, &buttonWidth, &buttonHeight);
+
+  uint16_t buttonColor;
+  if (buttonSelectedFlg)
+    buttonColor = titleBarBackButtonSelectedColor;
+  else
+    buttonColor = titleBarBackButtonColor;
+
+  lcdDrawFilledRoundedRectangle(buttonX, buttonY, buttonWidth, buttonHeight, buttonHeight / 4, buttonColor);
+
+  //
+  // draw a triangle pointing up or down
+  //
+  int arrowCenterX = buttonX + buttonWidth / 2;
+  int arrowCenterY = buttonY + buttonHeight / 2;
+  lcdDrawFilledTriangle(arrowCenterX - arrowWidth,  arrowCenterY - (direction * arrowWidth) / 2,
+                        arrowCenterX + arrowWidth,  arrowCenterY - (direction * arrowWidth) / 2,
+                        arrowCenterX,               arrowCenterY + (direction * arrowWidth) / 2,
+                        menuButtonTextColor);
+}
+
+
+
+//
+// get the XY coords and size of the arrows on the title bar for scrolling the menu 
+//  Enter:  direction = -1 for the up arrow, 1 for the down arrow
+//          buttonX, buttonY -> storage to return XY coords of the button
+//          buttonWidth, buttonHeight -> storage to return size of the button
+//
+void TeensyUserInterface::getMenuScrollButtonSizeAndLocation(int direction, int *buttonX, int *buttonY, 
+  int *buttonWidth, int *buttonHeight)
+{
+  *buttonHeight = titleBarHeight - 6;
+  *buttonWidth = *buttonHeight + 6;
+  *buttonY = (titleBarHeight - *buttonHeight) / 2;
+  *buttonX = lcdWidth - 4 - *buttonWidth;
+  if (direction < 0)
+    *buttonX -= *buttonWidth + 4;
 }
 
 
@@ -567,19 +1460,31 @@ void TeensyUserInterface::drawMenuItem(int menuIdx, boolean buttonSelectedFlg)
   int buttonHeight;
  
   //
-  // determine the coordinates and size of the button, then draw it
+  // determine the coordinates and size of the button, then draw it, buttons on menus 
+  // that scroll can be partly outside the display space
   //
   getMenuButtonSizeAndLocation(menuIdx, &buttonX, &buttonY, &buttonWidth, &buttonHeight);
+  menuDrawingDepth++;
+  boolean scrollFlg = getMenuLayout()->scrollFlg;
+  if (scrollFlg)
+    lcdPushClipRect(displaySpaceLeftX, displaySpaceTopY, displaySpaceWidth, displaySpaceHeight);
 
   //
   // get the button text
   //
-  const char *menuItemText = currentMenuTable[menuIdx].MenuItemText;
+  MENU_ITEM *menuItem = getMenuItem(menuIdx);
+  const char *menuItemText = menuItem->MenuItemText;
+
+  //
+  // the text in a menu table doesn't change so its width is remembered, the text 
+  // given for a dynamic menu may be in a buffer that's reused
+  //
+  const char *constantMenuItemText = (menuItem == &dynamicMenuItem) ? NULL : menuItemText;
     
   //
   // determine the menu entry type and draw it
   //
-  switch(currentMenuTable[menuIdx].MenuItemType)
+  switch(menuItem->MenuItemType)
   {    
     //
     // display a "sub menu" button
@@ -589,7 +1494,9 @@ void TeensyUserInterface::drawMenuItem(int menuIdx, boolean buttonSelectedFlg)
       //
       // draw the button
       //
+      constantLabelText = constantMenuItemText;
       drawButton(menuItemText, buttonSelectedFlg, buttonX, buttonY, buttonWidth, buttonHeight);
+      constantLabelText = NULL;
 
       //
       // draw a triangle showing the button connects to a submenu
@@ -608,7 +1515,9 @@ void TeensyUserInterface::drawMenuItem(int menuIdx, boolean buttonSelectedFlg)
     //
     case MENU_ITEM_TYPE_COMMAND:
     {
+      constantLabelText = constantMenuItemText;
       drawButton(menuItemText, buttonSelectedFlg, buttonX, buttonY, buttonWidth, buttonHeight);
+      constantLabelText = NULL;
       break;
     }
 
@@ -621,7 +1530,7 @@ void TeensyUserInterface::drawMenuItem(int menuIdx, boolean buttonSelectedFlg)
       // execute the callback fuction to get the toggle button's text
       //
       toggleSelectNextStateFlg = false;
-      (currentMenuTable[menuIdx].MenuItemFunction)();
+      (menuItem->MenuItemFunction)();
 
 
       //
@@ -632,8 +1541,39 @@ void TeensyUserInterface::drawMenuItem(int menuIdx, boolean buttonSelectedFlg)
       strcat(s, ":  ");
       strcat(s, toggleText);
       drawButton(s, buttonSelectedFlg, buttonX, buttonY, buttonWidth, buttonHeight);
+      break;
+    }
+
+    //
+    // display a "toggle state" button, its text is kept with the toggle
+    //    
+    case MENU_ITEM_TYPE_TOGGLE_STATE:
+    {
+      menuItemText = getToggleLabel(menuItem);
+      ((MENU_TOGGLE *) menuItem->MenuItemSubMenu)->dirtyFlg = false;
+      drawButton(menuItemText, buttonSelectedFlg, buttonX, buttonY, buttonWidth, buttonHeight);
+      break;
     }
   }
+
+  if (scrollFlg)
+    lcdPopClipRect();
+
+  //
+  // remember what's drawn in this button's slot
+  //
+  if (menuIdx - 1 < MENU_MAX_SLOTS)
+  {
+    MENU_SLOT *slot = &menuSlots[menuIdx - 1];
+    slot->x = buttonX;
+    slot->y = buttonY;
+    slot->width = buttonWidth;
+    slot->height = buttonHeight;
+    slot->menuItemType = menuItem->MenuItemType;
+    slot->selectedFlg = buttonSelectedFlg;
+    slot->labelText = menuItemText;
+  }
+  menuDrawingDepth--;
 }
 
 
@@ -645,33 +1585,43 @@ void TeensyUserInterface::drawMenuItem(int menuIdx, boolean buttonSelectedFlg)
 //
 int TeensyUserInterface::findMenuButtonForTouchEvent(void)
 {
-  int menuIdx = 1;
-  int buttonX, buttonY;
-  int buttonWidth, buttonHeight;
- 
+  MENU_LAYOUT *layout = getMenuLayout();
+  if ((layout->buttonCount == 0) || (layout->buttonWidth <= 0) || (layout->buttonHeight <= 0))
+    return(0);
+
   //
-  // loop through the menu, testing each button location
+  // find the row the touch is in, returning if it's in the space between rows, only
+  // the rows showing on menus that scroll can be touched
   //
-  while(true)
-  {
-    //
-    // check if at end of table, indicating that a matching button wasn't found
-    //
-    if(currentMenuTable[menuIdx].MenuItemType == MENU_ITEM_TYPE_END_OF_MENU)
-      return(0);
+  if (layout->scrollFlg && ((touchEventY < displaySpaceTopY) || (touchEventY > displaySpaceBottomY)))
+    return(0);
 
-    //
-    // check if the given coords were inside this button
-    //
-    getMenuButtonSizeAndLocation(menuIdx, &buttonX, &buttonY, &buttonWidth, &buttonHeight);
+  int y = touchEventY - layout->topY + layout->scrollY;
+  if (y < 0)
+    return(0);
+  int buttonRow = y / (layout->buttonHeight + layout->spacing);
+  if ((buttonRow >= layout->rows) || (y - buttonRow * (layout->buttonHeight + layout->spacing) >= layout->buttonHeight))
+    return(0);
 
-    if ((touchEventX >= buttonX) && (touchEventX <= buttonX + buttonWidth - 1))
-    {
-      if ((touchEventY >= buttonY) && (touchEventY <= buttonY + buttonHeight - 1))
-        return(menuIdx);
-    }
-    menuIdx++;
+  //
+  // find the column, the last row can have fewer buttons that are centered
+  //
+  int leftX = layout->leftX;
+  int buttonCountOnThisRow = layout->columns;
+  if (buttonRow == layout->rows - 1)
+  {
+    leftX = layout->lastRowLeftX;
+    buttonCountOnThisRow = layout->lastRowButtonCount;
   }
+
+  int x = touchEventX - leftX;
+  if (x < 0)
+    return(0);
+  int buttonColumn = x / (layout->buttonWidth + layout->spacing);
+  if ((buttonColumn >= buttonCountOnThisRow) || (x - buttonColumn * (layout->buttonWidth + layout->spacing) >= layout->buttonWidth))
+    return(0);
+
+  return(buttonRow * layout->columns + buttonColumn + 1);
 }
 
 
@@ -685,65 +1635,521 @@ int TeensyUserInterface::findMenuButtonForTouchEvent(void)
 void TeensyUserInterface::getMenuButtonSizeAndLocation(int menuIdx, int *buttonX, int *buttonY, 
   int *buttonWidth, int *buttonHeight)
 {
+  MENU_LAYOUT *layout = getMenuLayout();
   int menuButtonNumber = menuIdx - 1;
-  int buttonCountOnThisRow;
-  
+
   //
-  // count the total number of buttons
+  // determine the row and column of this button
   //
-  int idx = 1;
-  int buttonCount = 0;
-  while(true)
-  {
-    if(currentMenuTable[idx].MenuItemType == MENU_ITEM_TYPE_END_OF_MENU)
-      break;
+  int buttonRow = menuButtonNumber / layout->columns;
+  int buttonColumn = menuButtonNumber - (buttonRow * layout->columns);
+
+  //
+  // determine the XY coords of the button's upper left corner
+  //
+  int leftMostButtonX = layout->leftX;
+  if (buttonRow == layout->rows - 1)
+    leftMostButtonX = layout->lastRowLeftX;
+
+  *buttonWidth = layout->buttonWidth;
+  *buttonHeight = layout->buttonHeight;
+  *buttonX = leftMostButtonX + (layout->buttonWidth + layout->spacing) * buttonColumn;
+  *buttonY = layout->topY + (layout->buttonHeight + layout->spacing) * buttonRow - layout->scrollY;
+}
+
+
+
+//
+// set the descriptors that give the sizes of the menus, each is checked against its 
+// table and the ones that match are put in the hash table
+//  Enter:  menus -> the descriptors, NULL if there are none
+//          menuCount = number of descriptors
+//
+void TeensyUserInterface::setMenuDescriptors(const MENU_DESCRIPTOR *menus, int menuCount)
+{
+  menuDescriptors = menus;
+  memset(menuDescriptorHash, -1, sizeof(menuDescriptorHash));
+  menuLayout.menu = NULL;
+
+  int hashedCount = 0;
+  for (int i = 0; (i < menuCount) && (hashedCount < MENU_DESCRIPTOR_HASH_SIZE / 2); i++)
+  {
+    //
+    // the table must start with a header with the same columns and end right after 
+    // its buttons
+    //
+    MENU_ITEM *menu = menus[i].menu;
+    if ((menu[0].MenuItemType != MENU_ITEM_TYPE_MAIN_MENU_HEADER) && (menu[0].MenuItemType != MENU_ITEM_TYPE_SUB_MENU_HEADER))
+      continue;
+    if (((int) (intptr_t) menu[0].MenuItemFunction != menus[i].columns) || 
+        (menu[menus[i].buttonCount + 1].MenuItemType != MENU_ITEM_TYPE_END_OF_MENU))
+      continue;
+
+    int slot = ((uintptr_t) menu / sizeof(MENU_ITEM)) % MENU_DESCRIPTOR_HASH_SIZE;
+    while (menuDescriptorHash[slot] >= 0)
+      slot = (slot + 1) % MENU_DESCRIPTOR_HASH_SIZE;
+    menuDescriptorHash[slot] = i;
+    hashedCount++;
+  }
+}
+
+
+
+//
+// find the descriptor of a menu table
+//  Enter:  menu -> the menu table
+//  Exit:   pointer to the descriptor returned, NULL if the table doesn't have one
+//
+const MENU_DESCRIPTOR *TeensyUserInterface::findMenuDescriptor(MENU_ITEM *menu)
+{
+  int slot = ((uintptr_t) menu / sizeof(MENU_ITEM)) % MENU_DESCRIPTOR_HASH_SIZE;
+  while (menuDescriptorHash[slot] >= 0)
+  {
+    if (menuDescriptors[menuDescriptorHash[slot]].menu == menu)
+      return(&menuDescriptors[menuDescriptorHash[slot]]);
+    slot = (slot + 1) % MENU_DESCRIPTOR_HASH_SIZE;
+  }
+  return(NULL);
+}
+
 
-    idx++;
-    buttonCount++;
+
+//
+// get the layout of the current menu's buttons, laying them out again if the menu or
+// display space has changed since it was built
+//  Exit:   pointer to the layout returned
+//
+MENU_LAYOUT *TeensyUserInterface::getMenuLayout(void)
+{
+  if ((menuLayout.menu != currentMenuTable) || 
+      (menuLayout.displaySpaceLeftX != displaySpaceLeftX) || 
+      (menuLayout.displaySpaceTopY != displaySpaceTopY) || 
+      (menuLayout.displaySpaceWidth != displaySpaceWidth) || 
+      (menuLayout.displaySpaceHeight != displaySpaceHeight))
+    buildMenuLayout();
+
+  return(&menuLayout);
+}
+
+
+
+//
+// lay out the grid of buttons for the current menu
+//  Enter:  currentMenuTable -> the menu
+//
+void TeensyUserInterface::buildMenuLayout(void)
+{
+  MENU_LAYOUT *layout = &menuLayout;
+
+  //
+  // a menu that's laid out again keeps its scroll position
+  //
+  int previousScrollY = (layout->menu == currentMenuTable) ? layout->scrollY : 0;
+
+  layout->menu = currentMenuTable;
+  layout->displaySpaceLeftX = displaySpaceLeftX;
+  layout->displaySpaceTopY = displaySpaceTopY;
+  layout->displaySpaceWidth = displaySpaceWidth;
+  layout->displaySpaceHeight = displaySpaceHeight;
+
+  //
+  // get the number of buttons, rows and columns from the menu's descriptor
+  //
+  int buttonCount;
+  int columnsOfButtons;
+  int rowsOfButtons;
+  const MENU_DESCRIPTOR *descriptor = findMenuDescriptor(currentMenuTable);
+  if (descriptor != NULL)
+  {
+    buttonCount = descriptor->buttonCount;
+    columnsOfButtons = descriptor->columns;
+    rowsOfButtons = descriptor->rows;
   }
 
   //
-  // determine the number of rows and columns of buttons
+  // menus without a descriptor are searched for their end to count the buttons, 
+  // once each time the menu is selected
   //
-  int columnsOfButtons = (int) currentMenuTable[0].MenuItemFunction;
-  if ((columnsOfButtons < 1) || (columnsOfButtons > 4))
-    columnsOfButtons = 1;
+  else
+  {
+    int idx = 1;
+    buttonCount = 0;
+    while(true)
+    {
+      if(currentMenuTable[idx].MenuItemType == MENU_ITEM_TYPE_END_OF_MENU)
+        break;
+
+      idx++;
+      buttonCount++;
+    }
+
+    columnsOfButtons = (int) (intptr_t) currentMenuTable[0].MenuItemFunction;
+    if ((columnsOfButtons < 1) || (columnsOfButtons > 4))
+      columnsOfButtons = 1;
     
-  int rowsOfButtons = (buttonCount + columnsOfButtons - 1) / columnsOfButtons;
+    rowsOfButtons = (buttonCount + columnsOfButtons - 1) / columnsOfButtons;
+  }
+
+  //
+  // a dynamic menu has one entry in its table, the application says how many 
+  // buttons it has
+  //
+  layout->dynamic = NULL;
+  if (currentMenuTable[1].MenuItemType == MENU_ITEM_TYPE_DYNAMIC)
+  {
+    layout->dynamic = (MENU_DYNAMIC *) currentMenuTable[1].MenuItemSubMenu;
+    buttonCount = max((layout->dynamic->itemCount)(), 0);
+    rowsOfButtons = (buttonCount + columnsOfButtons - 1) / columnsOfButtons;
+  }
+
+  if (rowsOfButtons < 1)
+    rowsOfButtons = 1;
+
+  layout->buttonCount = buttonCount;
+
+  layout->columns = columnsOfButtons;
+  layout->rows = rowsOfButtons;
 
   //
   // determine the width of the buttons
   //
   int paddingOnTheSidesOfButtons = 10;
   int paddingBetweenButtons = 10;
-  *buttonWidth = (displaySpaceWidth - (paddingOnTheSidesOfButtons*2) - (paddingBetweenButtons*(columnsOfButtons-1))) / columnsOfButtons;
-  paddingOnTheSidesOfButtons = (displaySpaceWidth - (*buttonWidth * columnsOfButtons) - (paddingBetweenButtons*(columnsOfButtons-1))) / 2;
+  int buttonWidth = (displaySpaceWidth - (paddingOnTheSidesOfButtons*2) - (paddingBetweenButtons*(columnsOfButtons-1))) / columnsOfButtons;
 
   //
   // determine the height of the buttons
   //
   int paddingOnTopAndBottomOfButtons = 10;
-  *buttonHeight = (displaySpaceHeight - (paddingOnTopAndBottomOfButtons*2) - (paddingBetweenButtons*(rowsOfButtons-1))) / rowsOfButtons;
-  paddingOnTopAndBottomOfButtons = (displaySpaceHeight - (*buttonHeight * rowsOfButtons) - (paddingBetweenButtons*(rowsOfButtons-1))) / 2;
+  int buttonHeight = (displaySpaceHeight - (paddingOnTopAndBottomOfButtons*2) - (paddingBetweenButtons*(rowsOfButtons-1))) / rowsOfButtons;
 
   //
-  // determine the row and column of this button
+  // when scrolling is enabled, menus whose buttons would be too short scroll instead
   //
-  int buttonRow = menuButtonNumber / columnsOfButtons;
-  int buttonColumn = menuButtonNumber - (buttonRow * columnsOfButtons);
+  layout->scrollFlg = (menuScrollButtonHeight > 0) && (buttonHeight < menuScrollButtonHeight);
+  layout->scrollY = 0;
+  layout->maxScrollY = 0;
+  if (layout->scrollFlg)
+  {
+    buttonHeight = menuScrollButtonHeight;
+    int contentHeight = (paddingOnTopAndBottomOfButtons*2) + (buttonHeight * rowsOfButtons) + (paddingBetweenButtons*(rowsOfButtons-1));
+    layout->maxScrollY = max(contentHeight - displaySpaceHeight, 0);
+    layout->scrollY = min(previousScrollY, layout->maxScrollY);
+  }
+  else
+    paddingOnTopAndBottomOfButtons = (displaySpaceHeight - (buttonHeight * rowsOfButtons) - (paddingBetweenButtons*(rowsOfButtons-1))) / 2;
+
+  layout->buttonWidth = buttonWidth;
+  layout->buttonHeight = buttonHeight;
+  layout->spacing = paddingBetweenButtons;
+  layout->topY = displaySpaceTopY + paddingOnTopAndBottomOfButtons;
 
   //
-  // determine the XY coords of the button's upper left corner
+  // determine the X coord of the left most button on full rows, and on the last row 
+  // which can have fewer buttons
   //
-  if ((buttonRow != rowsOfButtons - 1) || (buttonCount % columnsOfButtons == 0))
-    buttonCountOnThisRow = columnsOfButtons;
+  layout->leftX = displaySpaceLeftX + (displaySpaceWidth - (buttonWidth * columnsOfButtons) - (paddingBetweenButtons*(columnsOfButtons-1))) / 2;
+
+  if (buttonCount % columnsOfButtons == 0)
+    layout->lastRowButtonCount = columnsOfButtons;
   else
-    buttonCountOnThisRow = buttonCount % columnsOfButtons;
+    layout->lastRowButtonCount = buttonCount % columnsOfButtons;
 
-  int leftMostButtonX = displaySpaceLeftX + (displaySpaceWidth - (*buttonWidth * buttonCountOnThisRow) - (paddingBetweenButtons*(buttonCountOnThisRow-1))) / 2;
-  
-  *buttonX = leftMostButtonX + (*buttonWidth + paddingBetweenButtons) * buttonColumn;
-  *buttonY = displaySpaceTopY + paddingOnTopAndBottomOfButtons + (*buttonHeight + paddingBetweenButtons) * buttonRow;
+  layout->lastRowLeftX = displaySpaceLeftX + (displaySpaceWidth - (buttonWidth * layout->lastRowButtonCount) - (paddingBetweenButtons*(layout->lastRowButtonCount-1))) / 2;
+}
+
+
+// ---------------------------------------------------------------------------------
+//                              Menu snapshot functions
+// ---------------------------------------------------------------------------------
+
+//
+// When a menu command draws its own screen, the menu must be drawn again when the
+// command returns.  With the snapshot cache enabled, the menu's screen is copied into
+// RAM before the command runs, compressed as runs of the same color.  When the command
+// returns, the copy is sent back to the display in one batch, as long as nothing the
+// menu shows has changed: the menu, its scroll position, colors, fonts, and the text 
+// on each button (including the toggles) are checked first.  Otherwise the menu is 
+// drawn as usual.  A typical menu compresses to a few thousand bytes.  The copy is 
+// only made while the framebuffer is enabled, reading the screen back from the LCD 
+// over SPI takes longer than drawing the menu again.
+//
+
+//
+// set the memory used to keep a copy of the menu's screen while a command runs
+//  Enter:  budgetBytes = most bytes of memory the copy may use, 0 to disable the cache
+//            (the default), a menu whose copy doesn't fit is drawn as usual, the 
+//            cache is only used while the framebuffer is enabled
+//          snapshotMemory -> budgetBytes of memory for the copy (such as external PSRAM), 
+//            or NULL to allocate it from the heap
+//  Exit:   true returned on success, false if the memory couldn't be allocated
+//
+boolean TeensyUserInterface::setMenuSnapshotCache(long budgetBytes, void *snapshotMemory)
+{
+  if (menuSnapshotAllocatedFlg)
+    free(menuSnapshot);
+  free(menuSnapshotRow);
+  menuSnapshot = NULL;
+  menuSnapshotRow = NULL;
+  menuSnapshotAllocatedFlg = false;
+  menuSnapshotValidFlg = false;
+  menuSnapshotLength = 0;
+  menuSnapshotBudget = 0;
+
+  if (budgetBytes <= 0)
+    return(true);
+
+  //
+  // a row of pixels is read and written at a time, so a row buffer is needed as well
+  //
+  menuSnapshotRow = (uint16_t *) malloc(max(lcdWidth, lcdHeight) * sizeof(uint16_t));
+  if (menuSnapshotRow == NULL)
+    return(false);
+
+  if (snapshotMemory == NULL)
+  {
+    snapshotMemory = malloc(budgetBytes);
+    if (snapshotMemory == NULL)
+    {
+      free(menuSnapshotRow);
+      menuSnapshotRow = NULL;
+      return(false);
+    }
+    menuSnapshotAllocatedFlg = true;
+  }
+
+  menuSnapshot = (uint16_t *) snapshotMemory;
+  menuSnapshotBudget = budgetBytes;
+  return(true);
+}
+
+
+
+//
+// get the number of times the menu was put back from the snapshot cache, and the 
+// number of times it had to be drawn
+//  Enter:  hits -> storage to return the number of menus put back from the cache
+//          misses -> storage to return the number of menus drawn because the copy 
+//            didn't fit or the menu had changed
+//          bytesUsed -> storage to return the size of the copy now in the cache
+//
+void TeensyUserInterface::getMenuSnapshotStatistics(unsigned long *hits, unsigned long *misses, long *bytesUsed)
+{
+  *hits = menuSnapshotHits;
+  *misses = menuSnapshotMisses;
+  *bytesUsed = menuSnapshotValidFlg ? menuSnapshotLength * (long) sizeof(uint16_t) : 0;
+}
+
+
+
+//
+// clear the snapshot cache statistics
+//
+void TeensyUserInterface::clearMenuSnapshotStatistics(void)
+{
+  menuSnapshotHits = 0;
+  menuSnapshotMisses = 0;
+}
+
+
+
+//
+// copy the menu's screen into the snapshot cache, the copy is a list of runs, each 
+// a count and a color, in the order the pixels are on the screen
+//
+void TeensyUserInterface::captureMenuSnapshot(void)
+{
+  if (menuSnapshot == NULL)
+    return;
+
+  //
+  // only a menu that's on the screen untouched is copied, and only from the framebuffer
+  //
+  if ((lcdDrawCount != menuScreenDrawCount) || (displayListDepth > 0) || (framebuffer == NULL))
+  {
+    menuSnapshotValidFlg = false;
+    return;
+  }
+
+  //
+  // the copy already made of this menu can be used again
+  //
+  uint32_t signature = getMenuSignature();
+  if (menuSnapshotValidFlg && (signature == menuSnapshotSignature))
+    return;
+
+  menuSnapshotValidFlg = false;
+  long maxLength = menuSnapshotBudget / (long) sizeof(uint16_t);
+  long length = 0;
+  uint16_t runColor = 0;
+  long runCount = 0;
+
+  for (int y = 0; y < lcdHeight; y++)
+  {
+    int memoryY;
+    mapRowsToMemory(y, y, &memoryY);
+    const uint16_t *row = framebuffer + (memoryY * lcdWidth);
+
+    for (int x = 0; x < lcdWidth; x++)
+    {
+      if ((runCount > 0) && (row[x] == runColor) && (runCount < 65535))
+      {
+        runCount++;
+        continue;
+      }
+
+      if (runCount > 0)
+      {
+        if (length + 2 > maxLength)
+          return;
+        menuSnapshot[length++] = runCount;
+        menuSnapshot[length++] = runColor;
+      }
+      runColor = row[x];
+      runCount = 1;
+    }
+  }
+
+  if (length + 2 > maxLength)
+    return;
+  menuSnapshot[length++] = runCount;
+  menuSnapshot[length++] = runColor;
+
+  menuSnapshotLength = length;
+  menuSnapshotSignature = signature;
+  menuSnapshotValidFlg = true;
+}
+
+
+
+//
+// put the menu's screen back from the snapshot cache
+//  Exit:   true returned if the menu was put back, false if it must be drawn
+//
+boolean TeensyUserInterface::restoreMenuSnapshot(void)
+{
+  if (menuSnapshot == NULL)
+    return(false);
+
+  if (!menuSnapshotValidFlg || (displayListDepth > 0) || (getMenuSignature() != menuSnapshotSignature))
+  {
+    menuSnapshotMisses++;
+    return(false);
+  }
+  menuSnapshotHits++;
+
+  //
+  // send the rows in one batch
+  //
+  menuDrawingDepth++;
+  lcdBeginBatch();
+
+  long idx = 0;
+  uint16_t runCount = 0;
+  uint16_t runColor = 0;
+  for (int y = 0; y < lcdHeight; y++)
+  {
+    int x = 0;
+    while (x < lcdWidth)
+    {
+      if (runCount == 0)
+      {
+        runCount = menuSnapshot[idx++];
+        runColor = menuSnapshot[idx++];
+      }
+      int count = min((int) runCount, lcdWidth - x);
+      runCount -= count;
+      while (count-- > 0)
+        menuSnapshotRow[x++] = runColor;
+    }
+    lcdDrawImage(0, y, lcdWidth, 1, menuSnapshotRow);
+  }
+
+  lcdEndBatch();
+  menuDrawingDepth--;
+  menuScreenDrawCount = lcdDrawCount;
+  return(true);
+}
+
+
+
+//
+// add data to a menu's signature
+//  Enter:  signature = signature so far
+//          data -> data to add
+//          length = number of bytes to add
+//  Exit:   new signature returned
+//
+static uint32_t addToMenuSignature(uint32_t signature, const void *data, int length)
+{
+  const byte *p = (const byte *) data;
+  for (int i = 0; i < length; i++)
+    signature = (signature ^ p[i]) * 16777619UL;
+  return(signature);
+}
+
+
+
+//
+// get a signature of everything that's shown on the current menu, if the signature 
+// is the same the menu looks the same
+//  Exit:   FNV-1a hash of the menu's appearance returned
+//
+uint32_t TeensyUserInterface::getMenuSignature(void)
+{
+  MENU_LAYOUT *layout = getMenuLayout();
+  uint32_t signature = 2166136261UL;
+
+  //
+  // the menu, where its buttons are, and its colors and fonts
+  //
+  int values[] = {currentOrientation, lcdWidth, lcdHeight, layout->buttonCount, layout->columns, 
+    layout->buttonWidth, layout->buttonHeight, layout->topY, layout->leftX, layout->scrollY, 
+    buttonTypeOnTitleBar};
+  signature = addToMenuSignature(signature, values, sizeof(values));
+
+  uint16_t colors[] = {titleBarColor, titleBarTextColor, titleBarBackButtonColor, titleBarBackButtonSelectedColor, 
+    menuBackgroundColor, menuButtonColor, menuButtonSelectedColor, menuButtonFrameColor, menuButtonTextColor};
+  signature = addToMenuSignature(signature, colors, sizeof(colors));
+
+  const void *pointers[] = {currentMenuTable, titleBarFont, menuButtonFont};
+  signature = addToMenuSignature(signature, pointers, sizeof(pointers));
+
+  const char *titleText = currentMenuTable[0].MenuItemText;
+  signature = addToMenuSignature(signature, titleText, strlen(titleText));
+
+  //
+  // the text on each button showing, dynamic menus and toggles are asked for theirs
+  //
+  MENU_ITEM savedDynamicMenuItem = dynamicMenuItem;
+  int savedDynamicMenuItemIndex = dynamicMenuItemIndex;
+  int firstMenuIdx;
+  int lastMenuIdx;
+  getVisibleMenuButtons(&firstMenuIdx, &lastMenuIdx);
+
+  for (int menuIdx = firstMenuIdx; menuIdx <= lastMenuIdx; menuIdx++)
+  {
+    MENU_ITEM *menuItem = getMenuItem(menuIdx);
+    const char *labelText = menuItem->MenuItemText;
+    signature = addToMenuSignature(signature, &menuItem->MenuItemType, sizeof(menuItem->MenuItemType));
+    signature = addToMenuSignature(signature, labelText, strlen(labelText) + 1);
+
+    if (menuItem->MenuItemType == MENU_ITEM_TYPE_TOGGLE)
+    {
+      toggleSelectNextStateFlg = false;
+      (menuItem->MenuItemFunction)();
+      labelText = toggleText;
+    }
+    else if (menuItem->MenuItemType == MENU_ITEM_TYPE_TOGGLE_STATE)
+      labelText = getToggleLabel(menuItem);
+    else
+      continue;
+    signature = addToMenuSignature(signature, labelText, strlen(labelText) + 1);
+  }
+
+  dynamicMenuItem = savedDynamicMenuItem;
+  dynamicMenuItemIndex = savedDynamicMenuItemIndex;
+  return(signature);
 }
 
 
@@ -769,6 +2175,11 @@ void TeensyUserInterface::setTitleBarColors(uint16_t _titleBarColor, uint16_t _t
     titleBarTextColor = _titleBarTextColor;
     titleBarBackButtonColor = _titleBarBackButtonColor;
     titleBarBackButtonSelectedColor = _titleBarBackButtonSelectedColor;
+
+    //
+    // the menu on the screen is drawn in full next time, in the new colors
+    //
+    menuOnScreenFlg = false;
 }
 
 
@@ -782,6 +2193,11 @@ void TeensyUserInterface::setTitleBarColors(uint16_t _titleBarColor, uint16_t _t
 void TeensyUserInterface::setTitleBarFont(const ui_font &font)
 {
   titleBarFont = &font;
+
+  //
+  // the menu on the screen is drawn in full next time, in the new font
+  //
+  menuOnScreenFlg = false;
 }
 
 
@@ -1147,6 +2563,13 @@ void TeensyUserInterface::clearDisplaySpace(void)
 //
 void TeensyUserInterface::clearDisplaySpace(uint16_t backgroundColor)
 {  
+  //
+  // undo any scrolling since the whole space is redrawn, the widgets that were 
+  // showing are gone
+  //
+  resetDisplaySpaceScroll();
+  clearTouchRegions();
+
   //
   // draw the frame
   //
@@ -1161,62 +2584,213 @@ void TeensyUserInterface::clearDisplaySpace(uint16_t backgroundColor)
 }
 
 
-// ---------------------------------------------------------------------------------
-//                                  Button functions  
-// ---------------------------------------------------------------------------------
 
 //
-// draw a rectangular button using the colors and font defined for the menu
-//  Enter:  uiButton -> the specifications for the button to draw
+// scroll the contents of the display space up or down using the menu's background 
+// color for the rows uncovered
+//  Enter:  rows = number of rows to scroll, positive moves the contents up
+//  Exit:   true returned on success, false if scrolling isn't possible
 //
-void TeensyUserInterface::drawButton(BUTTON &uiButton)
+boolean TeensyUserInterface::scrollDisplaySpace(int rows)
 {
-  int buttonX = uiButton.centerX - uiButton.width/2;
-  if (buttonX < 0) buttonX = 0;
-  int buttonY = uiButton.centerY - uiButton.height/2;
-  if (buttonY < 0) buttonY = 0;
-  
-  drawButton(uiButton.labelText, buttonX, buttonY, uiButton.width, uiButton.height, menuButtonColor, 
-    menuButtonFrameColor, menuButtonTextColor, *menuButtonFont);
+  return(scrollDisplaySpace(rows, menuBackgroundColor));
 }
 
-//
-// draw a rectangular button using the colors and font defined for the menu
-//  Enter:  uiButton -> the specifications for the button to draw
-//          showButtonTouchedFlg = true to draw button showing it's being touched, false to draw normal
-//
-void TeensyUserInterface::drawButton(BUTTON &uiButton, boolean showButtonTouchedFlg)
-{
-  uint16_t buttonColor;
 
-  int buttonX = uiButton.centerX - uiButton.width/2;
-  if (buttonX < 0) buttonX = 0;
-  int buttonY = uiButton.centerY - uiButton.height/2;
-  if (buttonY < 0) buttonY = 0;
-
-  if (showButtonTouchedFlg)
-    buttonColor = menuButtonSelectedColor;
-  else
-    buttonColor = menuButtonColor;
-  
-  drawButton(uiButton.labelText, buttonX, buttonY, uiButton.width, uiButton.height, buttonColor, 
-    menuButtonFrameColor, menuButtonTextColor, *menuButtonFont);
-}
 
 //
-// draw a rectangular button with extended options for setting color and font
-//  Enter:  uiButton -> the specifications for the button to draw
+// scroll the contents of the display space up or down, the rows uncovered are filled 
+// with the background color and can then be drawn on, in portrait orientations the 
+// LCD's hardware scrolling is used so nothing else is redrawn, in landscape the 
+// framebuffer is needed
+//  Enter:  rows = number of rows to scroll, positive moves the contents up
+//          backgroundColor = color to fill the rows uncovered
+//  Exit:   true returned on success, false if scrolling isn't possible
 //
-void TeensyUserInterface::drawButton(BUTTON_EXTENDED &uiButtonExt)
+boolean TeensyUserInterface::scrollDisplaySpace(int rows, uint16_t backgroundColor)
 {
-  int buttonX = uiButtonExt.centerX - uiButtonExt.width/2;
-  if (buttonX < 0) buttonX = 0;
-  int buttonY = uiButtonExt.centerY - uiButtonExt.height/2;
-  if (buttonY < 0) buttonY = 0;
-  
-  drawButton(uiButtonExt.labelText, buttonX, buttonY, uiButtonExt.width, uiButtonExt.height, 
-    uiButtonExt.buttonColor, uiButtonExt.buttonFrameColor, uiButtonExt.buttonTextColor, uiButtonExt.buttonFont);
-}
+  boolean portraitFlg = (currentOrientation == LCD_ORIENTATION_PORTRAIT_4PIN_TOP) || 
+    (currentOrientation == LCD_ORIENTATION_PORTRAIT_4PIN_BOTTOM);
+
+  if (rows == 0)
+    return(true);
+
+  //
+  // scrolling the whole space, or more, leaves nothing to keep
+  //
+  if (abs(rows) >= displaySpaceHeight)
+  {
+    lcdDrawFilledRectangle(displaySpaceLeftX, displaySpaceTopY, displaySpaceWidth, displaySpaceHeight, backgroundColor);
+    return(true);
+  }
+
+  if (!portraitFlg && (framebuffer == NULL))
+    return(false);
+
+  //
+  // draw anything recorded so far, since it belongs at the old scroll position
+  //
+  if ((displayListDepth > 0) && (displayList != NULL))
+  {
+    compileDisplayList();
+    playDisplayList();
+  }
+
+  if (portraitFlg)
+  {
+    //
+    // rotate the display space's rows with the LCD's scroll start address
+    //
+    scrollOffset = (scrollOffset + rows) % displaySpaceHeight;
+    if (scrollOffset < 0)
+      scrollOffset += displaySpaceHeight;
+    setHardwareScroll();
+  }
+  else
+  {
+    //
+    // move the rows in the framebuffer, the rows that changed are sent on the next flush
+    //
+    int firstY = (rows > 0) ? displaySpaceTopY : displaySpaceBottomY;
+    int step = (rows > 0) ? 1 : -1;
+    for (int y = firstY; (y - firstY) * step < displaySpaceHeight - abs(rows); y += step)
+      memcpy(framebuffer + (y * lcdWidth), framebuffer + ((y + rows) * lcdWidth), lcdWidth * sizeof(uint16_t));
+    addDirtyRect(0, displaySpaceTopY, lcdWidth - 1, displaySpaceBottomY);
+  }
+
+  //
+  // blank the rows uncovered
+  //
+  if (rows > 0)
+    lcdDrawFilledRectangle(displaySpaceLeftX, displaySpaceBottomY - rows + 1, displaySpaceWidth, rows, backgroundColor);
+  else
+    lcdDrawFilledRectangle(displaySpaceLeftX, displaySpaceTopY, displaySpaceWidth, -rows, backgroundColor);
+  return(true);
+}
+
+
+
+//
+// put the display space back to its unscrolled position, its contents are left 
+// scrambled so it should be redrawn
+//
+void TeensyUserInterface::resetDisplaySpaceScroll(void)
+{
+  if (scrollOffset == 0)
+    return;
+
+  if ((displayListDepth > 0) && (displayList != NULL))
+  {
+    compileDisplayList();
+    playDisplayList();
+  }
+
+  scrollOffset = 0;
+  setHardwareScroll();
+}
+
+
+
+//
+// set the LCD's vertical scrolling registers so the display space is shown rotated by 
+// scrollOffset rows
+//
+void TeensyUserInterface::setHardwareScroll(void)
+{
+  int topFixedRows = 0;
+  int scrollingRows = ILI9341_TFTHEIGHT;
+  int bottomFixedRows = 0;
+  int startRow = 0;
+
+  //
+  // the LCD scrolls in the order of its memory, which is upside down when the pins 
+  // are at the bottom
+  //
+  if (scrollOffset != 0)
+  {
+    scrollingRows = displaySpaceHeight;
+    if (currentOrientation == LCD_ORIENTATION_PORTRAIT_4PIN_TOP)
+    {
+      topFixedRows = displaySpaceTopY;
+      bottomFixedRows = ILI9341_TFTHEIGHT - displaySpaceBottomY - 1;
+      startRow = topFixedRows + scrollOffset;
+    }
+    else
+    {
+      topFixedRows = ILI9341_TFTHEIGHT - displaySpaceBottomY - 1;
+      bottomFixedRows = displaySpaceTopY;
+      startRow = topFixedRows + (displaySpaceHeight - scrollOffset);
+    }
+  }
+
+  sendPendingSpan();
+  lcd->setVerticalScrollInTransaction(topFixedRows, scrollingRows, bottomFixedRows, startRow);
+  finishSpans();
+}
+
+
+// ---------------------------------------------------------------------------------
+//                                  Button functions  
+// ---------------------------------------------------------------------------------
+
+//
+// draw a rectangular button using the colors and font defined for the menu
+//  Enter:  uiButton -> the specifications for the button to draw
+//
+void TeensyUserInterface::drawButton(BUTTON &uiButton)
+{
+  int buttonX = uiButton.centerX - uiButton.width/2;
+  if (buttonX < 0) buttonX = 0;
+  int buttonY = uiButton.centerY - uiButton.height/2;
+  if (buttonY < 0) buttonY = 0;
+  
+  drawButton(uiButton.labelText, buttonX, buttonY, uiButton.width, uiButton.height, menuButtonColor, 
+    menuButtonFrameColor, menuButtonTextColor, *menuButtonFont);
+  registerTouchRegion(&uiButton, uiButton.centerX - uiButton.width/2, uiButton.centerY - uiButton.height/2, 
+    uiButton.centerX - uiButton.width/2 + uiButton.width - 1, uiButton.centerY - uiButton.height/2 + uiButton.height - 1);
+}
+
+//
+// draw a rectangular button using the colors and font defined for the menu
+//  Enter:  uiButton -> the specifications for the button to draw
+//          showButtonTouchedFlg = true to draw button showing it's being touched, false to draw normal
+//
+void TeensyUserInterface::drawButton(BUTTON &uiButton, boolean showButtonTouchedFlg)
+{
+  uint16_t buttonColor;
+
+  int buttonX = uiButton.centerX - uiButton.width/2;
+  if (buttonX < 0) buttonX = 0;
+  int buttonY = uiButton.centerY - uiButton.height/2;
+  if (buttonY < 0) buttonY = 0;
+
+  if (showButtonTouchedFlg)
+    buttonColor = menuButtonSelectedColor;
+  else
+    buttonColor = menuButtonColor;
+  
+  drawButton(uiButton.labelText, buttonX, buttonY, uiButton.width, uiButton.height, buttonColor, 
+    menuButtonFrameColor, menuButtonTextColor, *menuButtonFont);
+  registerTouchRegion(&uiButton, uiButton.centerX - uiButton.width/2, uiButton.centerY - uiButton.height/2, 
+    uiButton.centerX - uiButton.width/2 + uiButton.width - 1, uiButton.centerY - uiButton.height/2 + uiButton.height - 1);
+}
+
+//
+// draw a rectangular button with extended options for setting color and font
+//  Enter:  uiButton -> the specifications for the button to draw
+//
+void TeensyUserInterface::drawButton(BUTTON_EXTENDED &uiButtonExt)
+{
+  int buttonX = uiButtonExt.centerX - uiButtonExt.width/2;
+  if (buttonX < 0) buttonX = 0;
+  int buttonY = uiButtonExt.centerY - uiButtonExt.height/2;
+  if (buttonY < 0) buttonY = 0;
+  
+  drawButton(uiButtonExt.labelText, buttonX, buttonY, uiButtonExt.width, uiButtonExt.height, 
+    uiButtonExt.buttonColor, uiButtonExt.buttonFrameColor, uiButtonExt.buttonTextColor, uiButtonExt.buttonFont);
+  registerTouchRegion(&uiButtonExt, uiButtonExt.centerX - uiButtonExt.width/2, uiButtonExt.centerY - uiButtonExt.height/2, 
+    uiButtonExt.centerX - uiButtonExt.width/2 + uiButtonExt.width - 1, uiButtonExt.centerY - uiButtonExt.height/2 + uiButtonExt.height - 1);
+}
 
 //
 // draw a rectangular button with extended options for setting color and font
@@ -1239,6 +2813,8 @@ void TeensyUserInterface::drawButton(BUTTON_EXTENDED &uiButtonExt, boolean showB
   
   drawButton(uiButtonExt.labelText, buttonX, buttonY, uiButtonExt.width, uiButtonExt.height, 
     buttonColor, uiButtonExt.buttonFrameColor, uiButtonExt.buttonTextColor, uiButtonExt.buttonFont);
+  registerTouchRegion(&uiButtonExt, uiButtonExt.centerX - uiButtonExt.width/2, uiButtonExt.centerY - uiButtonExt.height/2, 
+    uiButtonExt.centerX - uiButtonExt.width/2 + uiButtonExt.width - 1, uiButtonExt.centerY - uiButtonExt.height/2 + uiButtonExt.height - 1);
 }
 
 //
@@ -1297,9 +2873,29 @@ void TeensyUserInterface::drawButton(const char *labelText, int buttonX, int but
   //
   // break the button's text into 1 or 2 lines insuring that the text fits on the button
   //
+  lcdSetFont(buttonFont);
   maxTextWidthInPixels = buttonWidth - 8;
   lineCount = 1;
 
+  //
+  // most labels fit on one line, measure the whole label first so they don't need 
+  // breaking, the widths of menu labels are remembered since they never change
+  //
+  if (labelText == constantLabelText)
+    textWidthInPixels = constantStringWidthInPixels(labelText);
+  else
+    textWidthInPixels = lcdStringWidthInPixels(labelText);
+
+  if ((textWidthInPixels <= maxTextWidthInPixels) && (strlen(labelText) < buttonTextBufferLength))
+  {
+    lcdSetFontColor(buttonTextColor);
+    lcdPushClipRect(buttonX + 1, buttonY + 1, buttonWidth - 1, buttonHeight - 1);
+    lcdSetCursorXY(buttonX + buttonWidth/2, buttonY + (buttonHeight / 2) - (lcdGetFontHeightWithoutDecenders()/2));  
+    lcdPrintCentered(labelText);
+    lcdPopClipRect();
+    return;
+  }
+
   //
   // find the first line
   //
@@ -1347,10 +2943,11 @@ void TeensyUserInterface::drawButton(const char *labelText, int buttonX, int but
 
 
   //
-  // draw the text on the button, either 1 line or two
+  // draw the text on the button, either 1 line or two, text too long for the button 
+  // is clipped to its face
   //
-  lcdSetFont(buttonFont);
   lcdSetFontColor(buttonTextColor);
+  lcdPushClipRect(buttonX + 1, buttonY + 1, buttonWidth - 1, buttonHeight - 1);
 
   if (lineCount == 1)
   {
@@ -1366,6 +2963,8 @@ void TeensyUserInterface::drawButton(const char *labelText, int buttonX, int but
     lcdSetCursorXY(buttonX + buttonWidth/2, buttonY + (buttonHeight / 2) + 2);  
     lcdPrintCentered(buttonTextLine2);
   }
+
+  lcdPopClipRect();
 }
 
 
@@ -1428,6 +3027,12 @@ boolean TeensyUserInterface::checkForButtonClicked(BUTTON &uiButton)
   int Y1 = uiButton.centerY - uiButton.height/2;
   int X2 = X1 + uiButton.width - 1;
   int Y2 = Y1 + uiButton.height - 1;
+
+  //
+  // return if the event is on another widget
+  //
+  if (!touchEventMayHit(&uiButton, X1, Y1, X2, Y2))
+    return(false);
   
   //
   // check if most recent event was: this button "PUSHED"
@@ -1472,6 +3077,12 @@ boolean TeensyUserInterface::checkForButtonClicked(BUTTON_EXTENDED &uiButton)
   int Y1 = uiButton.centerY - uiButton.height/2;
   int X2 = X1 + uiButton.width - 1;
   int Y2 = Y1 + uiButton.height - 1;
+
+  //
+  // return if the event is on another widget
+  //
+  if (!touchEventMayHit(&uiButton, X1, Y1, X2, Y2))
+    return(false);
   
   //
   // check if most recent event was: this button "PUSHED"
@@ -1517,6 +3128,12 @@ boolean TeensyUserInterface::checkForButtonAutoRepeat(BUTTON &uiButton)
   int Y1 = uiButton.centerY - uiButton.height/2;
   int X2 = X1 + uiButton.width - 1;
   int Y2 = Y1 + uiButton.height - 1;
+
+  //
+  // return if the event is on another widget
+  //
+  if (!touchEventMayHit(&uiButton, X1, Y1, X2, Y2))
+    return(false);
   
   //
   // check if most recent event was: this button "PUSHED"
@@ -1566,6 +3183,12 @@ boolean TeensyUserInterface::checkForButtonAutoRepeat(BUTTON_EXTENDED &uiButton)
   int Y1 = uiButton.centerY - uiButton.height/2;
   int X2 = X1 + uiButton.width - 1;
   int Y2 = Y1 + uiButton.height - 1;
+
+  //
+  // return if the event is on another widget
+  //
+  if (!touchEventMayHit(&uiButton, X1, Y1, X2, Y2))
+    return(false);
   
   //
   // check if most recent event was: this button "PUSHED"
@@ -1618,6 +3241,12 @@ boolean TeensyUserInterface::checkForButtonFirstTouched(BUTTON &uiButton)
   int Y1 = uiButton.centerY - uiButton.height/2;
   int X2 = X1 + uiButton.width - 1;
   int Y2 = Y1 + uiButton.height - 1;
+
+  //
+  // return if the event is on another widget
+  //
+  if (!touchEventMayHit(&uiButton, X1, Y1, X2, Y2))
+    return(false);
   
   //
   // check if most recent event was: this button "PUSHED"
@@ -1655,6 +3284,12 @@ boolean TeensyUserInterface::checkForButtonFirstTouched(BUTTON_EXTENDED &uiButto
   int Y1 = uiButton.centerY - uiButton.height/2;
   int X2 = X1 + uiButton.width - 1;
   int Y2 = Y1 + uiButton.height - 1;
+
+  //
+  // return if the event is on another widget
+  //
+  if (!touchEventMayHit(&uiButton, X1, Y1, X2, Y2))
+    return(false);
   
   //
   // check if most recent event was: this button "PUSHED"
@@ -1694,6 +3329,7 @@ void TeensyUserInterface::drawNumberBox(NUMBER_BOX &numberBox)
   // get the coordinates of this Number Box
   //
   getNumberBoxCoordinates(numberBox, &downButtonX, &numberX, &upButtonX, &topY, &buttonWidth, &numberWidth, &height);
+  registerTouchRegion(&numberBox, upButtonX, topY, downButtonX + buttonWidth - 1, topY + height - 1);
 
   //
   // the frame of the Number Box
@@ -1741,9 +3377,11 @@ void TeensyUserInterface::drawNumberBox(NUMBER_BOX &numberBox)
 // check if user is touching the Number Box, pressing Up or Down
 // Note: getTouchEvents() must be called at the top of the loop that calls this function
 //  Enter:  numberBox -> the Number Box to check
+//          numberBoxTouchTiming -> touch timing for this Number Box, used while it's 
+//            touched, NULL (the default) to use the screen's
 //  Exit:   true returned if the Number Box's Value changed
 //
-boolean TeensyUserInterface::checkForNumberBoxTouched(NUMBER_BOX &numberBox)
+boolean TeensyUserInterface::checkForNumberBoxTouched(NUMBER_BOX &numberBox, const TOUCH_TIMING *numberBoxTouchTiming)
 {
   int downButtonX;
   int numberX;
@@ -1760,9 +3398,15 @@ boolean TeensyUserInterface::checkForNumberBoxTouched(NUMBER_BOX &numberBox)
     return(false);
 
   //
-  // get the coordinates of the DOWN button
+  // return if the event is on another widget
   //
   getNumberBoxCoordinates(numberBox, &downButtonX, &numberX, &upButtonX, &topY, &buttonWidth, &numberWidth, &height);
+  if (!touchEventMayHit(&numberBox, upButtonX, topY, downButtonX + buttonWidth - 1, topY + height - 1))
+    return(false);
+
+  //
+  // get the coordinates of the DOWN button
+  //
   int X1 = downButtonX;
   int Y1 = topY;
   int X2 = downButtonX + buttonWidth - 1;
@@ -1775,7 +3419,7 @@ boolean TeensyUserInterface::checkForNumberBoxTouched(NUMBER_BOX &numberBox)
   {
     drawDownButtonInNumberBox(numberBox, true);
     updateNumberBoxNumber(numberBox, -numberBox.stepAmount);
-    numberBoxRepeatCount = 0;
+    startNumberBoxRepeat(numberBoxTouchTiming);
     return(true);
   }
   
@@ -1784,8 +3428,7 @@ boolean TeensyUserInterface::checkForNumberBoxTouched(NUMBER_BOX &numberBox)
   //
   if (checkForTouchEventInRect(TOUCH_REPEAT_EVENT, X1, Y1, X2, Y2))
   {
-    numberBoxRepeatCount++;
-    int stepSize = numberBox.stepAmount * ((numberBoxRepeatCount / 16) + 1);
+    int64_t stepSize = (int64_t) numberBox.stepAmount * getNumberBoxRepeatStep();
     updateNumberBoxNumber(numberBox, -stepSize);
     return(true);
   }
@@ -1813,7 +3456,7 @@ boolean TeensyUserInterface::checkForNumberBoxTouched(NUMBER_BOX &numberBox)
   {
     drawUpButtonInNumberBox(numberBox, true);
     updateNumberBoxNumber(numberBox, numberBox.stepAmount);
-    numberBoxRepeatCount = 0;
+    startNumberBoxRepeat(numberBoxTouchTiming);
     return(true);
   }
   
@@ -1822,8 +3465,7 @@ boolean TeensyUserInterface::checkForNumberBoxTouched(NUMBER_BOX &numberBox)
   //
   if (checkForTouchEventInRect(TOUCH_REPEAT_EVENT, X1, Y1, X2, Y2))
   {
-    numberBoxRepeatCount++;
-    int stepSize = numberBox.stepAmount * ((numberBoxRepeatCount / 16) + 1);
+    int64_t stepSize = (int64_t) numberBox.stepAmount * getNumberBoxRepeatStep();
     updateNumberBoxNumber(numberBox, stepSize);
     return(true);
   }
@@ -1928,19 +3570,86 @@ void TeensyUserInterface::drawUpButtonInNumberBox(NUMBER_BOX &numberBox, boolean
 
 
 //
-// update the Number Box's Value
+// most a Number Box's step can grow to with no maximumStep, this keeps it from overflowing
+//
+const long NUMBER_BOX_STEP_LIMIT = 1000000;
+
+
+//
+// start auto repeating a Number Box's Up or Down button, the step starts at the 
+// Number Box's stepAmount
+//  Enter:  timing -> the Number Box's own touch timing, used for the rest of this 
+//            touch, NULL to use the screen's
+//
+void TeensyUserInterface::startNumberBoxRepeat(const TOUCH_TIMING *timing)
+{
+  numberBoxRepeatCount = 0;
+  numberBoxStepFactor = 1;
+  if (timing != NULL)
+  {
+    noInterrupts();                             // sampleTouchScreen() may be reading it
+    touchActiveTiming = timing;
+    interrupts();
+  }
+}
+
+
+
+//
+// count an auto repeat of a Number Box's button, growing the step as set by the 
+// touch timing
+//  Exit:   how many of the Number Box's stepAmount to step by returned
+//
+long TeensyUserInterface::getNumberBoxRepeatStep(void)
+{
+  const TOUCH_TIMING *timing = touchActiveTiming;
+
+  numberBoxRepeatCount++;
+  if ((timing->repeatsPerStepChange <= 0) || (numberBoxRepeatCount % timing->repeatsPerStepChange != 0))
+    return(numberBoxStepFactor);
+
+  long maximumStep = NUMBER_BOX_STEP_LIMIT;
+  if ((timing->maximumStep > 0) && (timing->maximumStep < maximumStep))
+    maximumStep = timing->maximumStep;
+
+  //
+  // grow the step, checking against the maximum before multiplying or adding so a 
+  // large stepMultiplier or stepIncrease can't overflow, a stepMultiplier less than 
+  // 0 is taken as 0
+  //
+  long multiplier = max(timing->stepMultiplier, 0);
+  if ((multiplier > 0) && (numberBoxStepFactor > maximumStep / multiplier))
+    numberBoxStepFactor = maximumStep;
+  else
+  {
+    numberBoxStepFactor = numberBoxStepFactor * multiplier;
+    if (timing->stepIncrease > maximumStep - numberBoxStepFactor)
+      numberBoxStepFactor = maximumStep;
+    else
+      numberBoxStepFactor = numberBoxStepFactor + timing->stepIncrease;
+  }
+
+  numberBoxStepFactor = constrain(numberBoxStepFactor, 1, maximumStep);
+  return(numberBoxStepFactor);
+}
+
+
+
+//
+// update the Number Box's Value, the new value is worked out in 64 bits and clamped 
+// to the Number Box's range, so a large auto repeat step can't overflow
 //  Enter:  numberBox -> the specifications of the Number Box
 //          stepAmount = signed amount to changes the Value by
 //  Exit:   true returned if the value changed, else false
 //
-boolean TeensyUserInterface::updateNumberBoxNumber(NUMBER_BOX &numberBox, int stepAmount)
+boolean TeensyUserInterface::updateNumberBoxNumber(NUMBER_BOX &numberBox, int64_t stepAmount)
 {
   //
   // check if Adding
   //
   if (stepAmount > 0)
   {
-    int newValue = numberBox.value + stepAmount;
+    int64_t newValue = (int64_t) numberBox.value + stepAmount;
     if (newValue > numberBox.maximumValue)
       newValue = numberBox.maximumValue;
     if (numberBox.value == newValue)
@@ -1955,7 +3664,7 @@ boolean TeensyUserInterface::updateNumberBoxNumber(NUMBER_BOX &numberBox, int st
   //
   if (stepAmount < 0)
   {
-    int newValue = numberBox.value + stepAmount;
+    int64_t newValue = (int64_t) numberBox.value + stepAmount;
     if (newValue < numberBox.minimumValue)
       newValue = numberBox.minimumValue;
     if (numberBox.value == newValue)
@@ -1999,10 +3708,12 @@ void TeensyUserInterface::drawNumberInNumberBox(NUMBER_BOX &numberBox)
   lcdDrawFilledRectangle(numberX+3, textY, numberWidth-6, fontHeight + 1, menuBackgroundColor);
 
   //
-  // draw the number
+  // draw the number, clipped to the number field
   //
+  lcdPushClipRect(numberX + 3, topY + 1, numberWidth - 6, height - 2);
   lcdSetCursorXY(numberX + numberWidth/2, textY);
   lcdPrintCentered(numberBox.value);
+  lcdPopClipRect();
 }
 
 
@@ -2053,6 +3764,7 @@ void TeensyUserInterface::drawNumberBox(NUMBER_BOX_FLOAT &numberBox)
   //
   getNumberBoxCoordinatesFloat(numberBox, &downButtonX, &numberX, &upButtonX, &topY, 
     &buttonWidth, &numberWidth, &height);
+  registerTouchRegion(&numberBox, upButtonX, topY, downButtonX + buttonWidth - 1, topY + height - 1);
 
   //
   // the frame of the Number Box
@@ -2100,9 +3812,11 @@ void TeensyUserInterface::drawNumberBox(NUMBER_BOX_FLOAT &numberBox)
 // check if user is touching the Number Box, pressing Up or Down (FLOAT)
 // Note: getTouchEvents() must be called at the top of the loop that calls this function
 //  Enter:  numberBox -> the Number Box to check
+//          numberBoxTouchTiming -> touch timing for this Number Box, used while it's 
+//            touched, NULL (the default) to use the screen's
 //  Exit:   true returned if the Number Box's Value changed
 //
-boolean TeensyUserInterface::checkForNumberBoxTouched(NUMBER_BOX_FLOAT &numberBox)
+boolean TeensyUserInterface::checkForNumberBoxTouched(NUMBER_BOX_FLOAT &numberBox, const TOUCH_TIMING *numberBoxTouchTiming)
 {
   int downButtonX;
   int numberX;
@@ -2119,9 +3833,15 @@ boolean TeensyUserInterface::checkForNumberBoxTouched(NUMBER_BOX_FLOAT &numberBo
     return(false);
 
   //
-  // get the coordinates of the DOWN button
+  // return if the event is on another widget
   //
   getNumberBoxCoordinatesFloat(numberBox, &downButtonX, &numberX, &upButtonX, &topY, &buttonWidth, &numberWidth, &height);
+  if (!touchEventMayHit(&numberBox, upButtonX, topY, downButtonX + buttonWidth - 1, topY + height - 1))
+    return(false);
+
+  //
+  // get the coordinates of the DOWN button
+  //
   int X1 = downButtonX;
   int Y1 = topY;
   int X2 = downButtonX + buttonWidth - 1;
@@ -2134,7 +3854,7 @@ boolean TeensyUserInterface::checkForNumberBoxTouched(NUMBER_BOX_FLOAT &numberBo
   {
     drawDownButtonInNumberBoxFloat(numberBox, true);
     updateNumberBoxNumberFloat(numberBox, -numberBox.stepAmount);
-    numberBoxRepeatCount = 0;
+    startNumberBoxRepeat(numberBoxTouchTiming);
     return(true);
   }
   
@@ -2143,8 +3863,7 @@ boolean TeensyUserInterface::checkForNumberBoxTouched(NUMBER_BOX_FLOAT &numberBo
   //
   if (checkForTouchEventInRect(TOUCH_REPEAT_EVENT, X1, Y1, X2, Y2))
   {
-    numberBoxRepeatCount++;
-    float stepSize = numberBox.stepAmount * (float)((numberBoxRepeatCount / 16) + 1);
+    float stepSize = numberBox.stepAmount * (float) getNumberBoxRepeatStep();
     updateNumberBoxNumberFloat(numberBox, -stepSize);
     return(true);
   }
@@ -2172,7 +3891,7 @@ boolean TeensyUserInterface::checkForNumberBoxTouched(NUMBER_BOX_FLOAT &numberBo
   {
     drawUpButtonInNumberBoxFloat(numberBox, true);
     updateNumberBoxNumberFloat(numberBox, numberBox.stepAmount);
-    numberBoxRepeatCount = 0;
+    startNumberBoxRepeat(numberBoxTouchTiming);
     return(true);
   }
   
@@ -2181,8 +3900,7 @@ boolean TeensyUserInterface::checkForNumberBoxTouched(NUMBER_BOX_FLOAT &numberBo
   //
   if (checkForTouchEventInRect(TOUCH_REPEAT_EVENT, X1, Y1, X2, Y2))
   {
-    numberBoxRepeatCount++;
-    float stepSize = numberBox.stepAmount * (float)((numberBoxRepeatCount / 16) + 1);
+    float stepSize = numberBox.stepAmount * (float) getNumberBoxRepeatStep();
     updateNumberBoxNumberFloat(numberBox, stepSize);
     return(true);
   }
@@ -2360,11 +4078,13 @@ void TeensyUserInterface::drawNumberInNumberBoxFloat(NUMBER_BOX_FLOAT &numberBox
   lcdDrawFilledRectangle(numberX+3, textY, numberWidth-6, fontHeight + 1, menuBackgroundColor);
 
   //
-  // draw the number
+  // draw the number, clipped to the number field
   //
   dtostrf(numberBox.value, 1, numberBox.digitsRightOfDecimal, stringBuffer);
+  lcdPushClipRect(numberX + 3, topY + 1, numberWidth - 6, height - 2);
   lcdSetCursorXY(numberX + numberWidth/2, textY);
   lcdPrintCentered(stringBuffer);
+  lcdPopClipRect();
 }
 
 
@@ -2413,6 +4133,7 @@ void TeensyUserInterface::drawSelectionBox(SELECTION_BOX &selectionBox)
   //
   int numberOfCells = countSelectionBoxChoices(selectionBox);
   getCoordsOfSelectionBoxCell(selectionBox, 0, &X, &Y, &width, &height);
+  registerTouchRegion(&selectionBox, X, Y, X + (width * numberOfCells) - 1, Y + height - 1);
   
   //
   // draw a box to contain call the cells
@@ -2457,9 +4178,16 @@ boolean TeensyUserInterface::checkForSelectionBoxTouched(SELECTION_BOX &selectio
     return(false);
 
   //
-  // loop through each of the choices in the Selection BO
+  // return if the event is on another widget
   //
   int numberOfCells = countSelectionBoxChoices(selectionBox);
+  getCoordsOfSelectionBoxCell(selectionBox, 0, &X, &Y, &width, &height);
+  if (!touchEventMayHit(&selectionBox, X, Y, X + (width * numberOfCells) - 1, Y + height - 1))
+    return(false);
+
+  //
+  // loop through each of the choices in the Selection BO
+  //
   for (int cellNumber = 0; cellNumber < numberOfCells; cellNumber++)
   {
     //
@@ -2612,11 +4340,44 @@ const byte CONFIRM_TOUCH_UP_STATE                       = 4;
 
 
 //
-// delay periods for dealing with touches in milliseconds
+// touch timing used until setTouchTiming() is called: 30ms debounce, repeating after
+// 800ms then every 120ms, a Number Box's step growing by one every 16 repeats
+//
+const TOUCH_TIMING defaultTouchTiming = {30, 800, 120, 16, 1, 1, 0};
+
+
+//
+// values returned by getFilteredTouchScreenCoords()
+//
+const int TOUCH_SAMPLES_RELEASED = 0;                   // none of the last samples were firmly pressed
+const int TOUCH_SAMPLES_UNSURE   = 1;                   // some were, or they weren't steady
+const int TOUCH_SAMPLES_PRESSED  = 2;                   // all of the last samples were firmly pressed and steady
+
+
+//
+// microseconds between touch filter samples, the XPT2046 library returns the same 
+// reading for 3ms, so samples closer together add nothing
+//
+const unsigned long TOUCH_FILTER_SAMPLE_PERIOD = 3000;
+
+
+//
+// touch screen calibration
+//
+const int TOUCH_CALIBRATION_MARKER = 0x54434131;        // "TCA1", marks a saved calibration as valid
+const int TOUCH_CALIBRATION_SAMPLES = 16;               // raw samples averaged for each target
+const long TOUCH_CALIBRATION_SETTLE_PERIOD = 50;        // milliseconds after a target is touched before sampling
+const long TOUCH_CALIBRATION_SAMPLE_PERIOD = 5;         // milliseconds between samples
+const int TOUCH_CALIBRATION_MAX_ERROR = 10;             // most pixels a target can be off after fitting
+const long TOUCH_CALIBRATION_TIMEOUT = 30000;           // milliseconds to wait for a target to be touched
+
+
+//
+// where the calibration targets are drawn, in thousandths of the display space's 
+// width and height
 //
-const long TOUCH_DEBOUNCE_PERIOD = 30;
-const long TOUCH_AUTO_REPEAT_DELAY = 800;
-const long TOUCH_AUTO_REPEAT_RATE = 120;
+const int touchCalibrationTargets3[3][2] = {{100, 100}, {900, 500}, {500, 900}};
+const int touchCalibrationTargets5[5][2] = {{100, 100}, {900, 100}, {900, 900}, {100, 900}, {500, 500}};
 
 
 // ---------------------------------------------------------------------------------
@@ -2642,64 +4403,403 @@ void TeensyUserInterface::touchScreenInitialize(int lcdOrientation)
 void TeensyUserInterface::touchScreenSetOrientation(int lcdOrientation)
 {
   ts->setRotation((lcdOrientation + 2) % 4);
-  setDefaultTouchScreenCalibrationConstants(lcdOrientation);
+  if (!readSavedTouchScreenCalibration(lcdOrientation))
+    setDefaultTouchScreenCalibrationConstants(lcdOrientation);
+
+  //
+  // events waiting and filtered samples were in the old orientation's coordinates, 
+  // sampleTouchScreen() may be running from an interrupt
+  //
+  noInterrupts();
   touchState = WAITING_FOR_TOUCH_DOWN_STATE;
+  clearTouchFilter();
+  interrupts();
+  discardTouchEvents();
+  clearTouchRegions();
 }
 
 
 
 //
-// check if the most recent touch event happened inside the given rectangle
-//  Enter:  eventType = the type of event to look for (ie TOUCH_PUSHED_EVENT, TOUCH_RELEASED_EVENT, TOUCH_REPEAT_EVENT)
-//          rectX1, rectY1 = upper left corner of the test area
-//          rectX2, rectY2 = lower right corner of the test area
-//  Exit:   true returned if most recent touch event matches the given parameters
+// add an area of the screen that's checked for touches, a touch event is then 
+// matched to its area with one lookup, the area is removed when it's painted over
+//  Enter:  owner -> what the area belongs to, returned by findTouchRegionForTouchEvent(), 
+//            adding an area again with the same owner moves it
+//          x, y = upper left corner of the area
+//          width, height = size of the area
 //
-boolean TeensyUserInterface::checkForTouchEventInRect(int eventType, int rectX1, int rectY1, int rectX2, int rectY2)
+void TeensyUserInterface::addTouchRegion(const void *owner, int x, int y, int width, int height)
 {
-  //
-  // check if the most recent event matches what we are looking for
-  //
-  if (eventType != touchEventType)
-    return(false);
-
-  //
-  // check if the most recent event happened inside the rectangle we are looking for
-  //
-  if ((touchEventX >= rectX1) && (touchEventX <= rectX2))
-  {
-    if ((touchEventY >= rectY1) && (touchEventY <= rectY2))
-      return(true);
-  }
-  return(false);
+  registerTouchRegion(owner, x, y, x + width - 1, y + height - 1);
 }
 
 
 
 //
-// check touch screen for new events
-//  Exit:   touchEventType = touch event type, TOUCH_NO_EVENT if no event
-//          touchEventX, touchEventY = LCD coordinates of touch event 
+// remove all of the areas added for touches, this is done whenever the display 
+// space is cleared or the orientation changes
 //
-void TeensyUserInterface::getTouchEvents(void)
+void TeensyUserInterface::clearTouchRegions(void)
 {
-  boolean currentlyTouched;
-  int currentTouchX;
-  int currentTouchY;
-  unsigned long currentTime = millis();
-  static unsigned long touchEventStartTime;
-  static int recordedTouchX;
-  static int recordedTouchY;
+  touchRegionCount = 0;
+  touchRegionSearchIdx = 0;
+  touchRegionGridValidFlg = false;
+  touchEventHitMaskValidFlg = false;
+}
 
-  touchEventType = TOUCH_NO_EVENT;                          // assume there will be no touch event
 
-  //
-  // check if anything is touched now
-  //
-  currentlyTouched = getTouchScreenCoords(&currentTouchX, &currentTouchY);
 
-  //
-  // select the current touch state
+//
+// find the area touched by the most recent touch event
+// Note: getTouchEvents() must be called at the top of the loop that calls this function
+//  Exit:   owner of the area returned, the one added last if areas overlap, NULL 
+//            if there is no event or it's not in any area
+//
+const void *TeensyUserInterface::findTouchRegionForTouchEvent(void)
+{
+  if (touchEventType == TOUCH_NO_EVENT)
+    return(NULL);
+
+  uint32_t hitMask = getTouchEventHitMask();
+  for (int regionIdx = touchRegionCount - 1; regionIdx >= 0; regionIdx--)
+  {
+    if (hitMask & ((uint32_t) 1 << regionIdx))
+      return(touchRegions[regionIdx].owner);
+  }
+  return(NULL);
+}
+
+
+
+//
+// add or move the touch area belonging to a widget, the grid is only rebuilt when 
+// an area changes
+//  Enter:  owner -> the widget
+//          x1, y1, x2, y2 = corners of the area, inclusive
+//
+void TeensyUserInterface::registerTouchRegion(const void *owner, int x1, int y1, int x2, int y2)
+{
+  TOUCH_REGION *region = NULL;
+  int regionIdx = findTouchRegion(owner);
+  if (regionIdx >= 0)
+    region = &touchRegions[regionIdx];
+
+  if (region == NULL)
+  {
+    //
+    // when there's no room, the widget is checked the slow way
+    //
+    if (touchRegionCount >= TOUCH_REGION_MAX)
+      return;
+    region = &touchRegions[touchRegionCount++];
+    region->owner = owner;
+  }
+
+  else if ((region->x1 == x1) && (region->y1 == y1) && (region->x2 == x2) && (region->y2 == y2))
+    return;
+
+  region->x1 = x1;
+  region->y1 = y1;
+  region->x2 = x2;
+  region->y2 = y2;
+  touchRegionGridValidFlg = false;
+  touchEventHitMaskValidFlg = false;
+}
+
+
+
+//
+// check if the most recent touch event could be on the given widget, widgets 
+// without a touch area, or that have moved since they were drawn, always could be
+//  Enter:  owner -> the widget
+//          x1, y1, x2, y2 = corners of the widget now, inclusive
+//  Exit:   false returned if the event is certainly not on the widget
+//
+boolean TeensyUserInterface::touchEventMayHit(const void *owner, int x1, int y1, int x2, int y2)
+{
+  int regionIdx = findTouchRegion(owner);
+  if (regionIdx < 0)
+    return(true);
+
+  TOUCH_REGION *region = &touchRegions[regionIdx];
+  if ((region->x1 != x1) || (region->y1 != y1) || (region->x2 != x2) || (region->y2 != y2))
+    return(true);
+
+  return((getTouchEventHitMask() & ((uint32_t) 1 << regionIdx)) != 0);
+}
+
+
+
+//
+// remove the touch areas that a drawing function is about to paint over, the widgets 
+// under them are gone
+//  Enter:  x1, y1, x2, y2 = corners of the area being filled, inclusive
+//
+void TeensyUserInterface::removeTouchRegionsUnder(int x1, int y1, int x2, int y2)
+{
+  if (touchRegionCount == 0)
+    return;
+
+  //
+  // only what's inside the clip rectangle is painted
+  //
+  x1 = max(x1, (int) clipRect.x1);
+  y1 = max(y1, (int) clipRect.y1);
+  x2 = min(x2, (int) clipRect.x2);
+  y2 = min(y2, (int) clipRect.y2);
+
+  int keptCount = 0;
+  for (int regionIdx = 0; regionIdx < touchRegionCount; regionIdx++)
+  {
+    TOUCH_REGION *region = &touchRegions[regionIdx];
+    if ((region->x1 >= x1) && (region->x2 <= x2) && (region->y1 >= y1) && (region->y2 <= y2))
+      continue;
+
+    touchRegions[keptCount++] = *region;
+  }
+
+  if (keptCount == touchRegionCount)
+    return;
+
+  touchRegionCount = keptCount;
+  touchRegionSearchIdx = 0;
+  touchRegionGridValidFlg = false;
+  touchEventHitMaskValidFlg = false;
+}
+
+
+
+//
+// find the touch area belonging to a widget, widgets are usually checked in the 
+// order they were drawn so the search starts after the last one found
+//  Enter:  owner -> the widget
+//  Exit:   index into touchRegions[] returned, -1 if the widget has no area
+//
+int TeensyUserInterface::findTouchRegion(const void *owner)
+{
+  for (int i = 0; i < touchRegionCount; i++)
+  {
+    int regionIdx = touchRegionSearchIdx + i;
+    if (regionIdx >= touchRegionCount)
+      regionIdx -= touchRegionCount;
+
+    if (touchRegions[regionIdx].owner == owner)
+    {
+      touchRegionSearchIdx = regionIdx + 1;
+      return(regionIdx);
+    }
+  }
+  return(-1);
+}
+
+
+
+//
+// get the touch areas that the most recent touch event is in, this is worked out 
+// once for each event
+//  Exit:   a bit set for each area in touchRegions[] that's touched
+//
+uint32_t TeensyUserInterface::getTouchEventHitMask(void)
+{
+  if (touchEventHitMaskValidFlg)
+    return(touchEventHitMask);
+
+  if (!touchRegionGridValidFlg)
+    buildTouchRegionGrid();
+
+  touchEventHitMask = 0;
+  int cellX = touchEventX >> TOUCH_REGION_CELL_SHIFT;
+  int cellY = touchEventY >> TOUCH_REGION_CELL_SHIFT;
+  if ((cellX >= 0) && (cellX < TOUCH_REGION_GRID_SIZE) && (cellY >= 0) && (cellY < TOUCH_REGION_GRID_SIZE))
+  {
+    //
+    // most cells hold one area, check the event is really inside those in the cell
+    //
+    uint32_t cellMask = touchRegionGrid[cellY][cellX];
+    while (cellMask != 0)
+    {
+      int regionIdx = __builtin_ctz(cellMask);
+      cellMask &= cellMask - 1;
+
+      TOUCH_REGION *region = &touchRegions[regionIdx];
+      if ((touchEventX >= region->x1) && (touchEventX <= region->x2) && 
+          (touchEventY >= region->y1) && (touchEventY <= region->y2))
+        touchEventHitMask |= (uint32_t) 1 << regionIdx;
+    }
+  }
+
+  touchEventHitMaskValidFlg = true;
+  return(touchEventHitMask);
+}
+
+
+
+//
+// build the grid of cells, marking in each the touch areas that overlap it
+//
+void TeensyUserInterface::buildTouchRegionGrid(void)
+{
+  memset(touchRegionGrid, 0, sizeof(touchRegionGrid));
+
+  for (int regionIdx = 0; regionIdx < touchRegionCount; regionIdx++)
+  {
+    TOUCH_REGION *region = &touchRegions[regionIdx];
+    int cellX1 = max((int) region->x1, 0) >> TOUCH_REGION_CELL_SHIFT;
+    int cellY1 = max((int) region->y1, 0) >> TOUCH_REGION_CELL_SHIFT;
+    int cellX2 = min((int) region->x2 >> TOUCH_REGION_CELL_SHIFT, TOUCH_REGION_GRID_SIZE - 1);
+    int cellY2 = min((int) region->y2 >> TOUCH_REGION_CELL_SHIFT, TOUCH_REGION_GRID_SIZE - 1);
+
+    for (int cellY = cellY1; cellY <= cellY2; cellY++)
+    {
+      for (int cellX = cellX1; cellX <= cellX2; cellX++)
+        touchRegionGrid[cellY][cellX] |= (uint32_t) 1 << regionIdx;
+    }
+  }
+
+  touchRegionGridValidFlg = true;
+}
+
+
+
+//
+// check if the most recent touch event happened inside the given rectangle
+//  Enter:  eventType = the type of event to look for (ie TOUCH_PUSHED_EVENT, TOUCH_RELEASED_EVENT, TOUCH_REPEAT_EVENT)
+//          rectX1, rectY1 = upper left corner of the test area
+//          rectX2, rectY2 = lower right corner of the test area
+//  Exit:   true returned if most recent touch event matches the given parameters
+//
+boolean TeensyUserInterface::checkForTouchEventInRect(int eventType, int rectX1, int rectY1, int rectX2, int rectY2)
+{
+  //
+  // check if the most recent event matches what we are looking for
+  //
+  if (eventType != touchEventType)
+    return(false);
+
+  //
+  // check if the most recent event happened inside the rectangle we are looking for
+  //
+  if ((touchEventX >= rectX1) && (touchEventX <= rectX2))
+  {
+    if ((touchEventY >= rectY1) && (touchEventY <= rectY2))
+      return(true);
+  }
+  return(false);
+}
+
+
+
+//
+// check touch screen for new events, when more than one event is waiting they're 
+// returned one per call in the order they happened
+//  Exit:   touchEventType = touch event type, TOUCH_NO_EVENT if no event
+//          touchEventX, touchEventY = LCD coordinates of touch event 
+//          touchEventMicros = time of the touch event from micros()
+//
+void TeensyUserInterface::getTouchEvents(void)
+{
+  touchEventType = TOUCH_NO_EVENT;                          // assume there will be no touch event
+  touchEventHitMaskValidFlg = false;
+
+  //
+  // send the next chunk of drawing done into the framebuffer to the display
+  //
+  if (framebuffer != NULL)
+  {
+    lcdStartFlush();
+    lcdContinueFlush();
+  }
+
+  //
+  // check the touch screen now, unless it's done by a timer interrupt
+  //
+  if (!touchSamplingFromInterruptFlg)
+    sampleTouchScreen();
+
+  //
+  // take the oldest event from the queue
+  //
+  TOUCH_EVENT event;
+  if (!dequeueTouchEvent(&event))
+    return;
+
+  touchEventType = event.eventType;
+  touchEventX = event.x;
+  touchEventY = event.y;
+  touchEventMicros = event.timeMicros;
+}
+
+
+
+//
+// take the oldest event from the touch event queue, only the main loop removes events 
+// so this is safe while sampleTouchScreen() adds them from an interrupt
+//  Enter:  event -> storage to return the event
+//  Exit:   true returned if an event was removed, false if the queue is empty
+//
+boolean TeensyUserInterface::dequeueTouchEvent(TOUCH_EVENT *event)
+{
+  byte tail = touchEventQueueTail;
+  if (tail == touchEventQueueHead)
+    return(false);
+  __sync_synchronize();
+
+  *event = touchEventQueue[tail];
+
+  __sync_synchronize();
+  touchEventQueueTail = (tail + 1) & (TOUCH_EVENT_QUEUE_SIZE - 1);
+  return(true);
+}
+
+
+
+//
+// throw away the touch events waiting in the queue, removing them one at a time from 
+// the tail as getTouchEvents() does
+//
+void TeensyUserInterface::discardTouchEvents(void)
+{
+  TOUCH_EVENT event;
+
+  while (dequeueTouchEvent(&event))
+    ;
+}
+
+
+
+//
+// check the touch screen once, adding any new touch event to the queue read by 
+// getTouchEvents(), this can be called from a timer interrupt so touches aren't 
+// missed while the application is busy drawing (see setTouchSamplingFromInterrupt())
+//
+void TeensyUserInterface::sampleTouchScreen(void)
+{
+  boolean currentlyTouched;
+  int currentTouchX;
+  int currentTouchY;
+  int filterResult = TOUCH_SAMPLES_PRESSED;
+  unsigned long currentTime = millis();
+  unsigned long currentMicros = micros();
+
+  //
+  // with the IRQ pin, nothing is read from the touch screen until it signals a touch
+  //
+  if (touchScreenIRQFlg && (touchState == WAITING_FOR_TOUCH_DOWN_STATE) && !ts->tirqTouched())
+    return;
+
+  //
+  // check if anything is touched now
+  //
+  if (touchFilterType == TOUCH_FILTER_OFF)
+    currentlyTouched = getTouchScreenCoords(&currentTouchX, &currentTouchY);
+  else
+  {
+    filterResult = getFilteredTouchScreenCoords(&currentTouchX, &currentTouchY);
+    currentlyTouched = (filterResult != TOUCH_SAMPLES_RELEASED);
+  }
+
+  //
+  // select the current touch state
   //
   switch(touchState)
   {
@@ -2712,6 +4812,7 @@ void TeensyUserInterface::getTouchEvents(void)
       {
          touchState = CONFIRM_TOUCH_DOWN_STATE;             // screen is touched, start timer to confirm touch
          touchEventStartTime = currentTime;
+         touchActiveTiming = touchTiming;                   // until a widget with its own timing takes the touch
       }
       return;
      } 
@@ -2722,8 +4823,16 @@ void TeensyUserInterface::getTouchEvents(void)
     //
     case CONFIRM_TOUCH_DOWN_STATE:
     {
-      if (currentTime < (touchEventStartTime + TOUCH_DEBOUNCE_PERIOD))
-        return;                                             // wait until debounce period complete
+      if (touchFilterType == TOUCH_FILTER_OFF)
+      {
+        if (currentTime < (touchEventStartTime + touchActiveTiming->debouncePeriod))
+          return;                                           // wait until debounce period complete
+      }
+      else
+      {
+        if (filterResult == TOUCH_SAMPLES_UNSURE)
+          return;                                           // wait until the samples are firmly pressed and steady
+      }
   
       //
       // check if the screen didn't stay touched
@@ -2737,15 +4846,15 @@ void TeensyUserInterface::getTouchEvents(void)
       //
       // the screen has been touched
       //
-      recordedTouchX = currentTouchX;                       // save coordinates where the touch occurred
-      recordedTouchY = currentTouchY;
+      touchRecordedX = currentTouchX;                       // save coordinates where the touch occurred
+      touchRecordedY = currentTouchY;
+      touchMoveX = currentTouchX;
+      touchMoveY = currentTouchY;
       
       touchEventStartTime = currentTime;                    // start auto repeat timer
       touchState = WAITING_FOR_TOUCH_UP_STATE;  
 
-      touchEventX = recordedTouchX;                         // return "screen has been pressed" event
-      touchEventY = recordedTouchY;
-      touchEventType = TOUCH_PUSHED_EVENT; 
+      queueTouchEvent(TOUCH_PUSHED_EVENT, touchRecordedX, touchRecordedY, currentMicros);
       return;
     }
 
@@ -2754,58 +4863,50 @@ void TeensyUserInterface::getTouchEvents(void)
     // check if waiting for the touch to be released
     //      
     case WAITING_FOR_TOUCH_UP_STATE:
+    case WAITING_FOR_TOUCH_UP_AFTER_AUTO_REPEAT_STATE:
     {
       //
       // screen has been continuously touched, check if no longer touched
       //
       if (!currentlyTouched)
       {
+        if (touchFilterType != TOUCH_FILTER_OFF)
+        {
+          touchState = WAITING_FOR_TOUCH_DOWN_STATE;        // the filter has already confirmed the release
+          queueTouchEvent(TOUCH_RELEASED_EVENT, touchRecordedX, touchRecordedY, currentMicros);
+          return;
+        }
+
         touchState = CONFIRM_TOUCH_UP_STATE;                // not touched now, go debounce the released
         return;
       }
 
       //
-      // still touched, check if time to auto repeat
-      //
-      if (currentTime < (touchEventStartTime + TOUCH_AUTO_REPEAT_DELAY))
-        return;                                             // no, return no event
-                                           
-      touchEventStartTime = currentTime;                    // yes auto repeat, reset auto repeat timer
-      touchState = WAITING_FOR_TOUCH_UP_AFTER_AUTO_REPEAT_STATE;
-
-      touchEventX = recordedTouchX;                         // return "touch is auto repeating" event
-      touchEventY = recordedTouchY;
-      touchEventType = TOUCH_REPEAT_EVENT;
-      return; 
-    }
-     
-
-    //
-    // check if auto repeat has started, waiting more repeats
-    //
-    case WAITING_FOR_TOUCH_UP_AFTER_AUTO_REPEAT_STATE:
-    {
-      //
-      // screen has been continuously touched & auto repeat started, check if still touched
+      // still touched, report the touch moving if asked for
       //
-      if (!currentlyTouched)
+      if ((touchMoveDistance > 0) && (filterResult == TOUCH_SAMPLES_PRESSED) && 
+          ((abs(currentTouchX - touchMoveX) >= touchMoveDistance) || (abs(currentTouchY - touchMoveY) >= touchMoveDistance)))
       {
-        touchState = CONFIRM_TOUCH_UP_STATE;                // not touched now, wait to debounce
-        return;
+        touchMoveX = currentTouchX;
+        touchMoveY = currentTouchY;
+        queueTouchEvent(TOUCH_MOVE_EVENT, touchMoveX, touchMoveY, currentMicros);
       }
- 
+
       //
-      // still touched, check if time to auto repeat
+      // check if time to auto repeat, the first repeat waits longer than the rest
       //
-      if (currentTime < (touchEventStartTime + TOUCH_AUTO_REPEAT_RATE))
-        return;                        // no, return no event
+      long repeatPeriod = touchActiveTiming->autoRepeatRate;
+      if (touchState == WAITING_FOR_TOUCH_UP_STATE)
+        repeatPeriod = touchActiveTiming->autoRepeatDelay;
+
+      if (currentTime < (touchEventStartTime + repeatPeriod))
+        return;                                             // no, return no event
                                            
-      touchEventStartTime = currentTime;                    // yes, reset auto repeat timer
+      touchEventStartTime = currentTime;                    // yes auto repeat, reset auto repeat timer
+      touchState = WAITING_FOR_TOUCH_UP_AFTER_AUTO_REPEAT_STATE;
 
-      touchEventX = recordedTouchX;                         // return "auto repeat" event
-      touchEventY = recordedTouchY;
-      touchEventType = TOUCH_REPEAT_EVENT;
-      return;
+      queueTouchEvent(TOUCH_REPEAT_EVENT, touchRecordedX, touchRecordedY, currentMicros);
+      return; 
     }
   
 
@@ -2826,7 +4927,7 @@ void TeensyUserInterface::getTouchEvents(void)
       //
       // check if debounce period has elapsed
       //
-      if (currentTime < (touchEventStartTime + TOUCH_DEBOUNCE_PERIOD))
+      if (currentTime < (touchEventStartTime + touchActiveTiming->debouncePeriod))
         return;                                             // delay period not up, return no event
   
       //
@@ -2834,9 +4935,7 @@ void TeensyUserInterface::getTouchEvents(void)
       //
       touchState = WAITING_FOR_TOUCH_DOWN_STATE;            // the touch cycle of events is now complete
 
-      touchEventX = recordedTouchX;                         // return touch "Released" event
-      touchEventY = recordedTouchY;
-      touchEventType = TOUCH_RELEASED_EVENT;
+      queueTouchEvent(TOUCH_RELEASED_EVENT, touchRecordedX, touchRecordedY, currentMicros);
       return;
     }
   }
@@ -2845,47 +4944,284 @@ void TeensyUserInterface::getTouchEvents(void)
 
 
 //
-// set default calibration constants for converting to LCD coordinates
-//  Enter:  lcdOrientation = LCD_ORIENTATION_PORTRAIT_4PIN_TOP, LCD_ORIENTATION_LANDSCAPE_4PIN_LEFT
-//                           LCD_ORIENTATION_PORTRAIT_4PIN_BOTTOM, LCD_ORIENTATION_LANDSCAPE_4PIN_RIGHT
+// add a touch event to the queue read by getTouchEvents(), when the queue is nearly 
+// full events are dropped, but room is always left for a touch's released event so 
+// the application never sees a touch without its release, or a release without its touch
+//  Enter:  eventType = TOUCH_PUSHED_EVENT, TOUCH_RELEASED_EVENT, TOUCH_REPEAT_EVENT or TOUCH_MOVE_EVENT
+//          x, y = LCD coordinates of the event
+//          timeMicros = time of the event from micros()
 //
-void TeensyUserInterface::setDefaultTouchScreenCalibrationConstants(int lcdOrientation)
+void TeensyUserInterface::queueTouchEvent(int eventType, int x, int y, unsigned long timeMicros)
 {
-  switch(lcdOrientation)
-  {
-    case LCD_ORIENTATION_PORTRAIT_4PIN_TOP:
-    {
-      setTouchScreenCalibrationConstants(20 - 4, 14.90,    17, 11.07);
-      break;
-    }
-    
-    case LCD_ORIENTATION_LANDSCAPE_4PIN_LEFT:
-    {
-      setTouchScreenCalibrationConstants(17, 11.07,    20, 14.90);
-      break;
-    }
-    
-    case LCD_ORIENTATION_PORTRAIT_4PIN_BOTTOM:
-    {
-     setTouchScreenCalibrationConstants(20, 14.90,     35, 11.07);
-     break;
-    }
-    
-    case LCD_ORIENTATION_LANDSCAPE_4PIN_RIGHT:
-    default:
-    {
-      setTouchScreenCalibrationConstants(35, 11.06,    19, 14.84);
-      break;
-    }
-  }
+  byte head = touchEventQueueHead;
+  byte nextHead = (head + 1) & (TOUCH_EVENT_QUEUE_SIZE - 1);
+  int freeCount = (touchEventQueueTail - nextHead) & (TOUCH_EVENT_QUEUE_SIZE - 1);
+  int neededCount = (eventType == TOUCH_RELEASED_EVENT) ? 1 : 2;
+
+  if (eventType == TOUCH_PUSHED_EVENT)
+    touchEventDroppedFlg = (freeCount < neededCount);
+  if (touchEventDroppedFlg || (freeCount < neededCount))
+    return;
+
+  TOUCH_EVENT *event = &touchEventQueue[head];
+  event->eventType = eventType;
+  event->x = x;
+  event->y = y;
+  event->timeMicros = timeMicros;
+
+  //
+  // the event must be complete before getTouchEvents() can see it
+  //
+  __sync_synchronize();
+  touchEventQueueHead = nextHead;
 }
 
 
 
 //
-// set the touch screen calibration constants used for converting from
-// touch coordinates to LCD coordinates
-//  Enter:  tsToLCDOffsetX = touch screen X offset calibration constant
+// select where the touch screen is checked, normally getTouchEvents() checks it each 
+// time it's called, so touches can be missed while the application is busy drawing
+//  Enter:  interruptFlg = true if the application calls sampleTouchScreen() from a 
+//            timer interrupt (every 1 to 5 ms), getTouchEvents() then only takes 
+//            the events waiting in the queue, false to check from getTouchEvents()
+//
+void TeensyUserInterface::setTouchSamplingFromInterrupt(boolean interruptFlg)
+{
+  touchSamplingFromInterruptFlg = interruptFlg;
+}
+
+
+
+//
+// report touches that move while the screen is held, as TOUCH_MOVE_EVENTs
+//  Enter:  moveDistance = number of pixels the touch must move before an event is 
+//            reported, 0 to not report moves (the default)
+//
+void TeensyUserInterface::setTouchMoveEvents(int moveDistance)
+{
+  touchMoveDistance = moveDistance;
+}
+
+
+
+//
+// set the touch timing for the screen: how long touches and releases must last, and 
+// how auto repeat speeds up, a Number Box with its own timing uses it instead while 
+// touched, the timing is put back when a menu command returns
+//  Enter:  timing -> the touch timing, it must stay in memory while used, NULL for 
+//            the default timing
+//
+void TeensyUserInterface::setTouchTiming(const TOUCH_TIMING *timing)
+{
+  if (timing == NULL)
+    timing = &defaultTouchTiming;
+
+  noInterrupts();                               // sampleTouchScreen() may be using them
+  touchTiming = timing;
+  touchActiveTiming = timing;
+  interrupts();
+}
+
+
+
+//
+// filter the touch screen's samples, a touch is then reported as soon as its last few 
+// samples are firmly pressed and steady, and released as soon as none are, rather than 
+// after the debounce period, samples are taken every 3ms
+//  Enter:  filterType = TOUCH_FILTER_MEDIAN, TOUCH_FILTER_TRIMMED_MEAN, or TOUCH_FILTER_OFF 
+//            (the default) to use each sample as is
+//          sampleCount = number of samples filtered, 1 to TOUCH_FILTER_MAX_SAMPLES, a 
+//            touch is reported once all but one are firmly pressed (all of them for 
+//            1 or 2 samples), (sampleCount - 2) * 3ms after it's firmly pressed
+//          pressureThreshold = least pressure (TS_Point.z) for a sample to count as 
+//            touched, lighter touches are ignored
+//          jitterPixels = most the samples can spread apart for a touch to be reported
+//
+void TeensyUserInterface::setTouchFilter(int filterType, int sampleCount, int pressureThreshold, int jitterPixels)
+{
+  noInterrupts();                               // sampleTouchScreen() may be filtering
+  touchFilterType = filterType;
+  touchFilterSampleCount = constrain(sampleCount, 1, TOUCH_FILTER_MAX_SAMPLES);
+  touchFilterPressureThreshold = pressureThreshold;
+  touchFilterJitterPixels = jitterPixels;
+  clearTouchFilter();
+  interrupts();
+}
+
+
+
+//
+// read the touch screen through the filter set by setTouchFilter()
+//  Enter:  xLCD, yLCD -> storage to return the filtered LCD coordinates, unchanged 
+//            when released
+//  Exit:   TOUCH_SAMPLES_PRESSED returned if the last samples were all firmly pressed 
+//            and steady, TOUCH_SAMPLES_RELEASED if none were, else TOUCH_SAMPLES_UNSURE
+//
+int TeensyUserInterface::getFilteredTouchScreenCoords(int *xLCD, int *yLCD)
+{
+  int xSorted[TOUCH_FILTER_MAX_SAMPLES];
+  int ySorted[TOUCH_FILTER_MAX_SAMPLES];
+
+  //
+  // between samples, return the last result
+  //
+  unsigned long currentMicros = micros();
+  if ((touchFilterLength > 0) && (currentMicros - touchFilterSampleMicros < TOUCH_FILTER_SAMPLE_PERIOD))
+  {
+    *xLCD = touchFilterResultX;
+    *yLCD = touchFilterResultY;
+    return(touchFilterResult);
+  }
+  touchFilterSampleMicros = currentMicros;
+
+  //
+  // add a sample, it only counts as pressed if pressed firmly
+  //
+  int xRaw;
+  int yRaw;
+  int pressure;
+  boolean pressedFlg = getRAWTouchScreenCoords(&xRaw, &yRaw, &pressure) && (pressure >= touchFilterPressureThreshold);
+
+  touchFilterPressedFlg[touchFilterIdx] = pressedFlg;
+  if (pressedFlg)
+  {
+    int x;
+    int y;
+    convertTouchScreenCoords(xRaw, yRaw, &x, &y);
+    touchFilterX[touchFilterIdx] = x;
+    touchFilterY[touchFilterIdx] = y;
+  }
+
+  touchFilterIdx++;
+  if (touchFilterIdx >= touchFilterSampleCount)
+    touchFilterIdx = 0;
+  if (touchFilterLength < touchFilterSampleCount)
+    touchFilterLength++;
+
+  //
+  // sort the pressed samples
+  //
+  int pressedCount = 0;
+  for (int i = 0; i < touchFilterLength; i++)
+  {
+    if (!touchFilterPressedFlg[i])
+      continue;
+
+    int j;
+    for (j = pressedCount; (j > 0) && (xSorted[j - 1] > touchFilterX[i]); j--)
+      xSorted[j] = xSorted[j - 1];
+    xSorted[j] = touchFilterX[i];
+
+    for (j = pressedCount; (j > 0) && (ySorted[j - 1] > touchFilterY[i]); j--)
+      ySorted[j] = ySorted[j - 1];
+    ySorted[j] = touchFilterY[i];
+
+    pressedCount++;
+  }
+
+  if (pressedCount == 0)
+  {
+    touchFilterResult = TOUCH_SAMPLES_RELEASED;
+    return(touchFilterResult);
+  }
+
+  //
+  // filter the position
+  //
+  if (touchFilterType == TOUCH_FILTER_TRIMMED_MEAN)
+  {
+    int trimCount = (pressedCount >= 3) ? 1 : 0;
+    long sumX = 0;
+    long sumY = 0;
+    for (int i = trimCount; i < pressedCount - trimCount; i++)
+    {
+      sumX += xSorted[i];
+      sumY += ySorted[i];
+    }
+    int count = pressedCount - 2 * trimCount;
+    touchFilterResultX = (sumX + count / 2) / count;
+    touchFilterResultY = (sumY + count / 2) / count;
+  }
+  else
+  {
+    touchFilterResultX = xSorted[pressedCount / 2];
+    touchFilterResultY = ySorted[pressedCount / 2];
+  }
+
+  //
+  // it's a firm touch when the samples pressed are close together, with 3 or more 
+  // samples one can be an outlier, and one can be missing so the light sample as the
+  // finger lands doesn't hold up the touch
+  //
+  int last = pressedCount - 1;
+  int spreadX = xSorted[last] - xSorted[0];
+  int spreadY = ySorted[last] - ySorted[0];
+  if (pressedCount >= 3)
+  {
+    spreadX = min(xSorted[last - 1] - xSorted[0], xSorted[last] - xSorted[1]);
+    spreadY = min(ySorted[last - 1] - ySorted[0], ySorted[last] - ySorted[1]);
+  }
+
+  int requiredCount = (touchFilterSampleCount >= 3) ? touchFilterSampleCount - 1 : touchFilterSampleCount;
+  if ((pressedCount >= requiredCount) && (spreadX <= touchFilterJitterPixels) && (spreadY <= touchFilterJitterPixels))
+    touchFilterResult = TOUCH_SAMPLES_PRESSED;
+  else
+    touchFilterResult = TOUCH_SAMPLES_UNSURE;
+
+  *xLCD = touchFilterResultX;
+  *yLCD = touchFilterResultY;
+  return(touchFilterResult);
+}
+
+
+
+//
+// forget the touch filter's samples
+//
+void TeensyUserInterface::clearTouchFilter(void)
+{
+  touchFilterIdx = 0;
+  touchFilterLength = 0;
+  touchFilterResult = TOUCH_SAMPLES_RELEASED;
+  touchFilterResultX = 0;
+  touchFilterResultY = 0;
+}
+
+
+
+//
+// default touch screen calibrations, by LCD orientation, each converts the raw X and Y
+// on its own: dividing by 14.90, 11.07, 11.06 or 14.84 then subtracting an offset
+//
+const TOUCH_CALIBRATION defaultTouchCalibrations[] = 
+{
+  {140749, 0, -(16 << TOUCH_CALIBRATION_SHIFT),    0, 189445, -(17 << TOUCH_CALIBRATION_SHIFT)},   // LCD_ORIENTATION_PORTRAIT_4PIN_TOP
+  {189445, 0, -(17 << TOUCH_CALIBRATION_SHIFT),    0, 140749, -(20 << TOUCH_CALIBRATION_SHIFT)},   // LCD_ORIENTATION_LANDSCAPE_4PIN_LEFT
+  {140749, 0, -(20 << TOUCH_CALIBRATION_SHIFT),    0, 189445, -(35 << TOUCH_CALIBRATION_SHIFT)},   // LCD_ORIENTATION_PORTRAIT_4PIN_BOTTOM
+  {189616, 0, -(35 << TOUCH_CALIBRATION_SHIFT),    0, 141318, -(19 << TOUCH_CALIBRATION_SHIFT)}    // LCD_ORIENTATION_LANDSCAPE_4PIN_RIGHT
+};
+
+
+
+//
+// set default calibration constants for converting to LCD coordinates
+//  Enter:  lcdOrientation = LCD_ORIENTATION_PORTRAIT_4PIN_TOP, LCD_ORIENTATION_LANDSCAPE_4PIN_LEFT
+//                           LCD_ORIENTATION_PORTRAIT_4PIN_BOTTOM, LCD_ORIENTATION_LANDSCAPE_4PIN_RIGHT
+//
+void TeensyUserInterface::setDefaultTouchScreenCalibrationConstants(int lcdOrientation)
+{
+  if ((lcdOrientation < LCD_ORIENTATION_PORTRAIT_4PIN_TOP) || (lcdOrientation > LCD_ORIENTATION_LANDSCAPE_4PIN_RIGHT))
+    lcdOrientation = LCD_ORIENTATION_LANDSCAPE_4PIN_RIGHT;
+
+  touchCalibration = defaultTouchCalibrations[lcdOrientation];
+}
+
+
+
+//
+// set the touch screen calibration constants used for converting from
+// touch coordinates to LCD coordinates
+//  Enter:  tsToLCDOffsetX = touch screen X offset calibration constant
 //          tsToLCDScalerX = touch screen X scaler calibration constant
 //          tsToLCDOffsetY = touch screen Y offset calibration constant
 //          tsToLCDScalerY = touch screen Y scaler calibration constant
@@ -2893,564 +5229,3707 @@ void TeensyUserInterface::setDefaultTouchScreenCalibrationConstants(int lcdOrien
 void TeensyUserInterface::setTouchScreenCalibrationConstants(int tsToLCDOffsetX, 
   float tsToLCDScalerX, int tsToLCDOffsetY, float tsToLCDScalerY)
 {
-  touchScreenToLCDOffsetX = tsToLCDOffsetX;
-  touchScreenToLCDScalerX = tsToLCDScalerX;
-  touchScreenToLCDOffsetY = tsToLCDOffsetY;
-  touchScreenToLCDScalerY = tsToLCDScalerY;
+  //
+  // dividing by the scaler becomes multiplying by its inverse, rounded up as 
+  // TOUCH_CALIBRATION describes
+  //
+  const double one = (double) ((int32_t) 1 << TOUCH_CALIBRATION_SHIFT);
+
+  touchCalibration.xScaleX = (int32_t) ceil(one / tsToLCDScalerX);
+  touchCalibration.xScaleY = 0;
+  touchCalibration.xOffset = -tsToLCDOffsetX * ((int32_t) 1 << TOUCH_CALIBRATION_SHIFT);
+  touchCalibration.yScaleX = 0;
+  touchCalibration.yScaleY = (int32_t) ceil(one / tsToLCDScalerY);
+  touchCalibration.yOffset = -tsToLCDOffsetY * ((int32_t) 1 << TOUCH_CALIBRATION_SHIFT);
 }
 
 
 
 //
-// get the XY values of where to touch screen is being touched (in LCD space)
-//  Enter:  xLCD, yLCD -> storage to return X and Y coordinates
-//  Exit:   true returned if touch screen is currently being touch, else false
+// set the touch screen calibration used for converting from touch coordinates to 
+// LCD coordinates, this can correct a touch screen that's rotated or skewed
+//  Enter:  calibration -> the calibration, see TOUCH_CALIBRATION
 //
-boolean TeensyUserInterface::getTouchScreenCoords(int *xLCD, int *yLCD)
+void TeensyUserInterface::setTouchScreenCalibration(const TOUCH_CALIBRATION &calibration)
 {
-  int xRaw;
-  int yRaw;
+  touchCalibration = calibration;
+}
+
+
+
+//
+// get the touch screen calibration being used
+//  Enter:  calibration -> storage to return the calibration
+//
+void TeensyUserInterface::getTouchScreenCalibration(TOUCH_CALIBRATION *calibration)
+{
+  *calibration = touchCalibration;
+}
+
+
+
+//
+// show targets for the user to touch, then work out the touch screen calibration 
+// from where they were touched, the calibration is used right away and saved in 
+// EEPROM for the current LCD orientation if an address has been set with 
+// setTouchScreenCalibrationEEPromAddress(), setOrientation() then loads it
+//  Enter:  pointCount = number of targets to show, 3 or 5, with 5 a target that's 
+//            touched poorly is detected
+//  Exit:   true returned if calibrated, false if the targets touched didn't fit 
+//            together or a target wasn't touched within 30 seconds, the calibration 
+//            is then unchanged
+//
+boolean TeensyUserInterface::calibrateTouchScreen(int pointCount)
+{
+  int rawX[5];
+  int rawY[5];
+  int lcdX[5];
+  int lcdY[5];
+
+  const int (*targets)[2] = touchCalibrationTargets5;
+  if (pointCount <= 3)
+  {
+    pointCount = 3;
+    targets = touchCalibrationTargets3;
+  }
+  else
+    pointCount = 5;
 
   //
-  // check if the screen is currently being touched
+  // draw the calibration screen
   //
-  if (getRAWTouchScreenCoords(&xRaw, &yRaw) == false)
-    return(false);
+  drawTitleBar("Touch Screen Calibration");
+  clearDisplaySpace();
+  lcdSetFont(*menuButtonFont);
+  lcdSetFontColor(menuButtonTextColor);
+  lcdSetCursorXY(displaySpaceCenterX, displaySpaceTopY + displaySpaceHeight / 3);
+  lcdPrintCentered("Touch and hold each target");
 
   //
-  // convert the coordinates into LCD space
+  // show each target, then average where it was touched
   //
-  int x = (int)((float)xRaw / touchScreenToLCDScalerX) - touchScreenToLCDOffsetX;
-  *xLCD = constrain(x, 0, lcdWidth - 1);
+  for (int pointIdx = 0; pointIdx < pointCount; pointIdx++)
+  {
+    lcdX[pointIdx] = displaySpaceLeftX + (long) displaySpaceWidth * targets[pointIdx][0] / 1000;
+    lcdY[pointIdx] = displaySpaceTopY + (long) displaySpaceHeight * targets[pointIdx][1] / 1000;
+
+    drawTouchCalibrationTarget(lcdX[pointIdx], lcdY[pointIdx], LCD_RED);
+    lcdFlush();
+    boolean sampledFlg = getTouchCalibrationSample(&rawX[pointIdx], &rawY[pointIdx]);
+    drawTouchCalibrationTarget(lcdX[pointIdx], lcdY[pointIdx], menuBackgroundColor);
+    if (!sampledFlg)
+    {
+      lcdFlush();
+      discardTouchEvents();
+      return(false);
+    }
+  }
+  lcdFlush();
 
-  int y = (int)((float)yRaw / touchScreenToLCDScalerY) - touchScreenToLCDOffsetY;
-  *yLCD = constrain(y, 0, lcdHeight - 1);
+  //
+  // throw away touch events queued while the targets were touched
+  //
+  discardTouchEvents();
+
+  //
+  // fit a calibration to the targets, then check that every target is close to where 
+  // the calibration puts it
+  //
+  TOUCH_CALIBRATION calibration;
+  if (!solveTouchScreenCalibration(rawX, rawY, lcdX, lcdY, pointCount, &calibration))
+    return(false);
+
+  for (int pointIdx = 0; pointIdx < pointCount; pointIdx++)
+  {
+    int x = (int) (((int64_t) calibration.xScaleX * rawX[pointIdx] + (int64_t) calibration.xScaleY * rawY[pointIdx] + 
+      calibration.xOffset) >> TOUCH_CALIBRATION_SHIFT);
+    int y = (int) (((int64_t) calibration.yScaleX * rawX[pointIdx] + (int64_t) calibration.yScaleY * rawY[pointIdx] + 
+      calibration.yOffset) >> TOUCH_CALIBRATION_SHIFT);
+    if ((abs(x - lcdX[pointIdx]) > TOUCH_CALIBRATION_MAX_ERROR) || (abs(y - lcdY[pointIdx]) > TOUCH_CALIBRATION_MAX_ERROR))
+      return(false);
+  }
 
+  touchCalibration = calibration;
+  writeSavedTouchScreenCalibration(currentOrientation);
   return(true);
 }
 
 
 
 //
-// get the raw XY values of where to touch screen is being touched (in touch screen space)
-//  Enter:  xRaw, yRaw -> storage to return X and Y raw coordinates
-//  Exit:   true returned if touch screen is currently being touch, else false
+// work out the touch screen calibration that best fits a set of touches, using least 
+// squares, this uses no hardware so it can be tested anywhere
+//  Enter:  rawX, rawY -> raw touch screen coordinates of each touch
+//          lcdX, lcdY -> LCD coordinates of what was touched
+//          pointCount = number of touches, 3 or more, not all in a line
+//          calibration -> storage to return the calibration, its values are rounded 
+//            up like setTouchScreenCalibrationConstants() does, see TOUCH_CALIBRATION
+//  Exit:   true returned on success, false if the touches can't be fit
 //
-boolean TeensyUserInterface::getRAWTouchScreenCoords(int *xRaw, int *yRaw)
+boolean TeensyUserInterface::solveTouchScreenCalibration(const int *rawX, const int *rawY, const int *lcdX, const int *lcdY, 
+  int pointCount, TOUCH_CALIBRATION *calibration)
 {
+  if (pointCount < 3)
+    return(false);
+
   //
-  // check if the screen is currently being touched
+  // work from the touches' center, this keeps the sums small
   //
-  if (ts->touched() == false)
+  double meanRawX = 0, meanRawY = 0, meanLcdX = 0, meanLcdY = 0;
+  for (int i = 0; i < pointCount; i++)
+  {
+    meanRawX += rawX[i];
+    meanRawY += rawY[i];
+    meanLcdX += lcdX[i];
+    meanLcdY += lcdY[i];
+  }
+  meanRawX /= pointCount;
+  meanRawY /= pointCount;
+  meanLcdX /= pointCount;
+  meanLcdY /= pointCount;
+
+  double sumUU = 0, sumUV = 0, sumVV = 0, sumUX = 0, sumVX = 0, sumUY = 0, sumVY = 0;
+  for (int i = 0; i < pointCount; i++)
+  {
+    double u = rawX[i] - meanRawX;
+    double v = rawY[i] - meanRawY;
+    sumUU += u * u;
+    sumUV += u * v;
+    sumVV += v * v;
+    sumUX += u * (lcdX[i] - meanLcdX);
+    sumVX += v * (lcdX[i] - meanLcdX);
+    sumUY += u * (lcdY[i] - meanLcdY);
+    sumVY += v * (lcdY[i] - meanLcdY);
+  }
+
+  //
+  // solve the normal equations, touches that are all in a line can't be solved
+  //
+  double determinant = sumUU * sumVV - sumUV * sumUV;
+  if (determinant <= 1.0e-6 * sumUU * sumVV)
+    return(false);
+
+  double xScaleX = (sumUX * sumVV - sumVX * sumUV) / determinant;
+  double xScaleY = (sumVX * sumUU - sumUX * sumUV) / determinant;
+  double yScaleX = (sumUY * sumVV - sumVY * sumUV) / determinant;
+  double yScaleY = (sumVY * sumUU - sumUY * sumUV) / determinant;
+
+  double xOffset = meanLcdX - xScaleX * meanRawX - xScaleY * meanRawY;
+  double yOffset = meanLcdY - yScaleX * meanRawX - yScaleY * meanRawY;
+
+  //
+  // convert to fixed point rounding up, the values must fit
+  //
+  const double one = (double) ((int32_t) 1 << TOUCH_CALIBRATION_SHIFT);
+  const double limit = 2147483647.0 / one;
+  if ((fabs(xScaleX) >= limit) || (fabs(xScaleY) >= limit) || (fabs(xOffset) >= limit) || 
+      (fabs(yScaleX) >= limit) || (fabs(yScaleY) >= limit) || (fabs(yOffset) >= limit))
+    return(false);
+
+  calibration->xScaleX = (int32_t) ceil(xScaleX * one);
+  calibration->xScaleY = (int32_t) ceil(xScaleY * one);
+  calibration->xOffset = (int32_t) ceil(xOffset * one);
+  calibration->yScaleX = (int32_t) ceil(yScaleX * one);
+  calibration->yScaleY = (int32_t) ceil(yScaleY * one);
+  calibration->yOffset = (int32_t) ceil(yOffset * one);
+  return(true);
+}
+
+
+
+//
+// wait for a calibration target to be touched and held, then average the raw 
+// coordinates, a touch released before enough samples are taken is ignored
+//  Enter:  xRaw, yRaw -> storage to return the averaged raw coordinates
+//  Exit:   true returned if sampled, false if the target wasn't touched and held 
+//            within TOUCH_CALIBRATION_TIMEOUT
+//
+boolean TeensyUserInterface::getTouchCalibrationSample(int *xRaw, int *yRaw)
+{
+  int x;
+  int y;
+  unsigned long waitStartTime = millis();
+
+  while(true)
+  {
+    //
+    // wait for the last touch to be released, then for a new touch
+    //
+    while (getRAWTouchScreenCoords(&x, &y))
+    {
+      if (millis() - waitStartTime >= TOUCH_CALIBRATION_TIMEOUT)
+        return(false);
+    }
+    while (!getRAWTouchScreenCoords(&x, &y))
+    {
+      if (millis() - waitStartTime >= TOUCH_CALIBRATION_TIMEOUT)
+        return(false);
+    }
+
+    //
+    // let the touch settle, then take the samples spread out in time
+    //
+    unsigned long startTime = millis();
+    unsigned long sampleTime = 0;
+    long sumX = 0;
+    long sumY = 0;
+    int sampleCount = 0;
+
+    while (sampleCount < TOUCH_CALIBRATION_SAMPLES)
+    {
+      if (!getRAWTouchScreenCoords(&x, &y))
+        break;
+
+      unsigned long currentTime = millis();
+      if ((currentTime - startTime < TOUCH_CALIBRATION_SETTLE_PERIOD) || 
+          ((sampleCount > 0) && (currentTime - sampleTime < TOUCH_CALIBRATION_SAMPLE_PERIOD)))
+        continue;
+
+      sumX += x;
+      sumY += y;
+      sampleCount++;
+      sampleTime = currentTime;
+    }
+
+    if (sampleCount == TOUCH_CALIBRATION_SAMPLES)
+    {
+      *xRaw = (sumX + sampleCount / 2) / sampleCount;
+      *yRaw = (sumY + sampleCount / 2) / sampleCount;
+      return(true);
+    }
+  }
+}
+
+
+
+//
+// draw a calibration target
+//  Enter:  x, y = LCD coordinates of the target's center
+//          color = color to draw the target, the background color erases it
+//
+void TeensyUserInterface::drawTouchCalibrationTarget(int x, int y, uint16_t color)
+{
+  lcdDrawHorizontalLine(x - 10, y, 21, color);
+  lcdDrawVerticalLine(x, y - 10, 21, color);
+  lcdDrawCircle(x, y, 6, color);
+}
+
+
+
+//
+// set where in EEPROM the touch screen calibrations are saved, the calibration 
+// saved there for the current orientation is loaded, call this after begin(), until 
+// it's called calibrations aren't saved
+//  Enter:  EEPromAddress = address in EEPROM, TOUCH_CALIBRATION_EEPROM_SIZE bytes are 
+//            used, -1 to not save calibrations
+//
+void TeensyUserInterface::setTouchScreenCalibrationEEPromAddress(int EEPromAddress)
+{
+  touchCalibrationEEPromAddress = EEPromAddress;
+  if (!readSavedTouchScreenCalibration(currentOrientation))
+    setDefaultTouchScreenCalibrationConstants(currentOrientation);
+}
+
+
+
+//
+// load the touch screen calibration saved for an orientation
+//  Enter:  lcdOrientation = the LCD orientation
+//  Exit:   true returned if loaded, false if none has been saved
+//
+boolean TeensyUserInterface::readSavedTouchScreenCalibration(int lcdOrientation)
+{
+  if ((touchCalibrationEEPromAddress < 0) || (lcdOrientation < 0) || (lcdOrientation > 3))
+    return(false);
+
+  int EEPromAddress = touchCalibrationEEPromAddress + lcdOrientation * TOUCH_CALIBRATION_EEPROM_SLOT_SIZE;
+  if (readConfigurationInt(EEPromAddress, 0) != TOUCH_CALIBRATION_MARKER)
     return(false);
 
+  touchCalibration.xScaleX = readConfigurationInt(EEPromAddress + 5, 0);
+  touchCalibration.xScaleY = readConfigurationInt(EEPromAddress + 10, 0);
+  touchCalibration.xOffset = readConfigurationInt(EEPromAddress + 15, 0);
+  touchCalibration.yScaleX = readConfigurationInt(EEPromAddress + 20, 0);
+  touchCalibration.yScaleY = readConfigurationInt(EEPromAddress + 25, 0);
+  touchCalibration.yOffset = readConfigurationInt(EEPromAddress + 30, 0);
+  return(true);
+}
+
+
+
+//
+// save the touch screen calibration for an orientation, the marker is written last 
+// so a save that's interrupted isn't loaded
+//  Enter:  lcdOrientation = the LCD orientation
+//
+void TeensyUserInterface::writeSavedTouchScreenCalibration(int lcdOrientation)
+{
+  if ((touchCalibrationEEPromAddress < 0) || (lcdOrientation < 0) || (lcdOrientation > 3))
+    return;
+
+  int EEPromAddress = touchCalibrationEEPromAddress + lcdOrientation * TOUCH_CALIBRATION_EEPROM_SLOT_SIZE;
+  writeConfigurationInt(EEPromAddress, 0);
+  writeConfigurationInt(EEPromAddress + 5, touchCalibration.xScaleX);
+  writeConfigurationInt(EEPromAddress + 10, touchCalibration.xScaleY);
+  writeConfigurationInt(EEPromAddress + 15, touchCalibration.xOffset);
+  writeConfigurationInt(EEPromAddress + 20, touchCalibration.yScaleX);
+  writeConfigurationInt(EEPromAddress + 25, touchCalibration.yScaleY);
+  writeConfigurationInt(EEPromAddress + 30, touchCalibration.yOffset);
+  writeConfigurationInt(EEPromAddress, TOUCH_CALIBRATION_MARKER);
+}
+
+
+
+//
+// get the XY values of where to touch screen is being touched (in LCD space)
+//  Enter:  xLCD, yLCD -> storage to return X and Y coordinates
+//  Exit:   true returned if touch screen is currently being touch, else false
+//
+boolean TeensyUserInterface::getTouchScreenCoords(int *xLCD, int *yLCD)
+{
+  int xRaw;
+  int yRaw;
+
+  //
+  // check if the screen is currently being touched
+  //
+  if (getRAWTouchScreenCoords(&xRaw, &yRaw) == false)
+    return(false);
+
+  //
+  // convert the coordinates into LCD space
+  //
+  convertTouchScreenCoords(xRaw, yRaw, xLCD, yLCD);
+  return(true);
+}
+
+
+
+//
+// convert raw touch screen coordinates to LCD coordinates using the calibration
+//  Enter:  xRaw, yRaw = raw touch screen coordinates
+//          xLCD, yLCD -> storage to return the LCD coordinates, kept on the LCD
+//
+void TeensyUserInterface::convertTouchScreenCoords(int xRaw, int yRaw, int *xLCD, int *yLCD)
+{
+  int x = (int) (((int64_t) touchCalibration.xScaleX * xRaw + (int64_t) touchCalibration.xScaleY * yRaw + 
+    touchCalibration.xOffset) >> TOUCH_CALIBRATION_SHIFT);
+  *xLCD = constrain(x, 0, lcdWidth - 1);
+
+  int y = (int) (((int64_t) touchCalibration.yScaleX * xRaw + (int64_t) touchCalibration.yScaleY * yRaw + 
+    touchCalibration.yOffset) >> TOUCH_CALIBRATION_SHIFT);
+  *yLCD = constrain(y, 0, lcdHeight - 1);
+}
+
+
+
+//
+// get the number of calls made to the touch screen driver since the count was last 
+// cleared, checking if it's touched and getting the point each count as one.  This is
+// not the number of SPI reads: the driver reads the touch screen at most once every 3ms
+// and answers the other calls from its last read
+//  Exit:   number of driver calls returned
+//
+unsigned long TeensyUserInterface::getTouchScreenDriverCallCount(void)
+{
+  return(touchScreenDriverCallCount);
+}
+
+
+
+//
+// clear the count of touch screen driver calls
+//
+void TeensyUserInterface::clearTouchScreenDriverCallCount(void)
+{
+  touchScreenDriverCallCount = 0;
+}
+
+
+
+//
+// get the raw XY values of where to touch screen is being touched (in touch screen space)
+//  Enter:  xRaw, yRaw -> storage to return X and Y raw coordinates
+//          pressure -> storage to return how hard it's pressed (TS_Point.z), or NULL
+//  Exit:   true returned if touch screen is currently being touch, else false
+//
+boolean TeensyUserInterface::getRAWTouchScreenCoords(int *xRaw, int *yRaw, int *pressure)
+{
+  //
+  // check if the screen is currently being touched
+  //
+  touchScreenDriverCallCount++;
+  if (ts->touched() == false)
+    return(false);
+
+  //
+  // get the raw coordinates and return them
+  //
+  touchScreenDriverCallCount++;
+  TS_Point rawTouchPoint = ts->getPoint();
+
+  *xRaw = rawTouchPoint.x;
+  *yRaw = rawTouchPoint.y;
+  if (pressure != NULL)
+    *pressure = rawTouchPoint.z;
+  return(true);
+}
+
+
+// ---------------------------------------------------------------------------------
+//                                    LCD functions  
+// ---------------------------------------------------------------------------------
+
+//
+// initialize the LCD display
+//  Enter:  lcdOrientation = LCD_ORIENTATION_PORTRAIT_4PIN_TOP, LCD_ORIENTATION_LANDSCAPE_4PIN_LEFT
+//                           LCD_ORIENTATION_PORTRAIT_4PIN_BOTTOM, LCD_ORIENTATION_LANDSCAPE_4PIN_RIGHT
+//          font -> the font typeface to load, ei: Arial_10
+//
+void TeensyUserInterface::lcdInitialize(int lcdOrientation, const ui_font &font)
+{
+  lcd->begin();
+  lcdSetOrientation(lcdOrientation);
+  lcdClearScreen(LCD_BLACK);
+  lcdSetFontColor(LCD_WHITE);  
+  lcdSetFont(font);
+}
+
+
+
+//
+// set the LCD display's orientation
+//  Enter:  lcdOrientation = LCD_ORIENTATION_PORTRAIT_4PIN_TOP, LCD_ORIENTATION_LANDSCAPE_4PIN_LEFT
+//                           LCD_ORIENTATION_PORTRAIT_4PIN_BOTTOM, LCD_ORIENTATION_LANDSCAPE_4PIN_RIGHT
+//
+void TeensyUserInterface::lcdSetOrientation(int lcdOrientation)
+{
+  lcd->setRotation(lcdOrientation);
+  currentOrientation = lcdOrientation;
+  lcdWidth = lcd->width();
+  lcdHeight = lcd->height();
+  lcdSetCursorXY(0, 0);
+
+  //
+  // nothing drawn survives the change, so menus are fully redrawn
+  //
+  lcdDrawCount++;
+
+  //
+  // stop any scrolling of the display space
+  //
+  scrollOffset = 0;
+  setHardwareScroll();
+
+  //
+  // the clip rectangles are cleared, clipping to the whole screen
+  //
+  clipStackCount = 0;
+  clipRect.x1 = 0;
+  clipRect.y1 = 0;
+  clipRect.x2 = lcdWidth - 1;
+  clipRect.y2 = lcdHeight - 1;
+
+  //
+  // the framebuffer's contents don't survive a change in orientation, blank it
+  //
+  if (framebuffer != NULL)
+  {
+    flushQueueCount = 0;
+    dirtyRectCount = 0;
+    if (tileFlags != NULL)
+      memset(tileFlags, 0, ((lcdWidth + LCD_TILE_SIZE - 1) / LCD_TILE_SIZE) * ((lcdHeight + LCD_TILE_SIZE - 1) / LCD_TILE_SIZE));
+    lcdClearScreen(LCD_BLACK);
+  }
+}
+
+
+
+//
+// fill the entire lcd screen with the given color
+//  Enter:  color = 16 bit color, bit format: rrrrrggggggbbbbb
+//
+void TeensyUserInterface::lcdClearScreen(uint16_t color)
+{
+  countLcdDrawing();
+  removeTouchRegionsUnder(0, 0, lcdWidth - 1, lcdHeight - 1);
+
+  if ((displayListDepth > 0) && recordDisplayListCommand(DISPLAY_LIST_FILL_RECT, color, 0, 0, lcdWidth, lcdHeight, 0, 0, NULL))
+    return;
+
+  int clipping = getClipping(0, 0, lcdWidth - 1, lcdHeight - 1);
+  if (clipping == CLIP_OUTSIDE)
+    return;
+
+  if ((framebuffer != NULL) || (clipping == CLIP_PARTIAL))
+  {
+    rasterFillRect(0, 0, lcdWidth, lcdHeight, color);
+    addPendingDirtyRect();
+    return;
+  }
+
+  lcd->fillScreen(color);
+}
+
+
+
+//
+// draw one pixel with the given coords and color
+//  Enter:  x, y = coords of the pixel to draw
+//          color = 16 bit color, bit format: rrrrrggggggbbbbb
+//
+void TeensyUserInterface::lcdDrawPixel(int x, int y, uint16_t color)
+{
+  countLcdDrawing();
+
+  if ((displayListDepth > 0) && recordDisplayListCommand(DISPLAY_LIST_FILL_RECT, color, x, y, 1, 1, 0, 0, NULL))
+    return;
+
+  int clipping = getClipping(x, y, x, y);
+  if (clipping == CLIP_OUTSIDE)
+    return;
+
+  if ((framebuffer != NULL) || (clipping == CLIP_PARTIAL))
+  {
+    rasterFillRect(x, y, 1, 1, color);
+    addPendingDirtyRect();
+    return;
+  }
+
+  lcd->drawPixel(x, y, color);
+}
+
+
+
+//
+// draw a line with the given coords and color
+//  Enter:  x1, y1 = first endpoint of line
+//          x2, y2 = second endpoint of line
+//          color = 16 bit color, bit format: rrrrrggggggbbbbb
+//
+void TeensyUserInterface::lcdDrawLine(int x1, int y1, int x2, int y2, uint16_t color)
+{
+  countLcdDrawing();
+
+  //
+  // when recording, horizontal and vertical lines are recorded as fills so they can be 
+  // merged with their neighbours
+  //
+  if (displayListDepth > 0)
+  {
+    boolean recordedFlg;
+    if ((x1 == x2) || (y1 == y2))
+      recordedFlg = recordDisplayListCommand(DISPLAY_LIST_FILL_RECT, color, min(x1, x2), min(y1, y2), 
+        abs(x2 - x1) + 1, abs(y2 - y1) + 1, 0, 0, NULL);
+    else
+      recordedFlg = recordDisplayListCommand(DISPLAY_LIST_LINE, color, x1, y1, x2, y2, 0, 0, NULL);
+    if (recordedFlg)
+      return;
+  }
+
+  int clipping = getClipping(min(x1, x2), min(y1, y2), max(x1, x2), max(y1, y2));
+  if (clipping == CLIP_OUTSIDE)
+    return;
+
+  if ((framebuffer != NULL) || (clipping == CLIP_PARTIAL))
+  {
+    rasterDrawLine(x1, y1, x2, y2, color);
+    addPendingDirtyRect();
+    return;
+  }
+
+  lcd->drawLine(x1, y1, x2, y2, color);
+}
+
+
+
+//
+// draw a horizontal line with the given coords, length and color
+//  Enter:  x, y = first endpoint of line
+//          length = length of line
+//          color = 16 bit color, bit format: rrrrrggggggbbbbb
+//
+void TeensyUserInterface::lcdDrawHorizontalLine(int x, int y, int length, uint16_t color)
+{
+  countLcdDrawing();
+
+  if ((displayListDepth > 0) && recordDisplayListCommand(DISPLAY_LIST_FILL_RECT, color, x, y, length, 1, 0, 0, NULL))
+    return;
+
+  int clipping = getClipping(x, y, x + length - 1, y);
+  if (clipping == CLIP_OUTSIDE)
+    return;
+
+  if ((framebuffer != NULL) || (clipping == CLIP_PARTIAL))
+  {
+    rasterFillRect(x, y, length, 1, color);
+    addPendingDirtyRect();
+    return;
+  }
+
+  lcd->drawFastHLine(x, y, length, color);
+}
+
+
+
+//
+// draw a vertical line with the given coords, length and color
+//  Enter: x, y = first endpoint of line
+//          length = length of line
+//          color = 16 bit color, bit format: rrrrrggggggbbbbb
+//
+void TeensyUserInterface::lcdDrawVerticalLine(int x, int y, int length, uint16_t color)
+{
+  countLcdDrawing();
+
+  if ((displayListDepth > 0) && recordDisplayListCommand(DISPLAY_LIST_FILL_RECT, color, x, y, 1, length, 0, 0, NULL))
+    return;
+
+  int clipping = getClipping(x, y, x, y + length - 1);
+  if (clipping == CLIP_OUTSIDE)
+    return;
+
+  if ((framebuffer != NULL) || (clipping == CLIP_PARTIAL))
+  {
+    rasterFillRect(x, y, 1, length, color);
+    addPendingDirtyRect();
+    return;
+  }
+
+  lcd->drawFastVLine(x, y, length, color);
+}
+
+
+
+//
+// draw rectangle at the given coords, length, width and color
+//  Enter:  x, y = upper left corner of rect
+//          width = width of rectangle
+//          height = height of rectangle
+//          color = 16 bit color, bit format: rrrrrggggggbbbbb
+//
+void TeensyUserInterface::lcdDrawRectangle(int x, int y, int width, int height, uint16_t color)
+{
+  countLcdDrawing();
+
+  if ((displayListDepth > 0) && recordDisplayListCommand(DISPLAY_LIST_RECTANGLE, color, x, y, width, height, 0, 0, NULL))
+    return;
+
+  int clipping = getClipping(x, y, x + width - 1, y + height - 1);
+  if (clipping == CLIP_OUTSIDE)
+    return;
+
+  if ((framebuffer != NULL) || (clipping == CLIP_PARTIAL))
+  {
+    rasterDrawRectangle(x, y, width, height, color);
+    addPendingDirtyRect();
+    return;
+  }
+
+  lcd->drawRect(x, y, width, height, color);
+}
+
+
+
+//
+// draw rounded rectangle at the given coords, length, width and color
+//  Enter:  x, y = upper left corner of rect
+//          width = width of rectangle
+//          height = height of rectangle
+//          radius = radius of the corners
+//          color = 16 bit color, bit format: rrrrrggggggbbbbb
+//
+void TeensyUserInterface::lcdDrawRoundedRectangle(int x, int y, int width, int height, int radius, uint16_t color)
+{
+  countLcdDrawing();
+
+  if ((displayListDepth > 0) && recordDisplayListCommand(DISPLAY_LIST_ROUNDED_RECTANGLE, color, x, y, width, height, radius, 0, NULL))
+    return;
+
+  int clipping = getClipping(x, y, x + width - 1, y + height - 1);
+  if (clipping == CLIP_OUTSIDE)
+    return;
+
+  if ((framebuffer != NULL) || (clipping == CLIP_PARTIAL))
+  {
+    rasterDrawRoundedRectangle(x, y, width, height, radius, color);
+    addPendingDirtyRect();
+    return;
+  }
+
+  lcd->drawRoundRect(x, y, width, height, radius, color);
+}
+
+
+
+//
+// draw a circle at the given coords, radius and color
+//  Enter:  x0, y0 = endpoint 0 of the triangle
+//          x1, y1 = endpoint 1 of the triangle
+//          x2, y2 = endpoint 2 of the triangle
+//          color = 16 bit color, bit format: rrrrrggggggbbbbb
+//
+void TeensyUserInterface::lcdDrawTriangle(int x0, int y0, int x1, int y1, int x2, int y2, uint16_t color)
+{
+  countLcdDrawing();
+
+  if ((displayListDepth > 0) && recordDisplayListCommand(DISPLAY_LIST_TRIANGLE, color, x0, y0, x1, y1, x2, y2, NULL))
+    return;
+
+  int clipping = getClipping(min(x0, min(x1, x2)), min(y0, min(y1, y2)), max(x0, max(x1, x2)), max(y0, max(y1, y2)));
+  if (clipping == CLIP_OUTSIDE)
+    return;
+
+  if ((framebuffer != NULL) || (clipping == CLIP_PARTIAL))
+  {
+    rasterDrawTriangle(x0, y0, x1, y1, x2, y2, color);
+    addPendingDirtyRect();
+    return;
+  }
+
+  lcd->drawTriangle(x0, y0, x1, y1, x2, y2, color);
+}
+
+
+
+//
+// draw a triangle at the given coords and color
+//  Enter:  x, y = upper left corner of rect
+//          radius = radius of the circle
+//          color = 16 bit color, bit format: rrrrrggggggbbbbb
+//
+void TeensyUserInterface::lcdDrawCircle(int x, int y, int radius, uint16_t color)
+{
+  countLcdDrawing();
+
+  if ((displayListDepth > 0) && recordDisplayListCommand(DISPLAY_LIST_CIRCLE, color, x, y, radius, 0, 0, 0, NULL))
+    return;
+
+  int clipping = getClipping(x - radius, y - radius, x + radius, y + radius);
+  if (clipping == CLIP_OUTSIDE)
+    return;
+
+  if ((framebuffer != NULL) || (clipping == CLIP_PARTIAL))
+  {
+    rasterDrawCircle(x, y, radius, color);
+    addPendingDirtyRect();
+    return;
+  }
+
+  lcd->drawCircle(x, y, radius, color);
+}
+
+
+
+//
+// draw a filled rectangle at the given coords, length, width and color
+//  Enter:  x, y = upper left corner of rect
+//          width = width of rectangle
+//          height = height of rectangle
+//          color = 16 bit color, bit format: rrrrrggggggbbbbb
+//
+void TeensyUserInterface::lcdDrawFilledRectangle(int x, int y, int width, int height, uint16_t color)
+{
+  countLcdDrawing();
+  removeTouchRegionsUnder(x, y, x + width - 1, y + height - 1);
+
+  if ((displayListDepth > 0) && recordDisplayListCommand(DISPLAY_LIST_FILL_RECT, color, x, y, width, height, 0, 0, NULL))
+    return;
+
+  int clipping = getClipping(x, y, x + width - 1, y + height - 1);
+  if (clipping == CLIP_OUTSIDE)
+    return;
+
+  if ((framebuffer != NULL) || (clipping == CLIP_PARTIAL))
+  {
+    rasterFillRect(x, y, width, height, color);
+    addPendingDirtyRect();
+    return;
+  }
+
+  lcd->fillRect(x, y, width, height, color);
+}
+
+
+
+//
+// draw a filled rounded rectangle at the given coords, length, width and color
+//  Enter:  x, y = upper left corner of rect
+//          width = width of rectangle
+//          height = height of rectangle
+//          radius = radius of the corners
+//          color = 16 bit color, bit format: rrrrrggggggbbbbb
+//
+void TeensyUserInterface::lcdDrawFilledRoundedRectangle(int x, int y, int width, int height, int radius, uint16_t color)
+{
+  countLcdDrawing();
+
+  if ((displayListDepth > 0) && recordDisplayListCommand(DISPLAY_LIST_FILLED_ROUNDED_RECT, color, x, y, width, height, radius, 0, NULL))
+    return;
+
+  int clipping = getClipping(x, y, x + width - 1, y + height - 1);
+  if (clipping == CLIP_OUTSIDE)
+    return;
+
+  //
+  // with span fills on, rows of the same width are sent to the display together
+  //
+  if (lcdSpanFillsFlg || (framebuffer != NULL) || (clipping == CLIP_PARTIAL))
+  {
+    rasterFillRoundedRectangle(x, y, width, height, radius, color);
+    addPendingDirtyRect();
+    return;
+  }
+
+  lcd->fillRoundRect(x, y, width, height, radius, color);
+}
+
+
+
+//
+// draw a circle at the given coords, radius and color
+//  Enter:  x0, y0 = endpoint 0 of the triangle
+//          x1, y1 = endpoint 1 of the triangle
+//          x2, y2 = endpoint 2 of the triangle
+//          color = 16 bit color, bit format: rrrrrggggggbbbbb
+//
+void TeensyUserInterface::lcdDrawFilledTriangle(int x0, int y0, int x1, int y1, int x2, int y2, uint16_t color)
+{
+  countLcdDrawing();
+
+  if ((displayListDepth > 0) && recordDisplayListCommand(DISPLAY_LIST_FILLED_TRIANGLE, color, x0, y0, x1, y1, x2, y2, NULL))
+    return;
+
+  int clipping = getClipping(min(x0, min(x1, x2)), min(y0, min(y1, y2)), max(x0, max(x1, x2)), max(y0, max(y1, y2)));
+  if (clipping == CLIP_OUTSIDE)
+    return;
+
+  //
+  // with span fills on, rows of the same width are sent to the display together
+  //
+  if (lcdSpanFillsFlg || (framebuffer != NULL) || (clipping == CLIP_PARTIAL))
+  {
+    rasterFillTriangle(x0, y0, x1, y1, x2, y2, color);
+    addPendingDirtyRect();
+    return;
+  }
+
+  lcd->fillTriangle(x0, y0, x1, y1, x2, y2, color);
+}
+
+
+
+//
+// draw a filled circle at the given coords, radius and color
+//  Enter:  x, y = upper left corner of rect
+//          radius = radius of the circle
+//          color = 16 bit color, bit format: rrrrrggggggbbbbb
+//
+void TeensyUserInterface::lcdDrawFilledCircle(int x, int y, int radius, uint16_t color)
+{
+  countLcdDrawing();
+
+  if ((displayListDepth > 0) && recordDisplayListCommand(DISPLAY_LIST_FILLED_CIRCLE, color, x, y, radius, 0, 0, 0, NULL))
+    return;
+
+  int clipping = getClipping(x - radius, y - radius, x + radius, y + radius);
+  if (clipping == CLIP_OUTSIDE)
+    return;
+
+  //
+  // with span fills on, rows of the same width are sent to the display together
+  //
+  if (lcdSpanFillsFlg || (framebuffer != NULL) || (clipping == CLIP_PARTIAL))
+  {
+    rasterFillCircle(x, y, radius, color);
+    addPendingDirtyRect();
+    return;
+  }
+
+  lcd->fillCircle(x, y, radius, color);
+}
+
+
+
+
+//
+// draw an image
+//  Enter:  x, y = coords of upper left corner on LCD where the image will be displayed
+//          width, height =  size of the image, this must be the same as the image data
+//          image -> image data, 2 bytes/pixel in the RGB565 format stored in PROGMEM
+// Note: use this utility to convert an image to C sourse code:
+//       www.rinkydinkelectronics.com/_t_doimageconverter565.php
+//
+void TeensyUserInterface::lcdDrawImage(int x, int y, int width, int height, const uint16_t *image)
+{
+  countLcdDrawing();
+  removeTouchRegionsUnder(x, y, x + width - 1, y + height - 1);
+
+  if ((displayListDepth > 0) && recordDisplayListCommand(DISPLAY_LIST_IMAGE, 0, x, y, width, height, 0, 0, image))
+    return;
+
+  int clipping = getClipping(x, y, x + width - 1, y + height - 1);
+  if (clipping == CLIP_OUTSIDE)
+    return;
+
+  if ((framebuffer != NULL) || (clipping == CLIP_PARTIAL))
+  {
+    rasterDrawImage(x, y, width, height, image);
+    addPendingDirtyRect();
+    return;
+  }
+
+  lcd->writeRect(x, y, width, height, image);
+}
+
+
+
+//
+// set the text font for the "print" functions
+//  Enter:  font -> the font typeface to load
+//          ie: Arial_8, Arial_8_Bold, Arial_9, Arial_9_Bold, Arial_10, Arial_10_Bold, Arial_11, Arial_11_Bold,
+//              Arial_12, 13, 14, 16, 18, 20, 24, 28, 32, 40, 48, 60, 72, 96
+//
+void TeensyUserInterface::lcdSetFont(const ui_font &font)
+{
+  lcd->setFont(font);
+  currentFont = &font;
+  currentFontAdvances = getFontAdvanceTable(&font);
+}
+
+
+
+//
+// set the foreground color for the "print" functions
+//  Enter:  color = 16 bit color, bit format: rrrrrggggggbbbbb
+//
+void TeensyUserInterface::lcdSetFontColor(uint16_t color)
+{
+  lcd->setTextColor(color);
+}
+
+
+
+//
+// print a string to the LCD display
+//  Enter:  s -> a null terminated string 
+//
+void TeensyUserInterface::lcdPrint(char *s)
+{
+  lcdPrint((const char *) s);
+}
+
+void TeensyUserInterface::lcdPrint(const char *s)
+{
+  countLcdDrawing();
+
+  if ((displayListDepth > 0) && recordDisplayListText(DISPLAY_LIST_TEXT, s, 0))
+    return;
+
+  //
+  // clipped text, and text using the glyph cache, is drawn by the rasterizer
+  //
+  boolean clippedFlg = (getClipping(0, 0, lcdWidth - 1, lcdHeight - 1) != CLIP_INSIDE);
+  if ((framebuffer != NULL) || clippedFlg || glyphCacheAvailable())
+  {
+    rasterPrint(s);
+    addPendingDirtyRect();
+    return;
+  }
+
+  lcd->print(s);
+}
+
+
+
+//
+// print a signed int at location of the cursor
+//  Enter:  n = signed number to print 
+//
+void TeensyUserInterface::lcdPrint(int n)
+{
+  char stringBuffer[14];
+  
+  itoa(n, stringBuffer, 10);
+  lcdPrint(stringBuffer);
+}
+
+
+
+//
+// print a float or double at location of the cursor
+//  Enter:  n = signed number to print 
+//          digitsRightOfDecimal = number of digits to display right of decimal point (optional)
+//
+void TeensyUserInterface::lcdPrint(double n, int digitsRightOfDecimal)
+{
+  char stringBuffer[40];
+
+  dtostrf(n, 1, digitsRightOfDecimal, stringBuffer);
+  lcdPrint(stringBuffer);
+}
+
+
+
+//
+// print a string to the LCD, right justified at the cursor
+//  Enter:  s -> string to print 
+//
+void TeensyUserInterface::lcdPrintRightJustified(char *s)
+{
+  int cursorX;
+  int cursorY;
+
+  lcdGetCursorXY(&cursorX, &cursorY);           // get the current cursor position
+  int stringWidth = lcdStringWidthInPixels(s);  // get the width of the string to print
+  cursorX = cursorX - stringWidth;              // determine new X coord for cursor to right justify
+
+  if (cursorX < 0)                              // set the new cursor position
+    cursorX = 0;
+  lcdSetCursorXY(cursorX, cursorY);
+  
+  lcdPrint(s);                                  // print the string
+}
+
+void TeensyUserInterface::lcdPrintRightJustified(const char *s)
+{
+  lcdPrintRightJustified((char *)s);
+}
+
+
+
+//
+// print a signed int on the LCD, right justify at the cursor 
+//  Enter:  n = signed number to print 
+//
+void TeensyUserInterface::lcdPrintRightJustified(int n)
+{
+  char stringBuffer[14];
+  
+  itoa(n, stringBuffer, 10);
+  lcdPrintRightJustified(stringBuffer);
+}
+
+
+
+//
+// print a float on the LCD, right justify at the cursor 
+//  Enter:  n = signed number to print 
+//          digitsRightOfDecimal = number of digits to display right of decimal point (optional)
+//
+void TeensyUserInterface::lcdPrintRightJustified(double n, int digitsRightOfDecimal)
+{
+  char stringBuffer[40];
+
+  dtostrf(n, 1, digitsRightOfDecimal, stringBuffer);
+  lcdPrintRightJustified(stringBuffer);
+}
+
+
+
+//
+// print a string to the LCD, centered side-to-side at the cursor 
+//  Enter:  s -> string to print 
+//
+void TeensyUserInterface::lcdPrintCentered(char *s)
+{
+  int cursorX;
+  int cursorY;
+
+  lcdGetCursorXY(&cursorX, &cursorY);           // get the current cursor position
+  int stringWidth = lcdStringWidthInPixels(s);  // get the width of the string to print
+  cursorX = cursorX - stringWidth/2;            // determine new X coord for cursor to center
+
+  if (cursorX < 0)                              // set the new cursor position
+    cursorX = 0;
+  lcdSetCursorXY(cursorX, cursorY);
+  
+  lcdPrint(s);                                  // print the string
+}
+
+void TeensyUserInterface::lcdPrintCentered(const char *s)
+{
+  lcdPrintCentered((char *) s);
+}
+
+
+
+//
+// print a signed int to the LCD, centered side-to-side at the cursor
+//  Enter:  n = signed number to print 
+//
+void TeensyUserInterface::lcdPrintCentered(int n)
+{
+  char stringBuffer[14];
+  
+  itoa(n, stringBuffer, 10);
+  lcdPrintCentered(stringBuffer);
+}
+
+
+
+//
+// print a float to the LCD, centered side-to-side at the cursor
+//          digitsRightOfDecimal = number of digits to display right of decimal point (optional)
+//  Enter:  n = signed number to print 
+//
+void TeensyUserInterface::lcdPrintCentered(double n, int digitsRightOfDecimal)
+{
+  char stringBuffer[40];
+
+  dtostrf(n, 1, digitsRightOfDecimal, stringBuffer);
+  lcdPrintCentered(stringBuffer);
+}
+
+
+
+//
+// print one ASCII charater to the LCD, at location of the cursor
+//  Enter:  c = character to display
+//
+void TeensyUserInterface::lcdPrintCharacter(byte character)
+{
+  countLcdDrawing();
+
+  if ((displayListDepth > 0) && recordDisplayListText(DISPLAY_LIST_CHARACTER, NULL, character))
+    return;
+
+  //
+  // clipped text, and text using the glyph cache, is drawn by the rasterizer
+  //
+  boolean clippedFlg = (getClipping(0, 0, lcdWidth - 1, lcdHeight - 1) != CLIP_INSIDE);
+  if ((framebuffer != NULL) || clippedFlg || glyphCacheAvailable())
+  {
+    rasterDrawFontCharacter(character);
+    addPendingDirtyRect();
+    return;
+  }
+
+  lcd->drawFontChar(character);
+}
+
+
+
+//
+// get the width of a string in pixels, for strings with several lines the width of 
+// the widest line is returned
+//
+int TeensyUserInterface::lcdStringWidthInPixels(char *s)
+{
+  return(lcdStringWidthInPixels((const char *) s));
+}
+
+int TeensyUserInterface::lcdStringWidthInPixels(const char *s)
+{
+  int width = 0;
+  int maxWidth = 0;
+
+  //
+  // add up the characters' advances from the font's table
+  //
+  while(*s)
+  {
+    byte c = *s++;
+    if (c == '\n')
+    {
+      if (width > maxWidth)
+        maxWidth = width;
+      width = 0;
+    }
+    else if (c < LCD_FONT_ADVANCE_TABLE_SIZE)
+      width += currentFontAdvances->advance[c];
+    else
+      width += fontGetCharacterAdvance(currentFont, c);
+  }
+
+  if (width > maxWidth)
+    maxWidth = width;
+  return(maxWidth);
+}
+
+
+
+//
+// get the width in pixels of a string that never changes, the widths of recently 
+// measured strings are remembered by the string's address and font
+//  Enter:  s -> a null terminated string that's never changed
+//  Exit:   width in pixels returned
+//
+int TeensyUserInterface::constantStringWidthInPixels(const char *s)
+{
+  for (int i = 0; i < LCD_MAX_MEMOIZED_WIDTHS; i++)
+  {
+    if ((memoizedWidths[i].s == s) && (memoizedWidths[i].font == currentFont))
+      return(memoizedWidths[i].width);
+  }
+
+  int width = lcdStringWidthInPixels(s);
+
+  LCD_MEMOIZED_WIDTH *memo = &memoizedWidths[memoizedWidthNext];
+  memo->font = currentFont;
+  memo->s = s;
+  memo->width = width;
+  memoizedWidthNext = (memoizedWidthNext + 1) % LCD_MAX_MEMOIZED_WIDTHS;
+  return(width);
+}
+
+
+
+//
+// get the height of the selected font in pixels, excluding decenders
+//
+int TeensyUserInterface::lcdGetFontHeightWithoutDecenders(void)
+{
+  return(currentFont->cap_height);
+}
+
+
+
+//
+// get the height of the selected font in pixels, including decenders & line spacing
+//
+int TeensyUserInterface::lcdGetFontHeightWithDecentersAndLineSpacing(void)
+{
+  return(currentFont->line_space);
+}
+
+
+
+//
+// set the cursor coords in pixels
+//  Enter:  x  0 = left most pixel
+//          y  0 = left most pixel
+//
+void TeensyUserInterface::lcdSetCursorXY(int x, int y)
+{
+  if ((x < 0) || (x >= lcdWidth)) return;
+  if ((y < 0) || (y >= lcdHeight)) return;
+  
+  lcd->setCursor(x, y);
+}
+
+
+
+//
+// get the cursor coords in pixels
+//  Enter:  x -> storage to return X,  0 = left most pixel
+//          y -> storage to return Y,  0 = left most pixel
+//
+void TeensyUserInterface::lcdGetCursorXY(int *x, int *y)
+{
+  int16_t x1;
+  int16_t y1;
+
+  lcd->getCursor(&x1, &y1);
+  *x = x1;
+  *y = y1;
+}
+
+
+
+//
+// make a RGB565 color
+//  Enter:  red (0 to 31)
+//          green (0 to 63) Note: green value 0x20 has same intensity as blue value 0x10
+//          blue (0 to 31)
+//  Exit:   16 bit color returned, bit format: rrrrrggggggbbbbb
+//
+uint16_t TeensyUserInterface::lcdMakeColor(int red, int green, int blue)
+{
+  return((red << 11) + (green << 5) + (blue));
+}
+
+
+
+//
+// limit drawing to a rectangle, the new clip rectangle is the part of the given one 
+// that's inside the current clip rectangle, nothing outside of it is drawn until 
+// lcdPopClipRect() is called
+//  Enter:  x, y = upper left corner of the clip rectangle
+//          width, height = size of the clip rectangle
+//  Exit:   true returned on success, false if too many clip rectangles are pushed
+//
+boolean TeensyUserInterface::lcdPushClipRect(int x, int y, int width, int height)
+{
+  if (clipStackCount >= LCD_MAX_CLIP_RECTS)
+    return(false);
+
+  clipStack[clipStackCount++] = clipRect;
+  clipRect.x1 = max(x, (int) clipRect.x1);
+  clipRect.y1 = max(y, (int) clipRect.y1);
+  clipRect.x2 = min(x + width - 1, (int) clipRect.x2);
+  clipRect.y2 = min(y + height - 1, (int) clipRect.y2);
+
+  if (displayListDepth > 0)
+    recordDisplayListCommand(DISPLAY_LIST_SET_CLIP, 0, clipRect.x1, clipRect.y1, 
+      clipRect.x2 - clipRect.x1 + 1, clipRect.y2 - clipRect.y1 + 1, 0, 0, NULL);
+  return(true);
+}
+
+
+
+//
+// restore the clip rectangle in effect before the last lcdPushClipRect()
+//
+void TeensyUserInterface::lcdPopClipRect(void)
+{
+  if (clipStackCount == 0)
+    return;
+
+  clipRect = clipStack[--clipStackCount];
+
+  if (displayListDepth > 0)
+    recordDisplayListCommand(DISPLAY_LIST_SET_CLIP, 0, clipRect.x1, clipRect.y1, 
+      clipRect.x2 - clipRect.x1 + 1, clipRect.y2 - clipRect.y1 + 1, 0, 0, NULL);
+}
+
+
+
+//
+// set filled circles, rounded rectangles and triangles to be drawn by the rasterizer 
+// as horizontal runs, runs of the same width on neighboring rows are sent with one 
+// address window, rather than by the LCD driver as a vertical line for each column
+//  Enter:  enableFlg = true to draw filled shapes as runs, false to use the LCD 
+//            driver (default)
+//
+void TeensyUserInterface::lcdSetSpanFills(boolean enableFlg)
+{
+  lcdSpanFillsFlg = enableFlg;
+}
+
+
+
+//
+// start a batch of drawing, until lcdEndBatch() is called everything drawn directly 
+// to the display is sent as runs of pixels in one SPI transaction, rows of the same 
+// width that follow each other are sent with one address window, batches can be nested
+//
+void TeensyUserInterface::lcdBeginBatch(void)
+{
+  batchDepth++;
+}
+
+
+
+//
+// end a batch of drawing, sending anything not yet sent and ending the SPI transaction
+//
+void TeensyUserInterface::lcdEndBatch(void)
+{
+  if (batchDepth == 0)
+    return;
+
+  batchDepth--;
+  if (batchDepth == 0)
+    finishSpans();
+}
+
+
+
+//
+// get counts of the runs of pixels drawn directly to the display by the rasterizer, 
+// and of the address windows used to send them, since the counts were last cleared
+//  Enter:  spansDrawn -> storage to return the number of runs drawn
+//          addressWindowsSet -> storage to return the number of address windows set
+//
+void TeensyUserInterface::lcdGetSpanStatistics(unsigned long *spansDrawn, unsigned long *addressWindowsSet)
+{
+  *spansDrawn = spanCount;
+  *addressWindowsSet = addressWindowCount;
+}
+
+
+
+//
+// clear the counts of runs drawn and address windows set
+//
+void TeensyUserInterface::lcdClearSpanStatistics(void)
+{
+  spanCount = 0;
+  addressWindowCount = 0;
+}
+
+
+
+//
+// count drawing done outside of the menus, so they know when they've been drawn over, 
+// every lcd drawing function calls this before drawing or recording anything
+//
+void TeensyUserInterface::countLcdDrawing(void)
+{
+  if (menuDrawingDepth == 0)
+    lcdDrawCount++;
+}
+
+
+
+//
+// determine how the region a drawing function covers relates to the clip rectangle
+//  Enter:  x1, y1 = upper left corner of the region
+//          x2, y2 = lower right corner of the region
+//  Exit:   CLIP_OUTSIDE returned if nothing would be drawn, CLIP_INSIDE if it can be 
+//          drawn by the LCD driver, CLIP_PARTIAL if it must be drawn by the rasterizer
+//          because it's partly clipped, a batch is open or the display space is scrolled
+//
+int TeensyUserInterface::getClipping(int x1, int y1, int x2, int y2)
+{
+  if ((x2 < clipRect.x1) || (x1 > clipRect.x2) || (y2 < clipRect.y1) || (y1 > clipRect.y2) || 
+      (clipRect.x1 > clipRect.x2) || (clipRect.y1 > clipRect.y2))
+    return(CLIP_OUTSIDE);
+
+  //
+  // while batching, everything is drawn by the rasterizer so it shares one SPI transaction
+  //
+  if ((batchDepth > 0) && (framebuffer == NULL))
+    return(CLIP_PARTIAL);
+
+  //
+  // the driver can't draw into the display space when it's scrolled
+  //
+  if ((scrollOffset != 0) && (y2 >= displaySpaceTopY) && (y1 <= displaySpaceBottomY))
+    return(CLIP_PARTIAL);
+
+  //
+  // when clipping to the whole screen, the driver clips itself
+  //
+  if ((clipRect.x1 == 0) && (clipRect.y1 == 0) && (clipRect.x2 == lcdWidth - 1) && (clipRect.y2 == lcdHeight - 1))
+    return(CLIP_INSIDE);
+
+  if ((x1 >= clipRect.x1) && (x2 <= clipRect.x2) && (y1 >= clipRect.y1) && (y2 <= clipRect.y2))
+    return(CLIP_INSIDE);
+  return(CLIP_PARTIAL);
+}
+
+
+
+//
+// map a run of rows on the screen to rows in the LCD's memory (and the framebuffer), 
+// they differ only in the display space, after it has been scrolled
+//  Enter:  y = first row of the run
+//          lastY = last row of the run
+//          memoryY -> storage to return the row in memory of the first row
+//  Exit:   the last row that's contiguous in memory with the first is returned
+//
+int TeensyUserInterface::mapRowsToMemory(int y, int lastY, int *memoryY)
+{
+  *memoryY = y;
+  if (scrollOffset == 0)
+    return(lastY);
+
+  if (y < displaySpaceTopY)
+    return(min(lastY, displaySpaceTopY - 1));
+
+  if (y > displaySpaceBottomY)
+    return(lastY);
+
+  int row = y - displaySpaceTopY + scrollOffset;
+  if (row >= displaySpaceHeight)
+    row -= displaySpaceHeight;
+  *memoryY = displaySpaceTopY + row;
+  return(min(lastY, min(displaySpaceBottomY, y + (displaySpaceHeight - 1 - row))));
+}
+
+
+// ---------------------------------------------------------------------------------
+//                                 Framebuffer functions
+// ---------------------------------------------------------------------------------
+
+//
+// Normally every lcd drawing function sends its pixels straight to the display.  When 
+// the framebuffer is enabled, drawing is done in RAM instead, and the regions of the 
+// screen that have changed are recorded.  Those "dirty" regions are sent to the display 
+// by lcdFlush(), each using one address window.  A menu redraw then sends each pixel 
+// only once, even though the background, button faces and text overlap.  
+//
+// Before a region is sent, the screen is divided into 16x16 tiles and each tile that 
+// region covers is checksummed.  Tiles whose checksum matches what was last sent are 
+// skipped, so redrawing a menu that ends up identical to what's shown sends nothing.
+//
+// The dirty regions can also be sent a chunk at a time: lcdStartFlush() hands them to 
+// a transfer engine that sends a chunk of rows each time lcdContinueFlush() is called.
+// getTouchEvents() starts and continues these transfers, so touches are still sampled 
+// (and the in-menu callback still runs) between the chunks of a large redraw.  This 
+// isn't a background transfer, ILI9341_t3 has no DMA, so each chunk is sent by the 
+// caller and the transfer only advances while getTouchEvents() is being called.  Most 
+// applications don't need to call any of the flush functions.  The framebuffer needs  
+// 2 bytes per pixel (153,600 bytes for a 320x240 display).
+//
+
+//
+// enable drawing into a framebuffer, the framebuffer is cleared to black
+//  Enter:  framebufferMemory -> memory for the framebuffer (lcdWidth * lcdHeight pixels), 
+//            or NULL to allocate it from the heap
+//  Exit:   true returned on success, false if the memory could not be allocated
+//
+boolean TeensyUserInterface::lcdEnableFramebuffer(uint16_t *framebufferMemory)
+{
+  if (framebuffer != NULL)
+    return(true);
+
+  if (framebufferMemory == NULL)
+  {
+    framebufferMemory = (uint16_t *) malloc(lcdWidth * lcdHeight * sizeof(uint16_t));
+    if (framebufferMemory == NULL)
+      return(false);
+    framebufferAllocatedFlg = true;
+  }
+  else
+    framebufferAllocatedFlg = false;
+
+  framebuffer = framebufferMemory;
+  dirtyRectCount = 0;
+  flushQueueCount = 0;
+
+  //
+  // allocate the tile checksums, without them every dirty region is sent
+  //
+  int tileCount = ((lcdWidth + LCD_TILE_SIZE - 1) / LCD_TILE_SIZE) * ((lcdHeight + LCD_TILE_SIZE - 1) / LCD_TILE_SIZE);
+  tileChecksums = (uint32_t *) malloc(tileCount * sizeof(uint32_t));
+  tileFlags = (byte *) malloc(tileCount);
+  if ((tileChecksums == NULL) || (tileFlags == NULL))
+  {
+    free(tileChecksums);
+    free(tileFlags);
+    tileChecksums = NULL;
+    tileFlags = NULL;
+  }
+  else
+    memset(tileFlags, 0, tileCount);
+
+  lcdClearScreen(LCD_BLACK);
+  return(true);
+}
+
+
+
+//
+// stop using the framebuffer, anything not yet flushed is sent to the display first
+//
+void TeensyUserInterface::lcdDisableFramebuffer(void)
+{
+  if (framebuffer == NULL)
+    return;
+
+  lcdFlush();
+  if (framebufferAllocatedFlg)
+    free(framebuffer);
+  framebuffer = NULL;
+  framebufferAllocatedFlg = false;
+
+  free(tileChecksums);
+  free(tileFlags);
+  tileChecksums = NULL;
+  tileFlags = NULL;
+}
+
+
+
+//
+// send the regions of the framebuffer that have changed to the display, returning 
+// when the transfer is complete
+//
+void TeensyUserInterface::lcdFlush(void)
+{
+  if (framebuffer == NULL)
+    return;
+
+  //
+  // finish any transfer already running, then send what has changed since it started
+  //
+  while (lcdFlushInProgress())
+    lcdContinueFlush();
+
+  lcdStartFlush();
+  while (lcdFlushInProgress())
+    lcdContinueFlush();
+}
+
+
+
+//
+// start sending the regions of the framebuffer that have changed to the display, the 
+// transfer is done in chunks by lcdContinueFlush(), if a transfer is already in 
+// progress, new changes are sent by the next one
+//
+void TeensyUserInterface::lcdStartFlush(void)
+{
+  if ((framebuffer == NULL) || lcdFlushInProgress() || (dirtyRectCount == 0))
+    return;
+
+  //
+  // move the dirty regions to the transfer queue, drawing done from here on starts 
+  // a new list
+  //
+  for (int i = 0; i < dirtyRectCount; i++)
+    flushQueue[i] = dirtyRects[i];
+  flushQueueCount = dirtyRectCount;
+  flushQueueIdx = 0;
+  flushRowY = flushQueue[0].y1;
+  flushX = flushQueue[0].x1;
+  dirtyRectCount = 0;
+
+  //
+  // find the tiles in the queued regions whose contents have changed
+  //
+  findChangedTiles();
+}
+
+
+
+//
+// send the next chunk of a transfer started by lcdStartFlush(), this is called by 
+// getTouchEvents()
+//
+void TeensyUserInterface::lcdContinueFlush(void)
+{
+  if (!lcdFlushInProgress())
+    return;
+
+  int pixelsRemaining = flushChunkSize;
+  while ((pixelsRemaining > 0) && (flushQueueIdx < flushQueueCount))
+  {
+    LCD_RECT &r = flushQueue[flushQueueIdx];
+    int runX1 = flushX;
+    int runX2 = r.x2;
+    int lastRowY;
+
+    if (tileChecksums == NULL)
+    {
+      //
+      // no tiles, send as many whole rows of the region as fit in this chunk
+      //
+      int rows = pixelsRemaining / (runX2 - runX1 + 1);
+      if (rows < 1) rows = 1;
+      lastRowY = flushRowY + rows - 1;
+      if (lastRowY > r.y2) lastRowY = r.y2;
+    }
+    else
+    {
+      //
+      // send the next run of changed tiles along this row of tiles
+      //
+      lastRowY = ((flushRowY / LCD_TILE_SIZE) + 1) * LCD_TILE_SIZE - 1;
+      if (lastRowY > r.y2) lastRowY = r.y2;
+      if (!findChangedTileRun(flushRowY, &runX1, &runX2))
+        runX1 = runX2 + 1;
+    }
+
+    if (runX1 <= runX2)
+    {
+      lcd->writeRectFromFramebuffer(runX1, flushRowY, runX2 - runX1 + 1, lastRowY - flushRowY + 1, 
+        framebuffer + (flushRowY * lcdWidth) + runX1, lcdWidth);
+      pixelsRemaining -= (runX2 - runX1 + 1) * (lastRowY - flushRowY + 1);
+    }
+
+    //
+    // advance to the next run, row of tiles, or region
+    //
+    flushX = runX2 + 1;
+    if (flushX > r.x2)
+    {
+      flushX = r.x1;
+      flushRowY = lastRowY + 1;
+      if (flushRowY > r.y2)
+      {
+        flushQueueIdx++;
+        if (flushQueueIdx < flushQueueCount)
+        {
+          flushRowY = flushQueue[flushQueueIdx].y1;
+          flushX = flushQueue[flushQueueIdx].x1;
+        }
+      }
+    }
+  }
+
+  //
+  // check if the transfer is complete
+  //
+  if (flushQueueIdx >= flushQueueCount)
+  {
+    flushQueueCount = 0;
+    if (flushCompleteCallbackFunction != NULL)
+      (flushCompleteCallbackFunction)();
+  }
+}
+
+
+
+//
+// check if a transfer of the framebuffer to the display is underway
+//  Exit:   true returned if a transfer is in progress
+//
+boolean TeensyUserInterface::lcdFlushInProgress(void)
+{
+  return(flushQueueCount > 0);
+}
+
+
+
+//
+// get counts of the tiles sent and skipped because they hadn't changed, since the 
+// counts were last cleared
+//  Enter:  tilesSent -> storage to return the number of tiles sent to the display
+//          tilesSkipped -> storage to return the number of tiles that were unchanged
+//
+void TeensyUserInterface::lcdGetTileStatistics(unsigned long *tilesSent, unsigned long *tilesSkipped)
+{
+  *tilesSent = tileSentCount;
+  *tilesSkipped = tileSkippedCount;
+}
+
+
+
+//
+// clear the counts of tiles sent and skipped
+//
+void TeensyUserInterface::lcdClearTileStatistics(void)
+{
+  tileSentCount = 0;
+  tileSkippedCount = 0;
+}
+
+
+
+//
+// flag the tiles covered by the transfer queue whose contents differ from what was 
+// last sent to the display
+//
+void TeensyUserInterface::findChangedTiles(void)
+{
+  if (tileChecksums == NULL)
+    return;
+
+  int tilesAcross = (lcdWidth + LCD_TILE_SIZE - 1) / LCD_TILE_SIZE;
+  int tilesDown = (lcdHeight + LCD_TILE_SIZE - 1) / LCD_TILE_SIZE;
+
+  //
+  // flag every tile covered by a queued region
+  //
+  for (int i = 0; i < flushQueueCount; i++)
+  {
+    LCD_RECT &r = flushQueue[i];
+    for (int tileRow = r.y1 / LCD_TILE_SIZE; tileRow <= r.y2 / LCD_TILE_SIZE; tileRow++)
+    {
+      for (int tileColumn = r.x1 / LCD_TILE_SIZE; tileColumn <= r.x2 / LCD_TILE_SIZE; tileColumn++)
+        tileFlags[tileRow * tilesAcross + tileColumn] |= TILE_FLAG_COVERED;
+    }
+  }
+
+  //
+  // checksum the covered tiles, keeping only those that changed
+  //
+  for (int tileRow = 0; tileRow < tilesDown; tileRow++)
+  {
+    for (int tileColumn = 0; tileColumn < tilesAcross; tileColumn++)
+    {
+      byte &flags = tileFlags[tileRow * tilesAcross + tileColumn];
+      if (!(flags & TILE_FLAG_COVERED))
+      {
+        flags &= TILE_FLAG_CHECKSUM_VALID;
+        continue;
+      }
+
+      //
+      // FNV-1a checksum of the tile's pixels
+      //
+      int x1 = tileColumn * LCD_TILE_SIZE;
+      int y1 = tileRow * LCD_TILE_SIZE;
+      int width = (x1 + LCD_TILE_SIZE > lcdWidth) ? lcdWidth - x1 : LCD_TILE_SIZE;
+      int height = (y1 + LCD_TILE_SIZE > lcdHeight) ? lcdHeight - y1 : LCD_TILE_SIZE;
+      uint32_t checksum = 2166136261UL;
+      for (int y = y1; y < y1 + height; y++)
+      {
+        const uint16_t *p = framebuffer + (y * lcdWidth) + x1;
+        for (int x = 0; x < width; x++)
+          checksum = (checksum ^ *p++) * 16777619UL;
+      }
+
+      uint32_t &lastChecksum = tileChecksums[tileRow * tilesAcross + tileColumn];
+      if ((flags & TILE_FLAG_CHECKSUM_VALID) && (checksum == lastChecksum))
+      {
+        flags = TILE_FLAG_CHECKSUM_VALID;
+        tileSkippedCount++;
+      }
+      else
+      {
+        lastChecksum = checksum;
+        flags = TILE_FLAG_CHECKSUM_VALID | TILE_FLAG_CHANGED;
+        tileSentCount++;
+      }
+    }
+  }
+}
+
+
+
+//
+// find the next run of changed tiles in the current row of tiles of the region being sent
+//  Enter:  y = Y coord in the row of tiles
+//          runX1 -> X coord to start searching from, the run's first X coord is returned
+//          runX2 -> last X coord to search, the run's last X coord is returned
+//  Exit:   true returned if a run was found
+//
+boolean TeensyUserInterface::findChangedTileRun(int y, int *runX1, int *runX2)
+{
+  int tilesAcross = (lcdWidth + LCD_TILE_SIZE - 1) / LCD_TILE_SIZE;
+  byte *rowFlags = tileFlags + ((y / LCD_TILE_SIZE) * tilesAcross);
+  int lastColumn = *runX2 / LCD_TILE_SIZE;
+
+  int column = *runX1 / LCD_TILE_SIZE;
+  while ((column <= lastColumn) && !(rowFlags[column] & TILE_FLAG_CHANGED))
+    column++;
+  if (column > lastColumn)
+    return(false);
+
+  if (column * LCD_TILE_SIZE > *runX1)
+    *runX1 = column * LCD_TILE_SIZE;
+
+  while ((column <= lastColumn) && (rowFlags[column] & TILE_FLAG_CHANGED))
+    column++;
+  if (column * LCD_TILE_SIZE - 1 < *runX2)
+    *runX2 = column * LCD_TILE_SIZE - 1;
+  return(true);
+}
+
+
+
+//
+// set the number of pixels sent each time lcdContinueFlush() is called, smaller 
+// chunks keep touch sampling more responsive, larger ones finish the transfer sooner, 
+// a chunk always finishes the run of changed tiles it starts, so it can send up to 16 
+// rows of a region
+//  Enter:  pixelsPerChunk = pixels to send per chunk (2048 pixels takes about 1ms)
+//
+void TeensyUserInterface::lcdSetFlushChunkSize(int pixelsPerChunk)
+{
+  if (pixelsPerChunk < 1)
+    pixelsPerChunk = 1;
+  flushChunkSize = pixelsPerChunk;
+}
+
+
+
+//
+// set a callback function that's executed each time a transfer of the framebuffer 
+// to the display completes
+//  Enter:  callbackFunction -> function to execute, set to NULL to disable
+//
+void TeensyUserInterface::lcdSetFlushCompleteCallbackFunction(void (*callbackFunction)())
+{
+  flushCompleteCallbackFunction = callbackFunction;
+}
+
+
+
+//
+// add the region touched by the last drawing function to the list of dirty rectangles,
+// when drawing directly to the display the region is discarded and the last run of 
+// pixels is sent
+//
+void TeensyUserInterface::addPendingDirtyRect(void)
+{
+  if (framebuffer == NULL)
+  {
+    finishSpans();
+    clearPendingDirtyRect();
+    return;
+  }
+
+  if (pendingDirtyX1 > pendingDirtyX2)
+    return;
+
+  //
+  // the dirty rectangles are kept in memory rows
+  //
+  int y = pendingDirtyY1;
+  while (y <= pendingDirtyY2)
+  {
+    int memoryY;
+    int runY2 = mapRowsToMemory(y, pendingDirtyY2, &memoryY);
+    addDirtyRect(pendingDirtyX1, memoryY, pendingDirtyX2, memoryY + runY2 - y);
+    y = runY2 + 1;
+  }
+  clearPendingDirtyRect();
+}
+
+
+
+//
+// start a new empty region for the next drawing function
+//
+void TeensyUserInterface::clearPendingDirtyRect(void)
+{
+  pendingDirtyX1 = 0x7fff;
+  pendingDirtyY1 = 0x7fff;
+  pendingDirtyX2 = -1;
+  pendingDirtyY2 = -1;
+}
+
+
+
+//
+// add a rectangle to the list of regions that need sending to the display, rectangles
+// are merged when their union costs no more pixels than sending them separately
+//  Enter:  x1, y1 = upper left corner of the region
+//          x2, y2 = lower right corner of the region
+//
+void TeensyUserInterface::addDirtyRect(int x1, int y1, int x2, int y2)
+{
+  int i = 0;
+  while(i < dirtyRectCount)
+  {
+    LCD_RECT &r = dirtyRects[i];
+    int ux1 = (r.x1 < x1) ? r.x1 : x1;
+    int uy1 = (r.y1 < y1) ? r.y1 : y1;
+    int ux2 = (r.x2 > x2) ? r.x2 : x2;
+    int uy2 = (r.y2 > y2) ? r.y2 : y2;
+    long unionArea = (long)(ux2 - ux1 + 1) * (uy2 - uy1 + 1);
+    long separateArea = (long)(x2 - x1 + 1) * (y2 - y1 + 1) + (long)(r.x2 - r.x1 + 1) * (r.y2 - r.y1 + 1);
+
+    //
+    // merge with this rect, then start over since the larger rect may now absorb others
+    //
+    if (unionArea <= separateArea)
+    {
+      x1 = ux1;  y1 = uy1;  x2 = ux2;  y2 = uy2;
+      dirtyRects[i] = dirtyRects[--dirtyRectCount];
+      i = 0;
+      continue;
+    }
+    i++;
+  }
+
+  //
+  // if the list is full, merge with the rect that adds the fewest extra pixels
+  //
+  while (dirtyRectCount >= LCD_MAX_DIRTY_RECTS)
+  {
+    int bestIdx = 0;
+    long bestGrowth = 0x7fffffff;
+    for (i = 0; i < dirtyRectCount; i++)
+    {
+      LCD_RECT &r = dirtyRects[i];
+      int ux1 = (r.x1 < x1) ? r.x1 : x1;
+      int uy1 = (r.y1 < y1) ? r.y1 : y1;
+      int ux2 = (r.x2 > x2) ? r.x2 : x2;
+      int uy2 = (r.y2 > y2) ? r.y2 : y2;
+      long growth = (long)(ux2 - ux1 + 1) * (uy2 - uy1 + 1) - (long)(r.x2 - r.x1 + 1) * (r.y2 - r.y1 + 1);
+      if (growth < bestGrowth)
+      {
+        bestGrowth = growth;
+        bestIdx = i;
+      }
+    }
+
+    LCD_RECT &r = dirtyRects[bestIdx];
+    if (r.x1 < x1) x1 = r.x1;
+    if (r.y1 < y1) y1 = r.y1;
+    if (r.x2 > x2) x2 = r.x2;
+    if (r.y2 > y2) y2 = r.y2;
+    dirtyRects[bestIdx] = dirtyRects[--dirtyRectCount];
+  }
+
+  LCD_RECT &newRect = dirtyRects[dirtyRectCount++];
+  newRect.x1 = x1;
+  newRect.y1 = y1;
+  newRect.x2 = x2;
+  newRect.y2 = y2;
+}
+
+
+
+//
+// send a rectangle of pixels from the framebuffer to the display using one address window
+//  Enter:  x, y = upper left corner on the display
+//          width, height = size of the rectangle
+//          pixels -> first pixel in the framebuffer
+//          pixelsPerRow = number of pixels in each row of the framebuffer
+//
+void TeensyUserInterfaceLCD::writeRectFromFramebuffer(int x, int y, int width, int height, 
+  const uint16_t *pixels, int pixelsPerRow)
+{
+  beginSPITransaction();
+  writeRectInTransaction(x, y, width, height, pixels, pixelsPerRow);
+  endSPITransaction();
+}
+
+
+
+//
+// send a rectangle of pixels to the display using one address window, the caller must 
+// have started an SPI transaction
+//  Enter:  x, y = upper left corner on the display
+//          width, height = size of the rectangle
+//          pixels -> first pixel to send
+//          pixelsPerRow = number of pixels from the start of one row to the next
+//
+void TeensyUserInterfaceLCD::writeRectInTransaction(int x, int y, int width, int height, 
+  const uint16_t *pixels, int pixelsPerRow)
+{
+  setAddr(x, y, x + width - 1, y + height - 1);
+  writecommand_cont(ILI9341_RAMWR);
+  for (int row = 0; row < height; row++)
+  {
+    const uint16_t *p = pixels + (row * pixelsPerRow);
+    int count = width;
+    if (row == height - 1)
+      count--;
+    while (count-- > 0)
+      writedata16_cont(*p++);
+  }
+  writedata16_last(pixels[(height - 1) * pixelsPerRow + width - 1]);
+}
+
+
+
+//
+// set the LCD's vertical scrolling area and the row of memory shown at its top, the 
+// caller must have started an SPI transaction
+//  Enter:  topFixedRows = number of rows at the top of memory that don't scroll
+//          scrollingRows = number of rows that scroll
+//          bottomFixedRows = number of rows at the bottom of memory that don't scroll
+//          startRow = row of memory shown at the top of the scrolling area
+//
+void TeensyUserInterfaceLCD::setVerticalScrollInTransaction(int topFixedRows, int scrollingRows, int bottomFixedRows, int startRow)
+{
+  writecommand_cont(ILI9341_VSCRDEF);
+  writedata16_cont(topFixedRows);
+  writedata16_cont(scrollingRows);
+  writedata16_cont(bottomFixedRows);
+  writecommand_cont(ILI9341_VSCRSADD);
+  writedata16_last(startRow);
+}
+
+
+
+//
+// fill a rectangle on the display using one address window, the caller must have 
+// started an SPI transaction
+//  Enter:  x, y = upper left corner on the display
+//          width, height = size of the rectangle
+//          color = 16 bit color, bit format: rrrrrggggggbbbbb
+//
+void TeensyUserInterfaceLCD::fillRectInTransaction(int x, int y, int width, int height, uint16_t color)
+{
+  setAddr(x, y, x + width - 1, y + height - 1);
+  writecommand_cont(ILI9341_RAMWR);
+  for (long count = (long)width * height; count > 1; count--)
+    writedata16_cont(color);
+  writedata16_last(color);
+}
+
+
+// ---------------------------------------------------------------------------------
+//                                Display list functions
+// ---------------------------------------------------------------------------------
+
+//
+// Screens are usually drawn back to front, so the same pixels get painted several 
+// times: clearDisplaySpace() fills the whole space, then each button fills its face 
+// and prints its label on top.  Between lcdBeginDisplayList() and lcdEndDisplayList() 
+// the lcd drawing functions are recorded instead of drawn.  When the list ends it's 
+// compiled: fills of the same color that sit side by side are merged into one, 
+// commands that are completely painted over by a later fill or image are dropped, and 
+// fills partly painted over are trimmed.  What's left is then drawn, to the display or 
+// to the framebuffer.  Text is recorded with the cursor, font and color in effect, 
+// and the cursor is advanced while recording just as if the text had been drawn.
+// After setMenuDisplayList(true), selectAndDrawMenu() draws each menu this way.
+//
+
+//
+// start recording the lcd drawing functions in a display list, lists can be nested,
+// only the outermost lcdEndDisplayList() draws the list
+//
+void TeensyUserInterface::lcdBeginDisplayList(void)
+{
+  if (displayListDepth == 0)
+  {
+    //
+    // allocate the list the first time it's used, if the memory isn't available 
+    // drawing is done immediately as usual
+    //
+    if (displayList == NULL)
+    {
+      displayList = (LCD_DISPLAY_LIST_COMMAND *) malloc(displayListMaxCommands * sizeof(LCD_DISPLAY_LIST_COMMAND));
+      displayListText = (char *) malloc(displayListMaxTextBytes);
+      if ((displayList == NULL) || (displayListText == NULL))
+      {
+        free(displayList);
+        free(displayListText);
+        displayList = NULL;
+        displayListText = NULL;
+      }
+    }
+
+    displayListCount = 0;
+    displayListTextLength = 0;
+    displayListRecordedCount = 0;
+    displayListCulledCount = 0;
+    displayListMergedCount = 0;
+    displayListPixelsSaved = 0;
+    displayListClipRect = clipRect;
+  }
+
+  displayListDepth++;
+}
+
+
+
+//
+// stop recording, then compile and draw the display list
+//
+void TeensyUserInterface::lcdEndDisplayList(void)
+{
+  if (displayListDepth == 0)
+    return;
+
+  displayListDepth--;
+  if (displayListDepth > 0)
+    return;
+
+  compileDisplayList();
+  playDisplayList();
+}
+
+
+
+//
+// set the size of the display list, when a list fills it's drawn and recording 
+// continues in an empty list
+//  Enter:  maxCommands = number of drawing commands the list holds (default 128)
+//          maxTextBytes = number of characters of text the list holds (default 1024)
+//  Exit:   true returned on success, false if called while recording
+//
+boolean TeensyUserInterface::lcdSetDisplayListSize(int maxCommands, int maxTextBytes)
+{
+  if (displayListDepth > 0)
+    return(false);
+
+  if (maxCommands < 1) maxCommands = 1;
+  if (maxTextBytes < 1) maxTextBytes = 1;
+
+  //
+  // the list is reallocated with the new size when next used
+  //
+  free(displayList);
+  free(displayListText);
+  displayList = NULL;
+  displayListText = NULL;
+  displayListMaxCommands = maxCommands;
+  displayListMaxTextBytes = maxTextBytes;
+  return(true);
+}
+
+
+
+//
+// get statistics for the last display list drawn
+//  Enter:  commandsRecorded -> storage to return the number of drawing commands recorded
+//          commandsCulled -> storage to return the number of commands not drawn because
+//            they were painted over by later commands
+//          commandsMerged -> storage to return the number of fills merged into another
+//          pixelsSaved -> storage to return the number of pixels not drawn
+//
+void TeensyUserInterface::lcdGetDisplayListStatistics(int *commandsRecorded, int *commandsCulled, int *commandsMerged, long *pixelsSaved)
+{
+  *commandsRecorded = displayListRecordedCount;
+  *commandsCulled = displayListCulledCount;
+  *commandsMerged = displayListMergedCount;
+  *pixelsSaved = displayListPixelsSaved;
+}
+
+
+
+//
+// add a drawing command to the display list, if the list is full it's drawn first 
+//  Enter:  commandType = DISPLAY_LIST_FILL_RECT, DISPLAY_LIST_LINE, ...
+//          color = 16 bit color, bit format: rrrrrggggggbbbbb
+//          p0 - p5 = the drawing function's coordinate arguments
+//          data -> image data for DISPLAY_LIST_IMAGE
+//  Exit:   true returned if recorded, false if it must be drawn now
+//
+boolean TeensyUserInterface::recordDisplayListCommand(byte commandType, uint16_t color, int p0, int p1, int p2, int p3, int p4, int p5, const void *data)
+{
+  int x1, y1, x2, y2;
+
+  if (displayList == NULL)
+    return(false);
+
+  if (displayListCount >= displayListMaxCommands)
+  {
+    compileDisplayList();
+    playDisplayList();
+  }
+
+  //
+  // determine the region the command draws into
+  //
+  switch(commandType)
+  {
+    case DISPLAY_LIST_LINE:
+      x1 = min(p0, p2);  y1 = min(p1, p3);  x2 = max(p0, p2);  y2 = max(p1, p3);
+      break;
+
+    case DISPLAY_LIST_TRIANGLE:
+    case DISPLAY_LIST_FILLED_TRIANGLE:
+      x1 = min(p0, min(p2, p4));  y1 = min(p1, min(p3, p5));
+      x2 = max(p0, max(p2, p4));  y2 = max(p1, max(p3, p5));
+      break;
+
+    case DISPLAY_LIST_CIRCLE:
+    case DISPLAY_LIST_FILLED_CIRCLE:
+      x1 = p0 - p2;  y1 = p1 - p2;  x2 = p0 + p2;  y2 = p1 + p2;
+      break;
+
+    default:
+      x1 = p0;  y1 = p1;  x2 = p0 + p2 - 1;  y2 = p1 + p3 - 1;
+      break;
+  }
+
+  LCD_DISPLAY_LIST_COMMAND &command = displayList[displayListCount++];
+  command.commandType = commandType;
+  command.culledFlg = false;
+  command.color = color;
+  command.params[0] = p0;  command.params[1] = p1;  command.params[2] = p2;
+  command.params[3] = p3;  command.params[4] = p4;  command.params[5] = p5;
+  command.data = data;
+  command.bounds.x1 = max(x1, (int) clipRect.x1);
+  command.bounds.y1 = max(y1, (int) clipRect.y1);
+  command.bounds.x2 = min(x2, (int) clipRect.x2);
+  command.bounds.y2 = min(y2, (int) clipRect.y2);
+  displayListRecordedCount++;
+  return(true);
+}
+
+
+
+//
+// add text to the display list, the cursor is advanced as if the text was drawn 
+//  Enter:  commandType = DISPLAY_LIST_TEXT or DISPLAY_LIST_CHARACTER
+//          s -> string to record for DISPLAY_LIST_TEXT
+//          character = character to record for DISPLAY_LIST_CHARACTER
+//  Exit:   true returned if recorded, false if it must be drawn now
+//
+boolean TeensyUserInterface::recordDisplayListText(byte commandType, const char *s, unsigned int character)
+{
+  int16_t cursorX;
+  int16_t cursorY;
+  int length = 0;
+
+  if (displayList == NULL)
+    return(false);
+
+  if (commandType == DISPLAY_LIST_TEXT)
+    length = strlen(s) + 1;
+
+  if ((displayListCount >= displayListMaxCommands) || (displayListTextLength + length > displayListMaxTextBytes))
+  {
+    compileDisplayList();
+    playDisplayList();
+    if (length > displayListMaxTextBytes)
+      return(false);
+  }
+
+  //
+  // run the text through the rasterizer without drawing to find the region it covers
+  // and to advance the cursor
+  //
+  lcd->getCursor(&cursorX, &cursorY);
+  clearPendingDirtyRect();
+  rasterMeasureOnlyFlg = true;
+  if (commandType == DISPLAY_LIST_TEXT)
+    rasterPrint(s);
+  else
+    rasterDrawFontCharacter(character);
+  rasterMeasureOnlyFlg = false;
+
+  LCD_DISPLAY_LIST_COMMAND &command = displayList[displayListCount++];
+  command.commandType = commandType;
+  command.culledFlg = false;
+  command.color = lcd->getTextColor();
+  command.params[0] = cursorX;
+  command.params[1] = cursorY;
+  command.params[2] = (commandType == DISPLAY_LIST_TEXT) ? displayListTextLength : character;
+  command.data = currentFont;
+  command.bounds.x1 = pendingDirtyX1;
+  command.bounds.y1 = pendingDirtyY1;
+  command.bounds.x2 = pendingDirtyX2;
+  command.bounds.y2 = pendingDirtyY2;
+  clearPendingDirtyRect();
+
+  if (commandType == DISPLAY_LIST_TEXT)
+  {
+    memcpy(displayListText + displayListTextLength, s, length);
+    displayListTextLength += length;
+  }
+
+  displayListRecordedCount++;
+  return(true);
+}
+
+
+
+//
+// compile the display list: merge fills that sit side by side, then drop or trim 
+// commands painted over by later fills and images
+//
+void TeensyUserInterface::compileDisplayList(void)
+{
+  int i, j, k;
+
+  //
+  // merge a fill into a later fill of the same color when together they form a 
+  // rectangle, and nothing drawn between them overlaps the earlier one
+  //
+  for (j = 1; j < displayListCount; j++)
+  {
+    LCD_DISPLAY_LIST_COMMAND &later = displayList[j];
+    if (later.commandType != DISPLAY_LIST_FILL_RECT)
+      continue;
+
+    for (i = j - 1; i >= 0; i--)
+    {
+      LCD_DISPLAY_LIST_COMMAND &earlier = displayList[i];
+      if ((earlier.commandType != DISPLAY_LIST_FILL_RECT) || earlier.culledFlg || (earlier.color != later.color))
+        continue;
+
+      LCD_RECT &a = earlier.bounds;
+      LCD_RECT &b = later.bounds;
+      if ((a.x1 > a.x2) || (a.y1 > a.y2))
+        continue;
+      boolean sideBySideFlg = (a.y1 == b.y1) && (a.y2 == b.y2) && ((a.x2 + 1 == b.x1) || (b.x2 + 1 == a.x1));
+      boolean aboveBelowFlg = (a.x1 == b.x1) && (a.x2 == b.x2) && ((a.y2 + 1 == b.y1) || (b.y2 + 1 == a.y1));
+      if (!sideBySideFlg && !aboveBelowFlg)
+        continue;
+
+      for (k = i + 1; k < j; k++)
+      {
+        LCD_RECT &c = displayList[k].bounds;
+        if (displayList[k].commandType == DISPLAY_LIST_SET_CLIP)
+          break;
+        if (!displayList[k].culledFlg && (c.x1 <= a.x2) && (c.x2 >= a.x1) && (c.y1 <= a.y2) && (c.y2 >= a.y1))
+          break;
+      }
+      if (k < j)
+        continue;
+
+      b.x1 = min(a.x1, b.x1);  b.y1 = min(a.y1, b.y1);
+      b.x2 = max(a.x2, b.x2);  b.y2 = max(a.y2, b.y2);
+      earlier.culledFlg = true;
+      displayListMergedCount++;
+    }
+  }
+
+  //
+  // drop commands completely covered by a later fill or image, and trim fills that 
+  // are covered along a whole edge
+  //
+  for (i = 0; i < displayListCount; i++)
+  {
+    LCD_DISPLAY_LIST_COMMAND &command = displayList[i];
+    if (command.culledFlg || (command.commandType == DISPLAY_LIST_SET_CLIP))
+      continue;
+
+    LCD_RECT &a = command.bounds;
+    if ((a.x1 > a.x2) || (a.y1 > a.y2))
+    {
+      command.culledFlg = true;
+      displayListCulledCount++;
+      continue;
+    }
+
+    for (j = i + 1; j < displayListCount; j++)
+    {
+      byte coverType = displayList[j].commandType;
+      if ((coverType != DISPLAY_LIST_FILL_RECT) && (coverType != DISPLAY_LIST_IMAGE))
+        continue;
+
+      LCD_RECT &c = displayList[j].bounds;
+      if ((c.x1 > a.x2) || (c.x2 < a.x1) || (c.y1 > a.y2) || (c.y2 < a.y1))
+        continue;
+
+      if ((c.x1 <= a.x1) && (c.x2 >= a.x2) && (c.y1 <= a.y1) && (c.y2 >= a.y2))
+      {
+        command.culledFlg = true;
+        displayListCulledCount++;
+        displayListPixelsSaved += (long)(a.x2 - a.x1 + 1) * (a.y2 - a.y1 + 1);
+        break;
+      }
+
+      if (command.commandType != DISPLAY_LIST_FILL_RECT)
+        continue;
+
+      if ((c.y1 <= a.y1) && (c.y2 >= a.y2))
+      {
+        if (c.x1 <= a.x1)
+        {
+          displayListPixelsSaved += (long)(c.x2 - a.x1 + 1) * (a.y2 - a.y1 + 1);
+          a.x1 = c.x2 + 1;
+        }
+        else if (c.x2 >= a.x2)
+        {
+          displayListPixelsSaved += (long)(a.x2 - c.x1 + 1) * (a.y2 - a.y1 + 1);
+          a.x2 = c.x1 - 1;
+        }
+      }
+      else if ((c.x1 <= a.x1) && (c.x2 >= a.x2))
+      {
+        if (c.y1 <= a.y1)
+        {
+          displayListPixelsSaved += (long)(a.x2 - a.x1 + 1) * (c.y2 - a.y1 + 1);
+          a.y1 = c.y2 + 1;
+        }
+        else if (c.y2 >= a.y2)
+        {
+          displayListPixelsSaved += (long)(a.x2 - a.x1 + 1) * (a.y2 - c.y1 + 1);
+          a.y2 = c.y1 - 1;
+        }
+      }
+    }
+  }
+}
+
+
+
+//
+// draw the commands left in the compiled display list, then empty the list
+//
+void TeensyUserInterface::playDisplayList(void)
+{
+  int16_t cursorX;
+  int16_t cursorY;
+
+  //
+  // remember the text settings and clipping in effect at the end of recording, then 
+  // restore the clipping in effect when the list started
+  //
+  lcd->getCursor(&cursorX, &cursorY);
+  const ui_font *font = currentFont;
+  uint16_t textColor = lcd->getTextColor();
+  LCD_RECT endClipRect = clipRect;
+  clipRect = displayListClipRect;
+
+  int depth = displayListDepth;
+  displayListDepth = 0;
+  lcdBeginBatch();
+
+  for (int i = 0; i < displayListCount; i++)
+  {
+    LCD_DISPLAY_LIST_COMMAND &command = displayList[i];
+    if (command.culledFlg)
+      continue;
+
+    int16_t *p = command.params;
+    LCD_RECT &b = command.bounds;
+    switch(command.commandType)
+    {
+      case DISPLAY_LIST_FILL_RECT:
+        lcdDrawFilledRectangle(b.x1, b.y1, b.x2 - b.x1 + 1, b.y2 - b.y1 + 1, command.color);
+        break;
+      case DISPLAY_LIST_LINE:
+        lcdDrawLine(p[0], p[1], p[2], p[3], command.color);
+        break;
+      case DISPLAY_LIST_RECTANGLE:
+        lcdDrawRectangle(p[0], p[1], p[2], p[3], command.color);
+        break;
+      case DISPLAY_LIST_ROUNDED_RECTANGLE:
+        lcdDrawRoundedRectangle(p[0], p[1], p[2], p[3], p[4], command.color);
+        break;
+      case DISPLAY_LIST_TRIANGLE:
+        lcdDrawTriangle(p[0], p[1], p[2], p[3], p[4], p[5], command.color);
+        break;
+      case DISPLAY_LIST_CIRCLE:
+        lcdDrawCircle(p[0], p[1], p[2], command.color);
+        break;
+      case DISPLAY_LIST_FILLED_ROUNDED_RECT:
+        lcdDrawFilledRoundedRectangle(p[0], p[1], p[2], p[3], p[4], command.color);
+        break;
+      case DISPLAY_LIST_FILLED_TRIANGLE:
+        lcdDrawFilledTriangle(p[0], p[1], p[2], p[3], p[4], p[5], command.color);
+        break;
+      case DISPLAY_LIST_FILLED_CIRCLE:
+        lcdDrawFilledCircle(p[0], p[1], p[2], command.color);
+        break;
+      case DISPLAY_LIST_IMAGE:
+        lcdDrawImage(p[0], p[1], p[2], p[3], (const uint16_t *) command.data);
+        break;
+      case DISPLAY_LIST_TEXT:
+      case DISPLAY_LIST_CHARACTER:
+        lcd->setCursorWithoutLimits(p[0], p[1]);
+        lcdSetFont(*(const ui_font *) command.data);
+        lcdSetFontColor(command.color);
+        if (command.commandType == DISPLAY_LIST_TEXT)
+          lcdPrint((const char *) (displayListText + (uint16_t) p[2]));
+        else
+          lcdPrintCharacter(p[2]);
+        break;
+      case DISPLAY_LIST_SET_CLIP:
+        clipRect = b;
+        break;
+    }
+  }
+
+  lcdEndBatch();
+  displayListDepth = depth;
+  displayListCount = 0;
+  displayListTextLength = 0;
+
+  lcd->setCursorWithoutLimits(cursorX, cursorY);
+  lcdSetFont(*font);
+  lcdSetFontColor(textColor);
+  clipRect = endClipRect;
+  displayListClipRect = endClipRect;
+}
+
+
+// ---------------------------------------------------------------------------------
+//                    Software rasterizer for drawing into the framebuffer
+// ---------------------------------------------------------------------------------
+
+//
+// The rasterizer draws into the framebuffer.  When there is no framebuffer, it's used 
+// to draw shapes that are partly outside the clip rectangle, sending each clipped 
+// run of pixels to the display.
+//
+
+//
+// fill a rectangle in the framebuffer, clipped to the clip rectangle, all other shapes 
+// are drawn with this function, when measuring only the region touched is recorded
+//  Enter:  x, y = upper left corner of rect
+//          width, height = size of rect
+//          color = 16 bit color, bit format: rrrrrggggggbbbbb
+//
+void TeensyUserInterface::rasterFillRect(int x, int y, int width, int height, uint16_t color)
+{
+  int x2 = x + width - 1;
+  int y2 = y + height - 1;
+
+  //
+  // clip to the clip rectangle
+  //
+  if (x < clipRect.x1) x = clipRect.x1;
+  if (y < clipRect.y1) y = clipRect.y1;
+  if (x2 > clipRect.x2) x2 = clipRect.x2;
+  if (y2 > clipRect.y2) y2 = clipRect.y2;
+  if ((x > x2) || (y > y2))
+    return;
+
+  //
+  // grow the region touched by the current drawing function
+  //
+  if (x < pendingDirtyX1) pendingDirtyX1 = x;
+  if (y < pendingDirtyY1) pendingDirtyY1 = y;
+  if (x2 > pendingDirtyX2) pendingDirtyX2 = x2;
+  if (y2 > pendingDirtyY2) pendingDirtyY2 = y2;
+  if (rasterMeasureOnlyFlg)
+    return;
+
   //
-  // get the raw coordinates and return them
+  // fill each run of rows that's contiguous in memory
   //
-  TS_Point rawTouchPoint = ts->getPoint();
+  int rowLength = x2 - x + 1;
+  while (y <= y2)
+  {
+    int memoryY;
+    int runY2 = mapRowsToMemory(y, y2, &memoryY);
 
-  *xRaw = rawTouchPoint.x;
-  *yRaw = rawTouchPoint.y;
-  return(true);
+    if (framebuffer == NULL)
+      addSpan(x, memoryY, x2, memoryY + runY2 - y, color);
+    else
+    {
+      uint16_t *row = framebuffer + (memoryY * lcdWidth) + x;
+      for (int count = runY2 - y + 1; count > 0; count--)
+      {
+        uint16_t *p = row;
+        for (int n = rowLength; n > 0; n--)
+          *p++ = color;
+        row += lcdWidth;
+      }
+    }
+
+    y = runY2 + 1;
+  }
 }
 
 
-// ---------------------------------------------------------------------------------
-//                                    LCD functions  
-// ---------------------------------------------------------------------------------
 
 //
-// initialize the LCD display
-//  Enter:  lcdOrientation = LCD_ORIENTATION_PORTRAIT_4PIN_TOP, LCD_ORIENTATION_LANDSCAPE_4PIN_LEFT
-//                           LCD_ORIENTATION_PORTRAIT_4PIN_BOTTOM, LCD_ORIENTATION_LANDSCAPE_4PIN_RIGHT
-//          font -> the font typeface to load, ei: Arial_10
+// add a run of pixels drawn directly to the display, a run the same width as the one 
+// before it and directly below it is joined to it, so both are sent with one address 
+// window
+//  Enter:  x1, y1 = upper left corner of the run
+//          x2, y2 = lower right corner of the run
+//          color = 16 bit color, bit format: rrrrrggggggbbbbb
 //
-void TeensyUserInterface::lcdInitialize(int lcdOrientation, const ui_font &font)
+void TeensyUserInterface::addSpan(int x1, int y1, int x2, int y2, uint16_t color)
 {
-  lcd->begin();
-  lcdSetOrientation(lcdOrientation);
-  lcdClearScreen(LCD_BLACK);
-  lcdSetFontColor(LCD_WHITE);  
-  lcdSetFont(font);
+  spanCount++;
+
+  if (spanPendingFlg && (color == spanColor) && (x1 == spanX1) && (x2 == spanX2) && (y1 == spanY2 + 1))
+  {
+    spanY2 = y2;
+    return;
+  }
+
+  sendPendingSpan();
+  spanX1 = x1;
+  spanY1 = y1;
+  spanX2 = x2;
+  spanY2 = y2;
+  spanColor = color;
+  spanPendingFlg = true;
 }
 
 
 
 //
-// set the LCD display's orientation
-//  Enter:  lcdOrientation = LCD_ORIENTATION_PORTRAIT_4PIN_TOP, LCD_ORIENTATION_LANDSCAPE_4PIN_LEFT
-//                           LCD_ORIENTATION_PORTRAIT_4PIN_BOTTOM, LCD_ORIENTATION_LANDSCAPE_4PIN_RIGHT
+// send the run of pixels waiting to be joined, starting an SPI transaction if one 
+// isn't already open
 //
-void TeensyUserInterface::lcdSetOrientation(int lcdOrientation)
+void TeensyUserInterface::sendPendingSpan(void)
 {
-  lcd->setRotation(lcdOrientation);
-  lcdWidth = lcd->width();
-  lcdHeight = lcd->height();
-  lcdSetCursorXY(0, 0);
+  if (!spanTransactionFlg)
+  {
+    lcd->beginTransaction();
+    spanTransactionFlg = true;
+  }
+
+  if (!spanPendingFlg)
+    return;
+
+  lcd->fillRectInTransaction(spanX1, spanY1, spanX2 - spanX1 + 1, spanY2 - spanY1 + 1, spanColor);
+  addressWindowCount++;
+  spanPendingFlg = false;
 }
 
 
 
 //
-// fill the entire lcd screen with the given color
-//  Enter:  color = 16 bit color, bit format: rrrrrggggggbbbbb
+// send the last run of pixels, then end the SPI transaction unless a batch is open
 //
-void TeensyUserInterface::lcdClearScreen(uint16_t color)
+void TeensyUserInterface::finishSpans(void)
 {
-  lcd->fillScreen(color);
+  if (spanPendingFlg)
+    sendPendingSpan();
+
+  if (spanTransactionFlg && (batchDepth == 0))
+  {
+    lcd->endTransaction();
+    spanTransactionFlg = false;
+  }
 }
 
 
 
 //
-// draw one pixel with the given coords and color
-//  Enter:  x, y = coords of the pixel to draw
-//          color = 16 bit color, bit format: rrrrrggggggbbbbb
+// draw a line into the framebuffer, horizontal or vertical runs of pixels are filled
+// together
 //
-void TeensyUserInterface::lcdDrawPixel(int x, int y, uint16_t color)
+void TeensyUserInterface::rasterDrawLine(int x1, int y1, int x2, int y2, uint16_t color)
 {
-  lcd->drawPixel(x, y, color);
+  int temp;
+
+  if (y1 == y2)
+  {
+    if (x1 > x2) { temp = x1; x1 = x2; x2 = temp; }
+    rasterFillRect(x1, y1, x2 - x1 + 1, 1, color);
+    return;
+  }
+
+  if (x1 == x2)
+  {
+    if (y1 > y2) { temp = y1; y1 = y2; y2 = temp; }
+    rasterFillRect(x1, y1, 1, y2 - y1 + 1, color);
+    return;
+  }
+
+  //
+  // Bresenham's line algorithm, stepping along the longer axis
+  //
+  boolean steepFlg = abs(y2 - y1) > abs(x2 - x1);
+  if (steepFlg)
+  {
+    temp = x1; x1 = y1; y1 = temp;
+    temp = x2; x2 = y2; y2 = temp;
+  }
+  if (x1 > x2)
+  {
+    temp = x1; x1 = x2; x2 = temp;
+    temp = y1; y1 = y2; y2 = temp;
+  }
+
+  int dx = x2 - x1;
+  int dy = abs(y2 - y1);
+  int err = dx / 2;
+  int yStep = (y1 < y2) ? 1 : -1;
+  int runStart = x1;
+
+  for (; x1 <= x2; x1++)
+  {
+    err -= dy;
+    if ((err < 0) || (x1 == x2))
+    {
+      if (steepFlg)
+        rasterFillRect(y1, runStart, 1, x1 - runStart + 1, color);
+      else
+        rasterFillRect(runStart, y1, x1 - runStart + 1, 1, color);
+      runStart = x1 + 1;
+      if (err < 0)
+      {
+        y1 += yStep;
+        err += dx;
+      }
+    }
+  }
 }
 
 
 
 //
-// draw a line with the given coords and color
-//  Enter:  x1, y1 = first endpoint of line
-//          x2, y2 = second endpoint of line
-//          color = 16 bit color, bit format: rrrrrggggggbbbbb
+// draw the outline of a rectangle into the framebuffer
 //
-void TeensyUserInterface::lcdDrawLine(int x1, int y1, int x2, int y2, uint16_t color)
+void TeensyUserInterface::rasterDrawRectangle(int x, int y, int width, int height, uint16_t color)
 {
-  lcd->drawLine(x1, y1, x2, y2, color);
+  rasterFillRect(x, y, width, 1, color);
+  rasterFillRect(x, y + height - 1, width, 1, color);
+  rasterFillRect(x, y, 1, height, color);
+  rasterFillRect(x + width - 1, y, 1, height, color);
 }
 
 
 
 //
-// draw a horizontal line with the given coords, length and color
-//  Enter:  x, y = first endpoint of line
-//          length = length of line
-//          color = 16 bit color, bit format: rrrrrggggggbbbbb
+// draw the outline of a rounded rectangle into the framebuffer
 //
-void TeensyUserInterface::lcdDrawHorizontalLine(int x, int y, int length, uint16_t color)
+void TeensyUserInterface::rasterDrawRoundedRectangle(int x, int y, int width, int height, int radius, uint16_t color)
 {
-  lcd->drawFastHLine(x, y, length, color);
+  int maxRadius = ((width < height) ? width : height) / 2;
+  if (radius > maxRadius) radius = maxRadius;
+
+  rasterFillRect(x + radius, y, width - 2*radius, 1, color);
+  rasterFillRect(x + radius, y + height - 1, width - 2*radius, 1, color);
+  rasterFillRect(x, y + radius, 1, height - 2*radius, color);
+  rasterFillRect(x + width - 1, y + radius, 1, height - 2*radius, color);
+
+  rasterDrawCircleCorners(x + radius,             y + radius,              radius, 0x1, color);
+  rasterDrawCircleCorners(x + width - radius - 1, y + radius,              radius, 0x2, color);
+  rasterDrawCircleCorners(x + width - radius - 1, y + height - radius - 1, radius, 0x4, color);
+  rasterDrawCircleCorners(x + radius,             y + height - radius - 1, radius, 0x8, color);
 }
 
 
 
 //
-// draw a vertical line with the given coords, length and color
-//  Enter: x, y = first endpoint of line
-//          length = length of line
-//          color = 16 bit color, bit format: rrrrrggggggbbbbb
+// draw the outline of a triangle into the framebuffer
 //
-void TeensyUserInterface::lcdDrawVerticalLine(int x, int y, int length, uint16_t color)
+void TeensyUserInterface::rasterDrawTriangle(int x0, int y0, int x1, int y1, int x2, int y2, uint16_t color)
 {
-  lcd->drawFastVLine(x, y, length, color);
+  rasterDrawLine(x0, y0, x1, y1, color);
+  rasterDrawLine(x1, y1, x2, y2, color);
+  rasterDrawLine(x2, y2, x0, y0, color);
 }
 
 
 
 //
-// draw rectangle at the given coords, length, width and color
-//  Enter:  x, y = upper left corner of rect
-//          width = width of rectangle
-//          height = height of rectangle
-//          color = 16 bit color, bit format: rrrrrggggggbbbbb
+// draw the outline of a circle into the framebuffer
 //
-void TeensyUserInterface::lcdDrawRectangle(int x, int y, int width, int height, uint16_t color)
+void TeensyUserInterface::rasterDrawCircle(int x, int y, int radius, uint16_t color)
 {
-  lcd->drawRect(x, y, width, height, color);
+  rasterFillRect(x, y + radius, 1, 1, color);
+  rasterFillRect(x, y - radius, 1, 1, color);
+  rasterFillRect(x + radius, y, 1, 1, color);
+  rasterFillRect(x - radius, y, 1, 1, color);
+  rasterDrawCircleCorners(x, y, radius, 0xf, color);
 }
 
 
 
 //
-// draw rounded rectangle at the given coords, length, width and color
-//  Enter:  x, y = upper left corner of rect
-//          width = width of rectangle
-//          height = height of rectangle
-//          radius = radius of the corners
+// draw quarters of a circle's outline into the framebuffer (midpoint circle algorithm)
+//  Enter:  x, y = center of the circle
+//          radius = radius of the circle
+//          corners = bit flags: 0x1 upper left, 0x2 upper right, 0x4 lower right, 0x8 lower left
 //          color = 16 bit color, bit format: rrrrrggggggbbbbb
 //
-void TeensyUserInterface::lcdDrawRoundedRectangle(int x, int y, int width, int height, int radius, uint16_t color)
+void TeensyUserInterface::rasterDrawCircleCorners(int x, int y, int radius, int corners, uint16_t color)
 {
-  lcd->drawRoundRect(x, y, width, height, radius, color);
+  int f = 1 - radius;
+  int ddFx = 1;
+  int ddFy = -2 * radius;
+  int dx = 0;
+  int dy = radius;
+
+  while (dx < dy)
+  {
+    if (f >= 0)
+    {
+      dy--;
+      ddFy += 2;
+      f += ddFy;
+    }
+    dx++;
+    ddFx += 2;
+    f += ddFx;
+
+    if (corners & 0x1)
+    {
+      rasterFillRect(x - dy, y - dx, 1, 1, color);
+      rasterFillRect(x - dx, y - dy, 1, 1, color);
+    }
+    if (corners & 0x2)
+    {
+      rasterFillRect(x + dx, y - dy, 1, 1, color);
+      rasterFillRect(x + dy, y - dx, 1, 1, color);
+    }
+    if (corners & 0x4)
+    {
+      rasterFillRect(x + dx, y + dy, 1, 1, color);
+      rasterFillRect(x + dy, y + dx, 1, 1, color);
+    }
+    if (corners & 0x8)
+    {
+      rasterFillRect(x - dy, y + dx, 1, 1, color);
+      rasterFillRect(x - dx, y + dy, 1, 1, color);
+    }
+  }
 }
 
 
 
 //
-// draw a circle at the given coords, radius and color
-//  Enter:  x0, y0 = endpoint 0 of the triangle
-//          x1, y1 = endpoint 1 of the triangle
-//          x2, y2 = endpoint 2 of the triangle
-//          color = 16 bit color, bit format: rrrrrggggggbbbbb
+// draw a filled circle into the framebuffer
 //
-void TeensyUserInterface::lcdDrawTriangle(int x0, int y0, int x1, int y1, int x2, int y2, uint16_t color)
+void TeensyUserInterface::rasterFillCircle(int x, int y, int radius, uint16_t color)
 {
-  lcd->drawTriangle(x0, y0, x1, y1, x2, y2, color);
+  rasterFillCircleHalves(x, y, y, radius, 0, color);
 }
 
 
 
 //
-// draw a triangle at the given coords and color
-//  Enter:  x, y = upper left corner of rect
+// fill a circle with horizontal spans, the circle's halves can be stretched apart to 
+// fill a rounded rectangle, the spans are drawn from top to bottom, one per row, so 
+// rows of the same width can be joined
+//  Enter:  x = center X of the circle's left half
+//          topY = center Y of the top half
+//          bottomY = center Y of the bottom half
 //          radius = radius of the circle
+//          stretchX = extra width added to each span (the circle's right half shifts right)
 //          color = 16 bit color, bit format: rrrrrggggggbbbbb
 //
-void TeensyUserInterface::lcdDrawCircle(int x, int y, int radius, uint16_t color)
+void TeensyUserInterface::rasterFillCircleHalves(int x, int topY, int bottomY, int radius, int stretchX, uint16_t color)
 {
-  lcd->drawCircle(x, y, radius, color);
-}
+  const int maxTableRadius = 160;
+  int16_t halfWidths[maxTableRadius + 1];
+  boolean tableFlg = (radius <= maxTableRadius);
+  int f = 1 - radius;
+  int ddFx = 1;
+  int ddFy = -2 * radius;
+  int dx = 0;
+  int dy = radius;
 
+  //
+  // find the half width of each row with the midpoint circle algorithm, very large 
+  // circles are drawn as the spans are found
+  //
+  if (tableFlg)
+  {
+    for (int row = 0; row <= radius; row++)
+      halfWidths[row] = -1;
+  }
 
+  while (dx < dy)
+  {
+    if (f >= 0)
+    {
+      dy--;
+      ddFy += 2;
+      f += ddFy;
+    }
+    dx++;
+    ddFx += 2;
+    f += ddFx;
 
-//
-// draw a filled rectangle at the given coords, length, width and color
-//  Enter:  x, y = upper left corner of rect
-//          width = width of rectangle
-//          height = height of rectangle
-//          color = 16 bit color, bit format: rrrrrggggggbbbbb
-//
-void TeensyUserInterface::lcdDrawFilledRectangle(int x, int y, int width, int height, uint16_t color)
-{
-  lcd->fillRect(x, y, width, height, color);
+    if (tableFlg)
+    {
+      if (dy > halfWidths[dx]) halfWidths[dx] = dy;
+      if (dx > halfWidths[dy]) halfWidths[dy] = dx;
+      continue;
+    }
+
+    rasterFillRect(x - dy, topY - dx,    2*dy + 1 + stretchX, 1, color);
+    rasterFillRect(x - dy, bottomY + dx, 2*dy + 1 + stretchX, 1, color);
+    rasterFillRect(x - dx, topY - dy,    2*dx + 1 + stretchX, 1, color);
+    rasterFillRect(x - dx, bottomY + dy, 2*dx + 1 + stretchX, 1, color);
+  }
+
+  if (!tableFlg)
+  {
+    rasterFillRect(x - radius, topY, 2*radius + 1 + stretchX, bottomY - topY + 1, color);
+    return;
+  }
+
+  //
+  // fill the rows of the top half, the middle, then the bottom half
+  //
+  for (int row = radius; row >= 1; row--)
+  {
+    if (halfWidths[row] >= 0)
+      rasterFillRect(x - halfWidths[row], topY - row, 2*halfWidths[row] + 1 + stretchX, 1, color);
+  }
+
+  rasterFillRect(x - radius, topY, 2*radius + 1 + stretchX, bottomY - topY + 1, color);
+
+  for (int row = 1; row <= radius; row++)
+  {
+    if (halfWidths[row] >= 0)
+      rasterFillRect(x - halfWidths[row], bottomY + row, 2*halfWidths[row] + 1 + stretchX, 1, color);
+  }
 }
 
 
 
 //
-// draw a filled rounded rectangle at the given coords, length, width and color
-//  Enter:  x, y = upper left corner of rect
-//          width = width of rectangle
-//          height = height of rectangle
-//          radius = radius of the corners
-//          color = 16 bit color, bit format: rrrrrggggggbbbbb
+// draw a filled rounded rectangle into the framebuffer
 //
-void TeensyUserInterface::lcdDrawFilledRoundedRectangle(int x, int y, int width, int height, int radius, uint16_t color)
+void TeensyUserInterface::rasterFillRoundedRectangle(int x, int y, int width, int height, int radius, uint16_t color)
 {
-  lcd->fillRoundRect(x, y, width, height, radius, color);
+  int maxRadius = ((width < height) ? width : height) / 2;
+  if (radius > maxRadius) radius = maxRadius;
+
+  rasterFillCircleHalves(x + radius, y + radius, y + height - radius - 1, radius, width - 2*radius - 1, color);
 }
 
 
 
 //
-// draw a circle at the given coords, radius and color
-//  Enter:  x0, y0 = endpoint 0 of the triangle
-//          x1, y1 = endpoint 1 of the triangle
-//          x2, y2 = endpoint 2 of the triangle
-//          color = 16 bit color, bit format: rrrrrggggggbbbbb
+// draw a filled triangle into the framebuffer using horizontal spans
 //
-void TeensyUserInterface::lcdDrawFilledTriangle(int x0, int y0, int x1, int y1, int x2, int y2, uint16_t color)
+void TeensyUserInterface::rasterFillTriangle(int x0, int y0, int x1, int y1, int x2, int y2, uint16_t color)
 {
-  lcd->fillTriangle(x0, y0, x1, y1, x2, y2, color);
+  int a, b, y, last, temp;
+
+  //
+  // sort the coordinates by Y (y2 >= y1 >= y0)
+  //
+  if (y0 > y1) { temp = y0; y0 = y1; y1 = temp;  temp = x0; x0 = x1; x1 = temp; }
+  if (y1 > y2) { temp = y2; y2 = y1; y1 = temp;  temp = x2; x2 = x1; x1 = temp; }
+  if (y0 > y1) { temp = y0; y0 = y1; y1 = temp;  temp = x0; x0 = x1; x1 = temp; }
+
+  //
+  // all points on the same line
+  //
+  if (y0 == y2)
+  {
+    a = b = x0;
+    if (x1 < a) a = x1; else if (x1 > b) b = x1;
+    if (x2 < a) a = x2; else if (x2 > b) b = x2;
+    rasterFillRect(a, y0, b - a + 1, 1, color);
+    return;
+  }
+
+  int dx01 = x1 - x0;
+  int dy01 = y1 - y0;
+  int dx02 = x2 - x0;
+  int dy02 = y2 - y0;
+  int dx12 = x2 - x1;
+  int dy12 = y2 - y1;
+  long sa = 0;
+  long sb = 0;
+
+  //
+  // upper part of the triangle, include the y1 scanline only if the lower part is flat
+  //
+  if (y1 == y2) last = y1;
+  else last = y1 - 1;
+
+  for (y = y0; y <= last; y++)
+  {
+    a = x0 + sa / dy01;
+    b = x0 + sb / dy02;
+    sa += dx01;
+    sb += dx02;
+    if (a > b) { temp = a; a = b; b = temp; }
+    rasterFillRect(a, y, b - a + 1, 1, color);
+  }
+
+  //
+  // lower part of the triangle
+  //
+  sa = (long)dx12 * (y - y1);
+  sb = (long)dx02 * (y - y0);
+  for (; y <= y2; y++)
+  {
+    a = x1 + sa / dy12;
+    b = x0 + sb / dy02;
+    sa += dx12;
+    sb += dx02;
+    if (a > b) { temp = a; a = b; b = temp; }
+    rasterFillRect(a, y, b - a + 1, 1, color);
+  }
 }
 
 
 
 //
-// draw a filled circle at the given coords, radius and color
-//  Enter:  x, y = upper left corner of rect
-//          radius = radius of the circle
-//          color = 16 bit color, bit format: rrrrrggggggbbbbb
+// copy an image into the framebuffer, clipped to the clip rectangle
 //
-void TeensyUserInterface::lcdDrawFilledCircle(int x, int y, int radius, uint16_t color)
+void TeensyUserInterface::rasterDrawImage(int x, int y, int width, int height, const uint16_t *image)
 {
-  lcd->fillCircle(x, y, radius, color);
-}
+  int x1 = max(x, (int) clipRect.x1);
+  int y1 = max(y, (int) clipRect.y1);
+  int x2 = min(x + width - 1, (int) clipRect.x2);
+  int y2 = min(y + height - 1, (int) clipRect.y2);
+  if ((x1 > x2) || (y1 > y2))
+    return;
 
+  //
+  // record the region touched
+  //
+  if (x1 < pendingDirtyX1) pendingDirtyX1 = x1;
+  if (y1 < pendingDirtyY1) pendingDirtyY1 = y1;
+  if (x2 > pendingDirtyX2) pendingDirtyX2 = x2;
+  if (y2 > pendingDirtyY2) pendingDirtyY2 = y2;
+  if (rasterMeasureOnlyFlg)
+    return;
 
+  //
+  // copy each run of rows that's contiguous in memory
+  //
+  const uint16_t *src = image + ((y1 - y) * width) + (x1 - x);
+  while (y1 <= y2)
+  {
+    int memoryY;
+    int runY2 = mapRowsToMemory(y1, y2, &memoryY);
 
+    if (framebuffer == NULL)
+    {
+      sendPendingSpan();
+      lcd->writeRectInTransaction(x1, memoryY, x2 - x1 + 1, runY2 - y1 + 1, src, width);
+      addressWindowCount++;
+      src += (runY2 - y1 + 1) * width;
+    }
+    else
+    {
+      for (int rowY = memoryY; rowY <= memoryY + runY2 - y1; rowY++)
+      {
+        memcpy(framebuffer + (rowY * lcdWidth) + x1, src, (x2 - x1 + 1) * sizeof(uint16_t));
+        src += width;
+      }
+    }
 
-//
-// draw an image
-//  Enter:  x, y = coords of upper left corner on LCD where the image will be displayed
-//          width, height =  size of the image, this must be the same as the image data
-//          image -> image data, 2 bytes/pixel in the RGB565 format stored in PROGMEM
-// Note: use this utility to convert an image to C sourse code:
-//       www.rinkydinkelectronics.com/_t_doimageconverter565.php
-//
-void TeensyUserInterface::lcdDrawImage(int x, int y, int width, int height, const uint16_t *image)
-{
-  lcd->writeRect(x, y, width, height, image);
+    y1 = runY2 + 1;
+  }
 }
 
 
 
 //
-// set the text font for the "print" functions
-//  Enter:  font -> the font typeface to load
-//          ie: Arial_8, Arial_8_Bold, Arial_9, Arial_9_Bold, Arial_10, Arial_10_Bold, Arial_11, Arial_11_Bold,
-//              Arial_12, 13, 14, 16, 18, 20, 24, 28, 32, 40, 48, 60, 72, 96
+// print a string into the framebuffer at the cursor, the same way the LCD driver does
 //
-void TeensyUserInterface::lcdSetFont(const ui_font &font)
+void TeensyUserInterface::rasterPrint(const char *s)
 {
-  lcd->setFont(font);
-  currentFont = &font;
+  int16_t cursorX;
+  int16_t cursorY;
+
+  while(*s)
+  {
+    char c = *s++;
+    if (c == '\n')
+    {
+      lcd->getCursor(&cursorX, &cursorY);
+      lcd->setCursorWithoutLimits(0, cursorY + currentFont->line_space);
+    }
+    else
+      rasterDrawFontCharacter((byte) c);
+  }
 }
 
 
 
 //
-// set the foreground color for the "print" functions
-//  Enter:  color = 16 bit color, bit format: rrrrrggggggbbbbb
+// functions for reading the bit packed glyphs in an ILI9341_t3 font
 //
-void TeensyUserInterface::lcdSetFontColor(uint16_t color)
+static uint32_t fontFetchBit(const uint8_t *p, uint32_t index)
 {
-  lcd->setTextColor(color);
+  return((p[index >> 3] & (0x80 >> (index & 7))) ? 1 : 0);
 }
 
-
-
-//
-// print a string to the LCD display
-//  Enter:  s -> a null terminated string 
-//
-void TeensyUserInterface::lcdPrint(char *s)
+static uint32_t fontFetchBitsUnsigned(const uint8_t *p, uint32_t index, uint32_t required)
 {
-  lcd->print(s);
+  uint32_t val = 0;
+  do
+  {
+    uint8_t b = p[index >> 3];
+    uint32_t avail = 8 - (index & 7);
+    if (avail <= required)
+    {
+      val <<= avail;
+      val |= b & ((1 << avail) - 1);
+      index += avail;
+      required -= avail;
+    }
+    else
+    {
+      b >>= avail - required;
+      val <<= required;
+      val |= b & ((1 << required) - 1);
+      break;
+    }
+  } while (required);
+  return(val);
 }
 
-void TeensyUserInterface::lcdPrint(const char *s)
+static int32_t fontFetchBitsSigned(const uint8_t *p, uint32_t index, uint32_t required)
 {
-  lcd->print(s);
+  uint32_t val = fontFetchBitsUnsigned(p, index, required);
+  if (val & (1 << (required - 1)))
+    return((int32_t)val - (1 << required));
+  return((int32_t)val);
 }
 
 
 
 //
-// print a signed int at location of the cursor
-//  Enter:  n = signed number to print 
+// get a pointer to a character's glyph in an ILI9341_t3 font
+//  Enter:  font -> the font
+//          c = the character
+//  Exit:   pointer to the glyph returned, NULL if the font doesn't have the character
 //
-void TeensyUserInterface::lcdPrint(int n)
+static const uint8_t *fontGetGlyph(const ui_font *font, unsigned int c)
 {
-  char stringBuffer[14];
-  
-  itoa(n, stringBuffer, 10);
-  lcdPrint(stringBuffer);
+  uint32_t bitOffset;
+
+  if ((c >= font->index1_first) && (c <= font->index1_last))
+    bitOffset = (c - font->index1_first) * font->bits_index;
+  else if ((c >= font->index2_first) && (c <= font->index2_last))
+    bitOffset = (c - font->index2_first + font->index1_last - font->index1_first + 1) * font->bits_index;
+  else
+    return(NULL);
+
+  const uint8_t *data = font->data + fontFetchBitsUnsigned(font->index, bitOffset, font->bits_index);
+  if (fontFetchBitsUnsigned(data, 0, 3) != 0)
+    return(NULL);
+  return(data);
 }
 
 
 
 //
-// print a float or double at location of the cursor
-//  Enter:  n = signed number to print 
-//          digitsRightOfDecimal = number of digits to display right of decimal point (optional)
+// read the header of a glyph in an ILI9341_t3 font
+//  Enter:  font -> the font
+//          data -> the glyph
+//          width, height, xOffset, yOffset, delta -> storage to return the glyph's size, 
+//            offset from the cursor, and the amount to advance the cursor
+//  Exit:   bit offset of the glyph's first row returned
 //
-void TeensyUserInterface::lcdPrint(double n, int digitsRightOfDecimal)
+static uint32_t fontReadGlyphHeader(const ui_font *font, const uint8_t *data, uint32_t *width, 
+  uint32_t *height, int32_t *xOffset, int32_t *yOffset, uint32_t *delta)
 {
-  char stringBuffer[40];
-
-  dtostrf(n, 1, digitsRightOfDecimal, stringBuffer);
-  lcdPrint(stringBuffer);
+  uint32_t bitOffset = 3;
+  *width = fontFetchBitsUnsigned(data, bitOffset, font->bits_width);
+  bitOffset += font->bits_width;
+  *height = fontFetchBitsUnsigned(data, bitOffset, font->bits_height);
+  bitOffset += font->bits_height;
+  *xOffset = fontFetchBitsSigned(data, bitOffset, font->bits_xoffset);
+  bitOffset += font->bits_xoffset;
+  *yOffset = fontFetchBitsSigned(data, bitOffset, font->bits_yoffset);
+  bitOffset += font->bits_yoffset;
+  *delta = fontFetchBitsUnsigned(data, bitOffset, font->bits_delta);
+  bitOffset += font->bits_delta;
+  return(bitOffset);
 }
 
 
 
 //
-// print a string to the LCD, right justified at the cursor
-//  Enter:  s -> string to print 
+// get the amount a character advances the cursor in an ILI9341_t3 font
+//  Enter:  font -> the font
+//          c = the character
+//  Exit:   advance in pixels returned, 0 if the font doesn't have the character
 //
-void TeensyUserInterface::lcdPrintRightJustified(char *s)
+static int fontGetCharacterAdvance(const ui_font *font, unsigned int c)
 {
-  int cursorX;
-  int cursorY;
-
-  lcdGetCursorXY(&cursorX, &cursorY);           // get the current cursor position
-  int stringWidth = lcdStringWidthInPixels(s);  // get the width of the string to print
-  cursorX = cursorX - stringWidth;              // determine new X coord for cursor to right justify
-
-  if (cursorX < 0)                              // set the new cursor position
-    cursorX = 0;
-  lcdSetCursorXY(cursorX, cursorY);
-  
-  lcdPrint(s);                                  // print the string
-}
+  const uint8_t *data = fontGetGlyph(font, c);
+  if (data == NULL)
+    return(0);
 
-void TeensyUserInterface::lcdPrintRightJustified(const char *s)
-{
-  lcdPrintRightJustified((char *)s);
+  uint32_t bitOffset = 3 + font->bits_width + font->bits_height + font->bits_xoffset + font->bits_yoffset;
+  return(fontFetchBitsUnsigned(data, bitOffset, font->bits_delta));
 }
 
 
 
 //
-// print a signed int on the LCD, right justify at the cursor 
-//  Enter:  n = signed number to print 
+// get the table of character advances for a font, building it if the font hasn't
+// been used recently
+//  Enter:  font -> the font
+//  Exit:   pointer to the font's advance table returned
 //
-void TeensyUserInterface::lcdPrintRightJustified(int n)
+LCD_FONT_ADVANCE_TABLE *TeensyUserInterface::getFontAdvanceTable(const ui_font *font)
 {
-  char stringBuffer[14];
-  
-  itoa(n, stringBuffer, 10);
-  lcdPrintRightJustified(stringBuffer);
+  for (int i = 0; i < LCD_MAX_FONT_ADVANCE_TABLES; i++)
+  {
+    if (fontAdvanceTables[i].font == font)
+      return(&fontAdvanceTables[i]);
+  }
+
+  //
+  // replace the oldest table
+  //
+  LCD_FONT_ADVANCE_TABLE *table = &fontAdvanceTables[fontAdvanceTableNext];
+  fontAdvanceTableNext = (fontAdvanceTableNext + 1) % LCD_MAX_FONT_ADVANCE_TABLES;
+
+  table->font = font;
+  for (int c = 0; c < LCD_FONT_ADVANCE_TABLE_SIZE; c++)
+  {
+    int advance = fontGetCharacterAdvance(font, c);
+    table->advance[c] = (advance > 255) ? 255 : advance;
+  }
+  return(table);
 }
 
 
 
 //
-// print a float on the LCD, right justify at the cursor 
-//  Enter:  n = signed number to print 
-//          digitsRightOfDecimal = number of digits to display right of decimal point (optional)
+// draw one character into the framebuffer at the cursor, then advance the cursor
+//  Enter:  c = character to draw
 //
-void TeensyUserInterface::lcdPrintRightJustified(double n, int digitsRightOfDecimal)
+void TeensyUserInterface::rasterDrawFontCharacter(unsigned int c)
 {
-  char stringBuffer[40];
+  int16_t cursorX;
+  int16_t cursorY;
+  const ui_font *font = currentFont;
+  LCD_GLYPH_CACHE_ENTRY *entry = NULL;
+  const uint8_t *data = NULL;
+  uint32_t bitOffset = 0;
+  uint32_t width;
+  uint32_t height;
+  int32_t xOffset;
+  int32_t yOffset;
+  uint32_t delta;
+
+  //
+  // get the glyph from the cache, decoding it into the cache if it's not there
+  //
+  if (glyphCacheAvailable())
+  {
+    entry = findCachedGlyph(font, c);
+    if (entry == NULL)
+      entry = addGlyphToCache(font, c);
+  }
 
-  dtostrf(n, 1, digitsRightOfDecimal, stringBuffer);
-  lcdPrintRightJustified(stringBuffer);
+  if (entry != NULL)
+  {
+    width = entry->width;
+    height = entry->height;
+    xOffset = entry->xOffset;
+    yOffset = entry->yOffset;
+    delta = entry->delta;
+  }
+  else
+  {
+    data = fontGetGlyph(font, c);
+    if (data == NULL)
+      return;
+    bitOffset = fontReadGlyphHeader(font, data, &width, &height, &xOffset, &yOffset, &delta);
+  }
+
+  //
+  // position the character, wrapping to the next line when it doesn't fit
+  //
+  lcd->getCursor(&cursorX, &cursorY);
+  int16_t startCursorX = cursorX;
+  int16_t startCursorY = cursorY;
+  if (cursorX < 0) cursorX = 0;
+  int originX = cursorX + xOffset;
+  if (originX < 0)
+  {
+    cursorX -= xOffset;
+    originX = 0;
+  }
+  if (originX + (int)width > lcdWidth)
+  {
+    originX = 0;
+    cursorX = (xOffset >= 0) ? 0 : -xOffset;
+    cursorY += font->line_space;
+  }
+  if (cursorY >= lcdHeight)
+  {
+    lcd->setCursorWithoutLimits(cursorX, cursorY);
+    return;
+  }
+  lcd->setCursorWithoutLimits(cursorX + delta, cursorY);
+
+  //
+  // skip characters outside of the clip rectangle, let the LCD driver draw uncached 
+  // characters completely inside it
+  //
+  int y = cursorY + font->cap_height - height - yOffset;
+  int clipping = getClipping(originX, y, originX + width - 1, y + height - 1);
+  if (clipping == CLIP_OUTSIDE)
+    return;
+  if ((framebuffer == NULL) && (clipping == CLIP_INSIDE) && !rasterMeasureOnlyFlg && (entry == NULL))
+  {
+    finishSpans();
+    lcd->setCursorWithoutLimits(startCursorX, startCursorY);
+    lcd->drawFontChar(c);
+    return;
+  }
+
+  uint16_t color = lcd->getTextColor();
+  if (entry == NULL)
+  {
+    decodeGlyphRuns(data, bitOffset, width, height, NULL, originX, y, color);
+    return;
+  }
+
+  //
+  // fill the cached glyph's runs
+  //
+  int blockIdx = entry->firstBlock;
+  for (int i = 0; i < entry->runCount; i++)
+  {
+    LCD_GLYPH_RUN *run = &glyphRunBlocks[blockIdx].runs[i % LCD_GLYPH_RUNS_PER_BLOCK];
+    rasterFillRect(originX + run->x, y + run->y, run->length, run->repeat, color);
+    if ((i % LCD_GLYPH_RUNS_PER_BLOCK) == LCD_GLYPH_RUNS_PER_BLOCK - 1)
+      blockIdx = glyphRunBlocks[blockIdx].nextBlock;
+  }
 }
 
 
 
 //
-// print a string to the LCD, centered side-to-side at the cursor 
-//  Enter:  s -> string to print 
+// decode the runs of set pixels in a glyph's rows, either filling them or storing 
+// them in a glyph cache entry
+//  Enter:  data -> the glyph
+//          bitOffset = bit offset of the glyph's first row
+//          width, height = size of the glyph
+//          entry -> cache entry to store the runs in, NULL to fill them instead
+//          originX, y = screen coords of the glyph's upper left corner when filling
+//          color = color to fill with
+//  Exit:   true returned on success, false if the cache has no room for the runs
 //
-void TeensyUserInterface::lcdPrintCentered(char *s)
+boolean TeensyUserInterface::decodeGlyphRuns(const uint8_t *data, uint32_t bitOffset, int width, 
+  int height, LCD_GLYPH_CACHE_ENTRY *entry, int originX, int y, uint16_t color)
 {
-  int cursorX;
-  int cursorY;
+  int rowY = 0;
+  int lastBlock = -1;
 
-  lcdGetCursorXY(&cursorX, &cursorY);           // get the current cursor position
-  int stringWidth = lcdStringWidthInPixels(s);  // get the width of the string to print
-  cursorX = cursorX - stringWidth/2;            // determine new X coord for cursor to center
+  //
+  // a row can be repeated several times
+  //
+  while (rowY < height)
+  {
+    uint32_t repeat = 1;
+    if (fontFetchBit(data, bitOffset++))
+    {
+      repeat = fontFetchBitsUnsigned(data, bitOffset, 3) + 2;
+      bitOffset += 3;
+    }
 
-  if (cursorX < 0)                              // set the new cursor position
-    cursorX = 0;
-  lcdSetCursorXY(cursorX, cursorY);
-  
-  lcdPrint(s);                                  // print the string
-}
+    //
+    // find each run of set bits in the row
+    //
+    int runStart = -1;
+    for (int x = 0; x <= width; x++)
+    {
+      if ((x < width) && fontFetchBit(data, bitOffset + x))
+      {
+        if (runStart < 0)
+          runStart = x;
+        continue;
+      }
+      if (runStart < 0)
+        continue;
 
-void TeensyUserInterface::lcdPrintCentered(const char *s)
-{
-  lcdPrintCentered((char *) s);
+      if (entry == NULL)
+        rasterFillRect(originX + runStart, y + rowY, x - runStart, repeat, color);
+      else
+      {
+        //
+        // store the run, starting a new block when the last one is full
+        //
+        int runIdx = entry->runCount % LCD_GLYPH_RUNS_PER_BLOCK;
+        if (runIdx == 0)
+        {
+          int blockIdx = allocateGlyphRunBlock(entry);
+          if (blockIdx < 0)
+            return(false);
+          if (lastBlock < 0)
+            entry->firstBlock = blockIdx;
+          else
+            glyphRunBlocks[lastBlock].nextBlock = blockIdx;
+          lastBlock = blockIdx;
+        }
+
+        LCD_GLYPH_RUN *run = &glyphRunBlocks[lastBlock].runs[runIdx];
+        run->x = runStart;
+        run->y = rowY;
+        run->length = x - runStart;
+        run->repeat = repeat;
+        entry->runCount++;
+      }
+      runStart = -1;
+    }
+
+    bitOffset += width;
+    rowY += repeat;
+  }
+  return(true);
 }
 
 
+// ---------------------------------------------------------------------------------
+//                                 Glyph cache functions
+// ---------------------------------------------------------------------------------
 
 //
-// print a signed int to the LCD, centered side-to-side at the cursor
-//  Enter:  n = signed number to print 
+// Text drawn by the rasterizer reads each character's glyph from a cache of decoded 
+// runs, so the bit packed font data is only decoded the first time a character is
+// drawn.  Glyphs are found by font and character.  When the cache fills, the least 
+// recently used glyphs are dropped.  The cache is off until lcdSetGlyphCacheSize() is 
+// called, then text is drawn by the rasterizer rather than the LCD driver.
 //
-void TeensyUserInterface::lcdPrintCentered(int n)
-{
-  char stringBuffer[14];
-  
-  itoa(n, stringBuffer, 10);
-  lcdPrintCentered(stringBuffer);
-}
-
 
 
 //
-// print a float to the LCD, centered side-to-side at the cursor
-//          digitsRightOfDecimal = number of digits to display right of decimal point (optional)
-//  Enter:  n = signed number to print 
+// enable the glyph cache and set its size, the cache is off by default
+//  Enter:  maxGlyphs = number of characters the cache holds (64 is typical), 0 to 
+//            disable the cache
+//          maxRuns = number of runs of pixels the cache holds for all of its characters 
+//            (512 is typical), a 10 point character is typically 10 to 20 runs, each 
+//            run uses 4 bytes of RAM
+//  Exit:   true returned on success, false if the memory couldn't be allocated
 //
-void TeensyUserInterface::lcdPrintCentered(double n, int digitsRightOfDecimal)
+boolean TeensyUserInterface::lcdSetGlyphCacheSize(int maxGlyphs, int maxRuns)
 {
-  char stringBuffer[40];
+  free(glyphCache);
+  free(glyphRunBlocks);
+  glyphCache = NULL;
+  glyphRunBlocks = NULL;
 
-  dtostrf(n, 1, digitsRightOfDecimal, stringBuffer);
-  lcdPrintCentered(stringBuffer);
+  if ((maxGlyphs <= 0) || (maxRuns <= 0))
+  {
+    glyphCacheMaxGlyphs = 0;
+    return(true);
+  }
+
+  glyphCacheMaxGlyphs = maxGlyphs;
+  glyphCacheMaxBlocks = (maxRuns + LCD_GLYPH_RUNS_PER_BLOCK - 1) / LCD_GLYPH_RUNS_PER_BLOCK;
+  if (glyphCacheMaxBlocks > 32767)
+    glyphCacheMaxBlocks = 32767;
+  glyphCacheFailedFlg = false;
+  return(glyphCacheAvailable());
 }
 
 
 
 //
-// print one ASCII charater to the LCD, at location of the cursor
-//  Enter:  c = character to display
+// get the number of characters found and not found in the glyph cache
+//  Enter:  hits -> storage to return the number of characters drawn from the cache
+//          misses -> storage to return the number of characters decoded from the font
 //
-void TeensyUserInterface::lcdPrintCharacter(byte character)
+void TeensyUserInterface::lcdGetGlyphCacheStatistics(unsigned long *hits, unsigned long *misses)
 {
-  lcd->drawFontChar(character);
+  *hits = glyphCacheHits;
+  *misses = glyphCacheMisses;
 }
 
 
 
 //
-// get the width of a string in pixels
+// clear the glyph cache statistics
 //
-int TeensyUserInterface::lcdStringWidthInPixels(char *s)
-{
-  return(lcd->strPixelLen(s));
-}
-
-int TeensyUserInterface::lcdStringWidthInPixels(const char *s)
+void TeensyUserInterface::lcdClearGlyphCacheStatistics(void)
 {
-  return(lcd->strPixelLen((char *) s));
+  glyphCacheHits = 0;
+  glyphCacheMisses = 0;
 }
 
 
 
 //
-// get the height of the selected font in pixels, excluding decenders
+// check if the glyph cache is enabled, allocating it when first used
+//  Exit:   true returned if the cache can be used
 //
-int TeensyUserInterface::lcdGetFontHeightWithoutDecenders(void)
+boolean TeensyUserInterface::glyphCacheAvailable(void)
 {
-  return(currentFont->cap_height);
+  if (glyphCache != NULL)
+    return(true);
+  if ((glyphCacheMaxGlyphs == 0) || glyphCacheFailedFlg)
+    return(false);
+
+  glyphCache = (LCD_GLYPH_CACHE_ENTRY *) malloc(glyphCacheMaxGlyphs * sizeof(LCD_GLYPH_CACHE_ENTRY));
+  glyphRunBlocks = (LCD_GLYPH_RUN_BLOCK *) malloc(glyphCacheMaxBlocks * sizeof(LCD_GLYPH_RUN_BLOCK));
+  if ((glyphCache == NULL) || (glyphRunBlocks == NULL))
+  {
+    free(glyphCache);
+    free(glyphRunBlocks);
+    glyphCache = NULL;
+    glyphRunBlocks = NULL;
+    glyphCacheFailedFlg = true;
+    return(false);
+  }
+
+  //
+  // mark all entries unused and chain all blocks into the free list
+  //
+  for (int i = 0; i < glyphCacheMaxGlyphs; i++)
+    glyphCache[i].font = NULL;
+
+  for (int i = 0; i < glyphCacheMaxBlocks; i++)
+    glyphRunBlocks[i].nextBlock = i + 1;
+  glyphRunBlocks[glyphCacheMaxBlocks - 1].nextBlock = -1;
+  glyphFreeBlock = 0;
+  return(true);
 }
 
 
 
 //
-// get the height of the selected font in pixels, including decenders & line spacing
+// find a character in the glyph cache
+//  Enter:  font -> the character's font
+//          c = the character
+//  Exit:   pointer to the cache entry returned, NULL if not in the cache
 //
-int TeensyUserInterface::lcdGetFontHeightWithDecentersAndLineSpacing(void)
+LCD_GLYPH_CACHE_ENTRY *TeensyUserInterface::findCachedGlyph(const ui_font *font, unsigned int c)
 {
-  return(currentFont->line_space);
+  for (int i = 0; i < glyphCacheMaxGlyphs; i++)
+  {
+    LCD_GLYPH_CACHE_ENTRY *entry = &glyphCache[i];
+    if ((entry->font == font) && (entry->character == c))
+    {
+      entry->lastUsed = ++glyphCacheClock;
+      glyphCacheHits++;
+      return(entry);
+    }
+  }
+
+  glyphCacheMisses++;
+  return(NULL);
 }
 
 
 
 //
-// set the cursor coords in pixels
-//  Enter:  x  0 = left most pixel
-//          y  0 = left most pixel
+// decode a character's glyph into the cache, replacing the least recently used 
+// character when the cache is full
+//  Enter:  font -> the character's font
+//          c = the character
+//  Exit:   pointer to the cache entry returned, NULL if the font doesn't have the 
+//            character or it can't be cached
 //
-void TeensyUserInterface::lcdSetCursorXY(int x, int y)
+LCD_GLYPH_CACHE_ENTRY *TeensyUserInterface::addGlyphToCache(const ui_font *font, unsigned int c)
 {
-  if ((x < 0) || (x >= lcdWidth)) return;
-  if ((y < 0) || (y >= lcdHeight)) return;
-  
-  lcd->setCursor(x, y);
+  uint32_t width;
+  uint32_t height;
+  int32_t xOffset;
+  int32_t yOffset;
+  uint32_t delta;
+
+  const uint8_t *data = fontGetGlyph(font, c);
+  if (data == NULL)
+    return(NULL);
+
+  uint32_t bitOffset = fontReadGlyphHeader(font, data, &width, &height, &xOffset, &yOffset, &delta);
+  if ((width > 255) || (height > 255) || (delta > 255) || 
+      (xOffset < -128) || (xOffset > 127) || (yOffset < -128) || (yOffset > 127))
+    return(NULL);
+
+  //
+  // use an unused entry, otherwise the least recently used one
+  //
+  LCD_GLYPH_CACHE_ENTRY *entry = &glyphCache[0];
+  for (int i = 0; i < glyphCacheMaxGlyphs; i++)
+  {
+    if (glyphCache[i].font == NULL)
+    {
+      entry = &glyphCache[i];
+      break;
+    }
+    if (glyphCache[i].lastUsed < entry->lastUsed)
+      entry = &glyphCache[i];
+  }
+  freeCachedGlyph(entry);
+
+  entry->font = font;
+  entry->character = c;
+  entry->width = width;
+  entry->height = height;
+  entry->xOffset = xOffset;
+  entry->yOffset = yOffset;
+  entry->delta = delta;
+  entry->runCount = 0;
+  entry->firstBlock = -1;
+  entry->lastUsed = ++glyphCacheClock;
+
+  //
+  // glyphs with more runs than the whole cache holds are drawn uncached
+  //
+  if (!decodeGlyphRuns(data, bitOffset, width, height, entry, 0, 0, 0))
+  {
+    freeCachedGlyph(entry);
+    return(NULL);
+  }
+  return(entry);
 }
 
 
 
 //
-// get the cursor coords in pixels
-//  Enter:  x -> storage to return X,  0 = left most pixel
-//          y -> storage to return Y,  0 = left most pixel
+// get a free block for storing glyph runs, dropping least recently used characters 
+// from the cache until one is free
+//  Enter:  buildingEntry -> the entry the block is for, it's never dropped
+//  Exit:   index of the block returned, -1 if there isn't one
 //
-void TeensyUserInterface::lcdGetCursorXY(int *x, int *y)
+int TeensyUserInterface::allocateGlyphRunBlock(LCD_GLYPH_CACHE_ENTRY *buildingEntry)
 {
-  int16_t x1;
-  int16_t y1;
+  while (glyphFreeBlock < 0)
+  {
+    LCD_GLYPH_CACHE_ENTRY *oldestEntry = NULL;
+    for (int i = 0; i < glyphCacheMaxGlyphs; i++)
+    {
+      LCD_GLYPH_CACHE_ENTRY *entry = &glyphCache[i];
+      if ((entry->font == NULL) || (entry == buildingEntry))
+        continue;
+      if ((oldestEntry == NULL) || (entry->lastUsed < oldestEntry->lastUsed))
+        oldestEntry = entry;
+    }
 
-  lcd->getCursor(&x1, &y1);
-  *x = x1;
-  *y = y1;
+    if (oldestEntry == NULL)
+      return(-1);
+    freeCachedGlyph(oldestEntry);
+  }
+
+  int blockIdx = glyphFreeBlock;
+  glyphFreeBlock = glyphRunBlocks[blockIdx].nextBlock;
+  glyphRunBlocks[blockIdx].nextBlock = -1;
+  return(blockIdx);
 }
 
 
 
 //
-// make a RGB565 color
-//  Enter:  red (0 to 31)
-//          green (0 to 63) Note: green value 0x20 has same intensity as blue value 0x10
-//          blue (0 to 31)
-//  Exit:   16 bit color returned, bit format: rrrrrggggggbbbbb
+// remove a character from the glyph cache, returning its blocks to the free list
+//  Enter:  entry -> the cache entry
 //
-uint16_t TeensyUserInterface::lcdMakeColor(int red, int green, int blue)
+void TeensyUserInterface::freeCachedGlyph(LCD_GLYPH_CACHE_ENTRY *entry)
 {
-  return((red << 11) + (green << 5) + (blue));
+  if (entry->font == NULL)
+    return;
+
+  int blockIdx = entry->firstBlock;
+  for (int i = 0; i < entry->runCount; i += LCD_GLYPH_RUNS_PER_BLOCK)
+  {
+    int nextBlockIdx = glyphRunBlocks[blockIdx].nextBlock;
+    glyphRunBlocks[blockIdx].nextBlock = glyphFreeBlock;
+    glyphFreeBlock = blockIdx;
+    blockIdx = nextBlockIdx;
+  }
+
+  entry->font = NULL;
 }
 
 
@@ -3488,7 +8967,7 @@ byte TeensyUserInterface::readConfigurationByte(int EEPromAddress, byte defaultV
   if (EEPROM.read(EEPromAddress) == 0xff)
     return(defaultValue);
 	
-    return(EEPROM.read(EEPromAddress + 1));
+  return(EEPROM.read(EEPromAddress + 1));
 }
 
 
@@ -107,6 +107,26 @@ typedef struct
 } BUTTON_EXTENDED;
 
 
+//
+// touch timing, how long touches and releases must last before they're reported, 
+// and how auto repeat speeds up while a touch is held, every repeatsPerStepChange 
+// repeats a Number Box's step grows to: step * stepMultiplier + stepIncrease 
+// (in multiples of its stepAmount, starting at 1 and never more than maximumStep), 
+// e.g. {30, 800, 120, 16, 1, 1, 0} grows the step by one every 16 repeats, and
+// {30, 500, 100, 10, 10, 0, 1000} grows it tenfold every 10 repeats, up to 1000
+//
+typedef struct
+{
+  int debouncePeriod;           // milliseconds a touch or release must last
+  int autoRepeatDelay;          // milliseconds a touch is held before it starts repeating
+  int autoRepeatRate;           // milliseconds between repeats
+  int repeatsPerStepChange;     // 0 for a step that never changes
+  int stepMultiplier;
+  int stepIncrease;
+  int maximumStep;              // 0 for no limit
+} TOUCH_TIMING;
+
+
 //
 // definition of a integer Number Box 
 //
@@ -160,6 +180,26 @@ typedef struct
 } SELECTION_BOX;
 
 
+//
+// a toggle that owns its state and the labels for each of its states, the button's
+// text is composed once each time the state changes, declare it like this:
+//    const char *ledOptions[] = {"Off", "On"};
+//    MENU_TOGGLE ledToggle = {0, 2, ledOptions};
+//
+const int MENU_TOGGLE_LABEL_LENGTH = 40;
+
+typedef struct
+{
+  int state;
+  int optionCount;
+  const char * const *optionLabels;
+  boolean dirtyFlg;
+  boolean labelValidFlg;
+  int labelState;
+  char label[MENU_TOGGLE_LABEL_LENGTH];
+} MENU_TOGGLE;
+
+
 //
 // definition of an entry in menu's table
 //
@@ -172,6 +212,77 @@ typedef struct _MENU_ITEM
 } MENU_ITEM;
 
 
+//
+// a menu whose buttons come from the application when they're shown, rather than
+// from a table, itemCount() returns the number of buttons, getItem() fills in the 
+// entry for one button, it's only called for the buttons on the screen
+//
+typedef struct
+{
+  int (*itemCount)(void);
+  void (*getItem)(int itemIdx, MENU_ITEM *menuItem);
+} MENU_DYNAMIC;
+
+
+//
+// the grid of buttons for the current menu, built once when the menu is selected
+//
+typedef struct
+{
+  MENU_ITEM *menu;
+  MENU_DYNAMIC *dynamic;
+  int displaySpaceLeftX;
+  int displaySpaceTopY;
+  int displaySpaceWidth;
+  int displaySpaceHeight;
+  int buttonCount;
+  int columns;
+  int rows;
+  int buttonWidth;
+  int buttonHeight;
+  int spacing;
+  int topY;
+  int leftX;
+  int lastRowLeftX;
+  int lastRowButtonCount;
+  boolean scrollFlg;
+  int scrollY;
+  int maxScrollY;
+} MENU_LAYOUT;
+
+
+//
+// the menus the user went through to get to the current menu, each level keeps 
+// its layout, scroll position and the button last touched so Back restores it
+//
+const int MENU_HISTORY_DEPTH = 8;
+
+typedef struct
+{
+  MENU_ITEM *menu;
+  MENU_LAYOUT layout;
+  int lastTouchedMenuIdx;
+} MENU_HISTORY_ENTRY;
+
+
+//
+// what's drawn in each button slot of the menu on the screen, so that going to 
+// another menu only redraws the buttons that differ
+//
+const int MENU_MAX_SLOTS = 32;
+
+typedef struct
+{
+  int16_t x;
+  int16_t y;
+  int16_t width;
+  int16_t height;
+  byte menuItemType;
+  boolean selectedFlg;
+  const char *labelText;
+} MENU_SLOT;
+
+
 //
 // types of entries in a menu table
 //
@@ -181,6 +292,20 @@ const byte MENU_ITEM_TYPE_SUB_MENU         = 2;
 const byte MENU_ITEM_TYPE_COMMAND          = 3;
 const byte MENU_ITEM_TYPE_TOGGLE           = 4;
 const byte MENU_ITEM_TYPE_END_OF_MENU      = 5;
+const byte MENU_ITEM_TYPE_TOGGLE_STATE     = 6;
+const byte MENU_ITEM_TYPE_DYNAMIC          = 7;
+
+
+//
+// the MENU_TOGGLE used by a MENU_ITEM_TYPE_TOGGLE_STATE entry, placed in its fourth field
+//
+#define MENU_TOGGLE_STATE(toggle)  ((MENU_ITEM *) &(toggle))
+
+
+//
+// the MENU_DYNAMIC used by a MENU_ITEM_TYPE_DYNAMIC entry, placed in its fourth field
+//
+#define MENU_DYNAMIC_ITEMS(dynamic)  ((MENU_ITEM *) &(dynamic))
 
 
 //
@@ -192,6 +317,155 @@ const byte MENU_ITEM_TYPE_END_OF_MENU      = 5;
 #define MENU_COLUMNS_4  ((void (*)()) 4)
 
 
+//
+// a menu table with its size worked out when compiled, build it with 
+// makeMenuDescriptor<columns>(menuTable) so that no time is spent searching the 
+// table for its end
+//
+// Only the column count and the table's length are checked when compiled, the 
+// table's entries can't be read in a constant expression.  The rest is checked once 
+// when the descriptors are given to beginMenu(): the first entry must be a header 
+// with the same MENU_COLUMNS_n and the last must be MENU_ITEM_TYPE_END_OF_MENU.  A 
+// descriptor that doesn't match its table is ignored and the table is searched.
+//
+typedef struct
+{
+  MENU_ITEM *menu;
+  int buttonCount;
+  int columns;
+  int rows;
+} MENU_DESCRIPTOR;
+
+template <int COLUMNS, int N>
+constexpr MENU_DESCRIPTOR makeMenuDescriptor(MENU_ITEM (&menu)[N])
+{
+  static_assert((COLUMNS >= 1) && (COLUMNS <= 4), "a menu has 1 to 4 columns of buttons");
+  static_assert(N >= 3, "a menu table needs a header, at least one button and an end of menu entry");
+  return(MENU_DESCRIPTOR{menu, N - 2, COLUMNS, (N - 2 + COLUMNS - 1) / COLUMNS});
+}
+
+
+//
+// descriptors are found from their menu tables with a hash table, so finding one 
+// takes the same time however many there are, up to half this many descriptors are 
+// kept in it, the tables of any others are searched
+//
+const int MENU_DESCRIPTOR_HASH_SIZE = 64;
+
+
+//
+// a rectangle on the LCD, the corners are inclusive
+//
+typedef struct
+{
+  int16_t x1;
+  int16_t y1;
+  int16_t x2;
+  int16_t y2;
+} LCD_RECT;
+
+
+//
+// number of dirty regions remembered by the framebuffer before they are merged
+//
+const int LCD_MAX_DIRTY_RECTS = 16;
+
+
+//
+// width and height of the tiles used to skip sending unchanged parts of the framebuffer
+//
+const int LCD_TILE_SIZE = 16;
+
+
+//
+// number of clip rectangles that can be pushed
+//
+const int LCD_MAX_CLIP_RECTS = 8;
+
+
+//
+// a drawing command recorded in a display list, bounds is the region of the screen
+// it draws into
+//
+typedef struct
+{
+  byte commandType;
+  byte culledFlg;
+  uint16_t color;
+  int16_t params[6];
+  LCD_RECT bounds;
+  const void *data;
+} LCD_DISPLAY_LIST_COMMAND;
+
+
+//
+// a run of set pixels in a decoded character glyph, repeated down "repeat" rows
+//
+typedef struct
+{
+  uint8_t x;
+  uint8_t y;
+  uint8_t length;
+  uint8_t repeat;
+} LCD_GLYPH_RUN;
+
+
+//
+// the runs of cached glyphs are stored in a chain of fixed size blocks
+//
+const int LCD_GLYPH_RUNS_PER_BLOCK = 8;
+
+typedef struct
+{
+  LCD_GLYPH_RUN runs[LCD_GLYPH_RUNS_PER_BLOCK];
+  int16_t nextBlock;
+} LCD_GLYPH_RUN_BLOCK;
+
+
+//
+// a decoded character glyph in the glyph cache, font is NULL for an unused entry
+//
+typedef struct
+{
+  const ui_font *font;
+  unsigned int character;
+  uint8_t width;
+  uint8_t height;
+  int8_t xOffset;
+  int8_t yOffset;
+  uint8_t delta;
+  int16_t runCount;
+  int16_t firstBlock;
+  unsigned long lastUsed;
+} LCD_GLYPH_CACHE_ENTRY;
+
+
+//
+// the advances of a font's characters, looked up when measuring strings
+//
+const int LCD_MAX_FONT_ADVANCE_TABLES = 4;
+const int LCD_FONT_ADVANCE_TABLE_SIZE = 128;
+
+typedef struct
+{
+  const ui_font *font;
+  uint8_t advance[LCD_FONT_ADVANCE_TABLE_SIZE];
+} LCD_FONT_ADVANCE_TABLE;
+
+
+//
+// the remembered width of a string that never changes
+//
+const int LCD_MAX_MEMOIZED_WIDTHS = 16;
+
+typedef struct
+{
+  const ui_font *font;
+  const char *s;
+  int width;
+} LCD_MEMOIZED_WIDTH;
+
+
 //
 // types of touch events
 //
@@ -199,6 +473,99 @@ const int TOUCH_NO_EVENT         = 0;       // no event from the touch screen (n
 const int TOUCH_PUSHED_EVENT     = 1;       // touch screen just touched
 const int TOUCH_RELEASED_EVENT   = 2;       // touch screen just released
 const int TOUCH_REPEAT_EVENT     = 3;       // touch screen touched and event repeating
+const int TOUCH_MOVE_EVENT       = 4;       // touch moved while touched (see setTouchMoveEvents())
+
+const int TOUCH_IRQ_PIN_NONE     = 255;     // the touch screen's IRQ pin isn't connected
+
+
+//
+// touch filters, with a filter a touch is reported once its last few samples are 
+// firmly pressed and steady, rather than after a fixed debounce delay
+//
+const int TOUCH_FILTER_OFF          = 0;    // each sample used as is, touches debounced by time
+const int TOUCH_FILTER_MEDIAN       = 1;    // position is the median of the samples
+const int TOUCH_FILTER_TRIMMED_MEAN = 2;    // position is the mean, leaving out the highest and lowest
+
+const int TOUCH_FILTER_MAX_SAMPLES  = 9;
+
+
+//
+// touch screen calibration, converts raw touch screen coordinates to LCD coordinates:
+//    lcdX = (xScaleX * rawX  +  xScaleY * rawY  +  xOffset) >> TOUCH_CALIBRATION_SHIFT
+//    lcdY = (yScaleX * rawX  +  yScaleY * rawY  +  yOffset) >> TOUCH_CALIBRATION_SHIFT
+// all six values are fixed point with TOUCH_CALIBRATION_SHIFT fraction bits, a touch 
+// screen that's rotated or skewed from the LCD uses xScaleY and yScaleX.  There is one 
+// rounding rule: the values are rounded up when made, and the shift rounds down, so a 
+// point that works out to a whole pixel isn't truncated to one less, and the rest 
+// truncate like the float divide this replaced
+//
+const int TOUCH_CALIBRATION_SHIFT = 21;
+
+typedef struct
+{
+  int32_t xScaleX;
+  int32_t xScaleY;
+  int32_t xOffset;
+  int32_t yScaleX;
+  int32_t yScaleY;
+  int32_t yOffset;
+} TOUCH_CALIBRATION;
+
+
+//
+// a calibration made with calibrateTouchScreen() is saved in EEPROM, one for each LCD 
+// orientation, at the address given to setTouchScreenCalibrationEEPromAddress(), by 
+// default they aren't saved
+//
+const int TOUCH_CALIBRATION_EEPROM_SLOT_SIZE = 7 * 5;   // a marker and 6 ints, 5 bytes each
+const int TOUCH_CALIBRATION_EEPROM_SIZE      = 4 * TOUCH_CALIBRATION_EEPROM_SLOT_SIZE;
+
+
+//
+// touch events waiting for the application, in the order they happened, events are 
+// added by sampleTouchScreen() and removed by getTouchEvents(), which may run in an 
+// interrupt and the main loop, so each end of the queue has its own index
+//
+const int TOUCH_EVENT_QUEUE_SIZE = 16;      // must be a power of 2
+
+typedef struct
+{
+  byte eventType;
+  int16_t x;
+  int16_t y;
+  unsigned long timeMicros;
+} TOUCH_EVENT;
+
+
+//
+// a touch sensitive area of the screen, registered when a widget is drawn so that a 
+// touch event is matched to its widget with one lookup in a coarse grid of cells, 
+// each cell has a bit for every region that overlaps it
+//
+const int TOUCH_REGION_MAX        = 32;
+const int TOUCH_REGION_CELL_SHIFT = 5;      // cells are 32 x 32 pixels
+const int TOUCH_REGION_GRID_SIZE  = 10;     // enough cells to cover 320 pixels
+
+typedef struct
+{
+  const void *owner;
+  int16_t x1;
+  int16_t y1;
+  int16_t x2;
+  int16_t y2;
+} TOUCH_REGION;
+
+
+//
+// status returned by pollMenu()
+//
+const int MENU_STATUS_NOT_RUNNING  = 0;     // no menu has been started with beginMenu()
+const int MENU_STATUS_IDLE         = 1;     // the menu is showing, nothing was touched
+const int MENU_STATUS_TOUCHED      = 2;     // a touch was handled, such as a button pushed or the menu scrolled
+const int MENU_STATUS_COMMAND      = 3;     // a command was executed
+const int MENU_STATUS_TOGGLED      = 4;     // a toggle was changed
+const int MENU_STATUS_MENU_CHANGED = 5;     // a sub menu or parent menu was selected
+const int MENU_STATUS_EXITED       = 6;     // Back was pressed on the main menu, the menus are done
 
 
 //
@@ -223,8 +590,10 @@ class TeensyUserInterface
     int touchEventType;
     int touchEventX;
     int touchEventY;
+    unsigned long touchEventMicros;
     byte toggleSelectNextStateFlg;
     const char *toggleText;
+    int dynamicMenuItemIndex;
 
 
     //
@@ -232,15 +601,30 @@ class TeensyUserInterface
     //
     TeensyUserInterface(void);
     void begin(int lcdCSPin, int LcdDCPin, int TouchScreenCSPin, int lcdOrientation, const ui_font &font);
+    void begin(int lcdCSPin, int LcdDCPin, int TouchScreenCSPin, int TouchScreenIRQPin, int lcdOrientation, const ui_font &font);
     void setOrientation(int lcdOrientation);
     void setColorPaletteBlue(void);
     void setColorPaletteGray(void);
 
     void setMenuColors(uint16_t _menuBackgroundColor, uint16_t _menuButtonColor, uint16_t _menuButtonSelectedColor, uint16_t _menuButtonFrameColor, uint16_t _menuButtonTextColor);
     void setMenuFont(const ui_font &font);
+    void setMenuScrolling(int buttonHeight);
+    void setMenuDisplayList(boolean enableFlg);
     void selectAndDrawMenu(MENU_ITEM *menu, boolean drawMenuFlg);
     void displayAndExecuteMenu(MENU_ITEM *menu);
+    void displayAndExecuteMenu(const MENU_DESCRIPTOR *menus, int menuCount);
+    void displayAndExecuteMenu(const MENU_DESCRIPTOR &menu) { displayAndExecuteMenu(&menu, 1); }
+    template <int N> void displayAndExecuteMenu(const MENU_DESCRIPTOR (&menus)[N]) { displayAndExecuteMenu(menus, N); }
     void setInMenuCallbackFunction(void (*callbackFunction)());
+    void beginMenu(MENU_ITEM *menu);
+    void beginMenu(const MENU_DESCRIPTOR *menus, int menuCount);
+    void beginMenu(const MENU_DESCRIPTOR &menu) { beginMenu(&menu, 1); }
+    template <int N> void beginMenu(const MENU_DESCRIPTOR (&menus)[N]) { beginMenu(menus, N); }
+    int pollMenu(void);
+    void setToggleState(MENU_TOGGLE &toggle, int state);
+    boolean setMenuSnapshotCache(long budgetBytes, void *snapshotMemory = NULL);
+    void getMenuSnapshotStatistics(unsigned long *hits, unsigned long *misses, long *bytesUsed);
+    void clearMenuSnapshotStatistics(void);
  
     void setTitleBarColors(uint16_t _titleBarColor, uint16_t _titleBarTextColor, uint16_t _titleBarBackButtonColor, uint16_t _titleBarBackButtonSelectedColor);
     void setTitleBarFont(const ui_font &font);
@@ -251,6 +635,8 @@ class TeensyUserInterface
     boolean checkForMenuButtonClicked(void);
     void clearDisplaySpace(void);
     void clearDisplaySpace(uint16_t backgroundColor);
+    boolean scrollDisplaySpace(int rows);
+    boolean scrollDisplaySpace(int rows, uint16_t backgroundColor);
 
     void drawButton(BUTTON &uiButton);
     void drawButton(BUTTON &uiButton, boolean buttonSelectedFlg);
@@ -268,17 +654,32 @@ class TeensyUserInterface
 
     void drawNumberBox(NUMBER_BOX &numberBox);
     void drawNumberBox(NUMBER_BOX_FLOAT &numberBox);
-    boolean checkForNumberBoxTouched(NUMBER_BOX &numberBox);
-    boolean checkForNumberBoxTouched(NUMBER_BOX_FLOAT &numberBox);
+    boolean checkForNumberBoxTouched(NUMBER_BOX &numberBox, const TOUCH_TIMING *numberBoxTouchTiming = NULL);
+    boolean checkForNumberBoxTouched(NUMBER_BOX_FLOAT &numberBox, const TOUCH_TIMING *numberBoxTouchTiming = NULL);
 
     void drawSelectionBox(SELECTION_BOX &selectionBox);
     boolean checkForSelectionBoxTouched(SELECTION_BOX &selectionBox);
 
     boolean checkForTouchEventInRect(int eventType, int rectX1, int rectY1, int rectX2, int rectY2);
     void getTouchEvents(void);
+    void sampleTouchScreen(void);
+    void setTouchSamplingFromInterrupt(boolean interruptFlg);
+    void setTouchMoveEvents(int moveDistance);
+    void setTouchFilter(int filterType, int sampleCount = 3, int pressureThreshold = 400, int jitterPixels = 4);
+    void setTouchTiming(const TOUCH_TIMING *timing);
+    void addTouchRegion(const void *owner, int x, int y, int width, int height);
+    void clearTouchRegions(void);
+    const void *findTouchRegionForTouchEvent(void);
     void setDefaultTouchScreenCalibrationConstants(int lcdOrientation);
     void setTouchScreenCalibrationConstants(int tsToLCDOffsetX, float tsToLCDScalerX, int tsToLCDOffsetY, float tsToLCDScalerY);
+    void setTouchScreenCalibration(const TOUCH_CALIBRATION &calibration);
+    void getTouchScreenCalibration(TOUCH_CALIBRATION *calibration);
+    boolean calibrateTouchScreen(int pointCount = 5);
+    static boolean solveTouchScreenCalibration(const int *rawX, const int *rawY, const int *lcdX, const int *lcdY, int pointCount, TOUCH_CALIBRATION *calibration);
+    void setTouchScreenCalibrationEEPromAddress(int EEPromAddress);
     boolean getTouchScreenCoords(int *xLCD, int *yLCD);
+    unsigned long getTouchScreenDriverCallCount(void);
+    void clearTouchScreenDriverCallCount(void);
 
     void lcdClearScreen(uint16_t color);
     void lcdDrawPixel(int x, int y, uint16_t color);
@@ -316,6 +717,33 @@ class TeensyUserInterface
     void lcdSetCursorXY(int x, int y);
     void lcdGetCursorXY(int *x, int *y);
     uint16_t lcdMakeColor(int red, int green, int blue);
+    boolean lcdPushClipRect(int x, int y, int width, int height);
+    void lcdPopClipRect(void);
+    void lcdSetSpanFills(boolean enableFlg);
+    void lcdBeginBatch(void);
+    void lcdEndBatch(void);
+    void lcdGetSpanStatistics(unsigned long *spansDrawn, unsigned long *addressWindowsSet);
+    void lcdClearSpanStatistics(void);
+
+    boolean lcdEnableFramebuffer(uint16_t *framebufferMemory = NULL);
+    void lcdDisableFramebuffer(void);
+    void lcdFlush(void);
+    void lcdStartFlush(void);
+    void lcdContinueFlush(void);
+    boolean lcdFlushInProgress(void);
+    void lcdSetFlushChunkSize(int pixelsPerChunk);
+    void lcdSetFlushCompleteCallbackFunction(void (*callbackFunction)());
+    void lcdGetTileStatistics(unsigned long *tilesSent, unsigned long *tilesSkipped);
+    void lcdClearTileStatistics(void);
+
+    void lcdBeginDisplayList(void);
+    void lcdEndDisplayList(void);
+    boolean lcdSetDisplayListSize(int maxCommands, int maxTextBytes);
+    void lcdGetDisplayListStatistics(int *commandsRecorded, int *commandsCulled, int *commandsMerged, long *pixelsSaved);
+
+    boolean lcdSetGlyphCacheSize(int maxGlyphs, int maxRuns);
+    void lcdGetGlyphCacheStatistics(unsigned long *hits, unsigned long *misses);
+    void lcdClearGlyphCacheStatistics(void);
 
     void writeConfigurationByte(int EEPromAddress, byte value);
     byte readConfigurationByte(int EEPromAddress, byte defaultValue);
@@ -333,6 +761,35 @@ class TeensyUserInterface
     // private member variables
     //
     MENU_ITEM *currentMenuTable;
+    MENU_LAYOUT menuLayout;
+    const MENU_DESCRIPTOR *menuDescriptors;
+    int8_t menuDescriptorHash[MENU_DESCRIPTOR_HASH_SIZE];
+    int menuScrollButtonHeight;
+    boolean menuDisplayListFlg;
+    MENU_SLOT menuSlots[MENU_MAX_SLOTS];
+    int menuSlotCount;
+    boolean menuOnScreenFlg;
+    const char *menuTitleText;
+    boolean menuTitleBackButtonFlg;
+    int menuDrawingDepth;
+    unsigned long lcdDrawCount;
+    unsigned long menuScreenDrawCount;
+    boolean toggleDirtyFlg;
+    boolean menuRunningFlg;
+    MENU_HISTORY_ENTRY menuHistory[MENU_HISTORY_DEPTH];
+    int menuHistoryTop;
+    int menuHistoryCount;
+    int menuLastTouchedIdx;
+    MENU_ITEM dynamicMenuItem;
+    uint16_t *menuSnapshot;
+    uint16_t *menuSnapshotRow;
+    long menuSnapshotBudget;
+    boolean menuSnapshotAllocatedFlg;
+    boolean menuSnapshotValidFlg;
+    long menuSnapshotLength;
+    uint32_t menuSnapshotSignature;
+    unsigned long menuSnapshotHits;
+    unsigned long menuSnapshotMisses;
     const ui_font *currentFont;
     void (*inMenuCallbackFunction)();
 
@@ -351,22 +808,144 @@ class TeensyUserInterface
     const ui_font *menuButtonFont;
 
     int numberBoxRepeatCount;
+    long numberBoxStepFactor;
 
-    int touchScreenToLCDOffsetX;
-    float touchScreenToLCDScalerX;
-    int touchScreenToLCDOffsetY;
-    float touchScreenToLCDScalerY;
+    TOUCH_CALIBRATION touchCalibration;
+    int touchCalibrationEEPromAddress;
     int touchState;
+    unsigned long touchEventStartTime;
+    int touchRecordedX;
+    int touchRecordedY;
+    int touchMoveX;
+    int touchMoveY;
+    int touchMoveDistance;
+    const TOUCH_TIMING *touchTiming;
+    const TOUCH_TIMING *touchActiveTiming;
+    boolean touchSamplingFromInterruptFlg;
+    int touchFilterType;
+    int touchFilterSampleCount;
+    int touchFilterPressureThreshold;
+    int touchFilterJitterPixels;
+    int16_t touchFilterX[TOUCH_FILTER_MAX_SAMPLES];
+    int16_t touchFilterY[TOUCH_FILTER_MAX_SAMPLES];
+    boolean touchFilterPressedFlg[TOUCH_FILTER_MAX_SAMPLES];
+    int touchFilterIdx;
+    int touchFilterLength;
+    unsigned long touchFilterSampleMicros;
+    int touchFilterResult;
+    int touchFilterResultX;
+    int touchFilterResultY;
+    TOUCH_EVENT touchEventQueue[TOUCH_EVENT_QUEUE_SIZE];
+    volatile byte touchEventQueueHead;
+    volatile byte touchEventQueueTail;
+    boolean touchEventDroppedFlg;
+    boolean touchScreenIRQFlg;
+    unsigned long touchScreenDriverCallCount;
+    TOUCH_REGION touchRegions[TOUCH_REGION_MAX];
+    int touchRegionCount;
+    int touchRegionSearchIdx;
+    uint32_t touchRegionGrid[TOUCH_REGION_GRID_SIZE][TOUCH_REGION_GRID_SIZE];
+    boolean touchRegionGridValidFlg;
+    uint32_t touchEventHitMask;
+    boolean touchEventHitMaskValidFlg;
+
+    uint16_t *framebuffer;
+    boolean framebufferAllocatedFlg;
+    LCD_RECT dirtyRects[LCD_MAX_DIRTY_RECTS];
+    int dirtyRectCount;
+    int pendingDirtyX1;
+    int pendingDirtyY1;
+    int pendingDirtyX2;
+    int pendingDirtyY2;
+    LCD_RECT flushQueue[LCD_MAX_DIRTY_RECTS];
+    int flushQueueCount;
+    int flushQueueIdx;
+    int flushRowY;
+    int flushX;
+    int flushChunkSize;
+    void (*flushCompleteCallbackFunction)();
+    uint32_t *tileChecksums;
+    byte *tileFlags;
+    unsigned long tileSentCount;
+    unsigned long tileSkippedCount;
+    boolean rasterMeasureOnlyFlg;
+    LCD_RECT clipRect;
+    LCD_RECT clipStack[LCD_MAX_CLIP_RECTS];
+    int clipStackCount;
+    boolean spanPendingFlg;
+    boolean spanTransactionFlg;
+    int spanX1;
+    int spanY1;
+    int spanX2;
+    int spanY2;
+    uint16_t spanColor;
+    int batchDepth;
+    int currentOrientation;
+    int scrollOffset;
+    boolean lcdSpanFillsFlg;
+    unsigned long spanCount;
+    unsigned long addressWindowCount;
+
+    LCD_DISPLAY_LIST_COMMAND *displayList;
+    char *displayListText;
+    int displayListMaxCommands;
+    int displayListMaxTextBytes;
+    int displayListCount;
+    int displayListTextLength;
+    int displayListDepth;
+    int displayListRecordedCount;
+    int displayListCulledCount;
+    int displayListMergedCount;
+    long displayListPixelsSaved;
+    LCD_RECT displayListClipRect;
+
+    LCD_GLYPH_CACHE_ENTRY *glyphCache;
+    LCD_GLYPH_RUN_BLOCK *glyphRunBlocks;
+    int glyphCacheMaxGlyphs;
+    int glyphCacheMaxBlocks;
+    int glyphFreeBlock;
+    boolean glyphCacheFailedFlg;
+    unsigned long glyphCacheClock;
+    unsigned long glyphCacheHits;
+    unsigned long glyphCacheMisses;
+
+    LCD_FONT_ADVANCE_TABLE fontAdvanceTables[LCD_MAX_FONT_ADVANCE_TABLES];
+    int fontAdvanceTableNext;
+    LCD_FONT_ADVANCE_TABLE *currentFontAdvances;
+    LCD_MEMOIZED_WIDTH memoizedWidths[LCD_MAX_MEMOIZED_WIDTHS];
+    int memoizedWidthNext;
+    const char *constantLabelText;
 
 
     //
     // private functions
     //
+    void runMenus(void);
     void executeMenuItem(int menuIdx);
     void drawMenu(void);
     void drawMenuItem(int menuIdx, boolean buttonSelectedFlg);
     int findMenuButtonForTouchEvent(void);
     void getMenuButtonSizeAndLocation(int menuButtonNumber, int *buttonX, int *buttonY, int *buttonWidth, int *buttonHeight);
+    MENU_LAYOUT *getMenuLayout(void);
+    void setMenuDescriptors(const MENU_DESCRIPTOR *menus, int menuCount);
+    const MENU_DESCRIPTOR *findMenuDescriptor(MENU_ITEM *menu);
+    void buildMenuLayout(void);
+    void drawMenuChanges(void);
+    void drawSelectedMenu(void);
+    void pushMenuHistory(void);
+    boolean popMenuHistory(void);
+    void drawDirtyToggles(void);
+    const char *getToggleLabel(MENU_ITEM *menuItem);
+    MENU_ITEM *getMenuItem(int menuIdx);
+    void getVisibleMenuButtons(int *firstMenuIdx, int *lastMenuIdx);
+    void captureMenuSnapshot(void);
+    boolean restoreMenuSnapshot(void);
+    uint32_t getMenuSignature(void);
+    void drawMenuRows(int y1, int y2);
+    void scrollMenu(int buttonRows);
+    boolean checkForMenuScrollButtons(void);
+    void drawMenuScrollButton(int direction, boolean buttonSelectedFlg);
+    void getMenuScrollButtonSizeAndLocation(int direction, int *buttonX, int *buttonY, int *buttonWidth, int *buttonHeight);
 
     void drawTitleBar(const char *titleBarText, int buttonType);
     void drawTitleBarBackButton(boolean buttonSelectedFlg);
@@ -376,7 +955,7 @@ class TeensyUserInterface
 
     void drawDownButtonInNumberBox(NUMBER_BOX &numberBox, boolean showButtonTouchedFlg);
     void drawUpButtonInNumberBox(NUMBER_BOX &numberBox, boolean showButtonTouchedFlg);
-    boolean updateNumberBoxNumber(NUMBER_BOX &numberBox, int stepAmount);
+    boolean updateNumberBoxNumber(NUMBER_BOX &numberBox, int64_t stepAmount);
     void drawNumberInNumberBox(NUMBER_BOX &numberBox);
     void getNumberBoxCoordinates(NUMBER_BOX &numberBox, int *downButtonX, int *numberX, int *upButtonX, int *topY, int *buttonWidth, int *numberWidth, int *height);
     void drawDownButtonInNumberBoxFloat(NUMBER_BOX_FLOAT &numberBox, boolean showButtonTouchedFlg);
@@ -391,10 +970,68 @@ class TeensyUserInterface
 
     void touchScreenInitialize(int lcdOrientation);
     void touchScreenSetOrientation(int lcdOrientation);
-    boolean getRAWTouchScreenCoords(int *xRaw, int *yRaw);
+    boolean getRAWTouchScreenCoords(int *xRaw, int *yRaw, int *pressure = NULL);
+    void convertTouchScreenCoords(int xRaw, int yRaw, int *xLCD, int *yLCD);
+    int getFilteredTouchScreenCoords(int *xLCD, int *yLCD);
+    void clearTouchFilter(void);
+    void startNumberBoxRepeat(const TOUCH_TIMING *timing);
+    long getNumberBoxRepeatStep(void);
+    void queueTouchEvent(int eventType, int x, int y, unsigned long timeMicros);
+    boolean dequeueTouchEvent(TOUCH_EVENT *event);
+    void discardTouchEvents(void);
+    boolean getTouchCalibrationSample(int *xRaw, int *yRaw);
+    void drawTouchCalibrationTarget(int x, int y, uint16_t color);
+    boolean readSavedTouchScreenCalibration(int lcdOrientation);
+    void writeSavedTouchScreenCalibration(int lcdOrientation);
+    void registerTouchRegion(const void *owner, int x1, int y1, int x2, int y2);
+    boolean touchEventMayHit(const void *owner, int x1, int y1, int x2, int y2);
+    void removeTouchRegionsUnder(int x1, int y1, int x2, int y2);
+    int findTouchRegion(const void *owner);
+    uint32_t getTouchEventHitMask(void);
+    void buildTouchRegionGrid(void);
      
     void lcdInitialize(int lcdOrientation, const ui_font &font);
     void lcdSetOrientation(int lcdOrientation);
+    void resetDisplaySpaceScroll(void);
+    void setHardwareScroll(void);
+    int mapRowsToMemory(int y, int lastY, int *memoryY);
+
+    void countLcdDrawing(void);
+    int getClipping(int x1, int y1, int x2, int y2);
+    void addPendingDirtyRect(void);
+    void clearPendingDirtyRect(void);
+    void addDirtyRect(int x1, int y1, int x2, int y2);
+    void findChangedTiles(void);
+    boolean findChangedTileRun(int y, int *runX1, int *runX2);
+    boolean recordDisplayListCommand(byte commandType, uint16_t color, int p0, int p1, int p2, int p3, int p4, int p5, const void *data);
+    boolean recordDisplayListText(byte commandType, const char *s, unsigned int character);
+    void compileDisplayList(void);
+    void playDisplayList(void);
+    void rasterFillRect(int x, int y, int width, int height, uint16_t color);
+    void addSpan(int x1, int y1, int x2, int y2, uint16_t color);
+    void sendPendingSpan(void);
+    void finishSpans(void);
+    void rasterDrawLine(int x1, int y1, int x2, int y2, uint16_t color);
+    void rasterDrawRectangle(int x, int y, int width, int height, uint16_t color);
+    void rasterDrawRoundedRectangle(int x, int y, int width, int height, int radius, uint16_t color);
+    void rasterDrawTriangle(int x0, int y0, int x1, int y1, int x2, int y2, uint16_t color);
+    void rasterDrawCircle(int x, int y, int radius, uint16_t color);
+    void rasterDrawCircleCorners(int x, int y, int radius, int corners, uint16_t color);
+    void rasterFillCircle(int x, int y, int radius, uint16_t color);
+    void rasterFillCircleHalves(int x, int topY, int bottomY, int radius, int stretchX, uint16_t color);
+    void rasterFillRoundedRectangle(int x, int y, int width, int height, int radius, uint16_t color);
+    void rasterFillTriangle(int x0, int y0, int x1, int y1, int x2, int y2, uint16_t color);
+    void rasterDrawImage(int x, int y, int width, int height, const uint16_t *image);
+    void rasterPrint(const char *s);
+    void rasterDrawFontCharacter(unsigned int c);
+    boolean glyphCacheAvailable(void);
+    LCD_FONT_ADVANCE_TABLE *getFontAdvanceTable(const ui_font *font);
+    int constantStringWidthInPixels(const char *s);
+    LCD_GLYPH_CACHE_ENTRY *findCachedGlyph(const ui_font *font, unsigned int c);
+    LCD_GLYPH_CACHE_ENTRY *addGlyphToCache(const ui_font *font, unsigned int c);
+    int allocateGlyphRunBlock(LCD_GLYPH_CACHE_ENTRY *buildingEntry);
+    void freeCachedGlyph(LCD_GLYPH_CACHE_ENTRY *entry);
+    boolean decodeGlyphRuns(const uint8_t *data, uint32_t bitOffset, int width, int height, LCD_GLYPH_CACHE_ENTRY *entry, int originX, int y, uint16_t color);
 };
 
 // ------------------------------------ End ---------------------------------